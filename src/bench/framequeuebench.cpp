@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares DataQueue and RingQueue in the scope frame fan-out: one producer
+ * pushes every frame into the queue of each scope (size 3, discard oldest),
+ * like ScopeController::newFrame -> ScopeWidget::onNewFrame, and every scope
+ * drains its queue with count() and pop() in its own thread, works on the
+ * newest frame for a while and polls again.
+ *
+ *   paced   frames at the given rate; reports the time the producer spends
+ *           pushing one frame to all scopes and the age of a frame when a
+ *           scope pops it
+ *   flood   the producer pushes as fast as it can for the same duration
+ *
+ *   framequeuebench [scopes] [fps] [seconds] [work microseconds]
+ */
+
+#include "dataqueue.h"
+#include "ringqueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Copying a SharedFrame only bumps an atomic reference count, like this.
+struct Frame
+{
+    std::shared_ptr<const std::vector<uint8_t>> image;
+    Clock::time_point pushed;
+};
+
+struct Result
+{
+    std::vector<double> pushNs;   // per frame, all scopes
+    std::vector<double> ageUs;    // per popped frame
+    double pushesPerSecond = 0.0; // flood only
+    long popped = 0;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    size_t n = std::min(values.size() - 1, size_t(values.size() * p));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+void work(int microseconds)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(microseconds);
+    while (Clock::now() < end) {
+    }
+}
+
+template<class Queue>
+Result run(int scopes, int fps, double seconds, int workUs, bool paced)
+{
+    std::vector<std::unique_ptr<Queue>> queues;
+    for (int i = 0; i < scopes; i++)
+        queues.emplace_back(new Queue(3, Queue::OverflowModeDiscardOldest));
+
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<double>> ages(scopes);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < scopes; i++) {
+        consumers.emplace_back([&, i] {
+            Queue &queue = *queues[i];
+            std::vector<double> &age = ages[i];
+            Frame frame;
+            while (!stop.load(std::memory_order_relaxed)) {
+                bool got = false;
+                while (queue.count() > 0) {
+                    frame = queue.pop();
+                    got = true;
+                }
+                if (got) {
+                    std::chrono::duration<double, std::micro> d = Clock::now() - frame.pushed;
+                    age.push_back(d.count());
+                    work(workUs);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    Result result;
+    auto image = std::make_shared<const std::vector<uint8_t>>(1024);
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start
+                            + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(seconds));
+    std::chrono::nanoseconds period(1000000000LL / fps);
+    Clock::time_point next = start;
+    long pushes = 0;
+    while (Clock::now() < end) {
+        if (paced) {
+            std::this_thread::sleep_until(next);
+            next += period;
+        }
+        Frame frame;
+        frame.image = image;
+        frame.pushed = Clock::now();
+        for (auto &queue : queues)
+            queue->push(frame);
+        std::chrono::duration<double, std::nano> d = Clock::now() - frame.pushed;
+        if (paced)
+            result.pushNs.push_back(d.count());
+        pushes++;
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    stop = true;
+    for (auto &consumer : consumers)
+        consumer.join();
+
+    result.pushesPerSecond = pushes / elapsed.count();
+    for (auto &age : ages) {
+        result.ageUs.insert(result.ageUs.end(), age.begin(), age.end());
+        result.popped += age.size();
+    }
+    return result;
+}
+
+void report(const char *name, const Result &paced, const Result &flood)
+{
+    std::printf("%-10s push p50 %7.0f ns  p99 %7.0f ns  max %8.0f ns | age p50 %6.0f us  p99 "
+                "%6.0f us | flood %9.0f frames/s\n",
+                name,
+                percentile(paced.pushNs, 0.5),
+                percentile(paced.pushNs, 0.99),
+                percentile(paced.pushNs, 1.0),
+                percentile(paced.ageUs, 0.5),
+                percentile(paced.ageUs, 0.99),
+                flood.pushesPerSecond);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int scopes = argc > 1 ? std::max(1, std::atoi(argv[1])) : 8;
+    int fps = argc > 2 ? std::max(1, std::atoi(argv[2])) : 120;
+    double seconds = argc > 3 ? std::max(0.1, std::atof(argv[3])) : 3.0;
+    int workUs = argc > 4 ? std::max(0, std::atoi(argv[4])) : 2000;
+
+    std::printf("%d scopes, %d fps, %.1f s, %d us work per frame\n", scopes, fps, seconds, workUs);
+    Result dataPaced = run<DataQueue<Frame>>(scopes, fps, seconds, workUs, true);
+    Result dataFlood = run<DataQueue<Frame>>(scopes, fps, seconds, workUs, false);
+    report("DataQueue", dataPaced, dataFlood);
+    Result ringPaced = run<RingQueue<Frame>>(scopes, fps, seconds, workUs, true);
+    Result ringFlood = run<RingQueue<Frame>>(scopes, fps, seconds, workUs, false);
+    report("RingQueue", ringPaced, ringFlood);
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the video scope analysis on synthetic 1080p and 4K yuv420p frames.
+ *
+ *   per-scope   The loops the luma waveform, RGB parade, vector and histogram
+ *               scopes used to run on their own, each on its own image. The
+ *               RGB image is prepared outside the timing, so this leaves out
+ *               the mlt_image_rgb conversion they also paid for.
+ *   shared      One VideoScopeAnalysis::analyze() for all four, plus render()
+ *               of the waveform, parade and vector images, per kernel.
+ *
+ * Every kernel must produce the same analysis as the scalar one.
+ *
+ *   scopeanalysisbench [frames]
+ */
+
+#include "widgets/scopes/videoscopeanalysis.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int AllComponents = VideoScopeAnalysis::LumaWaveform | VideoScopeAnalysis::RgbWaveform
+                          | VideoScopeAnalysis::Vector | VideoScopeAnalysis::Histogram;
+
+struct Frame
+{
+    int width;
+    int height;
+    std::vector<uint8_t> yuv;
+    std::vector<uint8_t> rgb;
+};
+
+// A gradient with some noise, so that the waveforms are not a handful of
+// lines and the bins see a realistic spread.
+Frame makeFrame(int width, int height)
+{
+    Frame f;
+    f.width = width;
+    f.height = height;
+    f.yuv.resize(size_t(width) * height * 3 / 2);
+    std::mt19937 random(width);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    uint8_t *y = f.yuv.data();
+    uint8_t *u = y + size_t(width) * height;
+    uint8_t *v = u + size_t(width / 2) * (height / 2);
+    for (int row = 0; row < height; row++) {
+        for (int x = 0; x < width; x++) {
+            int value = 16 + 219 * x / width + noise(random);
+            y[size_t(row) * width + x] = uint8_t(std::min(255, std::max(0, value)));
+        }
+    }
+    for (int row = 0; row < height / 2; row++) {
+        for (int x = 0; x < width / 2; x++) {
+            u[size_t(row) * (width / 2) + x] = uint8_t(16 + 224 * row / (height / 2));
+            v[size_t(row) * (width / 2) + x] = uint8_t(240 - 224 * x / (width / 2)
+                                                       + noise(random) / 4);
+        }
+    }
+
+    // Packed BT.709 RGB for the per-scope loops, as mlt_image_rgb would deliver it.
+    f.rgb.resize(size_t(width) * height * 3);
+    uint8_t *rgb = f.rgb.data();
+    for (int row = 0; row < height; row++) {
+        for (int x = 0; x < width; x++) {
+            size_t c = size_t(row / 2) * (width / 2) + x / 2;
+            double yy = (y[size_t(row) * width + x] - 16) * 255.0 / 219.0;
+            double uu = (u[c] - 128) * 255.0 / 224.0;
+            double vv = (v[c] - 128) * 255.0 / 224.0;
+            double values[3] = {yy + 1.5748 * vv,
+                                yy - 0.1873 * uu - 0.4681 * vv,
+                                yy + 1.8556 * uu};
+            for (double value : values)
+                *rgb++ = uint8_t(std::min(255.0, std::max(0.0, value + 0.5)));
+        }
+    }
+    return f;
+}
+
+void perScope(const Frame &f, std::vector<uint8_t> &image, std::vector<unsigned int> &bins)
+{
+    const int width = f.width;
+    const int height = f.height;
+
+    // Luma waveform
+    image.assign(size_t(width) * 256 * 4, 0);
+    const uint8_t *src = f.yuv.data();
+    uint8_t *dst = image.data();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t dy = 255 - src[0];
+            size_t dIndex = (dy * width + x) * 4;
+            if (dst[dIndex] < 0xff) {
+                dst[dIndex] += 0x0f;
+                dst[dIndex + 1] += 0x0f;
+                dst[dIndex + 2] += 0x0f;
+            }
+            src++;
+        }
+    }
+
+    // RGB parade
+    int imgWidth = width * 3;
+    image.assign(size_t(imgWidth) * 256 * 4, 0);
+    src = f.rgb.data();
+    dst = image.data();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t rIndex = ((255 - src[0]) * imgWidth + x) * 4;
+            if (dst[rIndex] < 0xff)
+                dst[rIndex] += 0x0f;
+            size_t gIndex = ((255 - src[1]) * imgWidth + width + x) * 4 + 1;
+            if (dst[gIndex] < 0xff)
+                dst[gIndex] += 0x0f;
+            size_t bIndex = ((255 - src[2]) * imgWidth + width * 2 + x) * 4 + 2;
+            if (dst[bIndex] < 0xff)
+                dst[bIndex] += 0x0f;
+            src += 3;
+        }
+    }
+
+    // Vector
+    image.assign(256 * 256 * 4, 0);
+    const uint8_t *uSrc = f.yuv.data() + size_t(width) * height;
+    const uint8_t *vSrc = uSrc + size_t(width) * height / 4;
+    dst = image.data();
+    for (int y = 0; y < height / 2; y++) {
+        for (int x = 0; x < width / 2; x++) {
+            size_t dIndex = ((255 - *vSrc) * 256 + *uSrc) * 4;
+            if (dst[dIndex] < 0xff) {
+                dst[dIndex] += 0x0f;
+                dst[dIndex + 1] += 0x0f;
+                dst[dIndex + 2] += 0x0f;
+            }
+            uSrc++;
+            vSrc++;
+        }
+    }
+
+    // Histogram
+    bins.assign(256 * 4, 0);
+    const uint8_t *pYUV = f.yuv.data();
+    const uint8_t *pRGB = f.rgb.data();
+    size_t count = size_t(width) * height;
+    while (count--) {
+        bins[*pYUV++]++;
+        bins[256 + *pRGB++]++;
+        bins[512 + *pRGB++]++;
+        bins[768 + *pRGB++]++;
+    }
+}
+
+void shared(const Frame &f, VideoScopeAnalysis &analysis, std::vector<uint8_t> &image)
+{
+    analysis.analyze(f.yuv.data(), f.width, f.height, 709, false, AllComponents);
+
+    const int width = f.width;
+    image.resize(size_t(width) * 3 * 256 * 4);
+    for (int y = 0; y < 256; y++) {
+        const uint8_t *luma = analysis.lumaWaveform() + size_t(y) * width;
+        VideoScopeAnalysis::render(luma, luma, luma, width, image.data() + size_t(y) * width * 4);
+    }
+    for (int y = 0; y < 256; y++) {
+        uint8_t *line = image.data() + size_t(y) * width * 3 * 4;
+        size_t offset = size_t(y) * width;
+        VideoScopeAnalysis::render(analysis.rgbWaveform(VideoScopeAnalysis::Red) + offset,
+                                   nullptr,
+                                   nullptr,
+                                   width,
+                                   line);
+        VideoScopeAnalysis::render(nullptr,
+                                   analysis.rgbWaveform(VideoScopeAnalysis::Green) + offset,
+                                   nullptr,
+                                   width,
+                                   line + width * 4);
+        VideoScopeAnalysis::render(nullptr,
+                                   nullptr,
+                                   analysis.rgbWaveform(VideoScopeAnalysis::Blue) + offset,
+                                   width,
+                                   line + width * 8);
+    }
+    for (int y = 0; y < 256; y++) {
+        const uint8_t *counts = analysis.vector() + y * 256;
+        VideoScopeAnalysis::render(counts, counts, counts, 256, image.data() + y * 256 * 4);
+    }
+}
+
+bool same(const VideoScopeAnalysis &a, const VideoScopeAnalysis &b)
+{
+    size_t plane = size_t(a.width()) * VideoScopeAnalysis::Levels;
+    if (std::memcmp(a.lumaWaveform(), b.lumaWaveform(), plane)
+        || std::memcmp(a.vector(), b.vector(), 256 * 256))
+        return false;
+    for (int c = VideoScopeAnalysis::Red; c <= VideoScopeAnalysis::Blue; c++) {
+        VideoScopeAnalysis::Channel channel = VideoScopeAnalysis::Channel(c);
+        if (std::memcmp(a.rgbWaveform(channel), b.rgbWaveform(channel), plane))
+            return false;
+    }
+    for (int c = VideoScopeAnalysis::Red; c <= VideoScopeAnalysis::Luma; c++) {
+        VideoScopeAnalysis::Channel channel = VideoScopeAnalysis::Channel(c);
+        if (std::memcmp(a.histogram(channel), b.histogram(channel), 256 * sizeof(unsigned int)))
+            return false;
+    }
+    return true;
+}
+
+template<typename Function>
+double millisecondsPerFrame(int frames, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        function();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+    const char *const kernelNames[] = {"scalar", "sse4.1", "avx2"};
+    const VideoScopeAnalysis::Kernel best = VideoScopeAnalysis::bestKernel();
+    const int sizes[][2] = {{1920, 1080}, {3840, 2160}};
+    int status = 0;
+
+    std::printf("%d frames each, best kernel: %s\n", frames, kernelNames[best]);
+    for (const auto &size : sizes) {
+        Frame f = makeFrame(size[0], size[1]);
+        std::vector<uint8_t> image;
+        std::vector<unsigned int> bins;
+
+        double baseline = millisecondsPerFrame(frames, [&] { perScope(f, image, bins); });
+        std::printf("%dx%d per-scope            %8.2f ms\n", f.width, f.height, baseline);
+
+        VideoScopeAnalysis::setKernel(VideoScopeAnalysis::KernelScalar);
+        VideoScopeAnalysis reference;
+        reference.analyze(f.yuv.data(), f.width, f.height, 709, false, AllComponents);
+
+        for (int k = VideoScopeAnalysis::KernelScalar; k <= best; k++) {
+            VideoScopeAnalysis::setKernel(VideoScopeAnalysis::Kernel(k));
+            VideoScopeAnalysis analysis;
+            double ms = millisecondsPerFrame(frames, [&] { shared(f, analysis, image); });
+            bool ok = same(analysis, reference);
+            std::printf("%dx%d shared (%-6s)      %8.2f ms  %5.2fx%s\n",
+                        f.width,
+                        f.height,
+                        kernelNames[k],
+                        ms,
+                        baseline / ms,
+                        ok ? "" : "  MISMATCH");
+            if (!ok)
+                status = 1;
+        }
+    }
+    VideoScopeAnalysis::setKernel(best);
+    return status;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the thumbnail storage before and after ThumbnailCache on a set of
+ * timeline-sized thumbnails (synthetic video frames) in a temporary folder:
+ *
+ *   png     one PNG file per key; get() touches the file with utime() and
+ *           decodes it, like Database did
+ *   cache   ThumbnailCache
+ *
+ * For each it reports put and get latency and the disk usage. The gets are in
+ * random order, like scrolling over a timeline with many clips.
+ *
+ *   thumbnailcachebench [thumbnails] [width] [height]
+ */
+
+#include "thumbnailcache.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <utime.h>
+#include <vector>
+
+namespace {
+
+struct Latency
+{
+    std::vector<double> us;
+
+    void add(qint64 ns) { us.push_back(ns / 1000.0); }
+    double percentile(double p) const
+    {
+        if (us.empty())
+            return 0.0;
+        std::vector<double> sorted = us;
+        size_t n = std::min(sorted.size() - 1, size_t(sorted.size() * p));
+        std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+        return sorted[n];
+    }
+};
+
+QImage makeThumbnail(int width, int height, int seed)
+{
+    // A gradient per clip with some noise, so that it compresses like video.
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    QImage image(width, height, QImage::Format_RGB32);
+    int r = random() % 200, g = random() % 200, b = random() % 200;
+    for (int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; x++) {
+            int shade = 48 * x / width + 24 * y / height + noise(random);
+            line[x] = qRgb(qBound(0, r + shade, 255),
+                           qBound(0, g + shade, 255),
+                           qBound(0, b + shade, 255));
+        }
+    }
+    return image;
+}
+
+QString keyOf(int i)
+{
+    // Like ThumbnailProvider::cacheKey(): the hash of the clip and a time. It
+    // is also a valid file name, as the PNG files need.
+    QByteArray clip = QCryptographicHash::hash(QByteArray::number(i / 20), QCryptographicHash::Md5);
+    return QStringLiteral("%1 00:00:%2.%3")
+        .arg(QString::fromLatin1(clip.toHex()))
+        .arg(i % 20, 2, 10, QChar('0'))
+        .arg(i * 7 % 100, 2, 10, QChar('0'));
+}
+
+qint64 folderSize(const QString &path)
+{
+    qint64 result = 0;
+    for (const QFileInfo &info : QDir(path).entryInfoList(QDir::Files))
+        result += info.size();
+    return result;
+}
+
+void report(const char *name, const Latency &put, const Latency &get, qint64 bytes, int misses)
+{
+    std::printf("%-6s put p50 %8.1f us  p99 %8.1f us | get p50 %8.1f us  p99 %8.1f us | "
+                "disk %7.1f MiB%s\n",
+                name,
+                put.percentile(0.5),
+                put.percentile(0.99),
+                get.percentile(0.5),
+                get.percentile(0.99),
+                bytes / 1048576.0,
+                misses ? "  MISSES" : "");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int count = argc > 1 ? std::max(1, atoi(argv[1])) : 2000;
+    const int width = argc > 2 ? std::max(1, atoi(argv[2])) : 192;
+    const int height = argc > 3 ? std::max(1, atoi(argv[3])) : 108;
+    QTemporaryDir temp;
+    if (!temp.isValid())
+        return 1;
+
+    std::vector<QImage> images;
+    for (int i = 0; i < count; i++)
+        images.push_back(makeThumbnail(width, height, i));
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    std::printf("%d thumbnails of %dx%d\n", count, width, height);
+    QElapsedTimer timer;
+    int status = 0;
+
+    // One PNG per key
+    {
+        QDir dir(temp.filePath("png"));
+        dir.mkpath(".");
+        Latency put, get;
+        int misses = 0;
+        for (int i = 0; i < count; i++) {
+            QString fileName = keyOf(i).replace(':', '-') + ".png";
+            timer.start();
+            bool saved = images[i].save(dir.filePath(fileName));
+            put.add(timer.nsecsElapsed());
+            if (!saved)
+                misses++;
+        }
+        for (int i : order) {
+            QString filePath = dir.filePath(keyOf(i).replace(':', '-') + ".png");
+            timer.start();
+            ::utime(filePath.toUtf8().constData(), nullptr);
+            QImage image(filePath);
+            get.add(timer.nsecsElapsed());
+            if (image.isNull())
+                misses++;
+        }
+        report("png", put, get, folderSize(dir.path()), misses);
+        if (misses)
+            status = 1;
+    }
+
+    // ThumbnailCache
+    {
+        ThumbnailCache cache(temp.filePath("cache"), 256 * 1024 * 1024);
+        Latency put, get;
+        int misses = 0;
+        for (int i = 0; i < count; i++) {
+            QString key = keyOf(i);
+            timer.start();
+            cache.put(key, images[i]);
+            put.add(timer.nsecsElapsed());
+        }
+        for (int i : order) {
+            QString key = keyOf(i);
+            timer.start();
+            QImage image = cache.get(key);
+            get.add(timer.nsecsElapsed());
+            if (image != images[i])
+                misses++;
+        }
+        report("cache", put, get, cache.diskUsage(), misses);
+        if (misses)
+            status = 1;
+    }
+    return status;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013-2022 Meltytech, LLC
+ * Copyright (c) 2013-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,26 +18,41 @@
 #include "database.h"
 
 #include "Logger.h"
-#include "dialogs/longuitask.h"
 #include "settings.h"
+#include "thumbnailcache.h"
 
-#include <utime.h>
 #include <QDir>
-#include <QFileInfo>
-#include <QtSql>
+#include <QtConcurrent/QtConcurrent>
 
 static QMutex g_mutex;
 static Database *instance = nullptr;
-static const int kMaxThumbnailCount = 5000;
-static const int kDeleteThumbnailsTimeoutMs = 60000;
+static const qint64 kMaxThumbnailBytes = 256 * 1024 * 1024;
+static const qint64 kMaxThumbnailMemoryBytes = 64 * 1024 * 1024;
+static const int kCompactThumbnailsTimeoutMs = 60000;
 
 Database::Database(QObject *parent)
     : QObject(parent)
+    , m_images(kMaxThumbnailMemoryBytes)
 {
-    m_deleteTimer.setInterval(kDeleteThumbnailsTimeoutMs);
-    connect(&m_deleteTimer, SIGNAL(timeout()), this, SLOT(deleteOldThumbnails()));
-    thumbnailsDir(); // convert from db to filesystem if needed
-    m_deleteTimer.start();
+    QDir dir(Settings.appDataLocation());
+    m_thumbnails.reset(new ThumbnailCache(dir.filePath("thumbnailcache"), kMaxThumbnailBytes));
+    // Thumbnails used to be one PNG file each in this folder.
+    if (dir.cd("thumbnails")) {
+        m_future = QtConcurrent::run([=]() {
+            QDir legacy = dir;
+            LOG_INFO() << "removing" << legacy.path();
+            legacy.removeRecursively();
+        });
+    }
+    m_compactTimer.setInterval(kCompactThumbnailsTimeoutMs);
+    connect(&m_compactTimer, SIGNAL(timeout()), this, SLOT(compactThumbnails()));
+    m_compactTimer.start();
+}
+
+Database::~Database()
+{
+    m_compactTimer.stop();
+    m_future.waitForFinished();
 }
 
 Database &Database::singleton(QObject *parent)
@@ -49,88 +64,107 @@ Database &Database::singleton(QObject *parent)
     return *instance;
 }
 
-static QString toFileName(const QString &s)
-{
-    QString result = s;
-    return result.replace(':', '-') + +".png";
-}
-
-QDir Database::thumbnailsDir()
+bool Database::putThumbnail(const QString &hash, const QImage &image)
 {
-    QDir dir(Settings.appDataLocation());
-    const char *subfolder = "thumbnails";
-    if (!dir.cd(subfolder)) {
-        if (dir.mkdir(subfolder)) {
-            dir.cd(subfolder);
-
-            // Convert the DB data to files on the filesystem.
-            LongUiTask longTask(QObject::tr("Converting Thumbnails"));
-            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-            QDir appDir(Settings.appDataLocation());
-            QString dbFilePath = appDir.filePath("db.sqlite3");
-            db.setDatabaseName(dbFilePath);
-            if (db.open()) {
-                QSqlQuery query;
-                QImage img;
-                query.setForwardOnly(true);
-                int n = -1;
-                if (query.exec("SELECT COUNT(*) FROM thumbnails;") && query.next()) {
-                    n = query.value(0).toInt();
-                }
-                query.exec(QStringLiteral("SELECT hash, accessed, image FROM thumbnails ORDER BY "
-                                          "accessed DESC LIMIT %1")
-                               .arg(kMaxThumbnailCount));
-                for (int i = 0; query.next(); i++) {
-                    QString fileName = toFileName(query.value(0).toString());
-                    longTask.reportProgress(
-                        QObject::tr(
-                            "Please wait for this one-time update to the thumbnail cache..."),
-                        i,
-                        n);
-                    if (img.loadFromData(query.value(2).toByteArray(), "PNG")) {
-                        img.save(dir.filePath(fileName));
-                        auto accessed = query.value(1).toDateTime();
-                        auto offset = accessed.timeZone().offsetFromUtc(accessed);
-                        struct utimbuf utimes
-                        {
-                            static_cast<time_t>(accessed.toSecsSinceEpoch() + offset),
-                                static_cast<time_t>(accessed.toSecsSinceEpoch() + offset)
-                        };
-                        ::utime(dir.filePath(fileName).toUtf8().constData(), &utimes);
-                    }
-                }
-                db.close();
-                QSqlDatabase::removeDatabase("QSQLITE");
-            }
+    if (image.isNull())
+        return false;
+    {
+        QMutexLocker locker(&m_imagesMutex);
+        m_images.insert(hash, new QImage(image), image.sizeInBytes());
+        if (QSharedPointer<Load> load = m_loads.value(hash)) {
+            load->replaced = true;
+            load->image = image;
         }
     }
-    return dir;
+    return m_thumbnails->put(hash, image);
 }
 
-bool Database::putThumbnail(const QString &hash, const QImage &image)
+QImage Database::getThumbnail(const QString &hash)
 {
-    return image.save(thumbnailsDir().filePath(toFileName(hash)));
+    return getThumbnail(hash, nullptr);
 }
 
-QImage Database::getThumbnail(const QString &hash)
+QImage Database::getThumbnail(const QString &hash, std::function<QImage()> make)
 {
-    QString filePath = thumbnailsDir().filePath(toFileName(hash));
-    ::utime(filePath.toUtf8().constData(), nullptr);
-    return QImage(filePath);
+    QMutexLocker locker(&m_imagesMutex);
+    for (;;) {
+        if (QImage *image = m_images.object(hash)) {
+            ++m_memoryHits;
+            return *image;
+        }
+        if (!m_loads.contains(hash))
+            break;
+        QSharedPointer<Load> load = m_loads.value(hash);
+        while (!load->done)
+            m_loadDone.wait(&m_imagesMutex);
+        if (!load->image.isNull()) {
+            // Loaded or made by another thread
+            ++m_memoryHits;
+            return load->image;
+        }
+        if (!make) {
+            ++m_misses;
+            return QImage();
+        }
+        // The other thread could not make it; try again as the loader.
+    }
+    QSharedPointer<Load> load(new Load);
+    m_loads.insert(hash, load);
+    locker.unlock();
+
+    QImage image = m_thumbnails->get(hash);
+    bool found = !image.isNull();
+    bool written = false;
+    if (!found && make) {
+        image = make();
+        if (!image.isNull())
+            written = m_thumbnails->put(hash, image);
+    }
+
+    locker.relock();
+    if (found)
+        ++m_diskHits;
+    else
+        ++m_misses;
+    if (load->replaced) {
+        // putThumbnail() was called meanwhile and already keeps its newer
+        // image in memory. If it wrote to disk before this thread did, write
+        // it again.
+        while (written && load->replaced) {
+            load->replaced = false;
+            image = load->image;
+            locker.unlock();
+            m_thumbnails->put(hash, image);
+            locker.relock();
+        }
+        image = load->image;
+    } else if (!image.isNull()) {
+        m_images.insert(hash, new QImage(image), image.sizeInBytes());
+    }
+    load->done = true;
+    load->image = image;
+    m_loads.remove(hash);
+    m_loadDone.wakeAll();
+    return image;
 }
 
-void Database::deleteOldThumbnails()
+void Database::compactThumbnails()
 {
-    auto result = QtConcurrent::run([=]() {
-        QDir dir = thumbnailsDir();
-        auto ls = dir.entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Readable, QDir::Time);
-        if (ls.size() - kMaxThumbnailCount > 0)
-            LOG_DEBUG() << "removing" << ls.size() - kMaxThumbnailCount;
-        for (int i = kMaxThumbnailCount; i < ls.size(); i++) {
-            QString filePath = dir.filePath(ls[i]);
-            if (!QFile::remove(filePath)) {
-                LOG_WARNING() << "failed to delete" << filePath;
-            }
+    {
+        QMutexLocker locker(&m_imagesMutex);
+        qint64 requests = m_memoryHits + m_diskHits + m_misses;
+        if (requests != m_loggedRequests) {
+            LOG_DEBUG() << "thumbnails from memory" << m_memoryHits << "from disk" << m_diskHits
+                        << "missing" << m_misses << "in memory" << m_images.size()
+                        << m_images.totalCost() << "bytes";
+            m_loggedRequests = requests;
         }
-    });
+    }
+
+    // Least recently used thumbnails are evicted as new ones are put; this
+    // only reclaims the space they leave in the cache files.
+    if (m_future.isFinished()) {
+        ThumbnailCache *thumbnails = m_thumbnails.data();
+        m_future = QtConcurrent::run([=]() { thumbnails->compact(); });
+    }
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013-2021 Meltytech, LLC
+ * Copyright (c) 2013-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,9 +18,19 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
-#include <QDir>
+#include <QCache>
+#include <QFuture>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSharedPointer>
 #include <QTimer>
+#include <QWaitCondition>
+
+#include <functional>
+
+class ThumbnailCache;
 
 class Database : public QObject
 {
@@ -28,17 +38,41 @@ class Database : public QObject
     explicit Database(QObject *parent = 0);
 
 public:
+    ~Database();
     static Database &singleton(QObject *parent = 0);
 
     bool putThumbnail(const QString &hash, const QImage &image);
     QImage getThumbnail(const QString &hash);
+    /*!
+      Returns the thumbnail for \a hash from memory or disk. On a miss it
+      calls \a make, if given, and stores the result. While one thread loads or
+      makes a thumbnail, other threads asking for the same \a hash wait for its
+      result instead of doing the work again.
+    */
+    QImage getThumbnail(const QString &hash, std::function<QImage()> make);
 
 private:
-    QDir thumbnailsDir();
-    QTimer m_deleteTimer;
+    struct Load
+    {
+        bool done = false;
+        bool replaced = false; // by putThumbnail() while loading
+        QImage image;
+    };
+
+    QScopedPointer<ThumbnailCache> m_thumbnails;
+    QMutex m_imagesMutex;
+    QWaitCondition m_loadDone;
+    QCache<QString, QImage> m_images; // decoded, cost in bytes
+    QHash<QString, QSharedPointer<Load>> m_loads;
+    qint64 m_memoryHits = 0;
+    qint64 m_diskHits = 0;
+    qint64 m_misses = 0;
+    qint64 m_loggedRequests = 0;
+    QTimer m_compactTimer;
+    QFuture<void> m_future;
 
 private slots:
-    void deleteOldThumbnails();
+    void compactThumbnails();
 };
 
 #define DB Database::singleton()
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2025 Meltytech, LLC
+ * Copyright (c) 2012-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -131,43 +131,32 @@ public:
         int inPoint = qRound(m_in / MLT.profile().fps() * m_profile.fps());
         int outPoint = qRound(m_out / MLT.profile().fps() * m_profile.fps());
 
-        QImage image = DB.getThumbnail(cacheKey(inPoint));
-        if (m_force || image.isNull()) {
-            image = makeThumbnail(inPoint);
-            m_producer.set(kThumbnailInProperty,
-                           new QImage(image),
-                           0,
-                           (mlt_destructor) deleteQImage,
-                           NULL);
-            DB.putThumbnail(cacheKey(inPoint), image);
-        } else {
-            m_producer.set(kThumbnailInProperty,
-                           new QImage(image),
+        m_producer.set(kThumbnailInProperty,
+                       new QImage(thumbnail(inPoint)),
+                       0,
+                       (mlt_destructor) deleteQImage,
+                       NULL);
+        if (setting == "tall" || setting == "wide") {
+            m_producer.set(kThumbnailOutProperty,
+                           new QImage(thumbnail(outPoint)),
                            0,
                            (mlt_destructor) deleteQImage,
                            NULL);
         }
-        if (setting == "tall" || setting == "wide") {
-            image = DB.getThumbnail(cacheKey(outPoint));
-            if (m_force || image.isNull()) {
-                image = makeThumbnail(outPoint);
-                m_producer.set(kThumbnailOutProperty,
-                               new QImage(image),
-                               0,
-                               (mlt_destructor) deleteQImage,
-                               NULL);
-                DB.putThumbnail(cacheKey(outPoint), image);
-            } else {
-                m_producer.set(kThumbnailOutProperty,
-                               new QImage(image),
-                               0,
-                               (mlt_destructor) deleteQImage,
-                               NULL);
-            }
-        }
         m_model->showThumbnail(m_row);
     }
 
+    QImage thumbnail(int frameNumber)
+    {
+        QString key = cacheKey(frameNumber);
+        if (m_force) {
+            QImage image = makeThumbnail(frameNumber);
+            DB.putThumbnail(key, image);
+            return image;
+        }
+        return DB.getThumbnail(key, [this, frameNumber]() { return makeThumbnail(frameNumber); });
+    }
+
     QImage makeThumbnail(int frameNumber)
     {
         int height = PlaylistModel::THUMBNAIL_HEIGHT * 2;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013-2023 Meltytech, LLC
+ * Copyright (c) 2013-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -27,15 +27,65 @@
 #include <QCryptographicHash>
 #include <QQuickImageProvider>
 
+#include <algorithm>
+#include <atomic>
+
+// Idle producers to keep open; they also count against MLT's avformat cache.
+static const int kMaxIdleProducers = 4;
+static const int kMaxThreads = 2;
+
+class ThumbnailResponse : public QQuickImageResponse
+{
+public:
+    QQuickTextureFactory *textureFactory() const override
+    {
+        return QQuickTextureFactory::textureFactoryForImage(m_image);
+    }
+
+    void cancel() override { m_canceled = true; }
+
+    bool isCanceled() const { return m_canceled; }
+
+    // Called from a worker; the engine only deletes the response after finished().
+    void setImage(const QImage &image)
+    {
+        QMetaObject::invokeMethod(
+            this,
+            [this, image]() {
+                m_image = image;
+                if (m_image.isNull()) {
+                    m_image = QImage(1, 1, QImage::Format_Alpha8);
+                    m_image.fill(0);
+                }
+                emit finished();
+            },
+            Qt::QueuedConnection);
+    }
+
+private:
+    QImage m_image;
+    std::atomic<bool> m_canceled{false};
+};
+
 ThumbnailProvider::ThumbnailProvider()
-    : QQuickImageProvider(QQmlImageProviderBase::Image,
-                          QQmlImageProviderBase::ForceAsynchronousImageLoading)
+    : QQuickAsyncImageProvider()
     , m_profile("atsc_720p_60")
-{}
+{
+    m_threadPool.setMaxThreadCount(kMaxThreads);
+}
+
+ThumbnailProvider::~ThumbnailProvider()
+{
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+    for (auto &idle : m_producers)
+        delete idle.second;
+}
 
-QImage ThumbnailProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+QQuickImageResponse *ThumbnailProvider::requestImageResponse(const QString &id,
+                                                             const QSize &requestedSize)
 {
-    QImage result;
+    ThumbnailResponse *response = new ThumbnailResponse;
 
     // id is [hash]/mlt_service/resource#frameNumber[!]
     // optional trailing '!' means to force update
@@ -59,34 +109,122 @@ QImage ThumbnailProvider::requestImage(const QString &id, QSize *size, const QSi
         resource = Util::removeQueryString(resource);
         properties.set("_profile", m_profile.get_profile(), 0);
 
-        QString key = cacheKey(properties, service, resource, hash, frameNumber);
-        result = DB.getThumbnail(key);
-        if (force || result.isNull()) {
-            if (service == "avformat-novalidate")
-                service = "avformat";
-            else if (service.startsWith("xml"))
-                service = "xml-nogl";
-            Mlt::Producer producer;
-            if (service == "count") {
-                producer = Mlt::Producer(m_profile, service.toUtf8().constData(), "loader-nogl");
-            } else if (!Settings.playerGPU() || (service != "xml-nogl" && service != "consumer")) {
-                producer = Mlt::Producer(m_profile,
-                                         service.toUtf8().constData(),
-                                         resource.toUtf8().constData());
-            }
-            if (producer.is_valid()) {
-                result = makeThumbnail(producer, frameNumber, requestedSize);
-                DB.putThumbnail(key, result);
+        Request request;
+        request.response = response;
+        request.key = cacheKey(properties, service, resource, hash, frameNumber);
+        request.frameNumber = frameNumber;
+        request.requestedSize = requestedSize;
+        request.force = force;
+
+        QString clip = QStringLiteral("%1 %2").arg(service, resource);
+        QMutexLocker locker(&m_mutex);
+        bool running = m_batches.contains(clip);
+        Batch &batch = m_batches[clip];
+        batch.service = service;
+        batch.resource = resource;
+        batch.requests.append(request);
+        if (!running)
+            m_threadPool.start([this, clip]() { runBatch(clip); });
+    } else {
+        response->setImage(QImage());
+    }
+    return response;
+}
+
+void ThumbnailProvider::runBatch(const QString &clip)
+{
+    Mlt::Producer *producer = nullptr;
+    bool fresh = false; // opened during this run
+    QMutexLocker locker(&m_mutex);
+    while (!m_batches[clip].requests.isEmpty()) {
+        QList<Request> requests;
+        requests.swap(m_batches[clip].requests);
+        QString service = m_batches[clip].service;
+        QString resource = m_batches[clip].resource;
+        locker.unlock();
+
+        std::sort(requests.begin(), requests.end(), [](const Request &a, const Request &b) {
+            return a.frameNumber < b.frameNumber;
+        });
+        for (const Request &request : requests) {
+            QImage image;
+            if (!request.response->isCanceled()) {
+                auto make = [&]() {
+                    if (request.force && !fresh) {
+                        // The media may have changed since the producer was opened.
+                        delete producer;
+                        delete takeIdleProducer(clip);
+                        producer = nullptr;
+                    }
+                    if (!producer)
+                        producer = takeIdleProducer(clip);
+                    if (!producer) {
+                        producer = newProducer(service, resource);
+                        fresh = true;
+                    }
+                    if (producer)
+                        return makeThumbnail(*producer, request.frameNumber, request.requestedSize);
+                    return QImage();
+                };
+                if (request.force) {
+                    image = make();
+                    DB.putThumbnail(request.key, image);
+                } else {
+                    // Delegates that show the same frame share one load or one make().
+                    image = DB.getThumbnail(request.key, make);
+                }
             }
+            request.response->setImage(image);
         }
+        locker.relock();
+    }
+    m_batches.remove(clip);
+
+    QList<Mlt::Producer *> evicted;
+    if (producer) {
+        m_producers.append(qMakePair(clip, producer));
+        while (m_producers.size() > kMaxIdleProducers)
+            evicted.append(m_producers.takeFirst().second);
     }
-    if (result.isNull()) {
-        result = QImage(1, 1, QImage::Format_Alpha8);
-        result.fill(0);
+    locker.unlock();
+    qDeleteAll(evicted);
+}
+
+Mlt::Producer *ThumbnailProvider::takeIdleProducer(const QString &clip)
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_producers.size(); i++) {
+        if (m_producers[i].first == clip)
+            return m_producers.takeAt(i).second;
     }
-    if (size)
-        *size = result.size();
-    return result;
+    return nullptr;
+}
+
+Mlt::Producer *ThumbnailProvider::newProducer(QString service, const QString &resource)
+{
+    if (service == "avformat-novalidate")
+        service = "avformat";
+    else if (service.startsWith("xml"))
+        service = "xml-nogl";
+    Mlt::Producer *producer = nullptr;
+    if (service == "count") {
+        producer = new Mlt::Producer(m_profile, service.toUtf8().constData(), "loader-nogl");
+    } else if (!Settings.playerGPU() || (service != "xml-nogl" && service != "consumer")) {
+        producer = new Mlt::Producer(m_profile,
+                                     service.toUtf8().constData(),
+                                     resource.toUtf8().constData());
+    }
+    if (!producer || !producer->is_valid()) {
+        delete producer;
+        return nullptr;
+    }
+    Mlt::Filter scaler(m_profile, "swscale");
+    Mlt::Filter padder(m_profile, "resize");
+    Mlt::Filter converter(m_profile, "avcolor_space");
+    producer->attach(scaler);
+    producer->attach(padder);
+    producer->attach(converter);
+    return producer;
 }
 
 QString ThumbnailProvider::cacheKey(Mlt::Properties &properties,
@@ -115,9 +253,6 @@ QImage ThumbnailProvider::makeThumbnail(Mlt::Producer &producer,
                                         int frameNumber,
                                         const QSize &requestedSize)
 {
-    Mlt::Filter scaler(m_profile, "swscale");
-    Mlt::Filter padder(m_profile, "resize");
-    Mlt::Filter converter(m_profile, "avcolor_space");
     int height = PlaylistModel::THUMBNAIL_HEIGHT * 2;
     int width = PlaylistModel::THUMBNAIL_WIDTH * 2;
 
@@ -126,8 +261,5 @@ QImage ThumbnailProvider::makeThumbnail(Mlt::Producer &producer,
         height = requestedSize.height();
     }
 
-    producer.attach(scaler);
-    producer.attach(padder);
-    producer.attach(converter);
     return MLT.image(producer, frameNumber, width, height);
 }
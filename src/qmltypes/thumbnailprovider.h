@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013-2016 Meltytech, LLC
+ * Copyright (c) 2013-2026 Meltytech, LLC
  * Author: Dan Dennedy <dan@dennedy.org>
  *
  * This program is free software: you can redistribute it and/or modify
@@ -21,22 +21,67 @@
 
 #include <MltProducer.h>
 #include <MltProfile.h>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
 #include <QQuickImageProvider>
+#include <QThreadPool>
 
-class ThumbnailProvider : public QQuickImageProvider
+class ThumbnailResponse;
+
+/*!
+  \class ThumbnailProvider
+  \brief The ThumbnailProvider makes the clip thumbnails of the timeline.
+
+  Requests are queued per clip, that is per service and resource. One worker
+  at a time takes all queued requests of a clip and serves them in frame
+  order, so that the decoder mostly moves forward; requests that arrive in
+  the meantime form the next pass. Thumbnails that are not cached are made
+  with a producer that stays open between passes: a few idle producers are
+  kept, least recently used first.
+*/
+
+class ThumbnailProvider : public QQuickAsyncImageProvider
 {
 public:
     explicit ThumbnailProvider();
-    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+    ~ThumbnailProvider();
+    QQuickImageResponse *requestImageResponse(const QString &id,
+                                              const QSize &requestedSize) override;
 
 private:
+    struct Request
+    {
+        ThumbnailResponse *response;
+        QString key;
+        int frameNumber;
+        QSize requestedSize;
+        bool force;
+    };
+
+    struct Batch
+    {
+        QString service;
+        QString resource;
+        QList<Request> requests;
+    };
+
     QString cacheKey(Mlt::Properties &properties,
                      const QString &service,
                      const QString &resource,
                      const QString &hash,
                      int frameNumber);
+    void runBatch(const QString &clip);
+    Mlt::Producer *takeIdleProducer(const QString &clip);
+    Mlt::Producer *newProducer(QString service, const QString &resource);
     QImage makeThumbnail(Mlt::Producer &, int frameNumber, const QSize &requestedSize);
+
     Mlt::Profile m_profile;
+    QMutex m_mutex;
+    QHash<QString, Batch> m_batches; // a clip is in here while a worker runs it
+    QList<QPair<QString, Mlt::Producer *>> m_producers; // idle, least recently used first
+    QThreadPool m_threadPool;
 };
 
 #endif // THUMBNAILPROVIDER_H
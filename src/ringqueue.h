@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RINGQUEUE_H
+#define RINGQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/*!
+  \class RingQueue
+  \brief The RingQueue is a lock-free DataQueue for one producer and one
+  consumer.
+
+  \threadsafe
+
+  RingQueue has the interface and the overflow modes of DataQueue. push() must
+  only be called from one thread at a time and pop() from one thread at a time;
+  count() may be called from anywhere. Use DataQueue when more than one object
+  pops.
+
+  push() and pop() do not take a lock unless they have to block: pop() on an
+  empty queue and push() on a full queue in OverflowModeWait. count() never
+  locks.
+
+  The items live in a ring of slots with sequence numbers, after D. Vyukov's
+  bounded queue. In OverflowModeDiscardOldest the producer pops the oldest item
+  itself, so the head index is the only value written by both threads; the
+  two sides claim an item with a compare-and-swap on it. The ring has twice
+  the maximum size, so the producer does not reuse a slot that the consumer
+  might still be moving an item out of. It only yields if it has gone around
+  the whole ring while the consumer stalled inside a single pop().
+*/
+
+template<class T>
+class RingQueue
+{
+public:
+    //! Overflow behavior modes, the same as DataQueue.
+    typedef enum {
+        OverflowModeDiscardOldest = 0, //!< Discard oldest items
+        OverflowModeDiscardNewest,     //!< Discard newest items
+        OverflowModeWait               //!< Wait for space to be free
+    } OverflowMode;
+
+    /*!
+      Constructs a RingQueue.
+
+      The \a size will be the maximum queue size and the \a mode will dictate
+      overflow behavior.
+    */
+    explicit RingQueue(int maxSize, OverflowMode mode);
+
+    //! Destructs a RingQueue.
+    virtual ~RingQueue();
+
+    /*!
+      Pushes an item into the queue. Only the producer may call this.
+
+      If the queue is full and overflow mode is OverflowModeWait then this
+      function will block until pop() is called.
+    */
+    void push(const T &item);
+
+    /*!
+      Pops an item from the queue. Only the consumer may call this.
+
+      If the queue is empty then this function will block. If blocking is
+      undesired, then check the return of count() before calling pop() or use
+      tryPop().
+    */
+    T pop();
+
+    //! Pops an item into \a item unless the queue is empty. Only the consumer may call this.
+    bool tryPop(T &item);
+
+    //! Returns the number of items in the queue.
+    int count() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    // Pops for the consumer, and for the producer discarding the oldest item.
+    bool take(T &item);
+    void wake(std::condition_variable &condition, const std::atomic<int> &waiters);
+
+    const size_t m_maxSize;
+    const size_t m_capacity;
+    const OverflowMode m_mode;
+    Slot *m_slots;
+
+    // Each index on its own cache line, so that the producer and the consumer
+    // do not invalidate each other's line on every item.
+    char m_padding0[64];
+    std::atomic<size_t> m_head;
+    char m_padding1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+    char m_padding2[64 - sizeof(std::atomic<size_t>)];
+
+    // Only used to block
+    std::mutex m_mutex;
+    std::condition_variable m_notEmptyCondition;
+    std::condition_variable m_notFullCondition;
+    std::atomic<int> m_popWaiters;
+    std::atomic<int> m_pushWaiters;
+};
+
+template<class T>
+RingQueue<T>::RingQueue(int maxSize, OverflowMode mode)
+    : m_maxSize(maxSize > 0 ? maxSize : 1)
+    , m_capacity(m_maxSize * 2)
+    , m_mode(mode)
+    , m_slots(new Slot[m_capacity])
+    , m_head(0)
+    , m_tail(0)
+    , m_popWaiters(0)
+    , m_pushWaiters(0)
+{
+    for (size_t i = 0; i < m_capacity; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+RingQueue<T>::~RingQueue()
+{
+    delete[] m_slots;
+}
+
+template<class T>
+void RingQueue<T>::push(const T &item)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) >= m_maxSize) {
+        switch (m_mode) {
+        case OverflowModeDiscardOldest: {
+            // May find nothing if the consumer just made room.
+            T oldest;
+            take(oldest);
+            break;
+        }
+        case OverflowModeDiscardNewest:
+            // This item is the newest so discard it and exit
+            return;
+        case OverflowModeWait: {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_pushWaiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (tail - m_head.load(std::memory_order_acquire) >= m_maxSize) {
+                m_notFullCondition.wait(lock);
+            }
+            m_pushWaiters.fetch_sub(1);
+            break;
+        }
+        }
+    }
+
+    Slot &slot = m_slots[tail % m_capacity];
+    // The slot is free once the item from one lap ago has been moved out.
+    while (slot.sequence.load(std::memory_order_acquire) != tail) {
+        std::this_thread::yield();
+    }
+    slot.item = item;
+    slot.sequence.store(tail + 1, std::memory_order_release);
+    m_tail.store(tail + 1, std::memory_order_release);
+    wake(m_notEmptyCondition, m_popWaiters);
+}
+
+template<class T>
+T RingQueue<T>::pop()
+{
+    T item;
+    if (!tryPop(item)) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_popWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!take(item)) {
+            m_notEmptyCondition.wait(lock);
+        }
+        m_popWaiters.fetch_sub(1);
+        lock.unlock();
+        if (m_mode == OverflowModeWait) {
+            wake(m_notFullCondition, m_pushWaiters);
+        }
+    }
+    return item;
+}
+
+template<class T>
+bool RingQueue<T>::tryPop(T &item)
+{
+    if (!take(item)) {
+        return false;
+    }
+    if (m_mode == OverflowModeWait) {
+        wake(m_notFullCondition, m_pushWaiters);
+    }
+    return true;
+}
+
+template<class T>
+int RingQueue<T>::count() const
+{
+    // Head first, so that the difference can not go negative.
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    size_t size = tail - head;
+    return int(size < m_maxSize ? size : m_maxSize);
+}
+
+template<class T>
+bool RingQueue<T>::take(T &item)
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = m_slots[head % m_capacity];
+        std::ptrdiff_t diff = std::ptrdiff_t(slot.sequence.load(std::memory_order_acquire)
+                                             - (head + 1));
+        if (diff == 0) {
+            // The item is there; claim it unless the other side was faster.
+            if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                item = std::move(slot.item);
+                // Release what the item holds (e.g. a frame) right away.
+                slot.item = T();
+                slot.sequence.store(head + m_capacity, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Not pushed yet
+            return false;
+        } else {
+            // Taken by the other side
+            head = m_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<class T>
+void RingQueue<T>::wake(std::condition_variable &condition, const std::atomic<int> &waiters)
+{
+    // Pairs with the fence after a waiter registers, so that either the waiter
+    // sees the change or this sees the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        condition.notify_all();
+    }
+}
+
+#endif // RINGQUEUE_H
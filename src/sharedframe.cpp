@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015-2023 Meltytech, LLC
+ * Copyright (c) 2015-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -59,6 +59,16 @@ SharedFrame &SharedFrame::operator=(const SharedFrame &other)
     return *this;
 }
 
+bool SharedFrame::operator==(const SharedFrame &other) const
+{
+    return d == other.d;
+}
+
+bool SharedFrame::operator!=(const SharedFrame &other) const
+{
+    return d != other.d;
+}
+
 bool SharedFrame::is_valid() const
 {
     return d && d->f.is_valid();
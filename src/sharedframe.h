@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Meltytech, LLC
+ * Copyright (c) 2015-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -53,6 +53,8 @@ public:
     SharedFrame(const SharedFrame &other);
     ~SharedFrame();
     SharedFrame &operator=(const SharedFrame &other);
+    bool operator==(const SharedFrame &other) const;
+    bool operator!=(const SharedFrame &other) const;
 
     bool is_valid() const;
     Mlt::Frame clone(bool audio = false, bool image = false, bool alpha = false) const;
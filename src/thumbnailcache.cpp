@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnailcache.h"
+
+#include "Logger.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const quint32 kIndexMagic = 0x31435453;  // "STC1"
+const quint32 kRecordMagic = 0x31525453; // "STR1"
+const quint32 kVersion = 1;
+const int kShardCount = 8;
+const quint32 kMinCapacity = 1024;
+// compact() leaves a data file alone unless it has at least this much garbage.
+const qint64 kMinCompactBytes = 1024 * 1024;
+
+struct IndexHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 capacity; // slots, a power of 2
+    quint32 count;
+    quint64 liveBytes;
+    quint64 dataEnd;
+    quint64 clock; // last access tick
+};
+
+struct Slot
+{
+    quint64 hash; // 0 is a free slot
+    quint64 offset;
+    quint32 size;
+    quint32 reserved;
+    quint64 accessed;
+};
+
+struct RecordHeader
+{
+    quint32 magic;
+    quint32 keySize;
+    qint32 width;
+    qint32 height;
+    qint32 format;
+    qint32 bytesPerLine;
+    quint32 flags;
+    quint32 payloadSize;
+};
+
+enum RecordFlags { RecordCompressed = 0x1 };
+
+static_assert(sizeof(IndexHeader) == 40, "IndexHeader is part of the file format");
+static_assert(sizeof(Slot) == 32, "Slot is part of the file format");
+static_assert(sizeof(RecordHeader) == 32, "RecordHeader is part of the file format");
+
+quint64 hashKey(const QByteArray &key)
+{
+    QByteArray digest = QCryptographicHash::hash(key, QCryptographicHash::Md5);
+    quint64 hash;
+    std::memcpy(&hash, digest.constData(), sizeof(hash));
+    return hash ? hash : 1;
+}
+
+} // namespace
+
+class ThumbnailCache::Shard
+{
+public:
+    Shard(const QString &fileName, qint64 maxBytes)
+        : m_index(fileName + ".index")
+        , m_data(fileName + ".data")
+        , m_maxBytes(maxBytes)
+        , m_header(nullptr)
+        , m_slots(nullptr)
+    {
+        QMutexLocker locker(&m_mutex);
+        open();
+    }
+
+    ~Shard()
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_header)
+            m_index.unmap(reinterpret_cast<uchar *>(m_header));
+    }
+
+    bool put(quint64 hash, const QByteArray &record)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_header || record.size() > m_maxBytes)
+            return false;
+        quint64 offset = m_header->dataEnd;
+        if (!m_data.seek(offset) || m_data.write(record) != record.size()) {
+            LOG_WARNING() << "failed to write" << m_data.fileName() << m_data.errorString();
+            m_data.resize(offset);
+            return false;
+        }
+        // The record is on disk before the index points to it.
+        m_header->dataEnd += record.size();
+
+        qint64 i = find(hash);
+        if (i < 0) {
+            if (m_header->count + 1 > m_header->capacity / 4 * 3 && !grow())
+                return false;
+            i = insert(hash);
+        } else {
+            m_header->liveBytes -= m_slots[i].size;
+        }
+        Slot &slot = m_slots[i];
+        slot.offset = offset;
+        slot.size = record.size();
+        slot.accessed = ++m_header->clock;
+        m_header->liveBytes += record.size();
+        if (qint64(m_header->liveBytes) > m_maxBytes)
+            evict();
+        return true;
+    }
+
+    QByteArray get(quint64 hash, const QByteArray &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_header)
+            return QByteArray();
+        qint64 i = find(hash);
+        if (i < 0)
+            return QByteArray();
+        Slot &slot = m_slots[i];
+        QByteArray record;
+        if (slot.offset + slot.size <= m_header->dataEnd && m_data.seek(slot.offset))
+            record = m_data.read(slot.size);
+        if (!isValid(record, key)) {
+            LOG_DEBUG() << "dropping damaged thumbnail" << key;
+            erase(i);
+            return QByteArray();
+        }
+        slot.accessed = ++m_header->clock;
+        return record;
+    }
+
+    void remove(quint64 hash)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_header)
+            return;
+        qint64 i = find(hash);
+        if (i >= 0)
+            erase(i);
+    }
+
+    void compact()
+    {
+        // Copy the records in file order without holding the lock, so that
+        // put() and get() go on meanwhile, and only point the index to the new
+        // file once it is complete.
+        struct Record
+        {
+            quint64 hash;
+            quint64 offset;
+            quint32 size;
+        };
+        std::vector<Record> records;
+        quint64 end;
+        quint64 epoch;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_header || m_compacting)
+                return;
+            qint64 garbage = m_header->dataEnd - m_header->liveBytes;
+            if (garbage < kMinCompactBytes || garbage < qint64(m_header->liveBytes) / 2)
+                return;
+            records.reserve(m_header->count);
+            for (quint32 i = 0; i < m_header->capacity; i++) {
+                if (m_slots[i].hash)
+                    records.push_back({m_slots[i].hash, m_slots[i].offset, m_slots[i].size});
+            }
+            end = m_header->dataEnd;
+            epoch = m_epoch;
+            m_compacting = true;
+        }
+        std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+            return a.offset < b.offset;
+        });
+
+        // The data file is append-only, so the records before end stay as
+        // they are while put() appends behind them.
+        QFile source(m_data.fileName());
+        QFile file(m_data.fileName() + ".new");
+        std::vector<quint64> offsets;
+        offsets.reserve(records.size());
+        quint64 offset = 0;
+        bool ok = source.open(QIODevice::ReadOnly)
+                  && file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        for (size_t i = 0; ok && i < records.size(); i++) {
+            QByteArray record;
+            if (source.seek(records[i].offset))
+                record = source.read(records[i].size);
+            ok = record.size() == qint64(records[i].size) && file.write(record) == record.size();
+            offsets.push_back(offset);
+            offset += records[i].size;
+        }
+        source.close();
+
+        QMutexLocker locker(&m_mutex);
+        m_compacting = false;
+        if (ok && (!m_header || m_epoch != epoch)) {
+            // reset() emptied the shard meanwhile.
+            ok = false;
+        } else if (ok && m_header->dataEnd > end) {
+            // Records that put() appended meanwhile move along as they are.
+            QByteArray tail;
+            if (m_data.seek(end))
+                tail = m_data.read(m_header->dataEnd - end);
+            ok = tail.size() == qint64(m_header->dataEnd - end) && file.write(tail) == tail.size();
+        }
+        if (!ok) {
+            LOG_WARNING() << "failed to compact" << m_data.fileName();
+            file.close();
+            file.remove();
+            return;
+        }
+        file.close();
+        m_data.close();
+        if (!QFile::remove(m_data.fileName()) || !file.rename(m_data.fileName())) {
+            LOG_WARNING() << "failed to replace" << m_data.fileName();
+            reset();
+            return;
+        }
+        if (!m_data.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+            reset();
+            return;
+        }
+        // Entries that were replaced or removed meanwhile no longer point to
+        // the copied record and are left alone.
+        for (size_t i = 0; i < records.size(); i++) {
+            qint64 j = find(records[i].hash);
+            if (j >= 0 && m_slots[j].offset == records[i].offset)
+                m_slots[j].offset = offsets[i];
+        }
+        const quint64 shift = end - offset;
+        for (quint32 i = 0; i < m_header->capacity; i++) {
+            if (m_slots[i].hash && m_slots[i].offset >= end)
+                m_slots[i].offset -= shift;
+        }
+        LOG_DEBUG() << m_data.fileName() << "compacted from" << m_header->dataEnd << "to"
+                    << m_header->dataEnd - shift << "bytes";
+        m_header->dataEnd -= shift;
+    }
+
+    int count()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_header ? m_header->count : 0;
+    }
+
+    qint64 size()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_header ? m_header->liveBytes : 0;
+    }
+
+    qint64 diskUsage()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_index.size() + m_data.size();
+    }
+
+private:
+    void open()
+    {
+        if (!m_index.open(QIODevice::ReadWrite | QIODevice::Unbuffered)
+            || !m_data.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+            LOG_WARNING() << "failed to open the thumbnail cache" << m_index.fileName();
+            return;
+        }
+        // Left over from an interrupted compact()
+        QFile::remove(m_data.fileName() + ".new");
+
+        bool valid = false;
+        if (m_index.size() >= qint64(sizeof(IndexHeader))) {
+            IndexHeader header;
+            m_index.seek(0);
+            valid = m_index.read(reinterpret_cast<char *>(&header), sizeof(header))
+                        == sizeof(header)
+                    && header.magic == kIndexMagic && header.version == kVersion
+                    && header.capacity >= kMinCapacity
+                    && !(header.capacity & (header.capacity - 1))
+                    && m_index.size() == indexSize(header.capacity)
+                    && header.count < header.capacity && header.liveBytes <= header.dataEnd
+                    && qint64(header.dataEnd) <= m_data.size() && map(header.capacity);
+        }
+        if (!valid) {
+            reset();
+        } else if (m_data.size() > qint64(m_header->dataEnd)) {
+            // A record was written but never indexed.
+            m_data.resize(m_header->dataEnd);
+        }
+    }
+
+    void reset()
+    {
+        LOG_INFO() << "starting empty" << m_index.fileName();
+        m_epoch++;
+        unmap();
+        if (!m_data.isOpen() && !m_data.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+            return;
+        m_data.resize(0);
+        m_index.resize(0);
+        if (!m_index.resize(indexSize(kMinCapacity)) || !map(kMinCapacity))
+            return;
+        m_header->magic = kIndexMagic;
+        m_header->version = kVersion;
+        m_header->capacity = kMinCapacity;
+        m_header->count = 0;
+        m_header->liveBytes = 0;
+        m_header->dataEnd = 0;
+        m_header->clock = 0;
+    }
+
+    static qint64 indexSize(quint32 capacity)
+    {
+        return sizeof(IndexHeader) + qint64(capacity) * sizeof(Slot);
+    }
+
+    bool map(quint32 capacity)
+    {
+        uchar *p = m_index.map(0, indexSize(capacity));
+        if (!p) {
+            LOG_WARNING() << "failed to map" << m_index.fileName() << m_index.errorString();
+            return false;
+        }
+        m_header = reinterpret_cast<IndexHeader *>(p);
+        m_slots = reinterpret_cast<Slot *>(p + sizeof(IndexHeader));
+        return true;
+    }
+
+    void unmap()
+    {
+        if (m_header)
+            m_index.unmap(reinterpret_cast<uchar *>(m_header));
+        m_header = nullptr;
+        m_slots = nullptr;
+    }
+
+    bool grow()
+    {
+        IndexHeader header = *m_header;
+        std::vector<Slot> slots(m_slots, m_slots + header.capacity);
+        unmap();
+        header.capacity *= 2;
+        if (!m_index.resize(indexSize(header.capacity)) || !map(header.capacity)) {
+            reset();
+            return false;
+        }
+        *m_header = header;
+        std::memset(m_slots, 0, header.capacity * sizeof(Slot));
+        m_header->count = 0;
+        for (const Slot &slot : slots) {
+            if (slot.hash)
+                m_slots[insert(slot.hash)] = slot;
+        }
+        return true;
+    }
+
+    quint32 home(quint64 hash) const
+    {
+        // The low bits chose the shard.
+        return (hash / kShardCount) & (m_header->capacity - 1);
+    }
+
+    qint64 find(quint64 hash) const
+    {
+        const quint32 mask = m_header->capacity - 1;
+        for (quint32 i = home(hash);; i = (i + 1) & mask) {
+            if (m_slots[i].hash == hash)
+                return i;
+            if (!m_slots[i].hash)
+                return -1;
+        }
+    }
+
+    quint32 insert(quint64 hash)
+    {
+        const quint32 mask = m_header->capacity - 1;
+        quint32 i = home(hash);
+        while (m_slots[i].hash)
+            i = (i + 1) & mask;
+        std::memset(&m_slots[i], 0, sizeof(Slot));
+        m_slots[i].hash = hash;
+        m_header->count++;
+        return i;
+    }
+
+    void erase(quint32 i)
+    {
+        // Linear probing without tombstones: move later entries of the probe
+        // sequence back into the hole unless that would put them before
+        // their home slot.
+        const quint32 mask = m_header->capacity - 1;
+        m_header->liveBytes -= m_slots[i].size;
+        for (quint32 j = (i + 1) & mask; m_slots[j].hash; j = (j + 1) & mask) {
+            quint32 k = home(m_slots[j].hash);
+            bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+            if (!stays) {
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+        }
+        std::memset(&m_slots[i], 0, sizeof(Slot));
+        m_header->count--;
+    }
+
+    void evict()
+    {
+        // Down to three quarters of the budget, so that the next few put()
+        // calls do not evict again.
+        std::vector<std::pair<quint64, quint64>> byAccess;
+        byAccess.reserve(m_header->count);
+        for (quint32 i = 0; i < m_header->capacity; i++) {
+            if (m_slots[i].hash)
+                byAccess.push_back(std::make_pair(m_slots[i].accessed, m_slots[i].hash));
+        }
+        std::sort(byAccess.begin(), byAccess.end());
+        const qint64 target = m_maxBytes / 4 * 3;
+        int evicted = 0;
+        for (const auto &entry : byAccess) {
+            if (qint64(m_header->liveBytes) <= target)
+                break;
+            erase(find(entry.second));
+            evicted++;
+        }
+        LOG_DEBUG() << "evicted" << evicted << "thumbnails from" << m_data.fileName();
+    }
+
+    bool isValid(const QByteArray &record, const QByteArray &key) const
+    {
+        RecordHeader header;
+        if (record.size() < qint64(sizeof(header)))
+            return false;
+        std::memcpy(&header, record.constData(), sizeof(header));
+        return header.magic == kRecordMagic && header.keySize == quint32(key.size())
+               && sizeof(header) + header.keySize + header.payloadSize == quint64(record.size())
+               && !std::memcmp(record.constData() + sizeof(header), key.constData(), key.size());
+    }
+
+    QMutex m_mutex;
+    QFile m_index;
+    QFile m_data;
+    const qint64 m_maxBytes;
+    IndexHeader *m_header;
+    Slot *m_slots;
+    quint64 m_epoch = 0;       // counts reset()
+    bool m_compacting = false; // by another thread
+};
+
+ThumbnailCache::ThumbnailCache(const QString &path, qint64 maxBytes)
+{
+    QDir().mkpath(path);
+    QDir dir(path);
+    for (int i = 0; i < kShardCount; i++) {
+        m_shards.emplace_back(new Shard(dir.filePath(QString::number(i)), maxBytes / kShardCount));
+    }
+}
+
+ThumbnailCache::~ThumbnailCache() {}
+
+bool ThumbnailCache::put(const QString &key, const QImage &image)
+{
+    if (image.isNull())
+        return false;
+    QImage source = image;
+    if (source.depth() < 8 || source.colorCount() > 0) {
+        // Palette images would need their color table too.
+        source = source.convertToFormat(source.hasAlphaChannel() ? QImage::Format_ARGB32
+                                                                 : QImage::Format_RGB32);
+    }
+    QByteArray keyData = key.toUtf8();
+    QByteArray pixels = QByteArray::fromRawData(reinterpret_cast<const char *>(source.constBits()),
+                                                source.sizeInBytes());
+    // Compress in the calling thread, outside of the shard lock. Inflating
+    // costs several times more than reading the raw pixels, so only keep the
+    // result if it at least halves the size, as with flat graphics.
+    QByteArray payload = qCompress(pixels, 1);
+    RecordHeader header;
+    header.flags = 0;
+    if (payload.size() <= pixels.size() / 2) {
+        header.flags |= RecordCompressed;
+    } else {
+        payload = pixels;
+    }
+    header.magic = kRecordMagic;
+    header.keySize = keyData.size();
+    header.width = source.width();
+    header.height = source.height();
+    header.format = source.format();
+    header.bytesPerLine = source.bytesPerLine();
+    header.payloadSize = payload.size();
+
+    QByteArray record;
+    record.reserve(sizeof(header) + keyData.size() + payload.size());
+    record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    record.append(keyData);
+    record.append(payload);
+    quint64 hash = hashKey(keyData);
+    return shard(hash).put(hash, record);
+}
+
+QImage ThumbnailCache::get(const QString &key)
+{
+    QByteArray keyData = key.toUtf8();
+    quint64 hash = hashKey(keyData);
+    QByteArray record = shard(hash).get(hash, keyData);
+    if (record.isEmpty())
+        return QImage();
+
+    RecordHeader header;
+    std::memcpy(&header, record.constData(), sizeof(header));
+    QByteArray pixels = record.mid(sizeof(header) + header.keySize);
+    if (header.flags & RecordCompressed)
+        pixels = qUncompress(pixels);
+    if (header.format <= QImage::Format_Invalid || header.format >= QImage::NImageFormats
+        || header.width <= 0 || header.height <= 0 || header.bytesPerLine <= 0
+        || pixels.size() != qint64(header.bytesPerLine) * header.height)
+        return QImage();
+    QImage image(header.width, header.height, QImage::Format(header.format));
+    if (image.isNull())
+        return QImage();
+    const qint64 lineSize = std::min<qint64>(image.bytesPerLine(), header.bytesPerLine);
+    for (int y = 0; y < header.height; y++) {
+        std::memcpy(image.scanLine(y),
+                    pixels.constData() + qint64(y) * header.bytesPerLine,
+                    lineSize);
+    }
+    return image;
+}
+
+void ThumbnailCache::remove(const QString &key)
+{
+    quint64 hash = hashKey(key.toUtf8());
+    shard(hash).remove(hash);
+}
+
+void ThumbnailCache::compact()
+{
+    for (auto &shard : m_shards)
+        shard->compact();
+}
+
+int ThumbnailCache::count() const
+{
+    int result = 0;
+    for (auto &shard : m_shards)
+        result += shard->count();
+    return result;
+}
+
+qint64 ThumbnailCache::size() const
+{
+    qint64 result = 0;
+    for (auto &shard : m_shards)
+        result += shard->size();
+    return result;
+}
+
+qint64 ThumbnailCache::diskUsage() const
+{
+    qint64 result = 0;
+    for (auto &shard : m_shards)
+        result += shard->diskUsage();
+    return result;
+}
+
+ThumbnailCache::Shard &ThumbnailCache::shard(quint64 hash) const
+{
+    return *m_shards[hash % kShardCount];
+}
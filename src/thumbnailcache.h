@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+/*!
+  \class ThumbnailCache
+  \brief The ThumbnailCache stores images by key in a few packed files.
+
+  \threadsafe
+
+  The keys are spread over shards by a 64-bit hash. Each shard has its own
+  lock, an append-only data file and a memory-mapped index: an open
+  addressing hash table from key hash to the location, size and last access
+  of a record. A lookup is a probe in memory plus one read, and marking an
+  image as used is a store into the mapping. A record holds the full key,
+  the geometry and format of the image and its pixels, compressed with zlib
+  only when that saves at least half.
+
+  When a shard holds more than its part of the byte budget, put() evicts
+  the least recently used images of that shard. Replaced and evicted records
+  stay in the data file until compact() rewrites it. It holds the lock of a
+  shard only to take a snapshot and to swap the files, but it takes a while,
+  so call it from a worker thread.
+
+  A record that does not match its key or its index entry, for example after
+  a crash, is dropped on read. An index that does not match its data file
+  empties the shard.
+*/
+
+class ThumbnailCache
+{
+public:
+    /*!
+      Opens or creates the cache files in the directory \a path. \a maxBytes
+      is the budget for the records, that is the stored size of the images.
+    */
+    explicit ThumbnailCache(const QString &path, qint64 maxBytes);
+    ~ThumbnailCache();
+
+    bool put(const QString &key, const QImage &image);
+    //! Returns a null image if \a key is not in the cache.
+    QImage get(const QString &key);
+    void remove(const QString &key);
+
+    //! Rewrites the data files that are mostly garbage.
+    void compact();
+
+    int count() const;
+    //! Bytes of the records in the cache.
+    qint64 size() const;
+    //! Bytes of all cache files, including garbage and free index slots.
+    qint64 diskUsage() const;
+
+private:
+    class Shard;
+    Shard &shard(quint64 hash) const;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
+
+#endif // THUMBNAILCACHE_H
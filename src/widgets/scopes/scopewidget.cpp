@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015-2022 Meltytech, LLC
+ * Copyright (c) 2015-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -21,9 +21,40 @@
 
 #include <QtConcurrent/QtConcurrent>
 
+namespace {
+
+// The analysis of the most recent frame, shared by all video scopes.
+struct SharedAnalysis
+{
+    QMutex mutex;
+    int scopeCount = 0;
+    SharedFrame frame;
+    std::shared_ptr<VideoScopeAnalysis> analysis;
+    // Components asked for since the last new frame
+    int wanted = 0;
+};
+
+SharedAnalysis &sharedAnalysis()
+{
+    static SharedAnalysis shared;
+    return shared;
+}
+
+void analyze(VideoScopeAnalysis &analysis, const SharedFrame &frame, int components)
+{
+    analysis.analyze(frame.get_image(mlt_image_yuv420p),
+                     frame.get_image_width(),
+                     frame.get_image_height(),
+                     frame.get_int("colorspace"),
+                     frame.get_int("full_range"),
+                     components);
+}
+
+} // namespace
+
 ScopeWidget::ScopeWidget(const QString &name)
     : QWidget()
-    , m_queue(3, DataQueue<SharedFrame>::OverflowModeDiscardOldest)
+    , m_queue(3, RingQueue<SharedFrame>::OverflowModeDiscardOldest)
     , m_future()
     , m_refreshPending(false)
     , m_mutex()
@@ -32,10 +63,22 @@ ScopeWidget::ScopeWidget(const QString &name)
 {
     LOG_DEBUG() << "begin" << m_future.isFinished();
     setObjectName(name);
+    SharedAnalysis &shared = sharedAnalysis();
+    QMutexLocker locker(&shared.mutex);
+    shared.scopeCount++;
     LOG_DEBUG() << "end";
 }
 
-ScopeWidget::~ScopeWidget() {}
+ScopeWidget::~ScopeWidget()
+{
+    SharedAnalysis &shared = sharedAnalysis();
+    QMutexLocker locker(&shared.mutex);
+    if (--shared.scopeCount == 0) {
+        // Do not hold on to a frame past the last scope.
+        shared.frame = SharedFrame();
+        shared.analysis.reset();
+    }
+}
 
 void ScopeWidget::onNewFrame(const SharedFrame &frame)
 {
@@ -78,6 +121,38 @@ void ScopeWidget::onRefreshThreadComplete()
     }
 }
 
+std::shared_ptr<const VideoScopeAnalysis> ScopeWidget::analyzeFrame(const SharedFrame &frame,
+                                                                    int components)
+{
+    if (!frame.is_valid() || !frame.get_image_width() || !frame.get_image_height()) {
+        return std::shared_ptr<const VideoScopeAnalysis>();
+    }
+
+    SharedAnalysis &shared = sharedAnalysis();
+    QMutexLocker locker(&shared.mutex);
+    if (frame != shared.frame || !shared.analysis) {
+        int wanted = shared.wanted | components;
+        shared.wanted = 0;
+        shared.frame = frame;
+        // Reuse the buffers unless a scope is still drawing from them.
+        if (!shared.analysis || shared.analysis.use_count() > 1) {
+            shared.analysis = std::make_shared<VideoScopeAnalysis>();
+        } else {
+            // Components of the previous frame must not pass as this frame's.
+            shared.analysis->clear();
+        }
+        analyze(*shared.analysis, frame, wanted);
+    } else if ((shared.analysis->components() & components) != components) {
+        // A scope that was just opened or skipped the previous frame.
+        if (shared.analysis.use_count() > 1) {
+            shared.analysis = std::make_shared<VideoScopeAnalysis>(*shared.analysis);
+        }
+        analyze(*shared.analysis, frame, components & ~shared.analysis->components());
+    }
+    shared.wanted |= components;
+    return shared.analysis;
+}
+
 void ScopeWidget::resizeEvent(QResizeEvent *)
 {
     m_mutex.lock();
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015-2023 Meltytech, LLC
+ * Copyright (c) 2015-2026 Meltytech, LLC
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -19,8 +19,9 @@
 #define SCOPEWIDGET_H
 
 #include "Logger.h"
-#include "dataqueue.h"
+#include "ringqueue.h"
 #include "sharedframe.h"
+#include "videoscopeanalysis.h"
 
 #include <QFuture>
 #include <QMutex>
@@ -28,6 +29,8 @@
 #include <QThread>
 #include <QWidget>
 
+#include <memory>
+
 /*!
   \class ScopeWidget
   \brief The ScopeWidget provides a common interface for all scopes in Shotcut.
@@ -38,8 +41,9 @@
   is the ability to trigger the "heavy lifting" to be done in a worker thread.
 
   Frames are received by the onNewFrame() slot. The ScopeWidget automatically
-  places new frames in the DataQueue (m_queue). Subclasses shall implement the
-  refreshScope() function and can check for new frames in m_queue.
+  places new frames in the RingQueue (m_queue). Subclasses shall implement the
+  refreshScope() function and can check for new frames in m_queue. Only
+  refreshScope() may pop from it, because RingQueue allows a single consumer.
 
   refreshScope() is run from a separate thread. Therefore, any members that are
   accessed by both the worker thread (refreshScope) and the GUI thread
@@ -50,6 +54,10 @@
   the paintEvent() implementation will complete quickly to avoid hanging up the
   GUI thread.
 
+  Video scopes should get their per-frame data from analyzeFrame() rather
+  than from the frame image, so that all open video scopes share one pass over
+  each frame.
+
   Subclasses shall also implement getTitle() so that the application can display
   an appropriate title for the scope.
 */
@@ -111,9 +119,21 @@ protected:
       Stores frames received by onNewFrame().
 
       Subclasses should check this queue for new frames in the refreshScope()
-      implementation.
+      implementation. At most one refreshScope() runs at a time, so that is
+      the one consumer; onNewFrame() is the one producer.
+    */
+    RingQueue<SharedFrame> m_queue;
+
+    /*!
+      Returns the analysis of \a frame with at least \a components (see
+      VideoScopeAnalysis::Component), or null if the frame has no image.
+
+      The analysis is shared by all video scopes. The first scope to ask for a
+      new frame analyzes what every scope asked for on the previous frame in
+      one pass; the others get the same result. Call it from refreshScope().
     */
-    DataQueue<SharedFrame> m_queue;
+    std::shared_ptr<const VideoScopeAnalysis> analyzeFrame(const SharedFrame &frame,
+                                                           int components);
 
     void resizeEvent(QResizeEvent *) Q_DECL_OVERRIDE;
     void changeEvent(QEvent *) Q_DECL_OVERRIDE;
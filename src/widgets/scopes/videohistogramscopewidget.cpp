@@ -24,6 +24,8 @@
 #include <QPainterPath>
 #include <QToolTip>
 
+#include <algorithm>
+
 const qreal IRE0 = 16;
 const qreal IRE100 = 235;
 
@@ -56,20 +58,14 @@ void VideoHistogramScopeWidget::refreshScope(const QSize &size, bool full)
     QVector<unsigned int> gBins(256, 0);
     QVector<unsigned int> bBins(256, 0);
 
-    if (m_frame.is_valid() && m_frame.get_image_width() && m_frame.get_image_height()) {
-        const uint8_t *pYUV = m_frame.get_image(mlt_image_yuv420p);
-        const uint8_t *pRGB = m_frame.get_image(mlt_image_rgb);
-        size_t count = m_frame.get_image_width() * m_frame.get_image_height();
-        unsigned int *pYbin = yBins.data();
-        unsigned int *pRbin = rBins.data();
-        unsigned int *pGbin = gBins.data();
-        unsigned int *pBbin = bBins.data();
-        while (count--) {
-            pYbin[*pYUV++]++;
-            pRbin[*pRGB++]++;
-            pGbin[*pRGB++]++;
-            pBbin[*pRGB++]++;
-        }
+    std::shared_ptr<const VideoScopeAnalysis> analysis
+        = analyzeFrame(m_frame, VideoScopeAnalysis::Histogram);
+
+    if (analysis) {
+        std::copy_n(analysis->histogram(VideoScopeAnalysis::Luma), 256, yBins.begin());
+        std::copy_n(analysis->histogram(VideoScopeAnalysis::Red), 256, rBins.begin());
+        std::copy_n(analysis->histogram(VideoScopeAnalysis::Green), 256, gBins.begin());
+        std::copy_n(analysis->histogram(VideoScopeAnalysis::Blue), 256, bBins.begin());
     }
 
     m_mutex.lock();
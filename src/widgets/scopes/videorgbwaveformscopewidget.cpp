@@ -45,46 +45,25 @@ void VideoRgbWaveformScopeWidget::refreshScope(const QSize &size, bool full)
         m_frame = m_queue.pop();
     }
 
-    int width = m_frame.get_image_width();
-    int height = m_frame.get_image_height();
+    std::shared_ptr<const VideoScopeAnalysis> analysis
+        = analyzeFrame(m_frame, VideoScopeAnalysis::RgbWaveform);
 
-    if (m_frame.is_valid() && width && height) {
+    if (analysis) {
+        int width = analysis->width();
         if (m_renderImg.width() != width) {
             m_renderImg = QImage(width, 256, QImage::QImage::Format_RGBX8888);
         }
 
-        QColor bgColor(0, 0, 0, 0xff);
-        m_renderImg.fill(bgColor);
-
-        const uint8_t *src = m_frame.get_image(mlt_image_rgb);
-        uint8_t *dst = m_renderImg.scanLine(0);
-
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                uint8_t ry = 255 - src[0];
-                size_t rIndex = (ry * width + x) * 4;
-                if (dst[rIndex] < 0xff) {
-                    dst[rIndex] += 0x0f;
-                }
-
-                uint8_t gy = 255 - src[1];
-                size_t gIndex = (gy * width + x) * 4 + 1;
-                if (dst[gIndex] < 0xff) {
-                    dst[gIndex] += 0x0f;
-                }
-
-                uint8_t by = 255 - src[2];
-                size_t bIndex = (by * width + x) * 4 + 2;
-                if (dst[bIndex] < 0xff) {
-                    dst[bIndex] += 0x0f;
-                }
-                src += 3;
-            }
-        }
+        const uint8_t *rSrc = analysis->rgbWaveform(VideoScopeAnalysis::Red);
+        const uint8_t *gSrc = analysis->rgbWaveform(VideoScopeAnalysis::Green);
+        const uint8_t *bSrc = analysis->rgbWaveform(VideoScopeAnalysis::Blue);
 
-        QImage scaledImage = m_renderImg
-                                 .scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
-                                 .convertToFormat(QImage::Format_RGB32);
+        for (int y = 0; y < 256; y++) {
+            VideoScopeAnalysis::render(rSrc, gSrc, bSrc, width, m_renderImg.scanLine(y));
+            rSrc += width;
+            gSrc += width;
+            bSrc += width;
+        }
 
         m_mutex.lock();
         m_displayImg.swap(m_renderImg);
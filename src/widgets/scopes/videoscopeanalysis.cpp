@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "videoscopeanalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCOPE_X86_KERNELS
+#define SCOPE_SSE41 __attribute__((target("sse4.1")))
+#define SCOPE_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Fixed point for the YUV to RGB conversion; coefficients are at most about
+// 2.1, so they fit signed 16 bit, and every kernel does the same integer math.
+const int Shift = 13;
+const int One = 1 << Shift;
+const int Round = 1 << (Shift - 1);
+
+// Columns per strip in analyze(); a multiple of 16 for the vector kernels.
+const int StripWidth = 256;
+
+struct Coefficients
+{
+    int16_t yOffset;
+    int16_t y;
+    int16_t rv;
+    int16_t gu;
+    int16_t gv;
+    int16_t bu;
+};
+
+Coefficients coefficients(int colorspace, int height, bool fullRange)
+{
+    double kr;
+    double kb;
+    if (colorspace != 601 && colorspace != 709 && colorspace != 2020 && colorspace != 240)
+        colorspace = height <= 576 ? 601 : 709;
+    switch (colorspace) {
+    case 601:
+        kr = 0.299;
+        kb = 0.114;
+        break;
+    case 240:
+        kr = 0.212;
+        kb = 0.087;
+        break;
+    case 2020:
+        kr = 0.2627;
+        kb = 0.0593;
+        break;
+    default:
+        kr = 0.2126;
+        kb = 0.0722;
+        break;
+    }
+    double kg = 1.0 - kr - kb;
+    double yScale = fullRange ? 1.0 : 255.0 / 219.0;
+    double cScale = fullRange ? 1.0 : 255.0 / 224.0;
+
+    Coefficients c;
+    c.yOffset = fullRange ? 0 : 16;
+    c.y = int16_t(std::lround(yScale * One));
+    c.rv = int16_t(std::lround(2.0 * (1.0 - kr) * cScale * One));
+    c.gu = int16_t(std::lround(-2.0 * (1.0 - kb) * kb / kg * cScale * One));
+    c.gv = int16_t(std::lround(-2.0 * (1.0 - kr) * kr / kg * cScale * One));
+    c.bu = int16_t(std::lround(2.0 * (1.0 - kb) * cScale * One));
+    return c;
+}
+
+inline uint8_t clampByte(int value)
+{
+    return uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+inline void hit(uint8_t &count)
+{
+    count += count != 255;
+}
+
+inline uint8_t level(uint8_t count)
+{
+    return count >= VideoScopeAnalysis::Saturation ? 255 : count * 15;
+}
+
+// Converts pixels [from, width) of a row. Chroma is sampled by nearest
+// neighbor; the last column of an odd width reuses the last chroma sample.
+void convertRowScalar(const uint8_t *y,
+                      const uint8_t *u,
+                      const uint8_t *v,
+                      int from,
+                      int width,
+                      int chromaWidth,
+                      const Coefficients &k,
+                      uint8_t *r,
+                      uint8_t *g,
+                      uint8_t *b)
+{
+    for (int x = from; x < width; x++) {
+        int cx = std::min(x >> 1, chromaWidth - 1);
+        int yy = (y[x] - k.yOffset) * k.y + Round;
+        int uu = u[cx] - 128;
+        int vv = v[cx] - 128;
+        r[x] = clampByte((yy + vv * k.rv) >> Shift);
+        g[x] = clampByte((yy + uu * k.gu + vv * k.gv) >> Shift);
+        b[x] = clampByte((yy + uu * k.bu) >> Shift);
+    }
+}
+
+void renderScalar(
+    const uint8_t *red, const uint8_t *green, const uint8_t *blue, int from, int count, uint8_t *rgbx)
+{
+    for (int i = from; i < count; i++) {
+        uint8_t *p = rgbx + i * 4;
+        p[0] = red ? level(red[i]) : 0;
+        p[1] = green ? level(green[i]) : 0;
+        p[2] = blue ? level(blue[i]) : 0;
+        p[3] = 0xff;
+    }
+}
+
+#ifdef SCOPE_X86_KERNELS
+
+// A pair of 16-bit coefficients for _mm_madd_epi16(): lo multiplies the first
+// value of each pair, hi the second.
+inline int pair(int16_t lo, int16_t hi)
+{
+    return int(uint32_t(uint16_t(lo)) | uint32_t(uint16_t(hi)) << 16);
+}
+
+SCOPE_SSE41 inline __m128i channelSse41(
+    __m128i yLo, __m128i yHi, __m128i cLo, __m128i cHi, __m128i coefficients)
+{
+    __m128i lo = _mm_srai_epi32(_mm_add_epi32(yLo, _mm_madd_epi16(cLo, coefficients)), Shift);
+    __m128i hi = _mm_srai_epi32(_mm_add_epi32(yHi, _mm_madd_epi16(cHi, coefficients)), Shift);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// 8 pixels per step; count must be a multiple of 8.
+SCOPE_SSE41 void convertRowSse41(const uint8_t *y,
+                                 const uint8_t *u,
+                                 const uint8_t *v,
+                                 int count,
+                                 const Coefficients &k,
+                                 uint8_t *r,
+                                 uint8_t *g,
+                                 uint8_t *b)
+{
+    const __m128i yOffset = _mm_set1_epi16(k.yOffset);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i yCoefficients = _mm_set1_epi32(pair(k.y, Round));
+    const __m128i rCoefficients = _mm_set1_epi32(pair(0, k.rv));
+    const __m128i gCoefficients = _mm_set1_epi32(pair(k.gu, k.gv));
+    const __m128i bCoefficients = _mm_set1_epi32(pair(k.bu, 0));
+
+    for (int x = 0; x < count; x += 8) {
+        int32_t u4;
+        int32_t v4;
+        std::memcpy(&u4, u + x / 2, 4);
+        std::memcpy(&v4, v + x / 2, 4);
+        __m128i uu = _mm_cvtsi32_si128(u4);
+        __m128i vv = _mm_cvtsi32_si128(v4);
+        // Each chroma sample covers two pixels.
+        uu = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_unpacklo_epi8(uu, uu)), chromaOffset);
+        vv = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_unpacklo_epi8(vv, vv)), chromaOffset);
+        __m128i yy = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)));
+        yy = _mm_sub_epi16(yy, yOffset);
+
+        __m128i yLo = _mm_madd_epi16(_mm_unpacklo_epi16(yy, ones), yCoefficients);
+        __m128i yHi = _mm_madd_epi16(_mm_unpackhi_epi16(yy, ones), yCoefficients);
+        __m128i cLo = _mm_unpacklo_epi16(uu, vv);
+        __m128i cHi = _mm_unpackhi_epi16(uu, vv);
+
+        __m128i rg = _mm_packus_epi16(channelSse41(yLo, yHi, cLo, cHi, rCoefficients),
+                                      channelSse41(yLo, yHi, cLo, cHi, gCoefficients));
+        __m128i bb = channelSse41(yLo, yHi, cLo, cHi, bCoefficients);
+        bb = _mm_packus_epi16(bb, bb);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(r + x), rg);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(g + x), _mm_unpackhi_epi64(rg, rg));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(b + x), bb);
+    }
+}
+
+SCOPE_AVX2 inline __m256i channelAvx2(
+    __m256i yLo, __m256i yHi, __m256i cLo, __m256i cHi, __m256i coefficients)
+{
+    __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(yLo, _mm256_madd_epi16(cLo, coefficients)),
+                                   Shift);
+    __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(yHi, _mm256_madd_epi16(cHi, coefficients)),
+                                   Shift);
+    return _mm256_packs_epi32(lo, hi);
+}
+
+// 16 pixels per step; count must be a multiple of 16. The unpacks and packs
+// work within 128-bit lanes, so the pixel order survives until the final
+// packus, which is put back in order with one permute.
+SCOPE_AVX2 void convertRowAvx2(const uint8_t *y,
+                               const uint8_t *u,
+                               const uint8_t *v,
+                               int count,
+                               const Coefficients &k,
+                               uint8_t *r,
+                               uint8_t *g,
+                               uint8_t *b)
+{
+    const __m256i yOffset = _mm256_set1_epi16(k.yOffset);
+    const __m256i chromaOffset = _mm256_set1_epi16(128);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i yCoefficients = _mm256_set1_epi32(pair(k.y, Round));
+    const __m256i rCoefficients = _mm256_set1_epi32(pair(0, k.rv));
+    const __m256i gCoefficients = _mm256_set1_epi32(pair(k.gu, k.gv));
+    const __m256i bCoefficients = _mm256_set1_epi32(pair(k.bu, 0));
+
+    for (int x = 0; x < count; x += 16) {
+        __m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+        __m128i v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+        __m256i uu = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)),
+                                      chromaOffset);
+        __m256i vv = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)),
+                                      chromaOffset);
+        __m256i yy = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x)));
+        yy = _mm256_sub_epi16(yy, yOffset);
+
+        __m256i yLo = _mm256_madd_epi16(_mm256_unpacklo_epi16(yy, ones), yCoefficients);
+        __m256i yHi = _mm256_madd_epi16(_mm256_unpackhi_epi16(yy, ones), yCoefficients);
+        __m256i cLo = _mm256_unpacklo_epi16(uu, vv);
+        __m256i cHi = _mm256_unpackhi_epi16(uu, vv);
+
+        __m256i rg = _mm256_packus_epi16(channelAvx2(yLo, yHi, cLo, cHi, rCoefficients),
+                                         channelAvx2(yLo, yHi, cLo, cHi, gCoefficients));
+        rg = _mm256_permute4x64_epi64(rg, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i bb = channelAvx2(yLo, yHi, cLo, cHi, bCoefficients);
+        bb = _mm256_permute4x64_epi64(_mm256_packus_epi16(bb, bb), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(r + x), _mm256_castsi256_si128(rg));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(g + x), _mm256_extracti128_si256(rg, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b + x), _mm256_castsi256_si128(bb));
+    }
+}
+
+SCOPE_SSE41 inline __m128i levelSse41(const uint8_t *counts, __m128i saturation)
+{
+    const __m128i factor = _mm_set1_epi16(15);
+    __m128i c = _mm_min_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(counts)),
+                             saturation);
+    __m128i lo = _mm_mullo_epi16(_mm_cvtepu8_epi16(c), factor);
+    __m128i hi = _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(c, 8)), factor);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// 16 pixels per step; count must be a multiple of 16. Render is bound by
+// the stores, so there is no AVX2 variant.
+SCOPE_SSE41 void renderSse41(
+    const uint8_t *red, const uint8_t *green, const uint8_t *blue, int count, uint8_t *rgbx)
+{
+    const __m128i saturation = _mm_set1_epi8(VideoScopeAnalysis::Saturation);
+    const __m128i alpha = _mm_set1_epi8(char(0xff));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i *out = reinterpret_cast<__m128i *>(rgbx);
+
+    for (int i = 0; i < count; i += 16) {
+        __m128i r = red ? levelSse41(red + i, saturation) : zero;
+        __m128i g = green ? levelSse41(green + i, saturation) : zero;
+        __m128i b = blue ? levelSse41(blue + i, saturation) : zero;
+        __m128i rgLo = _mm_unpacklo_epi8(r, g);
+        __m128i rgHi = _mm_unpackhi_epi8(r, g);
+        __m128i bxLo = _mm_unpacklo_epi8(b, alpha);
+        __m128i bxHi = _mm_unpackhi_epi8(b, alpha);
+        _mm_storeu_si128(out++, _mm_unpacklo_epi16(rgLo, bxLo));
+        _mm_storeu_si128(out++, _mm_unpackhi_epi16(rgLo, bxLo));
+        _mm_storeu_si128(out++, _mm_unpacklo_epi16(rgHi, bxHi));
+        _mm_storeu_si128(out++, _mm_unpackhi_epi16(rgHi, bxHi));
+    }
+}
+
+#endif // SCOPE_X86_KERNELS
+
+std::atomic<int> s_kernel(VideoScopeAnalysis::bestKernel());
+
+// Converts a whole row with the selected kernel and finishes with scalar code.
+void convertRow(const uint8_t *y,
+                const uint8_t *u,
+                const uint8_t *v,
+                int width,
+                int chromaWidth,
+                const Coefficients &k,
+                uint8_t *r,
+                uint8_t *g,
+                uint8_t *b)
+{
+    int done = 0;
+#ifdef SCOPE_X86_KERNELS
+    // The vector loads must not read chroma past chromaWidth.
+    int vectorWidth = std::min(width, chromaWidth * 2);
+    switch (s_kernel.load(std::memory_order_relaxed)) {
+    case VideoScopeAnalysis::KernelAvx2:
+        done = vectorWidth & ~15;
+        convertRowAvx2(y, u, v, done, k, r, g, b);
+        break;
+    case VideoScopeAnalysis::KernelSse41:
+        done = vectorWidth & ~7;
+        convertRowSse41(y, u, v, done, k, r, g, b);
+        break;
+    default:
+        break;
+    }
+#endif
+    convertRowScalar(y, u, v, done, width, chromaWidth, k, r, g, b);
+}
+
+} // namespace
+
+VideoScopeAnalysis::VideoScopeAnalysis()
+    : m_width(0)
+    , m_height(0)
+    , m_components(0)
+{
+    std::memset(m_histogram, 0, sizeof(m_histogram));
+}
+
+void VideoScopeAnalysis::analyze(
+    const uint8_t *image, int width, int height, int colorspace, bool fullRange, int components)
+{
+    if (width != m_width || height != m_height) {
+        m_width = width;
+        m_height = height;
+        m_components = 0;
+    }
+    if (!image || width < 2 || height < 2)
+        return;
+
+    const size_t planeSize = size_t(width) * Levels;
+    if (components & LumaWaveform)
+        m_luma.assign(planeSize, 0);
+    if (components & RgbWaveform) {
+        for (int c = Red; c <= Blue; c++)
+            m_rgb[c].assign(planeSize, 0);
+    }
+    if (components & Vector)
+        m_vector.assign(Levels * Levels, 0);
+
+    // Every other pixel goes to a second set of bins, so that runs of equal
+    // values do not wait on the previous increment of the same bin.
+    unsigned int bins[2][4][Levels];
+    if (components & Histogram)
+        std::memset(bins, 0, sizeof(bins));
+
+    const int chromaWidth = width / 2;
+    const int chromaHeight = height / 2;
+    const uint8_t *yPlane = image;
+    const uint8_t *uPlane = yPlane + size_t(width) * height;
+    const uint8_t *vPlane = uPlane + size_t(chromaWidth) * chromaHeight;
+    const Coefficients k = coefficients(colorspace, height, fullRange);
+    const bool needRgb = components & (RgbWaveform | Histogram);
+    uint8_t rgbRows[3][StripWidth];
+
+    // Column strips keep the part of each waveform they scatter into (256
+    // levels by StripWidth) in the L2 cache instead of the whole frame width.
+    for (int x0 = 0; x0 < width; x0 += StripWidth) {
+        const int count = std::min(StripWidth, width - x0);
+        const int chromaX0 = x0 / 2;
+        const int chromaCount = std::max(0, std::min(count / 2, chromaWidth - chromaX0));
+        const bool rgbWaveform = components & RgbWaveform;
+        uint8_t *luma = (components & LumaWaveform) ? m_luma.data() + x0 : nullptr;
+        uint8_t *red = rgbWaveform ? m_rgb[Red].data() + x0 : nullptr;
+        uint8_t *green = rgbWaveform ? m_rgb[Green].data() + x0 : nullptr;
+        uint8_t *blue = rgbWaveform ? m_rgb[Blue].data() + x0 : nullptr;
+
+        for (int row = 0; row < height; row++) {
+            const uint8_t *y = yPlane + size_t(row) * width + x0;
+            const int chromaRow = std::min(row >> 1, chromaHeight - 1);
+            const uint8_t *u = uPlane + size_t(chromaRow) * chromaWidth + chromaX0;
+            const uint8_t *v = vPlane + size_t(chromaRow) * chromaWidth + chromaX0;
+
+            if (luma) {
+                for (int x = 0; x < count; x++)
+                    hit(luma[(255 - y[x]) * width + x]);
+            }
+            if (needRgb) {
+                convertRow(y,
+                           u,
+                           v,
+                           count,
+                           chromaWidth - chromaX0,
+                           k,
+                           rgbRows[Red],
+                           rgbRows[Green],
+                           rgbRows[Blue]);
+            }
+            if (rgbWaveform) {
+                for (int x = 0; x < count; x++) {
+                    hit(red[(255 - rgbRows[Red][x]) * width + x]);
+                    hit(green[(255 - rgbRows[Green][x]) * width + x]);
+                    hit(blue[(255 - rgbRows[Blue][x]) * width + x]);
+                }
+            }
+            if (components & Histogram) {
+                for (int x = 0; x < count; x++) {
+                    unsigned int(*set)[Levels] = bins[x & 1];
+                    set[Luma][y[x]]++;
+                    set[Red][rgbRows[Red][x]]++;
+                    set[Green][rgbRows[Green][x]]++;
+                    set[Blue][rgbRows[Blue][x]]++;
+                }
+            }
+            if ((components & Vector) && (row & 1) == 0 && (row >> 1) < chromaHeight) {
+                uint8_t *dst = m_vector.data();
+                for (int x = 0; x < chromaCount; x++)
+                    hit(dst[(255 - v[x]) * Levels + u[x]]);
+            }
+        }
+    }
+
+    if (components & Histogram) {
+        for (int c = Red; c <= Luma; c++) {
+            for (int i = 0; i < Levels; i++)
+                m_histogram[c][i] = bins[0][c][i] + bins[1][c][i];
+        }
+    }
+    m_components |= components;
+}
+
+void VideoScopeAnalysis::render(
+    const uint8_t *red, const uint8_t *green, const uint8_t *blue, int count, uint8_t *rgbx)
+{
+    int done = 0;
+#ifdef SCOPE_X86_KERNELS
+    if (s_kernel.load(std::memory_order_relaxed) != KernelScalar) {
+        done = count & ~15;
+        renderSse41(red, green, blue, done, rgbx);
+    }
+#endif
+    renderScalar(red, green, blue, done, count, rgbx);
+}
+
+VideoScopeAnalysis::Kernel VideoScopeAnalysis::bestKernel()
+{
+#ifdef SCOPE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return KernelAvx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return KernelSse41;
+#endif
+    return KernelScalar;
+}
+
+VideoScopeAnalysis::Kernel VideoScopeAnalysis::kernel()
+{
+    return Kernel(s_kernel.load());
+}
+
+bool VideoScopeAnalysis::setKernel(Kernel kernel)
+{
+    if (kernel > bestKernel())
+        return false;
+    s_kernel = kernel;
+    return true;
+}
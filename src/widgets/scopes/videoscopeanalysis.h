@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEOSCOPEANALYSIS_H
+#define VIDEOSCOPEANALYSIS_H
+
+#include <stdint.h>
+#include <vector>
+
+/*!
+  \class VideoScopeAnalysis
+  \brief The VideoScopeAnalysis holds the per-frame data of the video scopes.
+
+  analyze() walks a yuv420p image once, row by row. Each row is converted to
+  RGB into small row buffers (SSE4.1 or AVX2 when the CPU has it, otherwise
+  scalar; all give identical results) and then accumulated into every
+  requested component while it is still in the L1 cache. The accumulation
+  itself is a scatter into 256 levels and stays scalar.
+
+  Waveforms and the vector plot are stored as saturating 8-bit hit counts laid
+  out like the scope images: one row per level, row 0 is level 255. render()
+  turns a row of counts into RGBX8888 pixels.
+
+  The RGB conversion follows the frame's colorspace (601, 709 or 2020) and
+  range, like MLT's own conversion to mlt_image_rgb, but samples chroma by
+  nearest neighbor.
+
+  The class does not depend on MLT. ScopeWidget::analyzeFrame() shares one
+  instance per frame among all video scopes.
+*/
+
+class VideoScopeAnalysis
+{
+public:
+    enum Component {
+        LumaWaveform = 0x1,
+        RgbWaveform = 0x2, //!< Used by the RGB waveform and the RGB parade
+        Vector = 0x4,      //!< U/V plot of the vector scope
+        Histogram = 0x8,   //!< Luma, red, green and blue histograms
+    };
+
+    enum Channel { Red = 0, Green, Blue, Luma };
+
+    enum Kernel { KernelScalar = 0, KernelSse41, KernelAvx2 };
+
+    static const int Levels = 256;
+    //! Hits after which a render() pixel is fully lit; each hit adds 15.
+    static const int Saturation = 17;
+
+    VideoScopeAnalysis();
+
+    /*!
+      Accumulates \a components of a yuv420p \a image. Components that were
+      analyzed before and are not in \a components are kept, so a missing
+      component can be added to an existing analysis of the same image. Call
+      clear() first to start on a new image.
+    */
+    void analyze(const uint8_t *image,
+                 int width,
+                 int height,
+                 int colorspace,
+                 bool fullRange,
+                 int components);
+
+    //! Forgets all analyzed components; the buffers are kept for reuse.
+    void clear() { m_components = 0; }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int components() const { return m_components; }
+
+    //! Levels rows of width() counts.
+    const uint8_t *lumaWaveform() const { return m_luma.data(); }
+    //! Levels rows of width() counts of \a channel (Red, Green or Blue).
+    const uint8_t *rgbWaveform(Channel channel) const { return m_rgb[channel].data(); }
+    //! Levels rows of Levels counts; the column is U, the row is 255 - V.
+    const uint8_t *vector() const { return m_vector.data(); }
+    //! Levels pixel counts of \a channel.
+    const unsigned int *histogram(Channel channel) const { return m_histogram[channel]; }
+
+    /*!
+      Writes \a count RGBX8888 pixels from rows of counts. A null channel is
+      written as 0. Any of the channels may point to the same row.
+    */
+    static void render(
+        const uint8_t *red, const uint8_t *green, const uint8_t *blue, int count, uint8_t *rgbx);
+
+    //! The best kernel the CPU supports; used unless setKernel() was called.
+    static Kernel bestKernel();
+    static Kernel kernel();
+    //! Returns false if the CPU does not support \a kernel.
+    static bool setKernel(Kernel kernel);
+
+private:
+    int m_width;
+    int m_height;
+    int m_components;
+    std::vector<uint8_t> m_luma;
+    std::vector<uint8_t> m_rgb[3];
+    std::vector<uint8_t> m_vector;
+    unsigned int m_histogram[4][Levels];
+};
+
+#endif // VIDEOSCOPEANALYSIS_H
@@ -101,35 +101,18 @@ void VideoVectorScopeWidget::refreshScope(const QSize &size, bool full)
         m_frame = m_queue.pop();
     }
 
-    int width = m_frame.get_image_width();
-    int height = m_frame.get_image_height();
+    std::shared_ptr<const VideoScopeAnalysis> analysis
+        = analyzeFrame(m_frame, VideoScopeAnalysis::Vector);
 
-    if (m_frame.is_valid() && width && height) {
+    if (analysis) {
         if (m_renderImg.width() != 256) {
             m_renderImg = QImage(256, 256, QImage::Format_RGBX8888);
         }
-        m_renderImg.fill(0);
-
-        const uint8_t *src = m_frame.get_image(mlt_image_yuv420p);
-        const uint8_t *uSrc = src + (width * height);
-        const uint8_t *vSrc = uSrc + (width * height / 4);
-        uint8_t *dst = m_renderImg.scanLine(0);
-        int cHeight = height / 2;
-        int cWidth = width / 2;
-
-        for (int y = 0; y < cHeight; y++) {
-            for (int x = 0; x < cWidth; x++) {
-                uint8_t dx = *uSrc;
-                uint8_t dy = 255 - *vSrc;
-                size_t dIndex = (dy * 256 + dx) * 4;
-                if (dst[dIndex] < 0xff) {
-                    dst[dIndex] += 0x0f;
-                    dst[dIndex + 1] += 0x0f;
-                    dst[dIndex + 2] += 0x0f;
-                }
-                uSrc++;
-                vSrc++;
-            }
+
+        const uint8_t *src = analysis->vector();
+        for (int y = 0; y < 256; y++) {
+            VideoScopeAnalysis::render(src, src, src, 256, m_renderImg.scanLine(y));
+            src += 256;
         }
 
         QImage newDisplayImage = m_graticuleImg.copy();
@@ -49,31 +49,19 @@ void VideoWaveformScopeWidget::refreshScope(const QSize &size, bool full)
         m_frame = m_queue.pop();
     }
 
-    int width = m_frame.get_image_width();
-    int height = m_frame.get_image_height();
+    std::shared_ptr<const VideoScopeAnalysis> analysis
+        = analyzeFrame(m_frame, VideoScopeAnalysis::LumaWaveform);
 
-    if (m_frame.is_valid() && width && height) {
+    if (analysis) {
+        int width = analysis->width();
         if (m_renderImg.width() != width) {
             m_renderImg = QImage(width, 256, QImage::Format_RGBX8888);
         }
 
-        QColor bgColor(0, 0, 0, 0xff);
-        m_renderImg.fill(bgColor);
-
-        const uint8_t *src = m_frame.get_image(mlt_image_yuv420p);
-        uint8_t *dst = m_renderImg.scanLine(0);
-
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                uint8_t dy = 255 - src[0];
-                size_t dIndex = (dy * width + x) * 4;
-                if (dst[dIndex] < 0xff) {
-                    dst[dIndex] += 0x0f;
-                    dst[dIndex + 1] += 0x0f;
-                    dst[dIndex + 2] += 0x0f;
-                }
-                src++;
-            }
+        const uint8_t *src = analysis->lumaWaveform();
+        for (int y = 0; y < 256; y++) {
+            VideoScopeAnalysis::render(src, src, src, width, m_renderImg.scanLine(y));
+            src += width;
         }
 
         QImage scaledImage = m_renderImg
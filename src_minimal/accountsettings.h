@@ -41,18 +41,29 @@ struct MailProvider {
     int imapPort;
     QString smtpServer;
     int smtpPort;
+    int maxConnections; // gleichzeitige IMAP-Sitzungen pro Konto
 };
 
 inline QList<MailProvider> knownProviders() {
     return {
-        {"GMX", "imap.gmx.net", 993, "mail.gmx.net", 587},
-        {"Web.de", "imap.web.de", 993, "smtp.web.de", 587},
-        {"Gmail", "imap.gmail.com", 993, "smtp.gmail.com", 587},
-        {"Outlook", "outlook.office365.com", 993, "smtp.office365.com", 587},
-        {"Yahoo", "imap.mail.yahoo.com", 993, "smtp.mail.yahoo.com", 587},
-        {"T-Online", "secureimap.t-online.de", 993, "securesmtp.t-online.de", 587},
-        {"iCloud", "imap.mail.me.com", 993, "smtp.mail.me.com", 587},
+        {"GMX", "imap.gmx.net", 993, "mail.gmx.net", 587, 4},
+        {"Web.de", "imap.web.de", 993, "smtp.web.de", 587, 4},
+        {"Gmail", "imap.gmail.com", 993, "smtp.gmail.com", 587, 15},
+        {"Outlook", "outlook.office365.com", 993, "smtp.office365.com", 587, 8},
+        {"Yahoo", "imap.mail.yahoo.com", 993, "smtp.mail.yahoo.com", 587, 5},
+        {"T-Online", "secureimap.t-online.de", 993, "securesmtp.t-online.de", 587, 4},
+        {"iCloud", "imap.mail.me.com", 993, "smtp.mail.me.com", 587, 4},
     };
 }
 
+// Provider zu einem IMAP-Server; unbekannte Server mit vorsichtigem Limit
+inline MailProvider providerForServer(const QString &imapServer) {
+    for (const auto &p : knownProviders()) {
+        if (p.imapServer.compare(imapServer, Qt::CaseInsensitive) == 0) {
+            return p;
+        }
+    }
+    return {QString(), imapServer, 993, QString(), 587, 2};
+}
+
 #endif // ACCOUNTSETTINGS_H
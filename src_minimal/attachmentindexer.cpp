@@ -0,0 +1,461 @@
+/*
+ * mailadler - Attachment Indexer
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "attachmentindexer.h"
+#include "bodycache.h"
+#include "bodystructure.h"
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include "searchindex.h"
+#include "textextractor.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+
+// Anhänge einer Nachricht, aus denen sich Text gewinnen lässt
+QVector<MimePart> indexableParts(const QByteArray &structure)
+{
+    QVector<MimePart> result;
+    if (structure.isEmpty()) {
+        return result;
+    }
+    for (const MimePart &part : BodyStructure::parse(structure)) {
+        if (part.isAttachment() && part.size <= quint32(AttachmentIndexer::MaxIndexSize)
+            && TextExtractor::canExtract(part)) {
+            result.append(part);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+AttachmentIndexer::AttachmentIndexer(MessageStore *store, BodyCache *cache, SearchIndex *index, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_cache(cache)
+    , m_index(index)
+    , m_pool(nullptr)
+    , m_valid(false)
+    , m_session(nullptr)
+    , m_sessionMailbox(-1)
+{
+    // Ein Kern bleibt für die Oberfläche frei
+    m_workers.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    m_workers.setThreadPriority(QThread::LowestPriority);
+
+    m_quiet.setSingleShot(true);
+    m_quiet.setInterval(QuietPeriod);
+    connect(&m_quiet, &QTimer::timeout, this, &AttachmentIndexer::schedule);
+}
+
+AttachmentIndexer::~AttachmentIndexer()
+{
+    for (const Running &r : std::as_const(m_running)) {
+        *r.cancelled = true;
+    }
+    m_workers.waitForDone();
+    // release() meldet die Sitzung sofort wieder frei
+    m_queue.clear();
+    m_missing.clear();
+    releaseSession();
+}
+
+bool AttachmentIndexer::open()
+{
+    QSqlQuery query(m_store->database());
+    // Neu angelegt: vorhandene Nachrichten einmal nachtragen
+    query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'attachment_jobs'");
+    const bool fresh = !query.next();
+
+    static const char *const statements[] = {
+        "CREATE TABLE IF NOT EXISTS attachment_jobs ("
+        " mailbox_id INTEGER NOT NULL REFERENCES mailboxes(id) ON DELETE CASCADE,"
+        " uid INTEGER NOT NULL,"
+        " section TEXT NOT NULL,"
+        " PRIMARY KEY (mailbox_id, uid, section)) WITHOUT ROWID",
+        // Text je Anhang, der Suchindex hält nur die Summe je Nachricht
+        "CREATE TABLE IF NOT EXISTS attachment_text ("
+        " mailbox_id INTEGER NOT NULL REFERENCES mailboxes(id) ON DELETE CASCADE,"
+        " uid INTEGER NOT NULL,"
+        " section TEXT NOT NULL,"
+        " text TEXT NOT NULL,"
+        " PRIMARY KEY (mailbox_id, uid, section)) WITHOUT ROWID",
+    };
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            qWarning() << "AttachmentIndexer: Schema-Fehler:" << query.lastError().text();
+            return false;
+        }
+    }
+    m_valid = true;
+    if (fresh) {
+        backfill();
+    }
+
+    query.setForwardOnly(true);
+    query.exec("SELECT mailbox_id, uid, section FROM attachment_jobs ORDER BY uid DESC");
+    while (query.next()) {
+        m_queue.append({query.value(0).toInt(), query.value(1).toUInt(), query.value(2).toString().toLatin1()});
+    }
+    if (!m_queue.isEmpty()) {
+        qDebug() << "AttachmentIndexer:" << m_queue.size() << "Anhänge ausstehend";
+    }
+    // Erst nach dem Start der Oberfläche
+    m_quiet.start();
+    return true;
+}
+
+void AttachmentIndexer::setPool(ImapConnectionPool *pool)
+{
+    m_pool = pool;
+    connect(m_pool, &ImapConnectionPool::sessionReady, this, &AttachmentIndexer::onSessionReady);
+    connect(m_pool, &ImapConnectionPool::sessionLost, this, &AttachmentIndexer::onSessionLost);
+}
+
+int AttachmentIndexer::pendingCount() const
+{
+    return int(m_queue.size() + m_missing.size() + m_running.size() + m_fetching.size());
+}
+
+void AttachmentIndexer::backfill()
+{
+    QSqlDatabase db = m_store->database();
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR IGNORE INTO attachment_jobs (mailbox_id, uid, section) VALUES (?, ?, ?)");
+    int count = 0;
+    db.transaction();
+    select.exec("SELECT mailbox_id, uid, structure FROM messages WHERE structure IS NOT NULL");
+    while (select.next()) {
+        for (const MimePart &part : indexableParts(select.value(2).toByteArray())) {
+            insert.bindValue(0, select.value(0));
+            insert.bindValue(1, select.value(1));
+            insert.bindValue(2, QString::fromLatin1(part.section));
+            insert.exec();
+            ++count;
+        }
+    }
+    db.commit();
+    qDebug() << "AttachmentIndexer:" << count << "vorhandene Anhänge vorgemerkt";
+}
+
+void AttachmentIndexer::addMessages(int mailboxId, const QList<EmailHeader> &headers)
+{
+    if (!m_valid) {
+        return;
+    }
+    QList<Job> jobs;
+    for (const EmailHeader &h : headers) {
+        for (const MimePart &part : indexableParts(h.structure)) {
+            jobs.append({mailboxId, h.uid, part.section});
+        }
+    }
+    enqueue(jobs);
+}
+
+void AttachmentIndexer::attachmentReady(int mailboxId, quint32 uid, const QByteArray &section)
+{
+    if (!m_valid) {
+        return;
+    }
+    const QByteArray structure = m_store->bodyStructure(mailboxId, uid);
+    for (const MimePart &part : indexableParts(structure)) {
+        if (part.section == section) {
+            enqueue({{mailboxId, uid, section}});
+            return;
+        }
+    }
+}
+
+void AttachmentIndexer::enqueue(const QList<Job> &jobs)
+{
+    if (jobs.isEmpty()) {
+        return;
+    }
+    QSqlDatabase db = m_store->database();
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO attachment_jobs (mailbox_id, uid, section) VALUES (?, ?, ?)");
+    db.transaction();
+    for (const Job &job : jobs) {
+        query.bindValue(0, job.mailboxId);
+        query.bindValue(1, job.uid);
+        query.bindValue(2, QString::fromLatin1(job.section));
+        query.exec();
+    }
+    db.commit();
+
+    // Neue Nachrichten vor dem Rückstand
+    QList<Job> sorted = jobs;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Job &a, const Job &b) { return a.uid > b.uid; });
+    m_queue = sorted + m_queue;
+    schedule();
+}
+
+void AttachmentIndexer::removeMessages(int mailboxId, const QVector<UidRange> &ranges)
+{
+    if (m_valid && !ranges.isEmpty()) {
+        drop(mailboxId, ranges);
+    }
+}
+
+void AttachmentIndexer::removeMailbox(int mailboxId)
+{
+    if (m_valid) {
+        drop(mailboxId, {{0, 0xffffffffu}});
+    }
+}
+
+void AttachmentIndexer::drop(int mailboxId, const QVector<UidRange> &ranges)
+{
+    auto matches = [mailboxId, &ranges](const Job &job) {
+        if (job.mailboxId != mailboxId) {
+            return false;
+        }
+        for (const UidRange &r : ranges) {
+            if (job.uid >= r.first && job.uid <= r.last) {
+                return true;
+            }
+        }
+        return false;
+    };
+    m_queue.removeIf(matches);
+    m_missing.removeIf(matches);
+    // Was gerade geladen wird, findet start() nicht mehr im MessageStore
+    for (const Running &r : std::as_const(m_running)) {
+        if (matches(r.job)) {
+            *r.cancelled = true;
+        }
+    }
+
+    QSqlDatabase db = m_store->database();
+    QSqlQuery query(db);
+    db.transaction();
+    for (const char *sql : {"DELETE FROM attachment_jobs WHERE mailbox_id = ? AND uid BETWEEN ? AND ?",
+                            "DELETE FROM attachment_text WHERE mailbox_id = ? AND uid BETWEEN ? AND ?"}) {
+        query.prepare(sql);
+        for (const UidRange &r : ranges) {
+            query.bindValue(0, mailboxId);
+            query.bindValue(1, r.first);
+            query.bindValue(2, r.last);
+            query.exec();
+        }
+    }
+    db.commit();
+}
+
+void AttachmentIndexer::userActive()
+{
+    m_quiet.start();
+}
+
+int AttachmentIndexer::workerLimit() const
+{
+    return m_quiet.isActive() ? 1 : m_workers.maxThreadCount();
+}
+
+void AttachmentIndexer::schedule()
+{
+    while (m_running.size() < workerLimit() && !m_queue.isEmpty()) {
+        start(m_queue.takeFirst());
+    }
+    download();
+}
+
+bool AttachmentIndexer::start(const Job &job)
+{
+    MimePart part;
+    bool found = false;
+    for (const MimePart &p : indexableParts(m_store->bodyStructure(job.mailboxId, job.uid))) {
+        if (p.section == job.section) {
+            part = p;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        // Nachricht inzwischen gelöscht
+        forget(job);
+        return false;
+    }
+
+    QByteArray data;
+    const bool cached = m_cache->read(job.mailboxId, job.uid, job.section, [&data](QByteArrayView block) {
+        if (data.size() + block.size() > MaxIndexSize) {
+            return false;
+        }
+        data.append(block);
+        return true;
+    });
+    if (!cached || data.size() < qsizetype(part.size)) {
+        // Größere Anhänge warten im Auftrag, bis der Benutzer sie lädt
+        if (m_pool && part.size <= quint32(MaxDownloadSize)) {
+            m_missing.append(job);
+        }
+        return false;
+    }
+
+    Running running;
+    running.job = job;
+    running.cancelled = std::make_shared<std::atomic<bool>>(false);
+    m_running.append(running);
+
+    const std::shared_ptr<std::atomic<bool>> cancelled = running.cancelled;
+    m_workers.start([this, job, part, data, cancelled]() {
+        QString text = TextExtractor::extract(data, part, cancelled.get());
+        // Dateiname ist auch ohne Text auffindbar
+        if (!part.filename.isEmpty()) {
+            text.prepend(part.filename + QLatin1Char('\n'));
+        }
+        QMetaObject::invokeMethod(this, [this, job, text, cancelled]() {
+            m_running.removeIf([&cancelled](const Running &r) { return r.cancelled == cancelled; });
+            if (!*cancelled) {
+                finish(job, text);
+            }
+            schedule();
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+void AttachmentIndexer::finish(const Job &job, const QString &text)
+{
+    QSqlDatabase db = m_store->database();
+    QSqlQuery query(db);
+    db.transaction();
+    query.prepare("INSERT OR REPLACE INTO attachment_text (mailbox_id, uid, section, text) VALUES (?, ?, ?, ?)");
+    query.addBindValue(job.mailboxId);
+    query.addBindValue(job.uid);
+    query.addBindValue(QString::fromLatin1(job.section));
+    query.addBindValue(text);
+    if (!query.exec()) {
+        qWarning() << "AttachmentIndexer:" << query.lastError().text();
+    }
+    query.prepare("DELETE FROM attachment_jobs WHERE mailbox_id = ? AND uid = ? AND section = ?");
+    query.addBindValue(job.mailboxId);
+    query.addBindValue(job.uid);
+    query.addBindValue(QString::fromLatin1(job.section));
+    query.exec();
+    db.commit();
+
+    // Ein Dokument je Nachricht aus allen bisher indexierten Anhängen
+    QStringList texts;
+    query.prepare("SELECT text FROM attachment_text WHERE mailbox_id = ? AND uid = ? ORDER BY section");
+    query.addBindValue(job.mailboxId);
+    query.addBindValue(job.uid);
+    if (query.exec()) {
+        while (query.next()) {
+            texts.append(query.value(0).toString());
+        }
+    }
+    m_index->addAttachments(job.mailboxId, job.uid, texts.join(QLatin1Char('\n')));
+    emit indexed(job.mailboxId, job.uid);
+}
+
+void AttachmentIndexer::forget(const Job &job)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("DELETE FROM attachment_jobs WHERE mailbox_id = ? AND uid = ? AND section = ?");
+    query.addBindValue(job.mailboxId);
+    query.addBindValue(job.uid);
+    query.addBindValue(QString::fromLatin1(job.section));
+    query.exec();
+}
+
+void AttachmentIndexer::onSessionReady()
+{
+    download();
+}
+
+void AttachmentIndexer::download()
+{
+    if (!m_pool || m_session || m_missing.isEmpty() || m_quiet.isActive()) {
+        return;
+    }
+    // Nur freie Sitzungen, der Indexer öffnet selbst keine
+    ImapConnection *session = m_pool->acquire();
+    if (!session) {
+        return;
+    }
+    m_session = session;
+    m_sessionMailbox = m_missing.first().mailboxId;
+    const QString folder = m_store->mailboxName(m_sessionMailbox);
+    if (folder.isEmpty()) {
+        const int mailboxId = m_sessionMailbox;
+        m_missing.removeIf([mailboxId](const Job &job) { return job.mailboxId == mailboxId; });
+        releaseSession();
+        return;
+    }
+
+    session->setLane(ImapConnection::BackgroundLane);
+    connect(session, &ImapConnection::bodySectionsReceived, this, &AttachmentIndexer::onBodySectionsReceived);
+    if (session->selectedFolder() != folder) {
+        session->selectFolder(folder);
+    }
+    for (int i = 0; i < m_missing.size() && m_fetching.size() < DownloadBatch; ++i) {
+        if (m_missing.at(i).mailboxId != m_sessionMailbox) {
+            continue;
+        }
+        const Job job = m_missing.takeAt(i--);
+        ImapBodySection section;
+        section.section = job.section;
+        m_fetching.append(job);
+        session->fetchBodySections(job.uid, {section});
+    }
+}
+
+void AttachmentIndexer::onBodySectionsReceived(quint32 uid, const QVector<ImapBodySection> &sections, bool ok)
+{
+    for (const ImapBodySection &s : sections) {
+        for (int i = 0; i < m_fetching.size(); ++i) {
+            const Job job = m_fetching.at(i);
+            if (job.uid != uid || job.section != s.section) {
+                continue;
+            }
+            m_fetching.removeAt(i);
+            // Fehlgeschlagene bleiben gespeichert und kommen nach einem Neustart wieder
+            if (ok) {
+                m_cache->insert(job.mailboxId, uid, s.section, -1, s.data);
+                m_queue.prepend(job);
+            }
+            break;
+        }
+    }
+    if (m_fetching.isEmpty()) {
+        // Sitzung zwischen zwei Stapeln für andere frei machen
+        releaseSession();
+        schedule();
+    }
+}
+
+void AttachmentIndexer::onSessionLost(ImapConnection *session)
+{
+    if (session != m_session) {
+        return;
+    }
+    // Offene Abschnitte wurden schon mit Fehler beendet
+    m_session = nullptr;
+    m_fetching.clear();
+}
+
+void AttachmentIndexer::releaseSession()
+{
+    if (!m_session) {
+        return;
+    }
+    ImapConnection *session = m_session;
+    m_session = nullptr;
+    m_sessionMailbox = -1;
+    disconnect(session, &ImapConnection::bodySectionsReceived, this, nullptr);
+    session->setLane(ImapConnection::InteractiveLane);
+    m_pool->release(session);
+}
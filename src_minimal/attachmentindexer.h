@@ -0,0 +1,116 @@
+/*
+ * mailadler - Attachment Indexer
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef ATTACHMENTINDEXER_H
+#define ATTACHMENTINDEXER_H
+
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+#include "imapconnection.h"
+
+class BodyCache;
+class ImapConnectionPool;
+class MessageStore;
+class SearchIndex;
+
+// Text aus Anhängen für die Volltextsuche (TextExtractor).
+//
+// Jeder durchsuchbare Anhang neuer Nachrichten wird als Auftrag in der Tabelle
+// attachment_jobs vermerkt und erst nach dem Indexieren wieder gelöscht; nach
+// einem Neustart geht es mit den übrigen weiter. Die Extraktion läuft in einem
+// eigenen Threadpool mit einem Arbeiter je Kern (einer bleibt frei), auf
+// niedrigster Priorität. Solange der Benutzer tippt, klickt oder scrollt, und
+// QuietPeriod danach, startet höchstens ein Arbeiter und nichts wird geladen.
+// Anhänge, die nicht im BodyCache liegen, holt der Indexer über freie
+// Sitzungen des Pools in der Hintergrundspur, solange sie MaxDownloadSize
+// nicht überschreiten; größere warten, bis sie der Benutzer öffnet.
+class AttachmentIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Größere Anhänge werden nicht indexiert (kodierte Größe)
+    static const int MaxIndexSize = 32 * 1024 * 1024;
+    static const int MaxDownloadSize = 4 * 1024 * 1024;
+    // Abschnitte je ausgeliehener Sitzung
+    static const int DownloadBatch = 8;
+    static const int QuietPeriod = 3000; // ms
+
+    AttachmentIndexer(MessageStore *store, BodyCache *cache, SearchIndex *index, QObject *parent = nullptr);
+    // Bricht laufende Extraktionen ab, ihre Aufträge bleiben gespeichert
+    ~AttachmentIndexer() override;
+
+    bool open();
+    void setPool(ImapConnectionPool *pool);
+
+    int pendingCount() const;
+
+public slots:
+    void addMessages(int mailboxId, const QList<EmailHeader> &headers);
+    // Vom Benutzer geladen, jetzt im BodyCache
+    void attachmentReady(int mailboxId, quint32 uid, const QByteArray &section);
+    void removeMessages(int mailboxId, const QVector<UidRange> &ranges);
+    void removeMailbox(int mailboxId);
+    // Eingabe des Benutzers: bis QuietPeriod danach zurückhalten
+    void userActive();
+
+signals:
+    void indexed(int mailboxId, quint32 uid);
+
+private slots:
+    void onSessionReady();
+    void onSessionLost(ImapConnection *session);
+    void onBodySectionsReceived(quint32 uid, const QVector<ImapBodySection> &sections, bool ok);
+
+private:
+    struct Job {
+        int mailboxId;
+        quint32 uid;
+        QByteArray section;
+    };
+
+    struct Running {
+        Job job;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    void enqueue(const QList<Job> &jobs);
+    void schedule();
+    bool start(const Job &job);
+    void finish(const Job &job, const QString &text);
+    void forget(const Job &job);
+    void download();
+    void releaseSession();
+    void drop(int mailboxId, const QVector<UidRange> &ranges);
+    int workerLimit() const;
+    void backfill();
+
+    MessageStore *m_store;
+    BodyCache *m_cache;
+    SearchIndex *m_index;
+    ImapConnectionPool *m_pool;
+    bool m_valid;
+
+    QList<Job> m_queue;   // bereit, neueste zuerst
+    QList<Job> m_missing; // nicht im BodyCache, zum Laden
+    QList<Running> m_running;
+    QThreadPool m_workers;
+    QTimer m_quiet;
+
+    // Ausgeliehene Sitzung und ihre Abschnitte
+    ImapConnection *m_session;
+    int m_sessionMailbox;
+    QList<Job> m_fetching;
+};
+
+#endif // ATTACHMENTINDEXER_H
@@ -0,0 +1,86 @@
+/*
+ * mailadler - Push Latency Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Misst die Zeit von der Einlieferung einer Nachricht beim Stand-in-Server
+ * bis sie per IDLE im lokalen Speicher angekommen ist.
+ *
+ *   idlelatencybench [laufzeit-ms] [nachrichten]
+ */
+
+#include "idlewatcher.h"
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include "imapstandin.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int roundTrip = argc > 1 ? std::atoi(argv[1]) : 50;
+    const int count = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    ImapStandIn server;
+    server.setRoundTrip(roundTrip);
+    server.setMessageCount(1000);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return 1;
+    }
+
+    IdleWatcher watcher(&store);
+    watcher.setAccount("bench");
+    watcher.pool()->setServer("127.0.0.1", server.serverPort(), false);
+    watcher.pool()->setCredentials("bench", "bench");
+
+    QElapsedTimer timer;
+    std::vector<double> latencies;
+    QTimer delivery;
+    delivery.setInterval(200);
+    QObject::connect(&delivery, &QTimer::timeout, [&]() {
+        delivery.stop();
+        timer.start();
+        server.deliver();
+    });
+
+    bool initial = true;
+    QObject::connect(&watcher, &IdleWatcher::messagesAdded, [&](int, const QList<EmailHeader> &) {
+        if (initial) {
+            // Erstbefüllung des Speichers, danach beginnt die Messung
+            initial = false;
+        } else {
+            latencies.push_back(timer.nsecsElapsed() / 1e6);
+            if (int(latencies.size()) == count) {
+                app.quit();
+                return;
+            }
+        }
+        delivery.start();
+    });
+
+    watcher.watch(QStringList() << "INBOX");
+    app.exec();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("RTT %d ms, %zu Nachrichten: Median %.1f ms, Maximum %.1f ms\n", roundTrip, latencies.size(),
+                latencies[latencies.size() / 2], latencies.back());
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * mailadler - IMAP Compression Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Packt ein aufgezeichnetes Transkript so, wie es ein Server mit
+ * COMPRESS=DEFLATE schicken würde (ein Sync-Flush je 16 KiB), und misst
+ * Kompressionsfaktor sowie Durchsatz von Entpacken + Parsen gegenüber
+ * reinem Parsen.
+ *
+ *   imapcompressionbench <transkript>
+ *
+ * Ein Transkript erzeugt "imapparserbench --generate".
+ */
+
+#include "imapcompression.h"
+#include "imapparser.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const qsizetype ChunkSize = 16 * 1024;
+const int Rounds = 5;
+
+// Antworten zählen, damit der Parser nicht wegoptimiert wird
+qint64 drain(ImapParser *parser)
+{
+    qint64 responses = 0;
+    while (parser->next() != ImapParser::NeedMore) {
+        ++responses;
+    }
+    return responses;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Aufruf: %s <transkript>\n", argv[0]);
+        return 1;
+    }
+    QFile file(QString::fromLocal8Bit(argv[1]));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Kann %s nicht lesen\n", argv[1]);
+        return 1;
+    }
+    const QByteArray transcript = file.readAll();
+
+    // Serverseite: Stück für Stück packen
+    ImapCompression server;
+    std::vector<QByteArray> packets;
+    qsizetype packed = 0;
+    for (qsizetype pos = 0; pos < transcript.size(); pos += ChunkSize) {
+        packets.push_back(server.deflate(transcript.mid(pos, ChunkSize)));
+        packed += packets.back().size();
+    }
+    std::printf("%lld Bytes -> %lld Bytes gepackt, Faktor %.2f\n", (long long)transcript.size(),
+                (long long)packed, double(transcript.size()) / double(packed));
+
+    qint64 plainNs = 0;
+    qint64 inflateNs = 0;
+    qint64 responses = 0;
+    for (int round = 0; round < Rounds; ++round) {
+        ImapParser plain;
+        QElapsedTimer timer;
+        timer.start();
+        for (qsizetype pos = 0; pos < transcript.size(); pos += ChunkSize) {
+            plain.append(transcript.constData() + pos, qMin(ChunkSize, transcript.size() - pos));
+            responses = drain(&plain);
+        }
+        plainNs += timer.nsecsElapsed();
+
+        ImapParser parser;
+        ImapCompression client;
+        timer.start();
+        for (const QByteArray &packet : packets) {
+            if (!client.inflate(packet.constData(), packet.size(), &parser)) {
+                std::fprintf(stderr, "Entpacken fehlgeschlagen\n");
+                return 1;
+            }
+            drain(&parser);
+        }
+        inflateNs += timer.nsecsElapsed();
+    }
+
+    const double mb = double(transcript.size()) * Rounds / (1024.0 * 1024.0);
+    std::printf("nur Parsen:         %8.1f MB/s\n", mb / (plainNs / 1e9));
+    std::printf("Entpacken + Parsen: %8.1f MB/s (bezogen auf entpackte Bytes)\n", mb / (inflateNs / 1e9));
+    Q_UNUSED(responses)
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * mailadler - IMAP Parser Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Spielt ein aufgezeichnetes FETCH-Transkript (rohe Server-Bytes) in
+ * Socket-großen Häppchen in den Parser ein und misst Durchsatz sowie
+ * Heap-Allokationen pro Nachricht.
+ *
+ *   imapparserbench <transkript>
+ *   imapparserbench --generate <transkript> [anzahl]
+ */
+
+#include "imapparser.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<quint64> g_allocations{0};
+
+QByteArray syntheticFetch(int seq)
+{
+    QByteArray line = "* " + QByteArray::number(seq) + " FETCH (UID " + QByteArray::number(seq + 1000)
+                      + " FLAGS (\\Seen) RFC822.SIZE 4711 ENVELOPE (\"Mon, 3 Feb 2026 10:15:00 +0100\" ";
+    if (seq % 10 == 0) {
+        // Ab und zu ein Literal, wie es z.B. GMX für lange Betreffzeilen schickt
+        const QByteArray subject = "=?UTF-8?Q?Rechnung_f=C3=BCr_Februar?= Nr. " + QByteArray::number(seq);
+        line += "{" + QByteArray::number(subject.size()) + "}\r\n" + subject;
+    } else {
+        line += "\"Re: Projekt \\\"Adler\\\" Besprechung " + QByteArray::number(seq) + "\"";
+    }
+    line += " ((\"Max Mustermann\" NIL \"max\" \"gmx.de\")) ((\"Max Mustermann\" NIL \"max\" \"gmx.de\"))"
+            " ((\"Max Mustermann\" NIL \"max\" \"gmx.de\")) ((NIL NIL \"erika\" \"web.de\"))"
+            " NIL NIL NIL \"<" + QByteArray::number(seq) + "@mail.gmx.net>\"))\r\n";
+    return line;
+}
+
+int generate(const char *path, int count)
+{
+    QFile file(QString::fromLocal8Bit(path));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Kann %s nicht schreiben\n", path);
+        return 1;
+    }
+    file.write("* OK [CAPABILITY IMAP4rev1] Benchmark ready\r\n");
+    for (int i = 1; i <= count; ++i) {
+        file.write(syntheticFetch(i));
+    }
+    file.write("A0001 OK FETCH completed\r\n");
+    return 0;
+}
+
+// Wertet eine FETCH-Antwort so aus, wie ImapConnection es tut, nur ohne QString
+quint64 consume(const ImapResponse &r)
+{
+    quint64 checksum = 0;
+    if (!r.is(1, "FETCH") || r.type(2) != ImapToken::List) {
+        return checksum;
+    }
+    const int end = r.next(2);
+    for (int key = 3; key < end; key = r.next(key)) {
+        const int value = r.next(key);
+        if (value >= end) {
+            break;
+        }
+        if (r.is(key, "UID")) {
+            checksum += r.number(value);
+        } else if (r.is(key, "ENVELOPE")) {
+            checksum += quint64(r.view(r.child(value, 1)).size());
+            const int from = r.child(r.child(value, 2), 0);
+            checksum += quint64(r.view(r.child(from, 3)).size());
+        }
+        key = value;
+    }
+    return checksum;
+}
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    ++g_allocations;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && QByteArray(argv[1]) == "--generate") {
+        return generate(argv[2], argc >= 4 ? std::atoi(argv[3]) : 100000);
+    }
+    if (argc < 2) {
+        std::fprintf(stderr, "Aufruf: %s <transkript> | --generate <transkript> [anzahl]\n", argv[0]);
+        return 1;
+    }
+
+    QFile file(QString::fromLocal8Bit(argv[1]));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Kann %s nicht lesen\n", argv[1]);
+        return 1;
+    }
+    const QByteArray transcript = file.readAll();
+    const qsizetype chunkSize = 16 * 1024; // typische Größe eines readyRead
+    const int rounds = 5;
+
+    ImapParser parser;
+    quint64 messages = 0;
+    quint64 malformed = 0;
+    quint64 checksum = 0;
+    quint64 allocations = 0;
+    qint64 nsecs = 0;
+
+    for (int round = 0; round < rounds; ++round) {
+        parser.reset();
+        messages = 0;
+        const quint64 allocBefore = g_allocations.load();
+        QElapsedTimer timer;
+        timer.start();
+
+        for (qsizetype pos = 0; pos < transcript.size(); pos += chunkSize) {
+            const qsizetype n = qMin(chunkSize, transcript.size() - pos);
+            parser.append(transcript.constData() + pos, n);
+            for (;;) {
+                const ImapParser::Result result = parser.next();
+                if (result == ImapParser::NeedMore) {
+                    break;
+                }
+                if (result == ImapParser::Malformed) {
+                    ++malformed;
+                    continue;
+                }
+                checksum += consume(parser.response());
+                ++messages;
+            }
+        }
+
+        // Erste Runde wärmt Puffer und Token-Speicher auf
+        if (round > 0) {
+            nsecs += timer.nsecsElapsed();
+            allocations += g_allocations.load() - allocBefore;
+        }
+    }
+
+    const double seconds = double(nsecs) / 1e9;
+    const double megabytes = double(transcript.size()) * (rounds - 1) / (1024.0 * 1024.0);
+    std::printf("Antworten:            %llu\n", static_cast<unsigned long long>(messages));
+    std::printf("Fehlerhaft:           %llu\n", static_cast<unsigned long long>(malformed / rounds));
+    std::printf("Durchsatz:            %.1f MB/s\n", megabytes / seconds);
+    std::printf("Zeit pro Antwort:     %.0f ns\n", double(nsecs) / double(messages * (rounds - 1)));
+    std::printf("Allokationen/Antwort: %.4f\n", double(allocations) / double(messages * (rounds - 1)));
+    std::printf("(Prüfsumme %llu)\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
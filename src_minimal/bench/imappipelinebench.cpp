@@ -0,0 +1,87 @@
+/*
+ * mailadler - IMAP Pipelining Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Fragt STATUS für viele Ordner einmal nacheinander (ein Befehl unterwegs)
+ * und einmal per Pipelining ab, gegen einen lokalen Stand-in-Server mit
+ * künstlicher Laufzeit.
+ *
+ *   imappipelinebench [laufzeit-ms] [ordner]
+ */
+
+#include "imapconnection.h"
+#include "imapstandin.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+struct Run {
+    const char *name;
+    int maxInFlight;
+};
+
+const Run Runs[] = {
+    {"nacheinander", 1},
+    {"pipelined", 64},
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int roundTrip = argc > 1 ? std::atoi(argv[1]) : 50;
+    const int folders = argc > 2 ? std::atoi(argv[2]) : 30;
+
+    ImapStandIn server;
+    server.setRoundTrip(roundTrip);
+    server.setFolderCount(folders);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    ImapConnection imap;
+    QElapsedTimer timer;
+    int run = 0;
+    int received = 0;
+
+    auto startRun = [&]() {
+        received = 0;
+        imap.setMaxInFlight(Runs[run].maxInFlight);
+        timer.start();
+        imap.requestStatus("INBOX");
+        for (int i = 1; i < folders; ++i) {
+            imap.requestStatus(QString("Ordner %1").arg(i));
+        }
+    };
+
+    QObject::connect(&imap, &ImapConnection::connected, [&]() { imap.login("bench", "bench"); });
+    QObject::connect(&imap, &ImapConnection::authenticated, startRun);
+    QObject::connect(&imap, &ImapConnection::statusReceived, [&]() {
+        if (++received < folders) {
+            return;
+        }
+        const qint64 ns = timer.nsecsElapsed();
+        std::printf("%-14s %4d STATUS  %8.1f ms  (RTT %d ms)\n", Runs[run].name, folders, ns / 1e6, roundTrip);
+        if (++run < int(sizeof(Runs) / sizeof(Runs[0]))) {
+            startRun();
+        } else {
+            app.quit();
+        }
+    });
+    QObject::connect(&imap, &ImapConnection::error, [&](const QString &message) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+        app.exit(1);
+    });
+
+    imap.connectToServer("127.0.0.1", server.serverPort(), false);
+    return app.exec();
+}
@@ -0,0 +1,364 @@
+/*
+ * mailadler - IMAP Transcript Recording and Replay
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapreplay.h"
+#include <QDebug>
+#include <QFile>
+#include <QSslSocket>
+#include <QTcpSocket>
+
+#include <algorithm>
+
+namespace {
+
+// "UID FETCH 1:500 (FLAGS)" -> "UID FETCH"
+QByteArray verbOf(const QByteArray &key)
+{
+    const QList<QByteArray> words = key.split(' ');
+    return words.value(0) == "UID" ? words.value(0) + ' ' + words.value(1).toUpper() : words.value(0);
+}
+
+bool isBinary(const QByteArray &line)
+{
+    return std::any_of(line.cbegin(), line.cend(), [](char c) { return (uchar(c) < 0x20 && c != '\t') || c == 0x7f; });
+}
+
+} // namespace
+
+QByteArray ImapTranscript::keyOf(const QByteArray &line)
+{
+    const qsizetype space = line.indexOf(' ');
+    if (space < 0) {
+        return line.toUpper();
+    }
+    const QByteArray command = line.mid(space + 1);
+    const qsizetype end = command.indexOf(' ');
+    const QByteArray verb = command.left(end < 0 ? command.size() : end).toUpper();
+    // Anmeldedaten unterscheiden sich zwischen Mitschnitt und Messung
+    if (verb == "LOGIN" || verb == "AUTHENTICATE") {
+        return verb;
+    }
+    return end < 0 ? verb : verb + command.mid(end);
+}
+
+void ImapTranscript::addSession(const QList<QPair<char, QByteArray>> &lines)
+{
+    ImapTranscriptSession session;
+    QList<int> open;
+    int awaiting = -1;
+    for (const auto &entry : lines) {
+        const QByteArray &line = entry.second;
+        if (entry.first == 'C') {
+            if (awaiting >= 0) {
+                // Fortsetzung des offenen Befehls
+                session.exchanges[awaiting].segments.append(QByteArray());
+                awaiting = -1;
+                continue;
+            }
+            ImapExchange exchange;
+            exchange.tag = line.left(line.indexOf(' '));
+            exchange.key = keyOf(line);
+            exchange.segments.append(QByteArray());
+            open.append(int(session.exchanges.size()));
+            session.exchanges.append(exchange);
+            continue;
+        }
+
+        const QByteArray tag = line.left(line.indexOf(' '));
+        int target = -1;
+        for (int i = 0; i < open.size(); ++i) {
+            if (session.exchanges.at(open.at(i)).tag == tag) {
+                target = open.takeAt(i);
+                break;
+            }
+        }
+        if (target < 0 && !open.isEmpty()) {
+            target = open.first();
+        }
+        if (target < 0) {
+            // Begrüßung bzw. BYE nach dem letzten Befehl
+            if (session.exchanges.isEmpty()) {
+                session.greeting += line + "\r\n";
+            } else {
+                session.exchanges.last().segments.last() += line + "\r\n";
+            }
+            continue;
+        }
+        session.exchanges[target].segments.last() += line + "\r\n";
+        if (line.startsWith('+')) {
+            awaiting = target;
+        }
+    }
+    m_sessions.append(session);
+    m_lines.append(lines);
+}
+
+bool ImapTranscript::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ImapTranscript: kann" << path << "nicht öffnen:" << file.errorString();
+        return false;
+    }
+    m_sessions.clear();
+    m_lines.clear();
+
+    QList<QPair<char, QByteArray>> lines;
+    bool started = false;
+    int number = 0;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        ++number;
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.startsWith("==")) {
+            if (started) {
+                addSession(lines);
+            }
+            lines.clear();
+            started = true;
+            continue;
+        }
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        if (line.size() < 2 || (line[0] != 'C' && line[0] != 'S') || (line[1] != ':' && line[1] != '~')) {
+            qWarning() << "ImapTranscript:" << path << "Zeile" << number << "unverständlich";
+            return false;
+        }
+        QByteArray content = line.size() > 2 ? line.mid(3) : QByteArray();
+        if (line[1] == '~') {
+            content = QByteArray::fromBase64(content);
+        }
+        lines.append({line[0], content});
+        started = true;
+    }
+    if (started) {
+        addSession(lines);
+    }
+    return !m_sessions.isEmpty();
+}
+
+bool ImapTranscript::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "ImapTranscript: kann" << path << "nicht schreiben:" << file.errorString();
+        return false;
+    }
+    file.write("# mailadler IMAP-Mitschnitt\n");
+    for (const auto &lines : m_lines) {
+        file.write("== Sitzung\n");
+        for (const auto &entry : lines) {
+            QByteArray out(1, entry.first);
+            out += isBinary(entry.second) ? "~ " + entry.second.toBase64() : ": " + entry.second;
+            out += '\n';
+            file.write(out);
+        }
+    }
+    return file.flush();
+}
+
+ImapReplay::ImapReplay(const ImapTranscript &transcript, QObject *parent)
+    : ImapStandIn(parent)
+    , m_transcript(transcript)
+    , m_nextSession(0)
+    , m_missCount(0)
+{
+}
+
+QByteArray ImapReplay::greeting(QTcpSocket *socket)
+{
+    if (m_transcript.isEmpty()) {
+        return ImapStandIn::greeting(socket);
+    }
+    Live live;
+    live.session = m_nextSession++ % int(m_transcript.sessions().size());
+    live.used.fill(false, m_transcript.sessions().at(live.session).exchanges.size());
+    m_live.insert(socket, live);
+    connect(socket, &QObject::destroyed, this, [this, socket]() { m_live.remove(socket); });
+    return m_transcript.sessions().at(live.session).greeting;
+}
+
+QByteArray ImapReplay::answer(QTcpSocket *socket, const QByteArray &line)
+{
+    const auto it = m_live.find(socket);
+    if (it == m_live.end()) {
+        return ImapStandIn::answer(socket, line);
+    }
+    Live &live = it.value();
+    const QList<ImapExchange> &exchanges = m_transcript.sessions().at(live.session).exchanges;
+
+    if (live.awaiting >= 0) {
+        const ImapExchange &e = exchanges.at(live.awaiting);
+        const QByteArray reply = retag(e.segments.at(live.segment), e.tag, live.tag);
+        if (++live.segment >= e.segments.size()) {
+            live.awaiting = -1;
+        }
+        return reply;
+    }
+
+    const QByteArray tag = line.left(line.indexOf(' '));
+    const int index = find(live, ImapTranscript::keyOf(line));
+    if (index < 0) {
+        ++m_missCount;
+        qWarning() << "ImapReplay: nicht im Mitschnitt:" << ImapTranscript::keyOf(line).left(80);
+        return tag + " BAD command not in transcript\r\n";
+    }
+    const ImapExchange &e = exchanges.at(index);
+    live.used[index] = true;
+    live.cursor = index + 1;
+    if (e.segments.size() > 1) {
+        live.awaiting = index;
+        live.segment = 1;
+        live.tag = tag;
+    }
+    return retag(e.segments.first(), e.tag, tag);
+}
+
+int ImapReplay::find(Live &live, const QByteArray &key) const
+{
+    const QList<ImapExchange> &exchanges = m_transcript.sessions().at(live.session).exchanges;
+    const int count = int(exchanges.size());
+    // Gleiche Reihenfolge wie beim Mitschnitt ist der Normalfall
+    for (int n = 0; n < count; ++n) {
+        const int i = (live.cursor + n) % count;
+        if (!live.used.at(i) && exchanges.at(i).key == key) {
+            return i;
+        }
+    }
+    // Sonst der nächste gleiche Befehl mit anderen Argumenten (andere UID-Menge)
+    const QByteArray verb = verbOf(key);
+    for (int n = 0; n < count; ++n) {
+        const int i = (live.cursor + n) % count;
+        if (!live.used.at(i) && verbOf(exchanges.at(i).key) == verb) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QByteArray ImapReplay::retag(const QByteArray &segment, const QByteArray &from, const QByteArray &to)
+{
+    if (from == to) {
+        return segment;
+    }
+    const QByteArray prefix = from + ' ';
+    QByteArray out;
+    out.reserve(segment.size());
+    qsizetype pos = 0;
+    while (pos < segment.size()) {
+        qsizetype end = segment.indexOf("\r\n", pos);
+        end = end < 0 ? segment.size() : end + 2;
+        const QByteArrayView line(segment.constData() + pos, end - pos);
+        if (line.startsWith(prefix)) {
+            out += to;
+            out += line.sliced(from.size());
+        } else {
+            out += line;
+        }
+        pos = end;
+    }
+    return out;
+}
+
+ImapRecorder::ImapRecorder(QObject *parent)
+    : QTcpServer(parent)
+    , m_port(993)
+    , m_encrypted(true)
+{
+}
+
+ImapRecorder::~ImapRecorder()
+{
+    qDeleteAll(m_sessions);
+}
+
+void ImapRecorder::setUpstream(const QString &host, int port, bool encrypted)
+{
+    m_host = host;
+    m_port = port;
+    m_encrypted = encrypted;
+}
+
+ImapTranscript ImapRecorder::transcript() const
+{
+    ImapTranscript transcript;
+    for (const Session *session : m_sessions) {
+        transcript.addSession(session->lines);
+    }
+    return transcript;
+}
+
+void ImapRecorder::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *client = new QTcpSocket(this);
+    client->setSocketDescriptor(socketDescriptor);
+    QSslSocket *server = new QSslSocket(this);
+    Session *session = new Session;
+    m_sessions.append(session);
+
+    // Kontext ist jeweils die Gegenseite, damit nie in eine gelöschte geschrieben wird
+    connect(client, &QTcpSocket::readyRead, server, [this, client, server, session]() {
+        const QByteArray data = client->readAll();
+        recordClient(session, data);
+        server->write(data);
+    });
+    connect(server, &QSslSocket::readyRead, client, [this, client, server, session]() {
+        const QByteArray data = server->readAll();
+        recordServer(session, data);
+        client->write(data);
+    });
+    connect(client, &QTcpSocket::disconnected, server, &QAbstractSocket::disconnectFromHost);
+    connect(server, &QAbstractSocket::disconnected, client, &QAbstractSocket::disconnectFromHost);
+    connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+    connect(server, &QAbstractSocket::disconnected, server, &QObject::deleteLater);
+
+    if (m_encrypted) {
+        server->connectToHostEncrypted(m_host, quint16(m_port));
+    } else {
+        server->connectToHost(m_host, quint16(m_port));
+    }
+}
+
+void ImapRecorder::recordClient(Session *session, const QByteArray &data)
+{
+    session->clientBuffer += data;
+    qsizetype end;
+    while ((end = session->clientBuffer.indexOf("\r\n")) >= 0) {
+        QByteArray line = session->clientBuffer.left(end);
+        session->clientBuffer.remove(0, end + 2);
+        if (session->continuation) {
+            // Antwort auf "+": bei der Anmeldung das Passwort bzw. SASL-Daten
+            if (session->lastCommand == "LOGIN" || session->lastCommand == "AUTHENTICATE") {
+                line = "***";
+            }
+            session->continuation = false;
+        } else {
+            const QList<QByteArray> words = line.split(' ');
+            session->lastCommand = words.value(1).toUpper();
+            if (session->lastCommand == "LOGIN") {
+                line = words.value(0) + " LOGIN \"***\" \"***\"";
+            }
+        }
+        session->lines.append({'C', line});
+    }
+}
+
+void ImapRecorder::recordServer(Session *session, const QByteArray &data)
+{
+    session->serverBuffer += data;
+    qsizetype end;
+    while ((end = session->serverBuffer.indexOf("\r\n")) >= 0) {
+        const QByteArray line = session->serverBuffer.left(end);
+        session->serverBuffer.remove(0, end + 2);
+        if (line.startsWith('+')) {
+            session->continuation = true;
+        }
+        session->lines.append({'S', line});
+    }
+}
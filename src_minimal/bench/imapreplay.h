@@ -0,0 +1,147 @@
+/*
+ * mailadler - IMAP Transcript Recording and Replay
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPREPLAY_H
+#define IMAPREPLAY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QTcpServer>
+
+#include "imapstandin.h"
+
+class QTcpSocket;
+
+// Mitschnitt von IMAP-Sitzungen.
+//
+// Textformat, eine Zeile je Protokollzeile ohne CRLF:
+//
+//   == Sitzung
+//   S: * OK [CAPABILITY IMAP4rev1 ...] ready
+//   C: A0001 LOGIN "max" "***"
+//   S: A0001 OK LOGIN completed
+//
+// "C~"/"S~" statt "C:"/"S:" kennzeichnen Base64, für Zeilen mit Steuerzeichen
+// (binäre Literale). Zeilen mit # sind Kommentare.
+//
+// Beim Einlesen werden die Antworten den Befehlen zugeordnet: getaggte über
+// ihr Tag, ungetaggte dem ältesten offenen Befehl, wie ein Server sie der
+// Reihe nach abarbeitet. Nach einer Fortsetzungsanforderung ("+") ist die
+// nächste Zeile des Clients kein neuer Befehl, sondern gehört zum offenen
+// (DONE nach IDLE, Literale, AUTHENTICATE).
+struct ImapExchange {
+    QByteArray tag;
+    // Befehl ohne Tag und ohne Anmeldedaten, zum Wiederfinden
+    QByteArray key;
+    // Antwort auf die Befehlszeile und auf jede Fortsetzungszeile, mit CRLF
+    QList<QByteArray> segments;
+};
+
+struct ImapTranscriptSession {
+    QByteArray greeting;
+    QList<ImapExchange> exchanges;
+};
+
+class ImapTranscript
+{
+public:
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+
+    // Zeilen wie im Mitschnitt ('C' oder 'S', Inhalt) in eine neue Sitzung
+    void addSession(const QList<QPair<char, QByteArray>> &lines);
+
+    const QList<ImapTranscriptSession> &sessions() const { return m_sessions; }
+    bool isEmpty() const { return m_sessions.isEmpty(); }
+
+    static QByteArray keyOf(const QByteArray &line);
+
+private:
+    QList<ImapTranscriptSession> m_sessions;
+    // Für save(): die Zeilen, wie sie kamen
+    QList<QList<QPair<char, QByteArray>>> m_lines;
+};
+
+// Spielt einen Mitschnitt als Server ab.
+//
+// Die n-te Verbindung bekommt die n-te Sitzung (reihum). Ein Befehl wird
+// zuerst ab der aktuellen Stelle, dann in der ganzen Sitzung unter den noch
+// nicht beantworteten gesucht; Tags der Antworten werden auf die des Clients
+// umgeschrieben. Was nicht im Mitschnitt steht, wird mit BAD beantwortet und
+// gezählt. Laufzeit und Bandbreite wie beim ImapStandIn.
+class ImapReplay : public ImapStandIn
+{
+    Q_OBJECT
+
+public:
+    explicit ImapReplay(const ImapTranscript &transcript, QObject *parent = nullptr);
+
+    int missCount() const { return m_missCount; }
+
+protected:
+    QByteArray greeting(QTcpSocket *socket) override;
+    QByteArray answer(QTcpSocket *socket, const QByteArray &line) override;
+
+private:
+    struct Live {
+        int session = 0;
+        int cursor = 0;
+        QList<bool> used;
+        // Befehl, der auf eine Fortsetzungszeile wartet, und deren Nummer
+        int awaiting = -1;
+        int segment = 0;
+        QByteArray tag;
+    };
+
+    int find(Live &live, const QByteArray &key) const;
+    static QByteArray retag(const QByteArray &segment, const QByteArray &from, const QByteArray &to);
+
+    ImapTranscript m_transcript;
+    QHash<QTcpSocket *, Live> m_live;
+    int m_nextSession;
+    int m_missCount;
+};
+
+// Schneidet Sitzungen mit: nimmt Verbindungen an und reicht sie an den
+// eigentlichen Server weiter (auf Wunsch mit TLS). Passwörter von LOGIN und
+// AUTHENTICATE werden nicht gespeichert.
+class ImapRecorder : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit ImapRecorder(QObject *parent = nullptr);
+    ~ImapRecorder() override;
+
+    void setUpstream(const QString &host, int port, bool encrypted);
+    // Alle bisherigen Sitzungen, auch noch offene
+    ImapTranscript transcript() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    struct Session {
+        QList<QPair<char, QByteArray>> lines;
+        QByteArray clientBuffer;
+        QByteArray serverBuffer;
+        QByteArray lastCommand; // Befehlswort, für Fortsetzungen
+        bool continuation = false;
+    };
+
+    void recordClient(Session *session, const QByteArray &data);
+    void recordServer(Session *session, const QByteArray &data);
+
+    QString m_host;
+    int m_port;
+    bool m_encrypted;
+    QList<Session *> m_sessions;
+};
+
+#endif // IMAPREPLAY_H
@@ -0,0 +1,163 @@
+/*
+ * mailadler - Local IMAP Stand-in
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapstandin.h"
+#include <QTcpSocket>
+#include <QTimer>
+
+ImapStandIn::ImapStandIn(QObject *parent)
+    : QTcpServer(parent)
+    , m_roundTrip(50)
+    , m_folderCount(30)
+    , m_messageCount(231)
+    , m_bytesPerSecond(0)
+    , m_commandCount(0)
+{
+    m_clock.start();
+}
+
+void ImapStandIn::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        m_pending.remove(socket);
+        m_busyUntil.remove(socket);
+        m_idleTags.remove(socket);
+        socket->deleteLater();
+    });
+    socket->write(greeting(socket));
+}
+
+QByteArray ImapStandIn::greeting(QTcpSocket *socket)
+{
+    Q_UNUSED(socket)
+    return "* OK [CAPABILITY IMAP4rev1 CONDSTORE ESEARCH IDLE MOVE UIDPLUS] mailadler stand-in ready\r\n";
+}
+
+void ImapStandIn::onReadyRead(QTcpSocket *socket)
+{
+    QByteArray &buffer = m_pending[socket];
+    buffer += socket->readAll();
+
+    // Alle vollständigen Zeilen dieses Pakets gemeinsam beantworten
+    QByteArray reply;
+    qsizetype end;
+    while ((end = buffer.indexOf("\r\n")) >= 0) {
+        reply += answer(socket, buffer.left(end));
+        buffer.remove(0, end + 2);
+    }
+    if (reply.isEmpty()) {
+        return;
+    }
+
+    // Gedrosselte Verbindung: Antworten stehen hintereinander an
+    const qint64 now = m_clock.elapsed();
+    qint64 ready = now + m_roundTrip;
+    if (m_bytesPerSecond > 0) {
+        ready = qMax(ready, m_busyUntil.value(socket)) + reply.size() * 1000 / m_bytesPerSecond;
+        m_busyUntil.insert(socket, ready);
+    }
+    QTimer::singleShot(int(ready - now), socket, [socket, reply]() { socket->write(reply); });
+}
+
+void ImapStandIn::deliver()
+{
+    ++m_messageCount;
+    const QByteArray exists = "* " + QByteArray::number(m_messageCount) + " EXISTS\r\n";
+    for (auto it = m_idleTags.cbegin(); it != m_idleTags.cend(); ++it) {
+        QTcpSocket *socket = it.key();
+        // Nur der Weg vom Server zum Client
+        QTimer::singleShot(m_roundTrip / 2, socket, [socket, exists]() { socket->write(exists); });
+    }
+}
+
+QByteArray ImapStandIn::answer(QTcpSocket *socket, const QByteArray &line)
+{
+    if (line.toUpper() == "DONE") {
+        const QByteArray tag = m_idleTags.take(socket);
+        return tag.isEmpty() ? QByteArray() : tag + " OK IDLE terminated\r\n";
+    }
+    ++m_commandCount;
+    const QList<QByteArray> parts = line.split(' ');
+    const QByteArray tag = parts.value(0);
+    const QByteArray command = parts.value(1).toUpper();
+    const QByteArray done = tag + " OK " + command + " completed\r\n";
+
+    if (command == "CAPABILITY") {
+        return "* CAPABILITY IMAP4rev1 CONDSTORE ESEARCH IDLE MOVE UIDPLUS\r\n" + done;
+    }
+    if (command == "LIST") {
+        QByteArray reply = "* LIST (\\HasNoChildren) \"/\" \"INBOX\"\r\n";
+        for (int i = 1; i < m_folderCount; ++i) {
+            reply += "* LIST (\\HasNoChildren) \"/\" \"Ordner " + QByteArray::number(i) + "\"\r\n";
+        }
+        return reply + done;
+    }
+    if (command == "STATUS") {
+        // Ordnername steht in Anführungszeichen, Leerzeichen möglich
+        const int open = line.indexOf('"');
+        const int close = line.indexOf('"', open + 1);
+        const QByteArray mailbox = line.mid(open, close - open + 1);
+        return "* STATUS " + mailbox + " (MESSAGES " + QByteArray::number(m_messageCount) + " UIDNEXT "
+               + QByteArray::number(m_messageCount + 1) + " UIDVALIDITY 1 UNSEEN 3)\r\n" + done;
+    }
+    if (command == "SELECT" || command == "EXAMINE") {
+        return "* " + QByteArray::number(m_messageCount) + " EXISTS\r\n* OK [UIDVALIDITY 1] UIDs valid\r\n"
+               + "* OK [UIDNEXT " + QByteArray::number(m_messageCount + 1) + "] Predicted next UID\r\n"
+               + tag + " OK [READ-WRITE] SELECT completed\r\n";
+    }
+    if (command == "UID" && parts.value(2).toUpper() == "FETCH") {
+        return fetch(tag, parts.value(3));
+    }
+    if (command == "UID" && parts.value(2).toUpper() == "SEARCH") {
+        // ESEARCH wird angeboten, MailSync fragt mit RETURN (ALL)
+        return "* ESEARCH (TAG \"" + tag + "\") UID"
+               + (m_messageCount ? " ALL 1:" + QByteArray::number(m_messageCount) : QByteArray()) + "\r\n"
+               + tag + " OK SEARCH completed\r\n";
+    }
+    if (command == "UID") {
+        // Änderungen werden nur bestätigt, der Inhalt bleibt gleich
+        const QByteArray sub = parts.value(2).toUpper();
+        if (sub == "STORE" || sub == "MOVE" || sub == "COPY" || sub == "EXPUNGE") {
+            return tag + " OK " + sub + " completed\r\n";
+        }
+    }
+    if (command == "EXPUNGE") {
+        return done;
+    }
+    if (command == "IDLE") {
+        m_idleTags.insert(socket, tag);
+        return "+ idling\r\n";
+    }
+    if (command == "LOGOUT") {
+        return "* BYE stand-in logging out\r\n" + done;
+    }
+    if (command == "LOGIN" || command == "NOOP" || command == "ENABLE") {
+        return done;
+    }
+    return tag + " BAD unknown command\r\n";
+}
+
+QByteArray ImapStandIn::fetch(const QByteArray &tag, const QByteArray &set)
+{
+    // Nur "a:b" und "a:*", mehr schickt MailSync nicht
+    const int colon = set.indexOf(':');
+    const quint32 first = qMax(1u, (colon < 0 ? set : set.left(colon)).toUInt());
+    const QByteArray to = colon < 0 ? set : set.mid(colon + 1);
+    const quint32 last = to == "*" ? quint32(m_messageCount) : qMin(to.toUInt(), quint32(m_messageCount));
+
+    QByteArray reply;
+    for (quint32 uid = first; uid <= last; ++uid) {
+        const QByteArray n = QByteArray::number(uid);
+        reply += "* " + n + " FETCH (UID " + n + " FLAGS (\\Seen) RFC822.SIZE 4711 ENVELOPE ("
+                 "\"Mon, 3 Feb 2026 10:15:00 +0100\" \"Nachricht " + n + "\" "
+                 "((\"Max Mustermann\" NIL \"max\" \"gmx.de\")) NIL NIL ((NIL NIL \"erika\" \"web.de\")) "
+                 "NIL NIL NIL \"<" + n + "@stand-in>\"))\r\n";
+    }
+    return reply + tag + " OK FETCH completed\r\n";
+}
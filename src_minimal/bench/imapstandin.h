@@ -0,0 +1,68 @@
+/*
+ * mailadler - Local IMAP Stand-in
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPSTANDIN_H
+#define IMAPSTANDIN_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Minimaler IMAP-Server für Messungen ohne echtes Konto.
+//
+// Jede Befehlszeile wird erst nach der eingestellten Laufzeit beantwortet,
+// wie über eine entfernte Verbindung. Befehle, die zusammen eintreffen,
+// werden auch zusammen beantwortet, so dass Pipelining sichtbar wird.
+// Optional ist die Bandbreite je Verbindung begrenzt, wie bei Providern,
+// die einzelne Sitzungen drosseln. Abgeleitete Klassen (ImapReplay) ersetzen
+// greeting() und answer() und erben Laufzeit und Drosselung.
+class ImapStandIn : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit ImapStandIn(QObject *parent = nullptr);
+
+    void setRoundTrip(int msecs) { m_roundTrip = msecs; }
+    void setFolderCount(int count) { m_folderCount = count; }
+    // Nachrichten je Ordner, UIDs 1..count
+    void setMessageCount(int count) { m_messageCount = count; }
+    // 0 = unbegrenzt
+    void setBytesPerSecond(qint64 rate) { m_bytesPerSecond = rate; }
+    int commandCount() const { return m_commandCount; }
+
+public slots:
+    // Neue Nachricht einliefern; Sitzungen im IDLE erhalten sofort EXISTS
+    void deliver();
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+    // Begrüßung einer neuen Verbindung, mit CRLF
+    virtual QByteArray greeting(QTcpSocket *socket);
+    // Antwort auf eine Zeile des Clients (ohne CRLF), leer für keine
+    virtual QByteArray answer(QTcpSocket *socket, const QByteArray &line);
+
+private:
+    void onReadyRead(QTcpSocket *socket);
+    QByteArray fetch(const QByteArray &tag, const QByteArray &set);
+
+    int m_roundTrip;
+    int m_folderCount;
+    int m_messageCount;
+    qint64 m_bytesPerSecond;
+    int m_commandCount;
+    QElapsedTimer m_clock;
+    QHash<QTcpSocket *, QByteArray> m_pending;
+    // Zeitpunkt (ms seit Start), ab dem die Verbindung wieder senden darf
+    QHash<QTcpSocket *, qint64> m_busyUntil;
+    // Tag des laufenden IDLE je Verbindung
+    QHash<QTcpSocket *, QByteArray> m_idleTags;
+};
+
+#endif // IMAPSTANDIN_H
@@ -0,0 +1,117 @@
+/*
+ * mailadler - Operation Journal Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Markiert alle Nachrichten eines Ordners einzeln als gelesen und
+ * verschiebt danach jede zweite der oberen Hälfte, wie bei einer großen
+ * Auswahl. Gemessen wird die lokale Dauer je Aktion und das Abspielen über
+ * eine langsame Verbindung zum Stand-in-Server, im Vergleich zu einem
+ * Befehl je Aktion.
+ *
+ *   journalbench [nachrichten] [laufzeit-ms]
+ */
+
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include "operationjournal.h"
+#include "imapstandin.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int messages = argc > 1 ? std::atoi(argv[1]) : 5000;
+    const int roundTrip = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    ImapStandIn server;
+    server.setRoundTrip(roundTrip);
+    server.setMessageCount(messages);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return 1;
+    }
+    const int mailboxId = store.mailboxId("bench", "INBOX");
+    QList<EmailHeader> headers;
+    for (int i = 1; i <= messages; ++i) {
+        EmailHeader h;
+        h.uid = quint32(i);
+        h.subject = QString("Nachricht %1").arg(i);
+        headers.append(h);
+    }
+    store.storeHeaders(mailboxId, headers);
+
+    ImapConnectionPool pool;
+    pool.setServer("127.0.0.1", server.serverPort(), false);
+    pool.setCredentials("bench", "bench");
+    pool.setMaxConnections(1);
+    OperationJournal journal(&pool, &store);
+    journal.open();
+    journal.setAccount("bench");
+
+    // Lokal: jede Aktion einzeln, wie einzelne Klicks
+    int actions = 0;
+    double worst = 0;
+    QElapsedTimer total;
+    total.start();
+    for (quint32 uid = 1; uid <= quint32(messages); ++uid) {
+        QElapsedTimer timer;
+        timer.start();
+        journal.setFlags("INBOX", {{uid, uid}}, FlagSeen, true);
+        worst = std::max(worst, timer.nsecsElapsed() / 1e6);
+        ++actions;
+    }
+    QVector<UidRange> selection;
+    for (quint32 uid = quint32(messages) / 2 + 1; uid <= quint32(messages); uid += 2) {
+        selection.append({uid, uid});
+    }
+    {
+        QElapsedTimer timer;
+        timer.start();
+        journal.move("INBOX", selection, "Archiv");
+        worst = std::max(worst, timer.nsecsElapsed() / 1e6);
+        ++actions;
+    }
+    const double local = total.nsecsElapsed() / 1e6;
+    std::printf("Lokal: %d Aktionen in %.0f ms (%.3f ms je Aktion, höchstens %.2f ms)\n", actions, local,
+                local / actions, worst);
+
+    // Abspielen: Anmeldung, SELECT und die zusammengefassten Befehle
+    int entries = 0;
+    int commands = 0;
+    QEventLoop loop;
+    QObject::connect(&journal, &OperationJournal::replayed, &loop, [&](int e, int c) {
+        entries = e;
+        commands = c;
+        loop.quit();
+    });
+    const int before = server.commandCount();
+    QElapsedTimer timer;
+    timer.start();
+    journal.start();
+    loop.exec();
+    const double replay = timer.nsecsElapsed() / 1e6;
+
+    const int single = messages + int(selection.size());
+    std::printf("Server (RTT %d ms): %d Einträge als %d Befehle, %d Befehle insgesamt mit Anmeldung, %.0f ms\n",
+                roundTrip, entries, commands, server.commandCount() - before, replay);
+    std::printf("Ohne Journal: %d Befehle, nacheinander etwa %.1f s\n", single, single * roundTrip / 1000.0);
+    std::printf("Im Journal verblieben: %d\n", journal.pendingCount());
+    return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * mailadler - Folder Synchronization Test
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * MailSync gegen einen Stand-in mit CONDSTORE und wahlweise QRESYNC, dessen
+ * Ordner sich zwischen den Abgleichen ändert:
+ *
+ *   Erstabgleich        alle Nachrichten, UIDNEXT und HIGHESTMODSEQ gespeichert
+ *   nur Flags geändert  kein Kopfzeilen-FETCH, nur die geänderten Flags
+ *   gelöscht und neu    VANISHED (EARLIER) bzw. UID SEARCH, dann die neue UID
+ *   neue UIDVALIDITY    lokaler Inhalt verworfen und neu geladen
+ *
+ * Beide Durchläufe (CONDSTORE, QRESYNC) müssen denselben Stand ergeben.
+ * Rückgabewert 0, wenn alle Prüfungen stimmen.
+ *
+ *   mailsynctest
+ */
+
+#include "imapconnection.h"
+#include "imapstandin.h"
+#include "mailsync.h"
+#include "messagestore.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QMap>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// Ein Ordner "INBOX" mit MODSEQ je Nachricht und gemerkten Löschungen
+class CondStoreStandIn : public ImapStandIn
+{
+public:
+    struct Message {
+        quint32 flags;
+        quint64 modSeq;
+    };
+
+    explicit CondStoreStandIn(bool qresync)
+        : m_qresync(qresync)
+        , m_uidValidity(7)
+        , m_uidNext(1)
+        , m_highestModSeq(0)
+        , m_headerFetches(0)
+    {
+        setRoundTrip(1);
+    }
+
+    void add(quint32 flags = 0)
+    {
+        m_messages.insert(m_uidNext++, {flags, ++m_highestModSeq});
+    }
+
+    void setFlags(quint32 uid, quint32 flags)
+    {
+        m_messages[uid] = {flags, ++m_highestModSeq};
+    }
+
+    void expunge(quint32 uid)
+    {
+        m_messages.remove(uid);
+        m_vanished.insert(uid, ++m_highestModSeq);
+    }
+
+    // Neue UIDVALIDITY, alle UIDs neu vergeben
+    void renumber(int count)
+    {
+        ++m_uidValidity;
+        m_messages.clear();
+        m_vanished.clear();
+        m_uidNext = 1;
+        for (int i = 0; i < count; ++i) {
+            add();
+        }
+    }
+
+    quint32 uidValidity() const { return m_uidValidity; }
+    quint32 uidNext() const { return m_uidNext; }
+    quint64 highestModSeq() const { return m_highestModSeq; }
+    QVector<quint32> uids() const { return QVector<quint32>(m_messages.keyBegin(), m_messages.keyEnd()); }
+    int headerFetches() const { return m_headerFetches; }
+
+protected:
+    QByteArray greeting(QTcpSocket *socket) override
+    {
+        Q_UNUSED(socket)
+        return "* OK [CAPABILITY " + capabilities() + "] mailadler sync test ready\r\n";
+    }
+
+    QByteArray answer(QTcpSocket *socket, const QByteArray &line) override
+    {
+        Q_UNUSED(socket)
+        const QList<QByteArray> parts = line.split(' ');
+        const QByteArray tag = parts.value(0);
+        const QByteArray command = parts.value(1).toUpper();
+        const QByteArray done = tag + " OK " + command + " completed\r\n";
+
+        if (command == "CAPABILITY") {
+            return "* CAPABILITY " + capabilities() + "\r\n" + done;
+        }
+        if (command == "ENABLE") {
+            return (m_qresync && line.toUpper().contains("QRESYNC") ? "* ENABLED QRESYNC\r\n" : "* ENABLED\r\n")
+                   + done;
+        }
+        if (command == "SELECT") {
+            return select(line) + tag + " OK [READ-WRITE] SELECT completed\r\n";
+        }
+        if (command == "UID" && parts.value(2).toUpper() == "FETCH") {
+            return fetch(line, parts.value(3)) + done;
+        }
+        if (command == "UID" && parts.value(2).toUpper() == "SEARCH") {
+            QVector<UidRange> ranges;
+            for (auto it = m_messages.cbegin(); it != m_messages.cend(); ++it) {
+                if (!ranges.isEmpty() && ranges.last().last + 1 == it.key()) {
+                    ranges.last().last = it.key();
+                } else {
+                    ranges.append({it.key(), it.key()});
+                }
+            }
+            return "* ESEARCH (TAG \"" + tag + "\") UID"
+                   + (ranges.isEmpty() ? QByteArray() : " ALL " + ImapConnection::uidSet(ranges)) + "\r\n" + done;
+        }
+        if (command == "LOGIN" || command == "NOOP") {
+            return done;
+        }
+        if (command == "LOGOUT") {
+            return "* BYE logging out\r\n" + done;
+        }
+        return tag + " BAD unknown command\r\n";
+    }
+
+private:
+    QByteArray capabilities() const
+    {
+        return m_qresync ? "IMAP4rev1 CONDSTORE QRESYNC ESEARCH ENABLE" : "IMAP4rev1 CONDSTORE ESEARCH";
+    }
+
+    QByteArray select(const QByteArray &line) const
+    {
+        QByteArray reply = "* " + QByteArray::number(m_messages.size()) + " EXISTS\r\n"
+                           + "* OK [UIDVALIDITY " + QByteArray::number(m_uidValidity) + "] UIDs valid\r\n"
+                           + "* OK [UIDNEXT " + QByteArray::number(m_uidNext) + "] Predicted next UID\r\n"
+                           + "* OK [HIGHESTMODSEQ " + QByteArray::number(m_highestModSeq) + "] Highest\r\n";
+
+        // "SELECT "INBOX" (QRESYNC (uidvalidity modseq))"; RFC 7162, 3.2.5
+        const qsizetype at = line.toUpper().indexOf("(QRESYNC (");
+        if (at < 0) {
+            return reply;
+        }
+        const QList<QByteArray> known = line.mid(at + 10).split(')').value(0).split(' ');
+        const quint32 uidValidity = known.value(0).toUInt();
+        const quint64 modSeq = known.value(1).toULongLong();
+        if (uidValidity != m_uidValidity) {
+            return reply;
+        }
+        QVector<UidRange> vanished;
+        for (auto it = m_vanished.cbegin(); it != m_vanished.cend(); ++it) {
+            if (it.value() > modSeq) {
+                vanished.append({it.key(), it.key()});
+            }
+        }
+        if (!vanished.isEmpty()) {
+            reply += "* VANISHED (EARLIER) " + ImapConnection::uidSet(vanished) + "\r\n";
+        }
+        return reply + changedSince(modSeq);
+    }
+
+    QByteArray fetch(const QByteArray &line, const QByteArray &set)
+    {
+        const qsizetype at = line.toUpper().indexOf("CHANGEDSINCE ");
+        if (at >= 0) {
+            return changedSince(line.mid(at + 13).split(')').value(0).toULongLong());
+        }
+
+        // Kopfzeilen für "a:b" bzw. "a:*"
+        ++m_headerFetches;
+        const qsizetype colon = set.indexOf(':');
+        const quint32 first = (colon < 0 ? set : set.left(colon)).toUInt();
+        const QByteArray to = colon < 0 ? set : set.mid(colon + 1);
+        const quint32 last = to == "*" ? m_uidNext : to.toUInt();
+        QByteArray reply;
+        int seq = 0;
+        for (auto it = m_messages.cbegin(); it != m_messages.cend(); ++it) {
+            ++seq;
+            if (it.key() < first || it.key() > last) {
+                continue;
+            }
+            const QByteArray n = QByteArray::number(it.key());
+            reply += "* " + QByteArray::number(seq) + " FETCH (UID " + n + " FLAGS "
+                     + ImapConnection::flagList(it->flags) + " MODSEQ (" + QByteArray::number(it->modSeq)
+                     + ") RFC822.SIZE 4711 ENVELOPE (\"Mon, 3 Feb 2026 10:15:00 +0100\" \"Nachricht " + n
+                     + "\" ((\"Max Mustermann\" NIL \"max\" \"gmx.de\")) NIL NIL "
+                       "((NIL NIL \"erika\" \"web.de\")) NIL NIL NIL \"<"
+                     + n + "@sync-test>\"))\r\n";
+        }
+        return reply;
+    }
+
+    QByteArray changedSince(quint64 modSeq) const
+    {
+        QByteArray reply;
+        int seq = 0;
+        for (auto it = m_messages.cbegin(); it != m_messages.cend(); ++it) {
+            ++seq;
+            if (it->modSeq > modSeq) {
+                reply += "* " + QByteArray::number(seq) + " FETCH (UID " + QByteArray::number(it.key()) + " FLAGS "
+                         + ImapConnection::flagList(it->flags) + " MODSEQ (" + QByteArray::number(it->modSeq)
+                         + "))\r\n";
+            }
+        }
+        return reply;
+    }
+
+    const bool m_qresync;
+    quint32 m_uidValidity;
+    quint32 m_uidNext;
+    quint64 m_highestModSeq;
+    int m_headerFetches;
+    QMap<quint32, Message> m_messages;
+    // Gelöschte UIDs mit dem MODSEQ der Löschung
+    QMap<quint32, quint64> m_vanished;
+};
+
+int failures = 0;
+
+void check(bool ok, const char *mode, const char *what)
+{
+    std::printf("%-4s %-9s %s\n", ok ? "ok" : "FEHLER", mode, what);
+    if (!ok) {
+        ++failures;
+    }
+}
+
+// Ein Abgleich bis MailSync::finished, höchstens 10 s
+bool runSync(MailSync *sync)
+{
+    QEventLoop loop;
+    bool result = false;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    const QMetaObject::Connection finished =
+        QObject::connect(sync, &MailSync::finished, &loop, [&](const QString &, bool ok) {
+            result = ok;
+            loop.quit();
+        });
+    timeout.start(10000);
+    sync->syncFolder("INBOX");
+    loop.exec();
+    QObject::disconnect(finished);
+    return result && timeout.isActive();
+}
+
+quint32 storedFlags(const MessageStore &store, int mailboxId, quint32 uid)
+{
+    const QVector<ImapFlagUpdate> flags = store.flags(mailboxId, {{uid, uid}});
+    return flags.isEmpty() ? 0 : flags.first().flags;
+}
+
+void run(bool qresync)
+{
+    const char *mode = qresync ? "QRESYNC" : "CONDSTORE";
+    CondStoreStandIn server(qresync);
+    for (int i = 0; i < 20; ++i) {
+        server.add(i % 2 ? FlagSeen : 0);
+    }
+    if (!server.listen(QHostAddress::LocalHost)) {
+        check(false, mode, "Stand-in startet");
+        return;
+    }
+
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("sync.db"));
+    if (!store.open()) {
+        check(false, mode, "Speicher öffnet");
+        return;
+    }
+    const int mailboxId = store.mailboxId("test", "INBOX");
+    ImapConnection imap;
+    MailSync sync(&imap, &store);
+    sync.setAccount("test");
+    QObject::connect(&imap, &ImapConnection::connected, [&]() { imap.login("test", "test"); });
+    int resets = 0;
+    QVector<UidRange> removed;
+    QObject::connect(&sync, &MailSync::mailboxReset, [&](int) { ++resets; });
+    QObject::connect(&sync, &MailSync::messagesRemoved,
+                     [&](int, const QVector<UidRange> &ranges) { removed += ranges; });
+    imap.connectToServer("127.0.0.1", server.serverPort(), false);
+
+    // Erstabgleich
+    check(runSync(&sync), mode, "Erstabgleich endet");
+    check(store.uids(mailboxId) == server.uids(), mode, "Erstabgleich: alle UIDs");
+    check(storedFlags(store, mailboxId, 2) == FlagSeen, mode, "Erstabgleich: Flags");
+    ImapFolderState state = store.folderState(mailboxId);
+    check(state.uidValidity == server.uidValidity() && state.uidNext == server.uidNext()
+              && state.highestModSeq == server.highestModSeq(),
+          mode, "Erstabgleich: Ordnerzustand");
+    check(imap.isEnabled("QRESYNC") == qresync, mode, "QRESYNC nur, wenn angeboten");
+
+    // Nur Flags geändert
+    server.setFlags(5, FlagSeen | FlagFlagged);
+    server.setFlags(2, 0);
+    const int fetches = server.headerFetches();
+    check(runSync(&sync), mode, "Flag-Delta endet");
+    check(server.headerFetches() == fetches, mode, "Flag-Delta: keine Kopfzeilen geholt");
+    check(storedFlags(store, mailboxId, 5) == (FlagSeen | FlagFlagged) && storedFlags(store, mailboxId, 2) == 0,
+          mode, "Flag-Delta: Flags übernommen");
+    check(store.folderState(mailboxId).highestModSeq == server.highestModSeq(), mode, "Flag-Delta: HIGHESTMODSEQ");
+
+    // Gelöscht und neu
+    server.expunge(3);
+    server.expunge(4);
+    server.add();
+    check(runSync(&sync), mode, "Löschungen enden");
+    check(store.uids(mailboxId) == server.uids(), mode, "Löschungen: UIDs wie auf dem Server");
+    // Ohne QRESYNC meldet removeUidsNotIn() zusätzlich alles oberhalb der letzten UID
+    check(std::any_of(removed.cbegin(), removed.cend(),
+                      [](const UidRange &r) { return r.first == 3 && r.last == 4; }),
+          mode, "Löschungen: messagesRemoved 3:4");
+    check(store.folderState(mailboxId).uidNext == server.uidNext(), mode, "Löschungen: UIDNEXT");
+
+    // Neue UIDVALIDITY
+    server.renumber(5);
+    check(runSync(&sync), mode, "UIDVALIDITY endet");
+    check(resets == 1, mode, "UIDVALIDITY: mailboxReset");
+    check(store.uids(mailboxId) == server.uids(), mode, "UIDVALIDITY: neu geladen");
+    state = store.folderState(mailboxId);
+    check(state.uidValidity == server.uidValidity() && state.highestModSeq == server.highestModSeq(), mode,
+          "UIDVALIDITY: Ordnerzustand");
+
+    imap.logout();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    run(false);
+    run(true);
+    std::printf("%s\n", failures ? "FEHLGESCHLAGEN" : "bestanden");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * mailadler - mbox Import Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Importiert eine mbox über MailArchive und exportiert sie wieder. Gemessen
+ * werden Durchsatz (MB/s), Nachrichten je Sekunde und der Spitzenbedarf an
+ * Speicher (VmHWM, nur Linux), der nicht mit der Dateigröße wachsen darf.
+ * Ohne Datei wird eine erzeugt: Nachrichten mit 2-20 kB Text, jede zehnte mit
+ * einem Anhang von 300 kB, ab und zu eine maskierte ">From "-Zeile.
+ *
+ *   mboximportbench [MB | mbox-datei]
+ */
+
+#include "mailarchive.h"
+#include "messagestore.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// "VmHWM:    123456 kB" -> kB
+qint64 memoryKb(const QByteArray &key)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith(key)) {
+            return line.mid(key.size()).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return -1;
+}
+
+bool generate(const QString &path, qint64 bytes)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QRandomGenerator generator(11);
+    QByteArray attachment(300 * 1024, Qt::Uninitialized);
+    for (char &c : attachment) {
+        c = char(generator.bounded(256));
+    }
+    const QByteArray encoded = attachment.toBase64(); // eine Zeile, wird unten umbrochen
+    const QByteArray line = "Sehr geehrte Damen und Herren, anbei die Unterlagen zum Angebot.\n";
+
+    for (quint32 n = 1; file.size() < bytes; ++n) {
+        QByteArray message = "From absender@example.de Mon Feb  3 10:15:00 2026\n";
+        message += "X-Mozilla-Status: " + QByteArray::number(n % 3 ? 1 : 0, 16).rightJustified(4, '0') + "\n";
+        message += "From: =?UTF-8?Q?J=C3=BCrgen_M=C3=BCller?= <absender@example.de>\n";
+        message += "To: Empf\xc3\xa4nger <empfaenger@example.de>, weitere@example.de\n";
+        message += "Subject: Angebot Nr. " + QByteArray::number(n) + "\n";
+        message += "Date: Mon, 3 Feb 2026 10:15:00 +0100 (CET)\n";
+        message += "Message-ID: <" + QByteArray::number(n) + ".bench@example.de>\n";
+        if (n > 1) {
+            message += "References: <" + QByteArray::number(n - 1) + ".bench@example.de>\n";
+        }
+        const bool withAttachment = n % 10 == 0;
+        if (withAttachment) {
+            message += "MIME-Version: 1.0\nContent-Type: multipart/mixed; boundary=\"grenze\"\n\n"
+                       "--grenze\nContent-Type: text/plain; charset=utf-8\n\n";
+        } else {
+            message += "Content-Type: text/plain; charset=utf-8\n\n";
+        }
+        const int lines = 30 + int(generator.bounded(300));
+        for (int i = 0; i < lines; ++i) {
+            message += i == 7 && n % 50 == 0 ? ">From der Zentrale weitergeleitet.\n" : line;
+        }
+        if (withAttachment) {
+            message += "--grenze\nContent-Type: application/pdf; name=\"angebot.pdf\"\n"
+                       "Content-Transfer-Encoding: base64\n\n";
+            for (qsizetype i = 0; i < encoded.size(); i += 76) {
+                message += encoded.mid(i, 76) + '\n';
+            }
+            message += "--grenze--\n";
+        }
+        message += '\n';
+        if (file.write(message) != message.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir dir;
+    QString source;
+    if (argc > 1 && QFileInfo::exists(QString::fromLocal8Bit(argv[1]))) {
+        source = QString::fromLocal8Bit(argv[1]);
+    } else {
+        const qint64 megabytes = argc > 1 ? std::atoll(argv[1]) : 1024;
+        source = dir.filePath("Inbox");
+        std::printf("Erzeuge %lld MB...\n", megabytes);
+        if (!generate(source, megabytes * 1024 * 1024)) {
+            std::fprintf(stderr, "mbox kann nicht geschrieben werden\n");
+            return 1;
+        }
+    }
+    const qint64 size = QFileInfo(source).size();
+    const double mebibytes = size / (1024.0 * 1024.0);
+
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return 1;
+    }
+    MailArchive archive(&store);
+    archive.open();
+
+    QEventLoop loop;
+    int count = 0;
+    bool ok = false;
+    QObject::connect(&archive, &MailArchive::finished, [&](int, int n, bool success) {
+        count = n;
+        ok = success;
+        loop.quit();
+    });
+
+    const qint64 before = memoryKb("VmHWM:");
+    QElapsedTimer timer;
+    timer.start();
+    const int mailboxId = archive.importMbox(source, "Inbox");
+    loop.exec();
+    const qint64 importTime = qMax<qint64>(1, timer.elapsed());
+    std::printf("Import: %d Nachrichten, %.0f MB in %lld ms (%.1f MB/s, %.0f Nachrichten/s), "
+                "VmHWM %lld kB (vorher %lld kB)\n",
+                count, mebibytes, importTime, mebibytes * 1000.0 / importTime, count * 1000.0 / importTime,
+                memoryKb("VmHWM:"), before);
+    if (!ok || store.messageCount(mailboxId) != count) {
+        return 1;
+    }
+
+    const QString target = dir.filePath("export.mbox");
+    timer.start();
+    archive.exportFolder(mailboxId, target, MailArchive::Mbox);
+    loop.exec();
+    const qint64 exportTime = qMax<qint64>(1, timer.elapsed());
+    const double exported = QFileInfo(target).size() / (1024.0 * 1024.0);
+    std::printf("Export: %d Nachrichten, %.0f MB in %lld ms (%.1f MB/s), VmHWM %lld kB\n",
+                count, exported, exportTime, exported * 1000.0 / exportTime, memoryKb("VmHWM:"));
+    return ok ? 0 : 1;
+}
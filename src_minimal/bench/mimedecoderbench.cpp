@@ -0,0 +1,206 @@
+/*
+ * mailadler - MIME Decoder Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Misst den Dekodier-Durchsatz in MB/s (bezogen auf die kodierte Eingabe)
+ * für Base64 mit 76er-Zeilen, quoted-printable, RFC-2047-Kopfzeilen und das
+ * Zerlegen einer mehrteiligen Nachricht. Die Eingabe kommt wie von der
+ * Leitung in Stücken zu 64 KiB; zum Vergleich QByteArray::fromBase64.
+ *
+ *   mimedecoderbench [MiB]
+ */
+
+#include "mimedecoder.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const qsizetype ChunkSize = 64 * 1024;
+const int Rounds = 5;
+
+QByteArray randomBytes(qsizetype size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    QRandomGenerator generator(42);
+    for (qsizetype i = 0; i < size; ++i) {
+        data[i] = char(generator.bounded(256));
+    }
+    return data;
+}
+
+// Wie im Nachrichtentext: Zeilen zu 76 Zeichen mit CRLF
+QByteArray wrapped(const QByteArray &base64)
+{
+    QByteArray out;
+    out.reserve(base64.size() + base64.size() / 76 * 2 + 2);
+    for (qsizetype pos = 0; pos < base64.size(); pos += 76) {
+        out += base64.mid(pos, 76);
+        out += "\r\n";
+    }
+    return out;
+}
+
+// Deutscher Fließtext mit Umlauten, Zeilen zu höchstens 76 Zeichen
+QByteArray quotedPrintable(qsizetype size)
+{
+    const QByteArray sentence = QStringLiteral("Die Überweisung für März wurde am Freitag ausgeführt, "
+                                               "bitte prüfen Sie die Beträge. ")
+                                    .toUtf8();
+    QByteArray out;
+    out.reserve(size + 80);
+    int column = 0;
+    while (out.size() < size) {
+        for (const char c : sentence) {
+            const uchar u = uchar(c);
+            QByteArray token;
+            if (u >= 128 || c == '=') {
+                token = '=' + QByteArray::number(u, 16).toUpper();
+            } else {
+                token = QByteArray(1, c);
+            }
+            if (column + token.size() > 75) {
+                out += "=\r\n";
+                column = 0;
+            }
+            out += token;
+            column += int(token.size());
+        }
+    }
+    return out;
+}
+
+QList<QByteArray> headers(int count)
+{
+    const QByteArray samples[] = {
+        "=?UTF-8?Q?Rechnung_f=C3=BCr_Februar?= Nr. ",
+        "=?utf-8?B?w5xiZXJ3ZWlzdW5nIGVyaGFsdGVu?= ",
+        "Re: =?iso-8859-1?q?Gr=FC=DFe_aus_M=FCnchen?= ",
+        "Einladung zum Sommerfest ",
+        "=?windows-1252?Q?Angebot_=80_199?= ",
+    };
+    QList<QByteArray> out;
+    for (int i = 0; i < count; ++i) {
+        out.append(samples[i % 5] + QByteArray::number(i));
+    }
+    return out;
+}
+
+QByteArray multipartMessage(const QByteArray &attachment)
+{
+    QByteArray m = "From: Anna Schmidt <anna@example.de>\r\n"
+                   "Subject: =?UTF-8?Q?Unterlagen_f=C3=BCr_M=C3=A4rz?=\r\n"
+                   "MIME-Version: 1.0\r\n"
+                   "Content-Type: multipart/mixed; boundary=\"==grenze==\"\r\n"
+                   "\r\n"
+                   "--==grenze==\r\n"
+                   "Content-Type: text/plain; charset=utf-8\r\n"
+                   "Content-Transfer-Encoding: quoted-printable\r\n"
+                   "\r\n";
+    m += quotedPrintable(4096);
+    m += "\r\n--==grenze==\r\n"
+         "Content-Type: application/pdf; name=\"Unterlagen.pdf\"\r\n"
+         "Content-Disposition: attachment; filename*=utf-8''Unterlagen%20M%C3%A4rz.pdf\r\n"
+         "Content-Transfer-Encoding: base64\r\n"
+         "\r\n";
+    m += wrapped(attachment.toBase64());
+    m += "--==grenze==--\r\n";
+    return m;
+}
+
+// Bester Lauf in MB/s
+template <typename F>
+double measure(qsizetype bytes, F run)
+{
+    double best = 0;
+    for (int round = 0; round < Rounds; ++round) {
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        const qint64 ns = qMax<qint64>(1, timer.nsecsElapsed());
+        best = qMax(best, double(bytes) * 1000.0 / double(ns));
+    }
+    return best;
+}
+
+qsizetype streamDecode(const QByteArray &input, TransferDecoder::Encoding encoding, QByteArray *out)
+{
+    TransferDecoder decoder(encoding);
+    qsizetype total = 0;
+    for (qsizetype pos = 0; pos < input.size(); pos += ChunkSize) {
+        const QByteArrayView chunk = QByteArrayView(input).sliced(pos, qMin(ChunkSize, input.size() - pos));
+        total += decoder.decode(chunk, out->data());
+    }
+    return total + decoder.finish(out->data());
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const qsizetype mib = argc > 1 ? qMax(1, std::atoi(argv[1])) : 32;
+    const QByteArray binary = randomBytes(mib * 1024 * 1024);
+    const QByteArray base64 = wrapped(binary.toBase64());
+    QByteArray out(TransferDecoder::maxDecodedSize(ChunkSize), Qt::Uninitialized);
+
+    std::printf("SIMD (SSSE3): %s\n", TransferDecoder::hasSimd() ? "ja" : "nein");
+
+    qsizetype decoded = 0;
+    const double b64 = measure(base64.size(), [&] {
+        decoded = streamDecode(base64, TransferDecoder::Base64, &out);
+    });
+    if (decoded != binary.size()) {
+        std::fprintf(stderr, "Base64: %lld statt %lld Bytes\n", qlonglong(decoded), qlonglong(binary.size()));
+        return 1;
+    }
+    const double qtB64 = measure(base64.size(), [&] {
+        decoded = QByteArray::fromBase64(base64).size();
+    });
+    std::printf("Base64:           %8.0f MB/s  (QByteArray::fromBase64: %.0f MB/s)\n", b64, qtB64);
+
+    const QByteArray qp = quotedPrintable(base64.size() / 4);
+    const double qpRate = measure(qp.size(), [&] {
+        decoded = streamDecode(qp, TransferDecoder::QuotedPrintable, &out);
+    });
+    std::printf("Quoted-printable: %8.0f MB/s\n", qpRate);
+
+    const QList<QByteArray> subjects = headers(200000);
+    qsizetype headerBytes = 0;
+    for (const QByteArray &h : subjects) {
+        headerBytes += h.size();
+    }
+    qsizetype chars = 0;
+    const double headerRate = measure(headerBytes, [&] {
+        chars = 0;
+        for (const QByteArray &h : subjects) {
+            chars += MimeDecoder::decodeHeader(h).size();
+        }
+    });
+    std::printf("RFC 2047:         %8.0f MB/s  (%.1f Mio. Kopfzeilen/s)\n", headerRate,
+                headerRate * 1e6 / (double(headerBytes) / subjects.size()) / 1e6);
+
+    const QByteArray message = multipartMessage(binary);
+    qsizetype partBytes = 0;
+    int parts = 0;
+    MimeStreamParser parser;
+    parser.partStarted = [&](const MimePart &) { ++parts; };
+    parser.partData = [&](QByteArrayView data) { partBytes += data.size(); };
+    const double mimeRate = measure(message.size(), [&] {
+        parser.reset();
+        parts = 0;
+        partBytes = 0;
+        for (qsizetype pos = 0; pos < message.size(); pos += ChunkSize) {
+            parser.feed(QByteArrayView(message).sliced(pos, qMin(ChunkSize, message.size() - pos)));
+        }
+        parser.finish();
+    });
+    std::printf("Multipart:        %8.0f MB/s  (%d Teile, %lld Bytes dekodiert)\n", mimeRate, parts,
+                qlonglong(partBytes));
+    return chars > 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+/*
+ * mailadler - Parallel Sync Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Erstabgleich mehrerer Ordner über 1, 2, 4, ... Sitzungen gegen einen
+ * lokalen Stand-in-Server mit Laufzeit und Bandbreitengrenze je
+ * Verbindung. Jeder Lauf beginnt mit einem leeren Speicher.
+ *
+ *   parallelsyncbench [nachrichten-je-ordner] [ordner] [laufzeit-ms] [kB/s-je-verbindung] [max-sitzungen]
+ */
+
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include "parallelsync.h"
+#include "imapstandin.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTemporaryDir>
+
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int messages = argc > 1 ? std::atoi(argv[1]) : 50000;
+    const int folders = argc > 2 ? std::atoi(argv[2]) : 20;
+    const int roundTrip = argc > 3 ? std::atoi(argv[3]) : 30;
+    const qint64 rate = argc > 4 ? std::atoll(argv[4]) * 1024 : 2048 * 1024;
+    const int maxSessions = argc > 5 ? std::atoi(argv[5]) : 8;
+
+    ImapStandIn server;
+    server.setRoundTrip(roundTrip);
+    server.setFolderCount(folders);
+    server.setMessageCount(messages);
+    server.setBytesPerSecond(rate);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    QStringList names{"INBOX"};
+    for (int i = 1; i < folders; ++i) {
+        names.append(QString("Ordner %1").arg(i));
+    }
+
+    double baseline = 0;
+    for (int sessions = 1; sessions <= maxSessions; sessions *= 2) {
+        QTemporaryDir dir;
+        MessageStore store(dir.filePath("bench.db"));
+        if (!store.open()) {
+            std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+            return 1;
+        }
+
+        ImapConnectionPool pool;
+        pool.setServer("127.0.0.1", server.serverPort(), false);
+        pool.setCredentials("bench", "bench");
+        pool.setMaxConnections(sessions);
+        ParallelSync sync(&pool, &store);
+        sync.setAccount("bench");
+
+        QEventLoop loop;
+        QObject::connect(&sync, &ParallelSync::finished, &loop, &QEventLoop::quit);
+        QElapsedTimer timer;
+        timer.start();
+        sync.syncFolders(names);
+        loop.exec();
+        const double ms = timer.nsecsElapsed() / 1e6;
+        if (sessions == 1) {
+            baseline = ms;
+        }
+
+        int stored = 0;
+        for (const QString &name : std::as_const(names)) {
+            stored += store.messageCount(store.mailboxId("bench", name));
+        }
+        std::printf("%2d Sitzungen  %9.1f ms  %8d Nachrichten  Faktor %.2f\n", sessions, ms, stored, baseline / ms);
+        pool.close();
+    }
+    return 0;
+}
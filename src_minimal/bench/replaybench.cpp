@@ -0,0 +1,220 @@
+/*
+ * mailadler - IMAP Replay Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Spielt einen Mitschnitt über ImapReplay ab und misst den Erstabgleich von
+ * INBOX mit ImapConnection, MailSync und MessageStore: Zeit vom
+ * Verbindungsaufbau bis zu den ersten gespeicherten Kopfzeilen (die Liste
+ * kann zeichnen) und bis zum Ende, Bytes auf der Leitung und CPU-Zeit des
+ * Clients je 1000 Nachrichten. Der Server läuft in einem eigenen Thread und
+ * zählt nicht mit.
+ *
+ *   replaybench <mitschnitt> [laufzeit-ms] [kB/s] [durchläufe]
+ *   replaybench record <mitschnitt> [nachrichten]
+ *   replaybench record <mitschnitt> <host> <port> <benutzer> <passwort>
+ *
+ * record schneidet denselben Abgleich gegen den ImapStandIn bzw. einen
+ * echten Server (TLS) mit.
+ */
+
+#include "imapconnection.h"
+#include "imapreplay.h"
+#include "imapstandin.h"
+#include "mailsync.h"
+#include "messagestore.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+namespace {
+
+struct SyncResult {
+    bool ok = false;
+    int messages = 0;
+    qint64 firstPaint = -1; // ms
+    qint64 total = 0;       // ms
+    qint64 cpu = 0;         // µs im Client-Thread
+    ImapTrafficStats traffic;
+};
+
+// CPU-Zeit des aufrufenden Threads in µs
+qint64 threadCpuTime()
+{
+#ifdef Q_OS_UNIX
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+    // Ganzer Prozess, der Server-Thread zählt mit
+    return qint64(std::clock()) * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+SyncResult runSync(quint16 port, const QString &user, const QString &password)
+{
+    SyncResult result;
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return result;
+    }
+
+    ImapConnection imap;
+    MailSync sync(&imap, &store);
+    sync.setAccount("bench");
+
+    QEventLoop loop;
+    QElapsedTimer timer;
+    QObject::connect(&imap, &ImapConnection::connected, [&]() { imap.login(user, password); });
+    QObject::connect(&sync, &MailSync::messagesAdded, [&]() {
+        if (result.firstPaint < 0) {
+            result.firstPaint = timer.elapsed();
+        }
+    });
+    QObject::connect(&sync, &MailSync::finished, [&](const QString &, bool ok) {
+        result.ok = ok;
+        loop.quit();
+    });
+    QObject::connect(&imap, &ImapConnection::error, [&](const QString &message) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+        loop.quit();
+    });
+
+    sync.syncFolder("INBOX");
+    const qint64 cpu = threadCpuTime();
+    timer.start();
+    imap.connectToServer("127.0.0.1", port, false);
+    loop.exec();
+    result.total = timer.elapsed();
+    result.cpu = threadCpuTime() - cpu;
+    result.traffic = imap.trafficStats();
+    result.messages = store.messageCount(store.mailboxId("bench", "INBOX"));
+
+    // Abmelden, damit ein Mitschnitt vollständig ist
+    QObject::connect(&imap, &ImapConnection::disconnected, &loop, &QEventLoop::quit);
+    QTimer::singleShot(2000, &loop, &QEventLoop::quit);
+    imap.logout();
+    loop.exec();
+    return result;
+}
+
+int record(int argc, char *argv[])
+{
+    const QString path = QString::fromLocal8Bit(argv[2]);
+    std::unique_ptr<ImapStandIn> standIn;
+    QString host = "127.0.0.1";
+    int port = 0;
+    bool encrypted = false;
+    QString user = "bench";
+    QString password = "bench";
+    if (argc > 6) {
+        host = QString::fromLocal8Bit(argv[3]);
+        port = std::atoi(argv[4]);
+        user = QString::fromLocal8Bit(argv[5]);
+        password = QString::fromLocal8Bit(argv[6]);
+        encrypted = true;
+    } else {
+        standIn.reset(new ImapStandIn);
+        standIn->setRoundTrip(0);
+        standIn->setMessageCount(argc > 3 ? std::atoi(argv[3]) : 10000);
+        if (!standIn->listen(QHostAddress::LocalHost)) {
+            std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(standIn->errorString()));
+            return 1;
+        }
+        port = standIn->serverPort();
+    }
+
+    ImapRecorder recorder;
+    recorder.setUpstream(host, port, encrypted);
+    if (!recorder.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Mitschnitt kann nicht starten: %s\n", qPrintable(recorder.errorString()));
+        return 1;
+    }
+    const SyncResult result = runSync(recorder.serverPort(), user, password);
+    const ImapTranscript transcript = recorder.transcript();
+    if (!result.ok || !transcript.save(path)) {
+        return 1;
+    }
+    std::printf("%d Nachrichten in %lld ms, %d Sitzung(en) nach %s\n", result.messages, result.total,
+                int(transcript.sessions().size()), qPrintable(path));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if (argc < 2) {
+        std::fprintf(stderr, "replaybench <mitschnitt> [laufzeit-ms] [kB/s] [durchläufe]\n"
+                             "replaybench record <mitschnitt> [nachrichten | host port benutzer passwort]\n");
+        return 1;
+    }
+    if (qstrcmp(argv[1], "record") == 0) {
+        return argc > 2 ? record(argc, argv) : 1;
+    }
+
+    const int roundTrip = argc > 2 ? std::atoi(argv[2]) : 30;
+    const qint64 rate = argc > 3 ? std::atoll(argv[3]) * 1024 : 0;
+    const int runs = argc > 4 ? std::atoi(argv[4]) : 3;
+
+    ImapTranscript transcript;
+    if (!transcript.load(QString::fromLocal8Bit(argv[1]))) {
+        return 1;
+    }
+
+    // Server im eigenen Thread, seine Arbeit fehlt in der CPU-Zeit des Clients
+    QThread serverThread;
+    ImapReplay *server = new ImapReplay(transcript);
+    server->setRoundTrip(roundTrip);
+    server->setBytesPerSecond(rate);
+    server->moveToThread(&serverThread);
+    serverThread.start();
+    quint16 port = 0;
+    QMetaObject::invokeMethod(server, [server, &port]() {
+        if (server->listen(QHostAddress::LocalHost)) {
+            port = server->serverPort();
+        }
+    }, Qt::BlockingQueuedConnection);
+
+    int status = port ? 0 : 1;
+    for (int run = 0; port && run < runs; ++run) {
+        const SyncResult r = runSync(port, "bench", "bench");
+        if (!r.ok) {
+            status = 1;
+        }
+        const double perThousand = r.messages ? double(r.cpu) / r.messages : 0; // µs je Nachricht = ms je 1000
+        std::printf("%d: %7d Nachrichten  erste Zeilen %6lld ms  Abgleich %7lld ms  "
+                    "Leitung ↓ %9.1f kB ↑ %7.1f kB  CPU %7.1f ms (%6.2f ms je 1000)\n",
+                    run + 1, r.messages, r.firstPaint, r.total, r.traffic.wireIn / 1024.0,
+                    r.traffic.wireOut / 1024.0, r.cpu / 1000.0, perThousand);
+    }
+
+    int misses = 0;
+    QMetaObject::invokeMethod(server, [server, &misses]() {
+        misses = server->missCount();
+        delete server;
+    }, Qt::BlockingQueuedConnection);
+    serverThread.quit();
+    serverThread.wait();
+    if (misses) {
+        std::printf("%d Befehle nicht im Mitschnitt\n", misses);
+    }
+    return status;
+}
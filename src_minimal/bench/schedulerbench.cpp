@@ -0,0 +1,150 @@
+/*
+ * mailadler - IMAP Scheduler Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Erstabgleich eines großen Ordners, während alle 50 ms ein interaktiver
+ * Befehl (NOOP, steht für "Nachricht öffnen") abgesetzt wird. Einmal wie
+ * bisher mit einem einzigen FETCH 1:*, einmal über MailSync in Stücken mit
+ * Hintergrundspur und ImapScheduler. Gemessen wird die Wartezeit der
+ * interaktiven Befehle und die Zeit bis zum ersten Stück Kopfzeilen.
+ *
+ *   schedulerbench [nachrichten] [laufzeit-ms] [kB/s]
+ */
+
+#include "imapconnection.h"
+#include "imapscheduler.h"
+#include "imapstandin.h"
+#include "mailsync.h"
+#include "messagestore.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int ProbeInterval = 50; // ms
+
+void probe(ImapConnection *imap, QVector<qint64> *samples)
+{
+    QElapsedTimer timer;
+    timer.start();
+    ImapCommand command;
+    command.text = "NOOP";
+    command.done = [samples, timer](const ImapResponse &) { samples->append(timer.nsecsElapsed() / 1000); };
+    imap->execute(std::move(command));
+}
+
+double percentile(QVector<qint64> samples, int percent)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    auto it = samples.begin() + samples.size() * percent / 100;
+    std::nth_element(samples.begin(), it, samples.end());
+    return double(*it) / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int messages = argc > 1 ? std::atoi(argv[1]) : 50000;
+    const int roundTrip = argc > 2 ? std::atoi(argv[2]) : 30;
+    const qint64 rate = argc > 3 ? std::atoll(argv[3]) * 1024 : 2048 * 1024;
+
+    ImapStandIn server;
+    server.setRoundTrip(roundTrip);
+    server.setMessageCount(messages);
+    server.setBytesPerSecond(rate);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    for (int run = 0; run < 2; ++run) {
+        const bool lanes = run == 1;
+        QTemporaryDir dir;
+        MessageStore store(dir.filePath("bench.db"));
+        if (!store.open()) {
+            std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+            return 1;
+        }
+        const int mailboxId = store.mailboxId("bench", "INBOX");
+
+        ImapConnection imap;
+        ImapScheduler scheduler;
+        scheduler.addConnection("bench", &imap);
+        MailSync sync(&imap, &store);
+        sync.setAccount("bench");
+        sync.setScheduler(&scheduler);
+
+        QEventLoop loop;
+        QElapsedTimer timer;
+        qint64 firstHeaders = -1;
+        QVector<qint64> samples;
+        QTimer probes;
+        probes.setInterval(ProbeInterval);
+        QObject::connect(&probes, &QTimer::timeout, [&]() { probe(&imap, &samples); });
+
+        QObject::connect(&imap, &ImapConnection::connected, [&]() { imap.login("bench", "bench"); });
+        QObject::connect(&imap, &ImapConnection::headersReceived, [&]() {
+            if (firstHeaders < 0) {
+                firstHeaders = timer.elapsed();
+            }
+        });
+        QObject::connect(&imap, &ImapConnection::error, [&](const QString &message) {
+            std::fprintf(stderr, "%s\n", qPrintable(message));
+        });
+        if (lanes) {
+            QObject::connect(&sync, &MailSync::finished, &loop, &QEventLoop::quit);
+            QObject::connect(&imap, &ImapConnection::authenticated, [&]() { timer.start(); probes.start(); });
+            sync.syncFolder("INBOX");
+        } else {
+            // Bisher: nach dem SELECT ein FETCH über den ganzen Ordner
+            QObject::connect(&imap, &ImapConnection::authenticated, [&]() {
+                timer.start();
+                probes.start();
+                imap.selectFolder("INBOX");
+                imap.fetchNewHeaders(1);
+            });
+            QObject::connect(&imap, &ImapConnection::headersReceived, [&](const QList<EmailHeader> &headers) {
+                store.storeHeaders(mailboxId, headers);
+            });
+            QObject::connect(&imap, &ImapConnection::commandFinished, [&](const QString &command) {
+                if (command == QLatin1String("FETCH")) {
+                    loop.quit();
+                }
+            });
+        }
+
+        imap.connectToServer("127.0.0.1", server.serverPort(), false);
+        loop.exec();
+        probes.stop();
+        const qint64 total = timer.elapsed();
+
+        std::printf("%-22s %8d Nachrichten  %7lld ms  erste Kopfzeilen %5lld ms  "
+                    "interaktiv p50 %7.1f ms  p99 %7.1f ms (%d Befehle)\n",
+                    lanes ? "Stücke mit Spuren" : "ein FETCH 1:*", store.messageCount(mailboxId), total,
+                    firstHeaders, percentile(samples, 50), percentile(samples, 99), int(samples.size()));
+        if (lanes) {
+            for (int lane = 0; lane < ImapConnection::LaneCount; ++lane) {
+                const ImapScheduler::LaneStats s = scheduler.stats(ImapConnection::Lane(lane));
+                std::printf("  %-12s %6llu Befehle  p50 %7.1f ms  p99 %7.1f ms\n",
+                            lane == ImapConnection::InteractiveLane ? "interaktiv" : "Hintergrund",
+                            static_cast<unsigned long long>(s.completed), s.p50, s.p99);
+            }
+        }
+        imap.logout();
+    }
+    return 0;
+}
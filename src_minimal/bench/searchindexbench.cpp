@@ -0,0 +1,173 @@
+/*
+ * mailadler - Search Index Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Baut den Volltextindex aus einem mbox-Korpus auf und misst den
+ * Indexdurchsatz sowie die Antwortzeit typischer Suchanfragen.
+ *
+ *   searchindexbench --generate <mbox> [anzahl]   synthetischen Korpus schreiben
+ *   searchindexbench <mbox>                       indizieren und suchen
+ */
+
+#include "searchindex.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const char *const Words[] = {
+    "Rechnung", "Rechnungen", "Bestellung", "Lieferung", "Zahlung", "Mahnung", "Angebot",
+    "Termin", "Besprechung", "Protokoll", "Überweisung", "Kündigung", "Verträge", "Vertrag",
+    "Urlaub", "Grüße", "freundlichen", "beigefügt", "Anhang", "Rückfrage", "Änderung",
+    "Straße", "München", "Köln", "Düsseldorf", "Geschäftsführung", "Mitarbeiter", "Projekt",
+    "Entwicklung", "Versand", "Paket", "Konto", "Passwort", "Sicherheit", "Hinweis",
+    "bitte", "heute", "morgen", "nächste", "Woche", "Jahresabschluss", "Steuer", "Bescheid",
+    "Einladung", "Geburtstag", "Feier", "Hallo", "Frage", "Antwort", "Unterlagen",
+};
+const char *const Names[] = {
+    "Anna Müller", "Jürgen Schäfer", "Petra Weiß", "Klaus Böhm", "Sabine Groß",
+    "Thomas Köhler", "Monika Schröder", "Stefan Krüger", "Ute Hoffmann", "Max Becker",
+};
+const int WordCount = int(sizeof(Words) / sizeof(Words[0]));
+const int NameCount = int(sizeof(Names) / sizeof(Names[0]));
+
+QByteArray sentence(QRandomGenerator &random, int words)
+{
+    QByteArray text;
+    for (int i = 0; i < words; ++i) {
+        if (i) {
+            text += ' ';
+        }
+        text += Words[random.bounded(WordCount)];
+    }
+    return text;
+}
+
+QByteArray address(const char *name)
+{
+    QByteArray local = QByteArray(name).toLower().replace(' ', '.');
+    return QByteArray(name) + " <" + local + "@example.de>";
+}
+
+int generate(const QString &path, int count)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Kann %s nicht schreiben\n", qPrintable(path));
+        return 1;
+    }
+    QRandomGenerator random(42);
+    for (int i = 0; i < count; ++i) {
+        QByteArray message = "From MAILER-DAEMON Thu Jan  1 00:00:00 2026\n";
+        message += "From: " + address(Names[random.bounded(NameCount)]) + "\n";
+        message += "To: " + address(Names[random.bounded(NameCount)]) + "\n";
+        message += "Subject: " + sentence(random, 3 + random.bounded(5)) + "\n";
+        message += "Content-Type: text/plain; charset=utf-8\n\n";
+        const int lines = 3 + random.bounded(20);
+        for (int l = 0; l < lines; ++l) {
+            message += sentence(random, 6 + random.bounded(8)) + "\n";
+        }
+        message += "\n";
+        file.write(message);
+    }
+    return 0;
+}
+
+// Einfache mbox-Zerlegung; Kopfzeilen ohne Faltung, Text unverändert
+std::vector<SearchDocument> readMbox(const QByteArray &data)
+{
+    std::vector<SearchDocument> documents;
+    qsizetype pos = data.startsWith("From ") ? 0 : data.indexOf("\nFrom ");
+    while (pos >= 0 && pos < data.size()) {
+        qsizetype next = data.indexOf("\nFrom ", pos + 1);
+        const qsizetype end = next < 0 ? data.size() : next + 1;
+        const qsizetype headerStart = data.indexOf('\n', pos) + 1;
+        qsizetype headerEnd = data.indexOf("\n\n", headerStart);
+        if (headerStart <= 0 || headerEnd < 0 || headerEnd > end) {
+            headerEnd = end;
+        }
+
+        SearchDocument d;
+        d.mailboxId = 1;
+        d.uid = quint32(documents.size() + 1);
+        for (const QByteArray &line : data.mid(headerStart, headerEnd - headerStart).split('\n')) {
+            const QByteArray lower = line.left(8).toLower();
+            if (lower.startsWith("subject:")) {
+                d.subject = QString::fromUtf8(line.mid(8).trimmed());
+            } else if (lower.startsWith("from:") || lower.startsWith("to:")) {
+                d.addresses += QString::fromUtf8(line.mid(line.indexOf(':') + 1).trimmed()) + QLatin1Char(' ');
+            }
+        }
+        d.body = QString::fromUtf8(data.mid(headerEnd, end - headerEnd));
+        documents.push_back(d);
+        pos = next < 0 ? -1 : next + 1;
+    }
+    return documents;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() >= 3 && args.at(1) == "--generate") {
+        return generate(args.at(2), args.size() > 3 ? args.at(3).toInt() : 100000);
+    }
+    if (args.size() < 2) {
+        std::fprintf(stderr, "Aufruf: %s [--generate] <mbox> [anzahl]\n", argv[0]);
+        return 1;
+    }
+
+    QFile file(args.at(1));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Kann %s nicht lesen\n", argv[1]);
+        return 1;
+    }
+    const std::vector<SearchDocument> documents = readMbox(file.readAll());
+    std::printf("%zu Nachrichten gelesen\n", documents.size());
+
+    QTemporaryDir dir;
+    SearchIndex index(dir.filePath("index.db"));
+    if (!index.open()) {
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (size_t pos = 0; pos < documents.size(); pos += 1000) {
+        const size_t end = std::min(documents.size(), pos + 1000);
+        index.addDocuments(QVector<SearchDocument>(documents.begin() + pos, documents.begin() + end));
+    }
+    index.waitForDone();
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    std::printf("Indiziert in %.2f s, %.0f Nachrichten/s\n", seconds, documents.size() / seconds);
+
+    // Gebeugte Formen und Umlaute sollen dieselben Treffer liefern
+    const char *const queries[] = {
+        "rechnung", "Rechnungen", "uberweisung", "Überweisung", "von:müller", "betreff:termin",
+        "nächste woche", "Geschäftsf", "jahresabschluss steuer bescheid", "xyzzy",
+    };
+    for (const char *query : queries) {
+        std::vector<qint64> times;
+        int hits = 0;
+        for (int round = 0; round < 9; ++round) {
+            timer.start();
+            hits = int(index.search(QString::fromUtf8(query), 50).size());
+            times.push_back(timer.nsecsElapsed());
+        }
+        std::sort(times.begin(), times.end());
+        std::printf("%-34s %3d Treffer  Median %7.2f ms  max %7.2f ms\n", query, hits,
+                    times[times.size() / 2] / 1e6, times.back() / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * mailadler - SMTP Send Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Schickt eine Nachricht mit großem Anhang über den Ausgang an den
+ * Stand-in-Server, einmal mit BDAT und einmal mit DATA, und meldet Dauer,
+ * Spitzen- und aktuellen Speicherbedarf (VmHWM/VmRSS, nur Linux). Der
+ * Spitzenwert wird vor jedem Lauf über /proc/self/clear_refs zurückgesetzt.
+ *
+ *   smtpsendbench [MiB] [laufzeit-ms]
+ */
+
+#include "messagestore.h"
+#include "messagewriter.h"
+#include "outbox.h"
+#include "smtpstandin.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHostAddress>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// "VmHWM:    123456 kB" -> kB
+qint64 memoryKb(const QByteArray &key)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith(key)) {
+            return line.mid(key.size()).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return -1;
+}
+
+void resetPeak()
+{
+    QFile clear("/proc/self/clear_refs");
+    if (clear.open(QIODevice::WriteOnly)) {
+        clear.write("5");
+    }
+}
+
+bool writeAttachment(const QString &path, int mebibytes)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    // Zufallsdaten, damit nichts unterwegs komprimiert werden kann
+    QByteArray block(1024 * 1024, Qt::Uninitialized);
+    QRandomGenerator generator(42);
+    for (int i = 0; i < mebibytes; ++i) {
+        generator.fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / 4);
+        if (file.write(block) != block.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int mebibytes = argc > 1 ? std::atoi(argv[1]) : 25;
+    const int roundTrip = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    SmtpStandIn server;
+    server.setRoundTrip(roundTrip);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        std::fprintf(stderr, "Stand-in kann nicht starten: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return 1;
+    }
+    const QString attachment = dir.filePath("anhang.bin");
+    if (!writeAttachment(attachment, mebibytes)) {
+        std::fprintf(stderr, "Anhang kann nicht geschrieben werden\n");
+        return 1;
+    }
+
+    OutgoingMail mail;
+    mail.from = QString::fromUtf8("Anna Müller <anna@example.de>");
+    mail.to << "bernd@example.de" << "carla@example.de";
+    mail.subject = QString::fromUtf8("Große Datei");
+    mail.text = QString::fromUtf8("Hallo,\n\nanbei die Datei.\n.\nGrüße\n");
+    mail.attachments << attachment;
+
+    std::printf("Anhang %d MiB, RTT %d ms, Start: VmRSS %lld kB\n", mebibytes, roundTrip,
+                memoryKb("VmRSS:"));
+    for (const bool chunking : {true, false}) {
+        Outbox outbox(&store, dir.filePath(chunking ? "bdat" : "data"));
+        outbox.open();
+        outbox.client()->setServer("127.0.0.1", server.serverPort(), SmtpClient::Plain);
+        outbox.client()->setChunkingAllowed(chunking);
+
+        bool ok = false;
+        QObject::connect(&outbox, &Outbox::sent, &app, [&]() {
+            ok = true;
+            app.quit();
+        });
+        QObject::connect(&outbox, &Outbox::failed, &app, [&](qint64, const QString &message) {
+            std::fprintf(stderr, "Fehler: %s\n", qPrintable(message));
+            app.quit();
+        });
+        QObject::connect(outbox.client(), &SmtpClient::failed, &app, [&](qint64, const QString &message) {
+            // Vorübergehende Fehler würde der Ausgang erst später wiederholen
+            std::fprintf(stderr, "Fehler: %s\n", qPrintable(message));
+            app.quit();
+        });
+
+        resetPeak();
+        QElapsedTimer timer;
+        timer.start();
+        if (!outbox.enqueue(mail)) {
+            std::fprintf(stderr, "Nachricht kann nicht eingereiht werden\n");
+            return 1;
+        }
+        const qint64 written = timer.elapsed();
+        outbox.start();
+        app.exec();
+        const qint64 elapsed = timer.elapsed();
+        if (!ok) {
+            return 1;
+        }
+        std::printf("%s: schreiben %lld ms, gesamt %lld ms (%.1f MB/s), VmHWM %lld kB, VmRSS %lld kB\n",
+                    chunking ? "BDAT" : "DATA", written, elapsed,
+                    mebibytes * 1.048576 * 1000.0 / qMax<qint64>(1, elapsed), memoryKb("VmHWM:"),
+                    memoryKb("VmRSS:"));
+    }
+    std::printf("%d Nachrichten, %d Befehle beim Stand-in\n", server.messageCount(), server.commandCount());
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * mailadler - Local SMTP Stand-in
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "smtpstandin.h"
+#include <QTcpSocket>
+#include <QTimer>
+
+SmtpStandIn::SmtpStandIn(QObject *parent)
+    : QTcpServer(parent)
+    , m_roundTrip(20)
+    , m_pipelining(true)
+    , m_chunking(true)
+    , m_eightBitMime(true)
+    , m_commandCount(0)
+    , m_messageCount(0)
+{
+}
+
+void SmtpStandIn::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    m_sessions.insert(socket, Session());
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        m_sessions.remove(socket);
+        socket->deleteLater();
+    });
+    reply(socket, "220 mailadler stand-in ESMTP\r\n");
+}
+
+void SmtpStandIn::onReadyRead(QTcpSocket *socket)
+{
+    Session &session = m_sessions[socket];
+    session.buffer += socket->readAll();
+
+    // Alles, was zusammen eintrifft, auch zusammen beantworten
+    QByteArray text;
+    bool quit = false;
+    for (;;) {
+        if (session.data) {
+            if (!consumeData(session, text)) {
+                break;
+            }
+            continue;
+        }
+        if (session.chunkLeft > 0 || session.lastChunk) {
+            if (!consumeChunk(session, text)) {
+                break;
+            }
+            continue;
+        }
+        const qsizetype end = session.buffer.indexOf("\r\n");
+        if (end < 0) {
+            break;
+        }
+        const QByteArray line = session.buffer.left(end);
+        session.buffer.remove(0, end + 2);
+        text += answer(session, line);
+        if (line.toUpper() == "QUIT") {
+            quit = true;
+            break;
+        }
+    }
+    if (text.isEmpty()) {
+        return;
+    }
+    reply(socket, text);
+    if (quit) {
+        QTimer::singleShot(m_roundTrip, socket, [socket]() { socket->disconnectFromHost(); });
+    }
+}
+
+bool SmtpStandIn::consumeData(Session &session, QByteArray &reply)
+{
+    // Der Abschluss kann über zwei Pakete verteilt sein, daher mit den
+    // letzten Bytes des vorigen Pakets suchen
+    const QByteArray window = session.tail + session.buffer;
+    const qsizetype end = window.indexOf("\r\n.\r\n");
+    if (end < 0) {
+        session.bytes += session.buffer.size();
+        session.tail = window.right(4);
+        session.buffer.clear();
+        return false;
+    }
+    const qsizetype consumed = end + 5 - session.tail.size();
+    // Abschluss-CRLF gehört zur letzten Zeile, der Punkt nicht
+    session.bytes += consumed - 3;
+    session.buffer.remove(0, consumed);
+    session.data = false;
+    session.tail.clear();
+    ++m_messageCount;
+    emit messageReceived(session.bytes);
+    reply += "250 2.0.0 Ok: queued\r\n";
+    return true;
+}
+
+bool SmtpStandIn::consumeChunk(Session &session, QByteArray &reply)
+{
+    const qint64 take = qMin<qint64>(session.chunkLeft, session.buffer.size());
+    session.buffer.remove(0, take);
+    session.chunkLeft -= take;
+    session.bytes += take;
+    if (session.chunkLeft > 0) {
+        return false;
+    }
+    if (session.lastChunk) {
+        session.lastChunk = false;
+        ++m_messageCount;
+        emit messageReceived(session.bytes);
+        reply += "250 2.0.0 Ok: queued\r\n";
+    } else {
+        reply += "250 2.0.0 Ok: chunk received\r\n";
+    }
+    return true;
+}
+
+QByteArray SmtpStandIn::answer(Session &session, const QByteArray &line)
+{
+    ++m_commandCount;
+    const QByteArray upper = line.toUpper();
+    if (upper.startsWith("EHLO ")) {
+        QByteArray text = "250-mailadler stand-in\r\n";
+        if (m_pipelining) {
+            text += "250-PIPELINING\r\n";
+        }
+        if (m_chunking) {
+            text += "250-CHUNKING\r\n";
+        }
+        if (m_eightBitMime) {
+            text += "250-8BITMIME\r\n";
+        }
+        return text + "250-SIZE 104857600\r\n250 AUTH PLAIN\r\n";
+    }
+    if (upper.startsWith("HELO ")) {
+        return "250 mailadler stand-in\r\n";
+    }
+    if (upper.startsWith("AUTH PLAIN")) {
+        return "235 2.7.0 Authentication successful\r\n";
+    }
+    if (upper.startsWith("MAIL FROM:")) {
+        if (!m_eightBitMime && upper.contains("BODY=8BITMIME")) {
+            return "555 5.5.4 Unsupported option: BODY\r\n";
+        }
+        session.bytes = 0;
+        return "250 2.1.0 Ok\r\n";
+    }
+    if (upper.startsWith("RCPT TO:")) {
+        return "250 2.1.5 Ok\r\n";
+    }
+    if (upper == "DATA") {
+        session.data = true;
+        // Die Zeile DATA endete schon mit CRLF, ein sofortiger "." schließt ab
+        session.tail = "\r\n";
+        return "354 End data with <CR><LF>.<CR><LF>\r\n";
+    }
+    if (m_chunking && upper.startsWith("BDAT ")) {
+        const QList<QByteArray> parts = upper.split(' ');
+        session.chunkLeft = parts.value(1).toLongLong();
+        session.lastChunk = parts.value(2) == "LAST";
+        return QByteArray();
+    }
+    if (upper == "RSET" || upper == "NOOP") {
+        return "250 2.0.0 Ok\r\n";
+    }
+    if (upper == "QUIT") {
+        return "221 2.0.0 Bye\r\n";
+    }
+    return "502 5.5.2 Command not recognized\r\n";
+}
+
+void SmtpStandIn::reply(QTcpSocket *socket, const QByteArray &text)
+{
+    QTimer::singleShot(m_roundTrip, socket, [socket, text]() { socket->write(text); });
+}
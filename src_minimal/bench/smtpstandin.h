@@ -0,0 +1,70 @@
+/*
+ * mailadler - Local SMTP Stand-in
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef SMTPSTANDIN_H
+#define SMTPSTANDIN_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Minimaler SMTP-Server (Senke) für Messungen ohne echtes Konto.
+//
+// Nimmt jede Anmeldung und jeden Empfänger an und verwirft den Inhalt;
+// er wird nur gezählt, nie gesammelt, damit der Speicherbedarf des
+// Clients messbar bleibt. PIPELINING, CHUNKING und 8BITMIME lassen sich
+// abschalten, um die Rückfallwege des Clients zu prüfen. Antworten
+// kommen wie beim IMAP-Stand-in erst nach der eingestellten Laufzeit.
+class SmtpStandIn : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit SmtpStandIn(QObject *parent = nullptr);
+
+    void setRoundTrip(int msecs) { m_roundTrip = msecs; }
+    void setPipelining(bool enabled) { m_pipelining = enabled; }
+    void setChunking(bool enabled) { m_chunking = enabled; }
+    void setEightBitMime(bool enabled) { m_eightBitMime = enabled; }
+    int commandCount() const { return m_commandCount; }
+    int messageCount() const { return m_messageCount; }
+
+signals:
+    // Inhalt ohne Punkt-Verdopplung bzw. BDAT-Rahmen gezählt
+    void messageReceived(qint64 bytes);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    struct Session {
+        QByteArray buffer;
+        bool data = false;     // zwischen DATA und "."
+        QByteArray tail;       // letzte Bytes vor dem Puffer, für "\r\n.\r\n"
+        qint64 chunkLeft = 0;  // Rest des laufenden BDAT-Stücks
+        bool lastChunk = false;
+        qint64 bytes = 0;
+    };
+
+    void onReadyRead(QTcpSocket *socket);
+    // Verbraucht Inhalt aus session.buffer; false, wenn mehr Daten nötig sind
+    bool consumeData(Session &session, QByteArray &reply);
+    bool consumeChunk(Session &session, QByteArray &reply);
+    QByteArray answer(Session &session, const QByteArray &line);
+    void reply(QTcpSocket *socket, const QByteArray &text);
+
+    int m_roundTrip;
+    bool m_pipelining;
+    bool m_chunking;
+    bool m_eightBitMime;
+    int m_commandCount;
+    int m_messageCount;
+    QHash<QTcpSocket *, Session> m_sessions;
+};
+
+#endif // SMTPSTANDIN_H
@@ -0,0 +1,184 @@
+/*
+ * mailadler - Header Snapshot Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Füllt einen Ordner mit vielen Nachrichten und misst den Kaltstart bis zur
+ * ersten sichtbaren Seite der Nachrichtenliste: MessageStore öffnen,
+ * MessageListModel::setMailbox() und data() für die ersten Zeilen. Zum
+ * Vergleich die erste Seite über SQLite, wie vor dem HeaderSnapshot. Unter
+ * Linux werden vor jedem Kaltstart Datenbank und Abbild per posix_fadvise aus
+ * dem Seitencache geworfen.
+ *
+ *   snapshotbench [nachrichten]
+ */
+
+#include "headersnapshot.h"
+#include "messagelistmodel.h"
+#include "messagestore.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QTemporaryDir>
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int Batch = 10000;
+const int Senders = 5000;
+// Sichtbare Zeilen beim ersten Bildaufbau
+const int FirstPage = 40;
+const qint64 Target = 200; // ms
+
+QList<EmailHeader> generate(quint32 first, int count)
+{
+    QList<EmailHeader> headers;
+    headers.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        EmailHeader h;
+        h.uid = first + quint32(i);
+        h.flags = h.uid % 7 ? FlagSeen : 0;
+        h.date = 1767225600 + qint64(h.uid) * 45 - (h.uid % 13) * 600;
+        h.from = QString("Absender %1 <absender%1@example.de>").arg(h.uid * 2654435761u % Senders);
+        h.subject = QString("Angebot Nr. %1 für Größe %2").arg(h.uid).arg(h.uid % 48);
+        headers.append(h);
+    }
+    return headers;
+}
+
+void evict(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    const QFileInfoList files = QFileInfo(path).isDir() ? QDir(path).entryInfoList(QDir::Files)
+                                                          : QFileInfoList{QFileInfo(path)};
+    for (const QFileInfo &info : files) {
+        const int fd = ::open(QFile::encodeName(info.absoluteFilePath()).constData(), O_RDONLY);
+        if (fd >= 0) {
+            ::fdatasync(fd);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+#else
+    Q_UNUSED(path)
+#endif
+}
+
+// Was die Ansicht für eine Zeile abfragt
+int touchRows(const MessageListModel &model, int rows)
+{
+    int chars = 0;
+    for (int row = 0; row < qMin(rows, model.rowCount()); ++row) {
+        for (int column = 0; column < MessageListModel::ColumnCount; ++column) {
+            const QModelIndex index = model.index(row, column);
+            chars += model.data(index).toString().size();
+            model.data(index, Qt::FontRole);
+        }
+    }
+    return chars;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // QFont im Modell braucht eine QGuiApplication, aber keinen Bildschirm
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    const int count = argc > 1 ? qMax(1, std::atoi(argv[1])) : 1000000;
+
+    QTemporaryDir dir;
+    const QString path = dir.filePath("bench.db");
+    int mailboxId = -1;
+    QElapsedTimer timer;
+    {
+        MessageStore store(path);
+        if (!store.open()) {
+            std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+            return 1;
+        }
+        mailboxId = store.mailboxId("bench", "INBOX");
+        timer.start();
+        for (int first = 1; first <= count; first += Batch) {
+            store.storeHeaders(mailboxId, generate(quint32(first), qMin(Batch, count - first + 1)));
+        }
+        std::printf("%d Nachrichten gespeichert: %lld ms\n", count, timer.elapsed());
+
+        timer.restart();
+        HeaderSnapshot *snapshot = store.snapshot(mailboxId);
+        if (!snapshot) {
+            std::fprintf(stderr, "Abbild kann nicht aufgebaut werden\n");
+            return 1;
+        }
+        std::printf("Abbild aufgebaut: %lld ms, %lld kB\n", timer.elapsed(),
+                    (QFileInfo(path + "-snapshots/" + QString::number(mailboxId) + ".rec").size()
+                     + QFileInfo(path + "-snapshots/" + QString::number(mailboxId) + ".str").size()
+                     + QFileInfo(path + "-snapshots/" + QString::number(mailboxId) + ".idx").size())
+                        / 1024);
+    }
+
+    // Vorher: erste Seite über SQLite
+    {
+        evict(path);
+        timer.restart();
+        MessageStore store(path);
+        store.open();
+        const int total = store.messageCount(mailboxId);
+        const QList<EmailHeader> page = store.headers(mailboxId, 2000);
+        std::printf("SQLite kalt: Anzahl und erste Seite (%d von %d) %lld ms\n", int(page.size()), total,
+                    timer.elapsed());
+    }
+
+    // Kaltstart bis zur ersten Seite
+    for (int run = 0; run < 2; ++run) {
+        evict(path);
+        evict(path + "-snapshots");
+        timer.restart();
+        MessageStore store(path);
+        store.open();
+        MessageListModel model(&store);
+        model.setMailbox(mailboxId);
+        const qint64 ready = timer.elapsed();
+        touchRows(model, FirstPage);
+        const qint64 painted = timer.elapsed();
+        std::printf("Kaltstart %d: %d Zeilen, Modell %lld ms, erste %d Zeilen %lld ms%s\n", run + 1,
+                    model.rowCount(), ready, FirstPage, painted, painted < Target ? "" : " (zu langsam)");
+
+        if (run == 0) {
+            // Neue Nachricht, Flags, Löschen: alles im Abbild, ohne Neuaufbau
+            const quint32 next = quint32(count) + 1;
+            const QList<EmailHeader> arrived = generate(next, 1);
+            timer.restart();
+            store.storeHeaders(mailboxId, arrived);
+            model.addMessages(mailboxId, arrived);
+            const qint64 added = timer.nsecsElapsed() / 1000;
+            timer.restart();
+            const QVector<ImapFlagUpdate> updates = {{next, FlagSeen | FlagFlagged, 0}};
+            store.updateFlags(mailboxId, updates);
+            model.updateFlags(mailboxId, updates);
+            const qint64 flagged = timer.nsecsElapsed() / 1000;
+            timer.restart();
+            const QVector<UidRange> removed = {{next, next}};
+            store.removeUids(mailboxId, removed);
+            model.removeMessages(mailboxId, removed);
+            const qint64 gone = timer.nsecsElapsed() / 1000;
+            timer.restart();
+            store.flushSnapshots();
+            std::printf("neue Nachricht %lld µs, Flags %lld µs, löschen %lld µs, Index schreiben %lld ms\n", added,
+                        flagged, gone, timer.elapsed());
+        }
+    }
+    return 0;
+}
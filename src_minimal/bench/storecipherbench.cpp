@@ -0,0 +1,261 @@
+/*
+ * mailadler - Store Encryption Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Misst dieselben Abläufe einmal unverschlüsselt und einmal mit StoreCipher
+ * und gibt den Aufschlag in Prozent aus; über 10 % wird markiert.
+ *
+ *   Sync     Kopfzeilen in Stapeln speichern (Datenbank und HeaderSnapshot),
+ *            danach Flags ändern, wie MailSync beim Abgleich
+ *   Liste    Absender und Betreff aller Zeilen aus dem Abbild lesen
+ *   Suche    Volltextindex aufbauen und typische Anfragen stellen
+ *   Inhalte  BodyCache: Texte und Anhangstücke einfügen, der Reihe nach und
+ *            zufällig lesen
+ *
+ * Ob die Datenbank selbst verschlüsselt ist, hängt vom SQLite-Treiber ab
+ * (SQLCipher); das Programm gibt es mit aus.
+ *
+ *   storecipherbench [nachrichten]
+ */
+
+#include "bodycache.h"
+#include "headersnapshot.h"
+#include "messagestore.h"
+#include "searchindex.h"
+#include "storecipher.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int Batch = 1000;
+const int Texts = 2000;
+const int TextSize = 20 * 1024;
+const int Attachments = 100;
+const int ChunksPerAttachment = 4;
+const int ChunkSize = 256 * 1024;
+const int RandomReads = 5000;
+const double Limit = 10.0; // Prozent
+
+const char *const Words[] = {
+    "Rechnung", "Bestellung", "Lieferung", "Zahlung", "Angebot", "Termin", "Besprechung",
+    "Überweisung", "Vertrag", "Grüße", "Anhang", "Änderung", "München", "Projekt", "Steuer",
+};
+const int WordCount = int(sizeof(Words) / sizeof(Words[0]));
+
+struct Timings {
+    qint64 sync = 0;
+    qint64 list = 0;
+    qint64 index = 0;
+    qint64 search = 0;
+    qint64 bodyInsert = 0;
+    qint64 bodyRead = 0;
+    qint64 bodyRandom = 0;
+};
+
+QString sentence(QRandomGenerator &random, int words)
+{
+    QString text;
+    for (int i = 0; i < words; ++i) {
+        if (i) {
+            text += QLatin1Char(' ');
+        }
+        text += QString::fromUtf8(Words[random.bounded(WordCount)]);
+    }
+    return text;
+}
+
+QList<EmailHeader> generate(quint32 first, int count)
+{
+    QRandomGenerator random(first);
+    QList<EmailHeader> headers;
+    headers.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        EmailHeader h;
+        h.uid = first + quint32(i);
+        h.flags = h.uid % 7 ? FlagSeen : 0;
+        h.date = 1767225600 + qint64(h.uid) * 45;
+        h.from = QString("Absender %1 <absender%1@example.de>").arg(h.uid * 2654435761u % 5000);
+        h.subject = sentence(random, 4 + int(random.bounded(4)));
+        headers.append(h);
+    }
+    return headers;
+}
+
+qint64 elapsedUs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1000;
+}
+
+Timings run(const QString &directory, const StoreCipher *cipher, int count)
+{
+    Timings t;
+    QElapsedTimer timer;
+    MessageStore store(directory + "/bench.db");
+    store.setCipher(cipher);
+    if (!store.open()) {
+        // Verschlüsselt nur mit SQLCipher im SQLite-Treiber
+        std::fprintf(stderr, cipher ? "Speicher kann nicht geöffnet werden, SQLCipher vorhanden?\n"
+                                    : "Speicher kann nicht geöffnet werden\n");
+        std::exit(1);
+    }
+    const int mailboxId = store.mailboxId("bench", "INBOX");
+    // Abbild vorher öffnen, damit jeder Stapel wie beim Abgleich angehängt wird
+    store.snapshot(mailboxId);
+
+    timer.start();
+    for (int first = 1; first <= count; first += Batch) {
+        store.storeHeaders(mailboxId, generate(quint32(first), qMin(Batch, count - first + 1)));
+    }
+    QVector<ImapFlagUpdate> updates;
+    for (int uid = 1; uid <= count; uid += 10) {
+        updates.append({quint32(uid), FlagSeen | FlagFlagged, 0});
+    }
+    store.updateFlags(mailboxId, updates);
+    store.flushSnapshots();
+    t.sync = elapsedUs(timer);
+
+    timer.restart();
+    HeaderSnapshot *snapshot = store.snapshot(mailboxId);
+    qint64 chars = 0;
+    for (quint32 i : snapshot->byDate()) {
+        chars += snapshot->sender(i).size() + snapshot->subject(i).size();
+    }
+    t.list = elapsedUs(timer);
+    if (chars == 0) {
+        std::fprintf(stderr, "Abbild ist leer\n");
+        std::exit(1);
+    }
+
+    {
+        SearchIndex index(store.path());
+        index.setCipher(cipher);
+        if (!index.open()) {
+            std::fprintf(stderr, "Suchindex kann nicht geöffnet werden\n");
+            std::exit(1);
+        }
+        QRandomGenerator random(7);
+        timer.restart();
+        for (int first = 1; first <= count; first += Batch) {
+            QVector<SearchDocument> documents;
+            for (int uid = first; uid < first + Batch && uid <= count; ++uid) {
+                SearchDocument d;
+                d.mailboxId = mailboxId;
+                d.uid = quint32(uid);
+                d.subject = sentence(random, 5);
+                d.addresses = QString("absender%1@example.de").arg(uid % 5000);
+                d.body = sentence(random, 40);
+                documents.append(d);
+            }
+            index.addDocuments(documents);
+        }
+        index.waitForDone();
+        t.index = elapsedUs(timer);
+
+        const char *const queries[] = {"rechnung", "überweisung", "termin projekt", "grüße münchen", "xyzzy"};
+        timer.restart();
+        for (int round = 0; round < 20; ++round) {
+            for (const char *query : queries) {
+                index.search(QString::fromUtf8(query), 50);
+            }
+        }
+        t.search = elapsedUs(timer);
+    }
+
+    BodyCache cache(&store, directory + "/bodies", cipher);
+    cache.setBudget(Q_INT64_C(4) * 1024 * 1024 * 1024);
+    cache.open();
+    QRandomGenerator random(3);
+    QByteArray text(TextSize, Qt::Uninitialized);
+    QByteArray chunk(ChunkSize, Qt::Uninitialized);
+    timer.restart();
+    for (int i = 0; i < Texts; ++i) {
+        for (char &c : text) {
+            c = char('a' + random.bounded(26));
+        }
+        cache.insert(mailboxId, quint32(i + 1), "1", -1, text);
+    }
+    for (int i = 0; i < Attachments; ++i) {
+        for (int n = 0; n < ChunksPerAttachment; ++n) {
+            for (char &c : chunk) {
+                c = char(random.bounded(256));
+            }
+            cache.insert(mailboxId, quint32(i + 1), "2", qint64(n) * ChunkSize, chunk);
+        }
+    }
+    t.bodyInsert = elapsedUs(timer);
+
+    qint64 bytes = 0;
+    timer.restart();
+    for (int i = 0; i < Texts; ++i) {
+        bytes += cache.part(mailboxId, quint32(i + 1), "1").size();
+    }
+    for (int i = 0; i < Attachments; ++i) {
+        cache.read(mailboxId, quint32(i + 1), "2", [&bytes](QByteArrayView block) {
+            bytes += block.size();
+            return true;
+        });
+    }
+    t.bodyRead = elapsedUs(timer);
+    const qint64 expected = qint64(Texts) * TextSize + qint64(Attachments) * ChunksPerAttachment * ChunkSize;
+    if (bytes != expected) {
+        std::fprintf(stderr, "BodyCache liefert %lld statt %lld Bytes\n", bytes, expected);
+        std::exit(1);
+    }
+
+    timer.restart();
+    for (int i = 0; i < RandomReads; ++i) {
+        const quint32 uid = quint32(random.bounded(Attachments)) + 1;
+        const qint64 offset = qint64(random.bounded(ChunksPerAttachment)) * ChunkSize;
+        cache.part(mailboxId, uid, "2", offset);
+    }
+    t.bodyRandom = elapsedUs(timer);
+    return t;
+}
+
+void report(const char *name, qint64 plain, qint64 sealed)
+{
+    const double overhead = plain > 0 ? (sealed - plain) * 100.0 / plain : 0.0;
+    std::printf("%-22s %10.1f ms %10.1f ms %+7.1f %%%s\n", name, plain / 1000.0, sealed / 1000.0, overhead,
+                overhead > Limit ? " (über 10 %)" : "");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int count = argc > 1 ? qMax(1, std::atoi(argv[1])) : 200000;
+
+    QTemporaryDir plainDir;
+    QTemporaryDir sealedDir;
+    QElapsedTimer timer;
+    timer.start();
+    StoreCipher cipher;
+    if (!cipher.create(sealedDir.filePath("bench.db.key"), "geheim")) {
+        std::fprintf(stderr, "Schlüssel kann nicht abgeleitet werden\n");
+        return 1;
+    }
+    std::printf("Schlüsselableitung (einmal je Sitzung): %lld ms\n", timer.elapsed());
+
+    std::printf("%d Nachrichten, %d Texte, %d Anhänge\n", count, Texts, Attachments);
+    const Timings plain = run(plainDir.path(), nullptr, count);
+    const Timings sealed = run(sealedDir.path(), &cipher, count);
+
+    std::printf("%-22s %13s %13s %9s\n", "", "Klartext", "verschlüsselt", "Aufschlag");
+    report("Sync", plain.sync, sealed.sync);
+    report("Liste lesen", plain.list, sealed.list);
+    report("Suchindex aufbauen", plain.index, sealed.index);
+    report("Suche (100 Anfragen)", plain.search, sealed.search);
+    report("Inhalte einfügen", plain.bodyInsert, sealed.bodyInsert);
+    report("Inhalte lesen", plain.bodyRead, sealed.bodyRead);
+    report("Inhalte zufällig", plain.bodyRandom, sealed.bodyRandom);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * mailadler - Threading Benchmark
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ *
+ * Erzeugt einen Ordner mit Unterhaltungen (60 % Antworten auf eine der
+ * letzten 5000 Nachrichten, References bis zu zehn Einträge) und misst den
+ * ersten Aufbau aus dem MessageStore bzw. aus dem Speicher sowie die Zeit je
+ * neu eintreffender Nachricht.
+ *
+ *   threadbench [nachrichten]
+ */
+
+#include "messagestore.h"
+#include "threadbuilder.h"
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int ArrivalCount = 10000;
+const int ReplyWindow = 5000;
+const int MaxReferences = 10;
+
+QList<EmailHeader> generate(int count, quint32 firstUid, QList<EmailHeader> *history)
+{
+    QRandomGenerator generator(7 + firstUid);
+    QList<EmailHeader> headers;
+    headers.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        EmailHeader h;
+        h.uid = firstUid + quint32(i);
+        h.messageId = QString("<%1.bench@example.de>").arg(h.uid);
+        h.date = 1767225600 + h.uid * 60;
+        if (!history->isEmpty() && generator.bounded(100) < 60) {
+            const int window = qMin(int(history->size()), ReplyWindow);
+            const EmailHeader &parent = history->at(history->size() - 1 - generator.bounded(window));
+            QList<QByteArray> refs = parent.references.split(' ');
+            refs.removeAll(QByteArray());
+            refs.append(parent.messageId.toLatin1());
+            while (refs.size() > MaxReferences) {
+                refs.removeFirst();
+            }
+            h.references = refs.join(' ');
+            h.subject = parent.subject.startsWith("Re: ") ? parent.subject : "Re: " + parent.subject;
+        } else {
+            h.subject = QString("Angebot Nr. %1").arg(h.uid);
+        }
+        history->append(h);
+        headers.append(h);
+    }
+    return headers;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? qMax(1, std::atoi(argv[1])) : 500000;
+
+    QList<EmailHeader> history;
+    const QList<EmailHeader> headers = generate(count, 1, &history);
+
+    QTemporaryDir dir;
+    MessageStore store(dir.filePath("bench.db"));
+    if (!store.open()) {
+        std::fprintf(stderr, "Speicher kann nicht geöffnet werden\n");
+        return 1;
+    }
+    const int mailboxId = store.mailboxId("bench", "INBOX");
+    store.storeHeaders(mailboxId, headers);
+
+    QElapsedTimer timer;
+    ThreadBuilder threads;
+    timer.start();
+    threads.load(&store, mailboxId);
+    const qint64 loadMs = timer.elapsed();
+
+    ThreadBuilder memory;
+    timer.restart();
+    memory.reserve(count);
+    memory.add(headers);
+    const qint64 memoryMs = timer.elapsed();
+
+    int largest = 0;
+    for (const EmailHeader &h : headers) {
+        largest = qMax(largest, memory.threadSize(h.uid));
+    }
+    std::printf("%d Nachrichten: Aufbau aus SQLite %lld ms, aus dem Speicher %lld ms, größte Unterhaltung %d\n",
+                count, qlonglong(loadMs), qlonglong(memoryMs), largest);
+
+    // Neue Nachrichten einzeln, wie sie per IDLE kommen
+    const QList<EmailHeader> arrivals = generate(ArrivalCount, quint32(count) + 1, &history);
+    timer.restart();
+    for (const EmailHeader &h : arrivals) {
+        threads.add(h.uid, h.messageId.toLatin1(), h.references, h.subject);
+    }
+    const double perArrival = double(timer.nsecsElapsed()) / ArrivalCount / 1000.0;
+    std::printf("Neue Nachricht: %.2f µs im Mittel (%d Nachrichten)\n", perArrival, ArrivalCount);
+    return threads.messageCount() == count + ArrivalCount ? 0 : 1;
+}
@@ -0,0 +1,456 @@
+/*
+ * mailadler - Message Body Cache
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "bodycache.h"
+#include "messagestore.h"
+#include "storecipher.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+
+#include <cstring>
+
+namespace {
+
+const qint64 CopyBlockSize = 64 * 1024;
+
+const char SealedMagic[4] = {'M', 'A', 'B', 'C'};
+const quint32 SealedVersion = 1;
+
+// Vor den Seiten einer verschlüsselten Datei; steht in der AAD jeder Seite
+struct SealedHeader {
+    char magic[4];
+    quint32 version;
+    quint32 pageSize;
+    quint32 reserved;
+    quint64 size; // Klartext
+    uchar nonce[8]; // zufällig je Datei, dazu die Seitennummer
+};
+static_assert(sizeof(SealedHeader) == 32, "Kopf hat feste Breite");
+
+const int PageAadSize = int(sizeof(SealedHeader)) + 4;
+
+void pageParameters(const SealedHeader &header, quint32 index, uchar *nonce, char *aad)
+{
+    std::memcpy(nonce, header.nonce, sizeof(header.nonce));
+    std::memcpy(nonce + sizeof(header.nonce), &index, sizeof(index));
+    std::memcpy(aad, &header, sizeof(header));
+    std::memcpy(aad + sizeof(header), &index, sizeof(index));
+}
+
+} // namespace
+
+BodyCache::BodyCache(MessageStore *store, const QString &directory, const StoreCipher *cipher)
+    : m_store(store)
+    , m_cipher(cipher)
+    , m_directory(directory)
+    , m_budget(DefaultBudget)
+    , m_size(0)
+    , m_clock(0)
+{
+    if (m_directory.isEmpty()) {
+        m_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/bodies";
+    }
+}
+
+bool BodyCache::open()
+{
+    if (!QDir().mkpath(m_directory)) {
+        qWarning() << "BodyCache: kann" << m_directory << "nicht anlegen";
+        return false;
+    }
+
+    QSqlQuery query(m_store->database());
+    const char *statements[] = {
+        "CREATE TABLE IF NOT EXISTS body_blobs ("
+        " hash BLOB PRIMARY KEY,"
+        " size INTEGER NOT NULL,"
+        " last_used INTEGER NOT NULL) WITHOUT ROWID",
+        "CREATE INDEX IF NOT EXISTS body_blobs_lru ON body_blobs (last_used)",
+        "CREATE TABLE IF NOT EXISTS body_parts ("
+        " mailbox_id INTEGER NOT NULL REFERENCES mailboxes(id) ON DELETE CASCADE,"
+        " uid INTEGER NOT NULL,"
+        " section TEXT NOT NULL,"
+        " start INTEGER NOT NULL,"
+        " hash BLOB NOT NULL,"
+        " PRIMARY KEY (mailbox_id, uid, section, start)) WITHOUT ROWID",
+        "CREATE INDEX IF NOT EXISTS body_parts_hash ON body_parts (hash)",
+    };
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            qWarning() << "BodyCache: Schema-Fehler:" << query.lastError().text();
+            return false;
+        }
+    }
+    // Ältere Datenbanken; schlägt fehl, wenn die Spalte existiert
+    query.exec("ALTER TABLE body_blobs ADD COLUMN sealed INTEGER NOT NULL DEFAULT 0");
+    removeForeign();
+
+    if (query.exec("SELECT COALESCE(SUM(size), 0), COALESCE(MAX(last_used), 0) FROM body_blobs") && query.next()) {
+        m_size = query.value(0).toLongLong();
+        m_clock = query.value(1).toLongLong();
+    }
+    return true;
+}
+
+void BodyCache::setBudget(qint64 bytes)
+{
+    m_budget = qMax<qint64>(bytes, 0);
+    if (m_size > m_budget) {
+        evict();
+    }
+}
+
+bool BodyCache::contains(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset) const
+{
+    return !hashOf(mailboxId, uid, section, offset).isEmpty();
+}
+
+QByteArray BodyCache::part(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset)
+{
+    const QByteArray hash = hashOf(mailboxId, uid, section, offset);
+    if (hash.isEmpty()) {
+        return QByteArray();
+    }
+    // Auch leer nicht null, null heißt "nicht im Cache"
+    QByteArray data("");
+    const bool ok = readBlob(hash, [&data](QByteArrayView block) {
+        data.append(block);
+        return true;
+    });
+    if (!ok) {
+        // Von außen gelöscht oder beschädigt: Eintrag verwerfen, der Abschnitt wird neu geladen
+        QSqlQuery query(m_store->database());
+        query.prepare("DELETE FROM body_parts WHERE hash = ?");
+        query.addBindValue(hash);
+        query.exec();
+        removeUnreferenced();
+        return QByteArray();
+    }
+    touch(hash);
+    return data;
+}
+
+void BodyCache::insert(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset, const QByteArray &data)
+{
+    const QByteArray hash = m_cipher ? m_cipher->mac(StoreCipher::BodyNames, data)
+                                     : QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT 1 FROM body_blobs WHERE hash = ?");
+    query.addBindValue(hash);
+    const bool known = query.exec() && query.next();
+
+    if (known) {
+        touch(hash);
+    } else {
+        const QString path = blobPath(hash);
+        if (hash.isEmpty() || !writeBlob(path, data)) {
+            qWarning() << "BodyCache: kann" << path << "nicht schreiben";
+            return;
+        }
+        query.prepare("INSERT INTO body_blobs (hash, size, last_used, sealed) VALUES (?, ?, ?, ?)");
+        query.addBindValue(hash);
+        query.addBindValue(qint64(data.size()));
+        query.addBindValue(++m_clock);
+        query.addBindValue(m_cipher ? 1 : 0);
+        query.exec();
+        m_size += data.size();
+    }
+
+    query.prepare("INSERT OR REPLACE INTO body_parts (mailbox_id, uid, section, start, hash) VALUES (?, ?, ?, ?, ?)");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    query.addBindValue(QString::fromLatin1(section));
+    query.addBindValue(offset);
+    query.addBindValue(hash);
+    if (!query.exec()) {
+        qWarning() << "BodyCache:" << query.lastError().text();
+    }
+
+    if (m_size > m_budget) {
+        evict();
+    }
+}
+
+bool BodyCache::read(int mailboxId, quint32 uid, const QByteArray &section,
+                     const std::function<bool(QByteArrayView)> &sink)
+{
+    QSqlQuery query(m_store->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT p.start, p.hash, b.size FROM body_parts p JOIN body_blobs b ON b.hash = p.hash"
+                  " WHERE p.mailbox_id = ? AND p.uid = ? AND p.section = ? ORDER BY p.start");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    query.addBindValue(QString::fromLatin1(section));
+    if (!query.exec()) {
+        return false;
+    }
+
+    qint64 expected = 0;
+    bool any = false;
+    while (query.next()) {
+        const qint64 start = query.value(0).toLongLong();
+        const QByteArray hash = query.value(1).toByteArray();
+        // Ganzer Abschnitt oder lückenlose Stücke
+        if (start >= 0 && start != expected) {
+            return false;
+        }
+        if (!readBlob(hash, sink)) {
+            return false;
+        }
+        touch(hash);
+        any = true;
+        if (start < 0) {
+            break;
+        }
+        expected = start + query.value(2).toLongLong();
+    }
+    return any;
+}
+
+bool BodyCache::write(int mailboxId, quint32 uid, const QByteArray &section, QIODevice *device)
+{
+    return read(mailboxId, uid, section, [device](QByteArrayView block) {
+        return device->write(block.data(), block.size()) == block.size();
+    });
+}
+
+void BodyCache::removeMessages(int mailboxId, const QVector<UidRange> &ranges)
+{
+    QSqlDatabase db = m_store->database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM body_parts WHERE mailbox_id = ? AND uid BETWEEN ? AND ?");
+    for (const UidRange &r : ranges) {
+        query.bindValue(0, mailboxId);
+        query.bindValue(1, r.first);
+        query.bindValue(2, r.last);
+        query.exec();
+    }
+    db.commit();
+    removeUnreferenced();
+}
+
+void BodyCache::removeMailbox(int mailboxId)
+{
+    removeMessages(mailboxId, {{0, 0xffffffffu}});
+}
+
+QString BodyCache::blobPath(const QByteArray &hash) const
+{
+    const QString hex = QString::fromLatin1(hash.toHex());
+    return m_directory + QLatin1Char('/') + hex.left(2) + QLatin1Char('/') + hex.mid(2);
+}
+
+QByteArray BodyCache::hashOf(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset) const
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT hash FROM body_parts WHERE mailbox_id = ? AND uid = ? AND section = ? AND start = ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    query.addBindValue(QString::fromLatin1(section));
+    query.addBindValue(offset);
+    if (query.exec() && query.next()) {
+        return query.value(0).toByteArray();
+    }
+    return QByteArray();
+}
+
+bool BodyCache::readBlob(const QByteArray &hash, const std::function<bool(QByteArrayView)> &sink) const
+{
+    QFile file(blobPath(hash));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (!m_cipher) {
+        QByteArray block;
+        while (!file.atEnd()) {
+            block = file.read(CopyBlockSize);
+            if (block.isEmpty() || !sink(block)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    SealedHeader header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || std::memcmp(header.magic, SealedMagic, sizeof(SealedMagic)) != 0 || header.version != SealedVersion
+        || header.pageSize != quint32(PageSize)) {
+        qWarning() << "BodyCache:" << file.fileName() << "ist nicht verschlüsselt oder unbekannt";
+        return false;
+    }
+    // Nur die gerade gebrauchte Seite liegt im Speicher
+    QByteArray sealed(PageSize + StoreCipher::TagSize, Qt::Uninitialized);
+    QByteArray plain(PageSize, Qt::Uninitialized);
+    uchar nonce[StoreCipher::NonceSize];
+    char aad[PageAadSize];
+    quint64 done = 0;
+    for (quint32 index = 0; done < header.size; ++index) {
+        const qint64 size = qint64(qMin<quint64>(PageSize, header.size - done));
+        pageParameters(header, index, nonce, aad);
+        if (file.read(sealed.data(), size + StoreCipher::TagSize) != size + StoreCipher::TagSize
+            || !m_cipher->open(StoreCipher::Bodies, nonce, QByteArrayView(aad, PageAadSize),
+                               QByteArrayView(sealed.constData(), size + StoreCipher::TagSize), plain.data())) {
+            qWarning() << "BodyCache:" << file.fileName() << "ist beschädigt";
+            return false;
+        }
+        if (!sink(QByteArrayView(plain.constData(), size))) {
+            return false;
+        }
+        done += quint64(size);
+    }
+    return file.atEnd();
+}
+
+bool BodyCache::writeBlob(const QString &path, const QByteArray &data) const
+{
+    QDir().mkpath(path.left(path.lastIndexOf(QLatin1Char('/'))));
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    if (!m_cipher) {
+        return file.write(data) == data.size() && file.commit();
+    }
+
+    SealedHeader header;
+    std::memcpy(header.magic, SealedMagic, sizeof(SealedMagic));
+    header.version = SealedVersion;
+    header.pageSize = PageSize;
+    header.reserved = 0;
+    header.size = quint64(data.size());
+    if (!StoreCipher::randomBytes(header.nonce, int(sizeof(header.nonce)))
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))) {
+        return false;
+    }
+    QByteArray sealed(PageSize + StoreCipher::TagSize, Qt::Uninitialized);
+    uchar nonce[StoreCipher::NonceSize];
+    char aad[PageAadSize];
+    quint32 index = 0;
+    for (qsizetype at = 0; at < data.size(); at += PageSize, ++index) {
+        const QByteArrayView page = QByteArrayView(data).sliced(at, qMin<qsizetype>(PageSize, data.size() - at));
+        const qint64 size = page.size() + StoreCipher::TagSize;
+        pageParameters(header, index, nonce, aad);
+        if (!m_cipher->seal(StoreCipher::Bodies, nonce, QByteArrayView(aad, PageAadSize), page, sealed.data())
+            || file.write(sealed.constData(), size) != size) {
+            return false;
+        }
+    }
+    return file.commit();
+}
+
+void BodyCache::touch(const QByteArray &hash)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("UPDATE body_blobs SET last_used = ? WHERE hash = ?");
+    query.addBindValue(++m_clock);
+    query.addBindValue(hash);
+    query.exec();
+}
+
+void BodyCache::removeUnreferenced()
+{
+    QSqlDatabase db = m_store->database();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT hash, size FROM body_blobs WHERE hash NOT IN (SELECT hash FROM body_parts)")) {
+        return;
+    }
+    QList<QByteArray> orphans;
+    while (query.next()) {
+        orphans.append(query.value(0).toByteArray());
+        m_size -= query.value(1).toLongLong();
+    }
+    if (orphans.isEmpty()) {
+        return;
+    }
+
+    db.transaction();
+    QSqlQuery remove(db);
+    remove.prepare("DELETE FROM body_blobs WHERE hash = ?");
+    for (const QByteArray &hash : std::as_const(orphans)) {
+        QFile::remove(blobPath(hash));
+        remove.bindValue(0, hash);
+        remove.exec();
+    }
+    db.commit();
+}
+
+void BodyCache::removeForeign()
+{
+    QSqlDatabase db = m_store->database();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT hash FROM body_blobs WHERE sealed != ?");
+    query.addBindValue(m_cipher ? 1 : 0);
+    if (!query.exec()) {
+        return;
+    }
+    QList<QByteArray> foreign;
+    while (query.next()) {
+        foreign.append(query.value(0).toByteArray());
+    }
+    if (foreign.isEmpty()) {
+        return;
+    }
+    qDebug() << "BodyCache: verwerfe" << foreign.size()
+             << (m_cipher ? "unverschlüsselte" : "verschlüsselte") << "Einträge";
+
+    // Nur ein Cache, die Teile werden bei Bedarf neu geladen
+    db.transaction();
+    QSqlQuery remove(db);
+    for (const QByteArray &hash : std::as_const(foreign)) {
+        QFile::remove(blobPath(hash));
+        remove.prepare("DELETE FROM body_parts WHERE hash = ?");
+        remove.addBindValue(hash);
+        remove.exec();
+        remove.prepare("DELETE FROM body_blobs WHERE hash = ?");
+        remove.addBindValue(hash);
+        remove.exec();
+    }
+    db.commit();
+}
+
+void BodyCache::evict()
+{
+    // Etwas unter das Budget, damit nicht jedes Einfügen erneut räumt
+    const qint64 target = m_budget - m_budget / 10;
+    QSqlDatabase db = m_store->database();
+    db.transaction();
+    QSqlQuery select(db);
+    QSqlQuery remove(db);
+    while (m_size > target) {
+        select.setForwardOnly(true);
+        if (!select.exec("SELECT hash, size FROM body_blobs ORDER BY last_used LIMIT 64")) {
+            break;
+        }
+        bool any = false;
+        while (m_size > target && select.next()) {
+            const QByteArray hash = select.value(0).toByteArray();
+            QFile::remove(blobPath(hash));
+            remove.prepare("DELETE FROM body_parts WHERE hash = ?");
+            remove.addBindValue(hash);
+            remove.exec();
+            remove.prepare("DELETE FROM body_blobs WHERE hash = ?");
+            remove.addBindValue(hash);
+            remove.exec();
+            m_size -= select.value(1).toLongLong();
+            any = true;
+        }
+        select.finish();
+        if (!any) {
+            m_size = 0;
+            break;
+        }
+    }
+    db.commit();
+}
@@ -0,0 +1,84 @@
+/*
+ * mailadler - Message Body Cache
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef BODYCACHE_H
+#define BODYCACHE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+#include <functional>
+
+#include "imapconnection.h"
+
+class MessageStore;
+class QIODevice;
+class StoreCipher;
+
+// Inhaltsadressierter Plattencache für Nachrichtenteile.
+//
+// Jeder Abschnitt (bzw. jedes Stück eines großen Anhangs) liegt als Datei
+// unter seinem SHA-256, gleiche Anhänge in mehreren Nachrichten also nur
+// einmal. Die Zuordnung (Postfach, UID, Abschnitt, Offset) -> Hash und die
+// LRU-Reihenfolge stehen in der Datenbank des MessageStore. Übersteigt die
+// Summe das Budget, werden die am längsten nicht benutzten Dateien gelöscht.
+//
+// Mit StoreCipher liegt jede Datei in Seiten von PageSize, jede einzeln per
+// AES-GCM verschlüsselt; Kopf und Seitennummer sind Teil der AAD, vertauschte
+// oder abgeschnittene Seiten fallen auf. Der Dateiname ist dann ein HMAC statt
+// SHA-256, sonst verriete er bekannte Anhänge. Beim Ein- oder Ausschalten
+// verwirft open() die Einträge im jeweils anderen Format.
+class BodyCache
+{
+public:
+    static constexpr qint64 DefaultBudget = Q_INT64_C(512) * 1024 * 1024;
+    static const int PageSize = 64 * 1024;
+
+    // cipher muss entsperrt sein und den BodyCache überleben
+    explicit BodyCache(MessageStore *store, const QString &directory = QString(),
+                       const StoreCipher *cipher = nullptr);
+
+    bool open();
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+    qint64 size() const { return m_size; }
+
+    // offset < 0: ganzer Abschnitt, sonst ein Stück ab offset
+    bool contains(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset = -1) const;
+    QByteArray part(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset = -1);
+    void insert(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset, const QByteArray &data);
+
+    // Stücke eines Abschnitts der Reihe nach an sink, ohne ihn ganz zu laden;
+    // sink liefert false zum Abbrechen
+    bool read(int mailboxId, quint32 uid, const QByteArray &section,
+              const std::function<bool(QByteArrayView)> &sink);
+    bool write(int mailboxId, quint32 uid, const QByteArray &section, QIODevice *device);
+
+    void removeMessages(int mailboxId, const QVector<UidRange> &ranges);
+    void removeMailbox(int mailboxId);
+
+private:
+    QString blobPath(const QByteArray &hash) const;
+    QByteArray hashOf(int mailboxId, quint32 uid, const QByteArray &section, qint64 offset) const;
+    // Datei in Blöcken an sink, verschlüsselte seitenweise geprüft und entschlüsselt
+    bool readBlob(const QByteArray &hash, const std::function<bool(QByteArrayView)> &sink) const;
+    bool writeBlob(const QString &path, const QByteArray &data) const;
+    // Einträge im anderen Format als m_cipher verlangt
+    void removeForeign();
+    void touch(const QByteArray &hash);
+    void removeUnreferenced();
+    void evict();
+
+    MessageStore *m_store;
+    const StoreCipher *m_cipher;
+    QString m_directory;
+    qint64 m_budget;
+    qint64 m_size;
+    qint64 m_clock; // LRU-Zähler statt Uhrzeit, unabhängig von Zeitsprüngen
+};
+
+#endif // BODYCACHE_H
@@ -0,0 +1,167 @@
+/*
+ * mailadler - Message Body Prefetcher
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "bodyprefetcher.h"
+#include "messagelistmodel.h"
+#include "messageloader.h"
+
+#include <algorithm>
+
+BodyPrefetcher::BodyPrefetcher(MessageLoader *loader, MessageListModel *model, QObject *parent)
+    : QObject(parent)
+    , m_loader(loader)
+    , m_model(model)
+    , m_lookahead(DefaultLookahead)
+    , m_byteBudget(DefaultByteBudget)
+    , m_mailboxId(-1)
+    , m_row(-1)
+    , m_direction(1)
+    , m_firstVisible(-1)
+    , m_lastVisible(-1)
+    , m_inFlight(0)
+    , m_windowBytes(0)
+    , m_nextSample{}
+{
+    for (QVector<qint64> &samples : m_samples) {
+        samples.reserve(SampleCount);
+    }
+    m_budgetWindow.start();
+    m_settle.setSingleShot(true);
+    m_settle.setInterval(SettleDelay);
+    m_resume.setSingleShot(true);
+    connect(&m_settle, &QTimer::timeout, this, &BodyPrefetcher::schedule);
+    connect(&m_resume, &QTimer::timeout, this, &BodyPrefetcher::schedule);
+    connect(m_loader, &MessageLoader::prefetched, this, &BodyPrefetcher::onPrefetched);
+}
+
+void BodyPrefetcher::selected(int row)
+{
+    const int mailboxId = m_model->mailboxId();
+    const quint32 uid = m_model->uid(row);
+    if (mailboxId != m_mailboxId) {
+        // Anderer Ordner: Richtung wie beim ersten Öffnen
+        m_mailboxId = mailboxId;
+        m_direction = 1;
+    } else if (m_row >= 0 && row != m_row && qAbs(row - m_row) <= JumpLimit) {
+        m_direction = row > m_row ? 1 : -1;
+    }
+    m_row = row;
+
+    m_selection.mailboxId = mailboxId;
+    m_selection.uid = uid;
+    m_selection.outcome = m_loader->isCached(mailboxId, uid)       ? Hit
+                          : m_loader->isPrefetching(mailboxId, uid) ? Late
+                                                                    : Miss;
+    m_selection.timer.start();
+    ++m_stats.selections;
+    ++m_stats.outcomes[m_selection.outcome];
+
+    // Erst nach load(), damit der Text der Auswahl vor den Vorabrufen läuft
+    QTimer::singleShot(0, this, &BodyPrefetcher::schedule);
+}
+
+void BodyPrefetcher::viewportChanged(int firstRow, int lastRow)
+{
+    m_firstVisible = firstRow;
+    m_lastVisible = lastRow;
+    m_settle.start();
+}
+
+void BodyPrefetcher::rendered(int mailboxId, quint32 uid)
+{
+    if (!m_selection.timer.isValid() || mailboxId != m_selection.mailboxId || uid != m_selection.uid) {
+        return;
+    }
+    addSample(m_selection.outcome, m_selection.timer.nsecsElapsed() / 1000);
+    m_selection.timer.invalidate();
+}
+
+void BodyPrefetcher::onPrefetched(int mailboxId, quint32 uid, bool ok)
+{
+    Q_UNUSED(mailboxId)
+    Q_UNUSED(uid)
+    m_inFlight = qMax(0, m_inFlight - 1);
+    if (ok) {
+        ++m_stats.prefetched;
+    }
+    schedule();
+}
+
+void BodyPrefetcher::schedule()
+{
+    if (m_budgetWindow.hasExpired(BudgetInterval)) {
+        m_budgetWindow.restart();
+        m_windowBytes = 0;
+    }
+    const int mailboxId = m_model->mailboxId();
+    const int rows = m_model->rowCount();
+    if (mailboxId < 0 || rows == 0 || m_lookahead == 0) {
+        return;
+    }
+
+    // Ab der Auswahl; ist sie aus dem Bild gescrollt, ab dem Rand, über den
+    // die Leserichtung in den sichtbaren Bereich führt
+    int anchor = mailboxId == m_mailboxId ? m_row : -1;
+    if (m_firstVisible >= 0 && (anchor < m_firstVisible || anchor > m_lastVisible)) {
+        anchor = m_direction > 0 ? m_firstVisible - 1 : m_lastVisible + 1;
+    }
+
+    int candidates = 0;
+    for (int row = anchor + m_direction, scanned = 0;
+         row >= 0 && row < rows && candidates < m_lookahead && scanned < ScanLimit; row += m_direction, ++scanned) {
+        if (m_model->index(row, 0).data(MessageListModel::FlagsRole).toUInt() & FlagSeen) {
+            continue;
+        }
+        ++candidates;
+        const quint32 uid = m_model->uid(row);
+        if (m_loader->isPrefetching(mailboxId, uid)) {
+            continue;
+        }
+        if (m_inFlight >= MaxInFlight) {
+            break;
+        }
+        if (m_windowBytes >= m_byteBudget) {
+            // Im nächsten Fenster weiter, falls bis dahin nichts anderes kommt
+            m_resume.start(int(qMax<qint64>(0, BudgetInterval - m_budgetWindow.elapsed())));
+            break;
+        }
+        qint64 bytes = 0;
+        if (m_loader->prefetch(mailboxId, uid, &bytes)) {
+            ++m_inFlight;
+            m_windowBytes += bytes;
+            m_stats.bytes += bytes;
+        }
+    }
+}
+
+void BodyPrefetcher::addSample(Outcome outcome, qint64 usecs)
+{
+    QVector<qint64> &samples = m_samples[outcome];
+    if (samples.size() < SampleCount) {
+        samples.append(usecs);
+    } else {
+        samples[m_nextSample[outcome]] = usecs;
+        m_nextSample[outcome] = (m_nextSample[outcome] + 1) % SampleCount;
+    }
+}
+
+BodyPrefetcher::Stats BodyPrefetcher::stats() const
+{
+    Stats s = m_stats;
+    for (int outcome = 0; outcome < OutcomeCount; ++outcome) {
+        QVector<qint64> samples = m_samples[outcome];
+        if (samples.isEmpty()) {
+            continue;
+        }
+        auto p50 = samples.begin() + samples.size() / 2;
+        std::nth_element(samples.begin(), p50, samples.end());
+        s.renderP50[outcome] = double(*p50) / 1000.0;
+        auto p90 = samples.begin() + samples.size() * 9 / 10;
+        std::nth_element(samples.begin(), p90, samples.end());
+        s.renderP90[outcome] = double(*p90) / 1000.0;
+    }
+    return s;
+}
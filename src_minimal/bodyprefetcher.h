@@ -0,0 +1,118 @@
+/*
+ * mailadler - Message Body Prefetcher
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef BODYPREFETCHER_H
+#define BODYPREFETCHER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class MessageListModel;
+class MessageLoader;
+
+// Lädt die Texte der Nachrichten vorab, die voraussichtlich als nächste
+// geöffnet werden, damit die Auswahl ohne Roundtrip aus dem BodyCache kommt.
+//
+// Vorhersage: die nächsten lookahead() ungelesenen Zeilen in Leserichtung,
+// gezählt ab der Auswahl bzw., wenn sie aus dem sichtbaren Bereich gescrollt
+// ist, ab dessen Rand. Die Richtung folgt dem letzten Schritt der Auswahl;
+// Sprünge über mehr als JumpLimit Zeilen ändern sie nicht.
+//
+// Grenzen: höchstens MaxInFlight Vorabrufe gleichzeitig (Hintergrundspur),
+// höchstens byteBudget() Bytes je BudgetInterval, und der BodyCache wird nie
+// über seine Räumgrenze gefüllt (MessageLoader::prefetch()).
+//
+// Gemessen wird je Auswahl, ob der Text schon im Cache lag (Hit), ein
+// Vorabruf noch unterwegs war (Late) oder nicht (Miss), und die Zeit von der
+// Auswahl bis zur Anzeige (rendered()).
+class BodyPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DefaultLookahead = 5;
+    static const int MaxInFlight = 2;
+    static const int JumpLimit = 10;
+    // So weit wird nach ungelesenen Zeilen gesucht
+    static const int ScanLimit = 200;
+    static constexpr qint64 DefaultByteBudget = Q_INT64_C(8) * 1024 * 1024;
+    static const int BudgetInterval = 60 * 1000; // ms
+    // Nach dem Scrollen erst vorab laden, wenn die Liste steht
+    static const int SettleDelay = 150; // ms
+    static const int SampleCount = 256;
+
+    enum Outcome { Hit, Late, Miss, OutcomeCount };
+
+    struct Stats {
+        int selections = 0;
+        int outcomes[OutcomeCount] = {};
+        int prefetched = 0; // abgeschlossene Vorabrufe
+        qint64 bytes = 0;   // angefordert
+        // Auswahl bis Anzeige über die letzten SampleCount Auswahlen je Ausgang
+        double renderP50[OutcomeCount] = {}; // ms
+        double renderP90[OutcomeCount] = {}; // ms
+
+        double hitRate() const { return selections ? double(outcomes[Hit]) / selections : 0.0; }
+    };
+
+    BodyPrefetcher(MessageLoader *loader, MessageListModel *model, QObject *parent = nullptr);
+
+    void setLookahead(int count) { m_lookahead = qMax(0, count); }
+    int lookahead() const { return m_lookahead; }
+    // Bytes je BudgetInterval
+    void setByteBudget(qint64 bytes) { m_byteBudget = qMax<qint64>(0, bytes); }
+    qint64 byteBudget() const { return m_byteBudget; }
+
+    Stats stats() const;
+
+public slots:
+    // Vor MessageLoader::load(), sonst zählt ein Cache-Treffer nicht
+    void selected(int row);
+    // Sichtbare Zeilen, lastRow eingeschlossen
+    void viewportChanged(int firstRow, int lastRow);
+    // Text der Nachricht steht in der Vorschau
+    void rendered(int mailboxId, quint32 uid);
+
+private slots:
+    void onPrefetched(int mailboxId, quint32 uid, bool ok);
+    void schedule();
+
+private:
+    struct Selection {
+        int mailboxId = -1;
+        quint32 uid = 0;
+        Outcome outcome = Miss;
+        QElapsedTimer timer;
+    };
+
+    void addSample(Outcome outcome, qint64 usecs);
+
+    MessageLoader *m_loader;
+    MessageListModel *m_model;
+    int m_lookahead;
+    qint64 m_byteBudget;
+
+    int m_mailboxId;
+    int m_row;
+    int m_direction; // +1 nach unten, -1 nach oben
+    int m_firstVisible;
+    int m_lastVisible;
+    int m_inFlight;
+
+    QElapsedTimer m_budgetWindow;
+    qint64 m_windowBytes;
+    QTimer m_settle;
+    QTimer m_resume; // bis zum nächsten Budgetfenster
+
+    Selection m_selection; // wartet auf rendered()
+    Stats m_stats;
+    QVector<qint64> m_samples[OutcomeCount];
+    int m_nextSample[OutcomeCount];
+};
+
+#endif // BODYPREFETCHER_H
@@ -0,0 +1,137 @@
+/*
+ * mailadler - MIME Body Structure
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "bodystructure.h"
+#include "imapparser.h"
+#include "mimedecoder.h"
+
+namespace {
+
+// Wert zu einem Schlüssel in einer Parameterliste ("charset" "utf-8" ...)
+QByteArray parameter(const ImapResponse &response, int list, const char *name)
+{
+    if (response.type(list) != ImapToken::List) {
+        return QByteArray();
+    }
+    const int end = response.next(list);
+    for (int key = list + 1; key < end && response.next(key) < end; key = response.next(response.next(key))) {
+        if (response.string(key).compare(name, Qt::CaseInsensitive) == 0) {
+            return response.string(response.next(key));
+        }
+    }
+    return QByteArray();
+}
+
+// Dateiname aus einer Parameterliste; die Server reichen RFC 2231
+// (filename*, filename*0*) und RFC 2047 meist unverändert durch
+QString fileName(const ImapResponse &response, int list, const char *name)
+{
+    if (response.type(list) != ImapToken::List) {
+        return QString();
+    }
+    // Wieder als Kopfzeilen-Parameter zusammensetzen und dort auswerten
+    QByteArray params;
+    const int end = response.next(list);
+    for (int key = list + 1; key < end && response.next(key) < end; key = response.next(response.next(key))) {
+        QByteArray value = response.string(response.next(key));
+        value.replace('\\', "\\\\").replace('"', "\\\"");
+        params += "; " + response.string(key) + "=\"" + value + '"';
+    }
+    return MimeDecoder::parameter(params, name);
+}
+
+void walk(const ImapResponse &response, int list, const QByteArray &prefix, QVector<MimePart> *parts)
+{
+    const int first = response.child(list, 0);
+    if (first < 0) {
+        return;
+    }
+
+    if (response.type(first) == ImapToken::List) {
+        // multipart: (teil)(teil)... "subtype" ...
+        const int end = response.next(list);
+        int n = 1;
+        for (int child = first; child < end && response.type(child) == ImapToken::List; child = response.next(child)) {
+            walk(response, child, prefix.isEmpty() ? QByteArray::number(n) : prefix + '.' + QByteArray::number(n), parts);
+            ++n;
+        }
+        return;
+    }
+
+    // Einzelteil: type subtype (params) id description encoding size ...
+    MimePart part;
+    part.section = prefix.isEmpty() ? QByteArray("1") : prefix;
+    part.type = response.string(first).toLower();
+    part.subtype = response.string(response.child(list, 1)).toLower();
+    const int params = response.child(list, 2);
+    part.charset = parameter(response, params, "charset").toLower();
+    part.contentId = response.string(response.child(list, 3));
+    part.encoding = response.string(response.child(list, 5)).toLower();
+    part.size = quint32(response.number(response.child(list, 6)));
+
+    // Erweiterungsdaten beginnen hinter den typabhängigen Feldern:
+    // text/* hat noch die Zeilenzahl, message/rfc822 Envelope, Body und Zeilen
+    int extension = 7;
+    if (part.type == "text") {
+        extension = 8;
+    } else if (part.type == "message" && part.subtype == "rfc822") {
+        extension = 10;
+    }
+    const int disposition = response.child(list, extension + 1);
+    if (disposition >= 0 && response.type(disposition) == ImapToken::List) {
+        part.disposition = response.string(response.child(disposition, 0)).toLower();
+        part.filename = fileName(response, response.child(disposition, 1), "filename");
+    }
+    if (part.filename.isEmpty()) {
+        part.filename = fileName(response, params, "name");
+    }
+    parts->append(part);
+}
+
+} // namespace
+
+QVector<MimePart> BodyStructure::parse(const ImapResponse &response, int list)
+{
+    QVector<MimePart> parts;
+    if (list >= 0 && response.type(list) == ImapToken::List) {
+        walk(response, list, QByteArray(), &parts);
+    }
+    return parts;
+}
+
+QVector<MimePart> BodyStructure::parse(const QByteArray &structure)
+{
+    if (structure.isEmpty()) {
+        return QVector<MimePart>();
+    }
+    // Als Antwort verpacken, damit Literale und Escapes wie beim Empfang gelten
+    ImapParser parser;
+    const QByteArray line = "* 0 FETCH (BODYSTRUCTURE (" + structure + "))\r\n";
+    parser.append(line.constData(), line.size());
+    if (parser.next() != ImapParser::Ready) {
+        return QVector<MimePart>();
+    }
+    const ImapResponse &response = parser.response();
+    return parse(response, response.child(2, 1));
+}
+
+int BodyStructure::textPart(const QVector<MimePart> &parts)
+{
+    int html = -1;
+    for (int i = 0; i < parts.size(); ++i) {
+        const MimePart &p = parts.at(i);
+        if (!p.isText() || p.disposition == "attachment" || !p.filename.isEmpty()) {
+            continue;
+        }
+        if (p.subtype == "plain") {
+            return i;
+        }
+        if (p.subtype == "html" && html < 0) {
+            html = i;
+        }
+    }
+    return html;
+}
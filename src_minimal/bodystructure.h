@@ -0,0 +1,45 @@
+/*
+ * mailadler - MIME Body Structure
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef BODYSTRUCTURE_H
+#define BODYSTRUCTURE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class ImapResponse;
+
+// Ein Blatt der MIME-Struktur (kein multipart/*)
+struct MimePart {
+    QByteArray section;     // IMAP-Abschnitt, z.B. "1.2"
+    QByteArray type;        // klein geschrieben, z.B. "text"
+    QByteArray subtype;     // z.B. "plain"
+    QByteArray charset;
+    QByteArray encoding;    // Content-Transfer-Encoding, klein geschrieben
+    QByteArray disposition; // "inline", "attachment" oder leer
+    QByteArray contentId;
+    QString filename;
+    quint32 size = 0;       // kodierte Größe in Bytes (Offsets für BODY[]<>)
+
+    bool isText() const { return type == "text"; }
+    bool isAttachment() const { return disposition == "attachment" || !filename.isEmpty() || !isText(); }
+};
+
+// Zerlegt eine BODYSTRUCTURE-Antwort (RFC 3501, 7.4.2) in ihre Blätter.
+// Gekapselte Nachrichten (message/rfc822) gelten als ein Anhang.
+class BodyStructure
+{
+public:
+    static QVector<MimePart> parse(const ImapResponse &response, int list);
+    // Gespeicherte Form aus EmailHeader::structure
+    static QVector<MimePart> parse(const QByteArray &structure);
+
+    // Anzuzeigender Text: text/plain vor text/html, -1 wenn keiner
+    static int textPart(const QVector<MimePart> &parts);
+};
+
+#endif // BODYSTRUCTURE_H
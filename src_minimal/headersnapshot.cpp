@@ -0,0 +1,514 @@
+/*
+ * mailadler - Header Snapshot
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "headersnapshot.h"
+#include "storecipher.h"
+#include <QDebug>
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+const char RecordMagic[4] = {'M', 'A', 'H', 'R'};
+const char IndexMagic[4] = {'M', 'A', 'H', 'I'};
+
+// Puffer beim Neuaufbau
+const int WriteChunk = 1 << 20;
+
+// Nonce und Tag einer versiegelten Zeichenkette
+const int SealOverhead = StoreCipher::NonceSize + StoreCipher::TagSize;
+
+} // namespace
+
+HeaderSnapshot::HeaderSnapshot(const QString &directory, int mailboxId, const StoreCipher *cipher)
+    : m_directory(directory)
+    , m_mailboxId(mailboxId)
+    , m_cipher(cipher)
+    , m_nonceCounter(0)
+    , m_open(false)
+    , m_dirty(false)
+    , m_generation(0)
+    , m_recordMap(nullptr)
+    , m_stringMap(nullptr)
+    , m_records(nullptr)
+    , m_strings(nullptr)
+    , m_recordCount(0)
+    , m_stringSize(0)
+{
+}
+
+HeaderSnapshot::~HeaderSnapshot()
+{
+    flush();
+    close();
+}
+
+QString HeaderSnapshot::filePath(const char *suffix) const
+{
+    return QString("%1/%2%3").arg(m_directory).arg(m_mailboxId).arg(QLatin1String(suffix));
+}
+
+bool HeaderSnapshot::openFiles(QIODevice::OpenMode mode)
+{
+    m_recordFile.setFileName(filePath(".rec"));
+    m_stringFile.setFileName(filePath(".str"));
+    if (!m_recordFile.open(mode) || !m_stringFile.open(mode)) {
+        m_recordFile.close();
+        m_stringFile.close();
+        return false;
+    }
+    return true;
+}
+
+bool HeaderSnapshot::open(quint64 generation)
+{
+    close();
+
+    QFile index(filePath(".idx"));
+    IndexHeader header;
+    if (!index.open(QIODevice::ReadOnly)
+        || index.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 || header.version != Version
+        || header.generation != generation || header.live > header.records
+        || index.size() != qint64(sizeof(header)) + 2 * qint64(header.live) * qint64(sizeof(quint32))) {
+        return false;
+    }
+
+    FileHeader fileHeader;
+    if (!openFiles(QIODevice::ReadWrite)
+        || m_recordFile.read(reinterpret_cast<char *>(&fileHeader), sizeof(fileHeader)) != qint64(sizeof(fileHeader))
+        || std::memcmp(fileHeader.magic, RecordMagic, sizeof(RecordMagic)) != 0 || fileHeader.version != Version
+        || fileHeader.recordSize != sizeof(Record) || fileHeader.flags != (m_cipher ? SealedStrings : 0)
+        || m_recordFile.size() != qint64(sizeof(FileHeader)) + qint64(header.records) * qint64(sizeof(Record))
+        || quint64(m_stringFile.size()) != header.strings) {
+        close();
+        return false;
+    }
+
+    m_recordCount = header.records;
+    m_stringSize = header.strings;
+    m_byUid.resize(header.live);
+    m_byDate.resize(header.live);
+    const qint64 bytes = qint64(header.live) * qint64(sizeof(quint32));
+    if (!map() || index.read(reinterpret_cast<char *>(m_byUid.data()), bytes) != bytes
+        || index.read(reinterpret_cast<char *>(m_byDate.data()), bytes) != bytes) {
+        close();
+        return false;
+    }
+    // Eine kaputte .idx darf nicht hinter die Abbildung zeigen
+    const auto outside = [this](quint32 i) { return i >= m_recordCount; };
+    if (std::any_of(m_byUid.cbegin(), m_byUid.cend(), outside)
+        || std::any_of(m_byDate.cbegin(), m_byDate.cend(), outside)) {
+        close();
+        return false;
+    }
+
+    m_generation = generation;
+    m_dirty = false;
+    m_open = true;
+    return true;
+}
+
+bool HeaderSnapshot::rebuild(const QSqlDatabase &db, quint64 generation)
+{
+    close();
+    // Ohne .idx gilt ein halb geschriebener Neuaufbau nach einem Absturz nicht
+    QFile::remove(filePath(".idx"));
+    QDir().mkpath(m_directory);
+    if (!openFiles(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qWarning() << "HeaderSnapshot: kann" << m_recordFile.fileName() << "nicht anlegen";
+        return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, RecordMagic, sizeof(RecordMagic));
+    fileHeader.version = Version;
+    fileHeader.recordSize = sizeof(Record);
+    fileHeader.flags = m_cipher ? SealedStrings : 0;
+    bool ok = m_recordFile.write(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader))
+              == qint64(sizeof(fileHeader));
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid, flags, date, sender, subject FROM messages WHERE mailbox_id = ? ORDER BY uid");
+    query.addBindValue(m_mailboxId);
+    if (!query.exec()) {
+        qWarning() << "HeaderSnapshot: Abfrage fehlgeschlagen:" << query.lastError().text();
+        close();
+        return false;
+    }
+
+    // Absender wiederholen sich, Betreffzeilen kaum
+    QHash<QString, QPair<quint32, quint16>> senders;
+    QByteArray records;
+    QByteArray strings;
+    const auto write = [&]() {
+        ok = ok && m_recordFile.write(records) == records.size() && m_stringFile.write(strings) == strings.size();
+        m_recordCount += quint32(records.size() / qsizetype(sizeof(Record)));
+        m_stringSize += quint64(strings.size());
+        records.clear();
+        strings.clear();
+    };
+    while (ok && query.next()) {
+        Record r;
+        r.uid = query.value(0).toUInt();
+        r.flags = query.value(1).toUInt() & ~Removed;
+        r.date = query.value(2).toLongLong();
+        r.reserved = 0;
+        const QString sender = query.value(3).toString();
+        auto it = senders.constFind(sender);
+        if (it == senders.constEnd()) {
+            QPair<quint32, quint16> entry;
+            addString(sender, &strings, &entry.first, &entry.second);
+            it = senders.insert(sender, entry);
+        }
+        r.senderOffset = it->first;
+        r.senderLength = it->second;
+        addString(query.value(4).toString(), &strings, &r.subjectOffset, &r.subjectLength);
+        records.append(reinterpret_cast<const char *>(&r), sizeof(r));
+        if (records.size() >= WriteChunk || strings.size() >= WriteChunk) {
+            write();
+        }
+    }
+    write();
+    if (!ok || !m_recordFile.flush() || !m_stringFile.flush() || !map()) {
+        qWarning() << "HeaderSnapshot: Neuaufbau fehlgeschlagen:" << m_recordFile.errorString();
+        close();
+        return false;
+    }
+
+    // Nach UID liegen die Datensätze schon
+    m_byUid.resize(qsizetype(m_recordCount));
+    std::iota(m_byUid.begin(), m_byUid.end(), 0u);
+    m_byDate = m_byUid;
+    std::sort(m_byDate.begin(), m_byDate.end(), [this](quint32 a, quint32 b) { return lessByDate(a, b); });
+
+    m_generation = generation;
+    m_dirty = true;
+    m_open = true;
+    flush();
+    qDebug() << "HeaderSnapshot: Ordner" << m_mailboxId << "mit" << m_recordCount << "Nachrichten aufgebaut";
+    return true;
+}
+
+void HeaderSnapshot::flush()
+{
+    if (!m_open || !m_dirty) {
+        return;
+    }
+    IndexHeader header;
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = Version;
+    header.generation = m_generation;
+    header.records = m_recordCount;
+    header.live = quint32(m_byUid.size());
+    header.strings = m_stringSize;
+
+    const qint64 bytes = qint64(m_byUid.size()) * qint64(sizeof(quint32));
+    QSaveFile file(filePath(".idx"));
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || file.write(reinterpret_cast<const char *>(m_byUid.constData()), bytes) != bytes
+        || file.write(reinterpret_cast<const char *>(m_byDate.constData()), bytes) != bytes || !file.commit()) {
+        qWarning() << "HeaderSnapshot: kann" << file.fileName() << "nicht schreiben:" << file.errorString();
+        return;
+    }
+    m_dirty = false;
+}
+
+void HeaderSnapshot::discard()
+{
+    close();
+    m_generation = 0;
+    m_dirty = false;
+    QFile::remove(filePath(".idx"));
+    QFile::remove(filePath(".rec"));
+    QFile::remove(filePath(".str"));
+}
+
+bool HeaderSnapshot::map()
+{
+    m_recordMap = m_recordFile.map(0, m_recordFile.size());
+    if (!m_recordMap) {
+        return false;
+    }
+    m_records = reinterpret_cast<Record *>(m_recordMap + sizeof(FileHeader));
+    // Leere Dateien lassen sich nicht abbilden
+    if (m_stringSize > 0) {
+        m_stringMap = m_stringFile.map(0, qint64(m_stringSize));
+        if (!m_stringMap) {
+            return false;
+        }
+        m_strings = reinterpret_cast<const char *>(m_stringMap);
+    }
+    return true;
+}
+
+void HeaderSnapshot::unmap()
+{
+    if (m_recordMap) {
+        m_recordFile.unmap(m_recordMap);
+    }
+    if (m_stringMap) {
+        m_stringFile.unmap(m_stringMap);
+    }
+    m_recordMap = nullptr;
+    m_stringMap = nullptr;
+    m_records = nullptr;
+    m_strings = nullptr;
+}
+
+void HeaderSnapshot::close()
+{
+    unmap();
+    m_recordFile.close();
+    m_stringFile.close();
+    m_open = false;
+    m_recordCount = 0;
+    m_stringSize = 0;
+    m_byUid.clear();
+    m_byDate.clear();
+}
+
+QString HeaderSnapshot::sender(quint32 index) const
+{
+    const Record &r = m_records[index];
+    return string(r.senderOffset, r.senderLength);
+}
+
+QString HeaderSnapshot::subject(quint32 index) const
+{
+    const Record &r = m_records[index];
+    return string(r.subjectOffset, r.subjectLength);
+}
+
+QString HeaderSnapshot::string(quint32 offset, quint16 length) const
+{
+    if (!m_cipher) {
+        return length ? QString::fromUtf8(m_strings + offset, length) : QString();
+    }
+    if (length <= SealOverhead) {
+        return QString();
+    }
+    const char *sealed = m_strings + offset;
+    QVarLengthArray<char, 256> plain(length - SealOverhead);
+    // Beschädigt bleibt die Zelle leer, die Liste soll trotzdem stehen
+    if (!m_cipher->open(StoreCipher::Snapshots, reinterpret_cast<const uchar *>(sealed),
+                        QByteArrayView(reinterpret_cast<const char *>(&m_mailboxId), sizeof(m_mailboxId)),
+                        QByteArrayView(sealed + StoreCipher::NonceSize, length - StoreCipher::NonceSize),
+                        plain.data())) {
+        return QString();
+    }
+    return QString::fromUtf8(plain.constData(), plain.size());
+}
+
+qint64 HeaderSnapshot::find(quint32 uid) const
+{
+    auto it = std::lower_bound(m_byUid.cbegin(), m_byUid.cend(), uid,
+                               [this](quint32 i, quint32 value) { return m_records[i].uid < value; });
+    if (it != m_byUid.cend() && m_records[*it].uid == uid) {
+        return *it;
+    }
+    return -1;
+}
+
+void HeaderSnapshot::store(const QList<EmailHeader> &headers, quint64 generation)
+{
+    if (!m_open) {
+        return;
+    }
+    QVector<Record> fresh;
+    QByteArray strings;
+    for (const EmailHeader &h : headers) {
+        const qint64 existing = find(h.uid);
+        if (existing >= 0) {
+            m_records[existing].flags = h.flags & ~Removed;
+            continue;
+        }
+        Record r;
+        r.uid = h.uid;
+        r.flags = h.flags & ~Removed;
+        r.date = h.date;
+        r.reserved = 0;
+        addString(h.from, &strings, &r.senderOffset, &r.senderLength);
+        addString(h.subject, &strings, &r.subjectOffset, &r.subjectLength);
+        fresh.append(r);
+    }
+
+    if (!fresh.isEmpty()) {
+        // Doppelte UIDs im selben Aufruf: die letzte gilt, wie in der Datenbank
+        std::stable_sort(fresh.begin(), fresh.end(), [](const Record &a, const Record &b) { return a.uid < b.uid; });
+        QVector<Record> unique;
+        unique.reserve(fresh.size());
+        for (const Record &r : fresh) {
+            if (!unique.isEmpty() && unique.last().uid == r.uid) {
+                unique.last() = r;
+            } else {
+                unique.append(r);
+            }
+        }
+
+        const quint32 first = m_recordCount;
+        const QByteArray records(reinterpret_cast<const char *>(unique.constData()),
+                                 unique.size() * qsizetype(sizeof(Record)));
+        if (!append(records, strings)) {
+            // Passt nicht mehr zur Datenbank, beim nächsten Öffnen neu aufbauen
+            m_generation = 0;
+            m_dirty = true;
+            return;
+        }
+        QVector<quint32> added(unique.size());
+        std::iota(added.begin(), added.end(), first);
+        insertSorted(&m_byUid, added, false);
+        insertSorted(&m_byDate, added, true);
+    }
+    m_generation = generation;
+    m_dirty = true;
+}
+
+void HeaderSnapshot::setFlags(const QVector<ImapFlagUpdate> &updates, quint64 generation)
+{
+    if (!m_open) {
+        return;
+    }
+    for (const ImapFlagUpdate &u : updates) {
+        const qint64 i = find(u.uid);
+        if (i >= 0) {
+            m_records[i].flags = u.flags & ~Removed;
+        }
+    }
+    m_generation = generation;
+    m_dirty = true;
+}
+
+void HeaderSnapshot::remove(const QVector<UidRange> &ranges, quint64 generation)
+{
+    if (!m_open) {
+        return;
+    }
+    bool removed = false;
+    for (const UidRange &r : ranges) {
+        auto begin = std::lower_bound(m_byUid.begin(), m_byUid.end(), r.first,
+                                      [this](quint32 i, quint32 value) { return m_records[i].uid < value; });
+        auto end = std::upper_bound(begin, m_byUid.end(), r.last,
+                                    [this](quint32 value, quint32 i) { return value < m_records[i].uid; });
+        if (begin == end) {
+            continue;
+        }
+        for (auto it = begin; it != end; ++it) {
+            m_records[*it].flags |= Removed;
+        }
+        m_byUid.erase(begin, end);
+        removed = true;
+    }
+    if (removed) {
+        m_byDate.erase(std::remove_if(m_byDate.begin(), m_byDate.end(),
+                                      [this](quint32 i) { return m_records[i].flags & Removed; }),
+                       m_byDate.end());
+    }
+    m_generation = generation;
+    m_dirty = true;
+}
+
+bool HeaderSnapshot::append(const QByteArray &records, const QByteArray &strings)
+{
+    // Die alte Abbildung bleibt gültig, bis alles geschrieben ist
+    const qint64 recordEnd = qint64(sizeof(FileHeader)) + qint64(m_recordCount) * qint64(sizeof(Record));
+    const bool ok = m_stringFile.seek(qint64(m_stringSize)) && m_stringFile.write(strings) == strings.size()
+                    && m_stringFile.flush() && m_recordFile.seek(recordEnd)
+                    && m_recordFile.write(records) == records.size() && m_recordFile.flush();
+    if (!ok) {
+        qWarning() << "HeaderSnapshot: Anhängen fehlgeschlagen:" << m_recordFile.errorString()
+                   << m_stringFile.errorString();
+        return false;
+    }
+
+    unmap();
+    m_recordCount += quint32(records.size() / qsizetype(sizeof(Record)));
+    m_stringSize += quint64(strings.size());
+    if (!map()) {
+        qWarning() << "HeaderSnapshot: kann" << m_recordFile.fileName() << "nicht abbilden";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void HeaderSnapshot::addString(const QString &text, QByteArray *strings, quint32 *offset, quint16 *length)
+{
+    const QByteArray bytes = text.toUtf8();
+    const int overhead = m_cipher ? SealOverhead : 0;
+    const qsizetype plain = qMin<qsizetype>(bytes.size(), 0xffff - overhead);
+    const quint16 size = quint16(plain > 0 ? plain + overhead : 0);
+    const quint64 at = m_stringSize + quint64(strings->size());
+    // Offsets sind 32 Bit breit; was darüber hinausgeht, bleibt leer
+    if (size == 0 || at + size > 0xffffffffu) {
+        *offset = 0;
+        *length = 0;
+        return;
+    }
+    if (m_cipher) {
+        const qsizetype start = strings->size();
+        strings->resize(start + size);
+        uchar *nonce = reinterpret_cast<uchar *>(strings->data() + start);
+        // Zufälliger Präfix je Abbild und Zähler, RAND_bytes je Zeile wäre beim Neuaufbau zu teuer
+        if (m_nonceCounter == 0 && !StoreCipher::randomBytes(m_noncePrefix, int(sizeof(m_noncePrefix)))) {
+            strings->resize(start);
+            *offset = 0;
+            *length = 0;
+            return;
+        }
+        std::memcpy(nonce, m_noncePrefix, sizeof(m_noncePrefix));
+        std::memcpy(nonce + sizeof(m_noncePrefix), &m_nonceCounter, sizeof(m_nonceCounter));
+        ++m_nonceCounter;
+        if (!m_cipher->seal(StoreCipher::Snapshots, nonce,
+                               QByteArrayView(reinterpret_cast<const char *>(&m_mailboxId), sizeof(m_mailboxId)),
+                               QByteArrayView(bytes.constData(), plain),
+                               strings->data() + start + StoreCipher::NonceSize)) {
+            strings->resize(start);
+            *offset = 0;
+            *length = 0;
+            return;
+        }
+    } else {
+        strings->append(bytes.constData(), size);
+    }
+    *offset = quint32(at);
+    *length = size;
+}
+
+void HeaderSnapshot::insertSorted(QVector<quint32> *index, const QVector<quint32> &added, bool byDate) const
+{
+    const auto less = [this, byDate](quint32 a, quint32 b) {
+        return byDate ? lessByDate(a, b) : m_records[a].uid < m_records[b].uid;
+    };
+    QVector<quint32> sorted = added;
+    std::sort(sorted.begin(), sorted.end(), less);
+
+    // Neue Nachrichten sind fast immer die jüngsten und kommen nur ans Ende
+    const qsizetype middle = index->size();
+    index->append(sorted);
+    if (middle > 0 && less(sorted.first(), index->at(middle - 1))) {
+        std::inplace_merge(index->begin(), index->begin() + middle, index->end(), less);
+    }
+}
+
+bool HeaderSnapshot::lessByDate(quint32 a, quint32 b) const
+{
+    const Record &x = m_records[a];
+    const Record &y = m_records[b];
+    return x.date != y.date ? x.date < y.date : x.uid < y.uid;
+}
@@ -0,0 +1,144 @@
+/*
+ * mailadler - Header Snapshot
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef HEADERSNAPSHOT_H
+#define HEADERSNAPSHOT_H
+
+#include <QFile>
+#include <QList>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+#include "imapconnection.h"
+
+class StoreCipher;
+
+// Kopfzeilen eines Ordners als Speicherabbild, damit die Nachrichtenliste
+// ohne SQL-Abfrage und ohne Zeilen-Objekte sofort steht.
+//
+// Drei Dateien je Ordner:
+//   <id>.rec  Kopf und Datensätze fester Breite, wird nur angehängt
+//   <id>.str  UTF-8-Zeichenketten für Absender und Betreff, wird nur angehängt
+//   <id>.idx  Datensatznummern aufsteigend nach UID und nach (Datum, UID),
+//             dazu der Stand (MessageStore::generation()) aller drei Dateien
+// .rec und .str werden per mmap gelesen. Geänderte Flags werden im Datensatz
+// überschrieben, gelöschte Nachrichten nur markiert, erst rebuild() räumt auf.
+// .idx entsteht bei flush() neu; passt sie nach einem Absturz nicht mehr zu
+// den anderen Dateien oder zur Datenbank, baut MessageStore alles neu auf.
+// Zahlen in der Byte-Reihenfolge des Rechners, die Dateien sind nur ein Cache.
+//
+// Mit StoreCipher ist jede Zeichenkette einzeln versiegelt (Nonce, AES-GCM,
+// Tag; die mailboxId als AAD), damit sender() und subject() ohne Seiten- oder
+// Dateientschlüsselung direkt aus der Abbildung lesen. UID, Datum und Flags
+// bleiben lesbar wie in den Dateinamen des BodyCache.
+class HeaderSnapshot
+{
+public:
+    struct Record {
+        quint32 uid;
+        quint32 flags; // ImapFlag, dazu Removed
+        qint64 date;
+        quint32 senderOffset;
+        quint32 subjectOffset;
+        quint16 senderLength;
+        quint16 subjectLength;
+        quint32 reserved;
+    };
+    static_assert(sizeof(Record) == 32, "Datensätze haben feste Breite");
+
+    // Gelöscht, belegt aber bis zum nächsten rebuild() seinen Platz
+    static constexpr quint32 Removed = 0x80000000u;
+    static constexpr quint32 Version = 1;
+    // FileHeader::flags
+    static constexpr quint32 SealedStrings = 0x1;
+
+    // cipher muss entsperrt sein und das Abbild überleben
+    HeaderSnapshot(const QString &directory, int mailboxId, const StoreCipher *cipher = nullptr);
+    ~HeaderSnapshot();
+
+    // Vorhandene Dateien mit genau diesem Stand abbilden; false, wenn sie
+    // fehlen, veraltet sind oder nicht zusammenpassen
+    bool open(quint64 generation);
+    // Aus der Tabelle messages neu schreiben, danach wie open()
+    bool rebuild(const QSqlDatabase &db, quint64 generation);
+    // .idx schreiben, wenn sich seit dem letzten Mal etwas geändert hat
+    void flush();
+    // Dateien löschen, z.B. bei neuer UIDVALIDITY
+    void discard();
+
+    int mailboxId() const { return m_mailboxId; }
+    bool isOpen() const { return m_open; }
+    quint64 generation() const { return m_generation; }
+    int recordCount() const { return int(m_recordCount); }
+    int liveCount() const { return int(m_byUid.size()); }
+
+    const Record &record(quint32 index) const { return m_records[index]; }
+    QString sender(quint32 index) const;
+    QString subject(quint32 index) const;
+    // Datensatznummern der vorhandenen Nachrichten
+    const QVector<quint32> &byUid() const { return m_byUid; }
+    const QVector<quint32> &byDate() const { return m_byDate; }
+    // Datensatznummer oder -1
+    qint64 find(quint32 uid) const;
+
+    // Jeweils schon in der Datenbank, generation ist der neue Stand
+    void store(const QList<EmailHeader> &headers, quint64 generation);
+    void setFlags(const QVector<ImapFlagUpdate> &updates, quint64 generation);
+    void remove(const QVector<UidRange> &ranges, quint64 generation);
+
+private:
+    struct FileHeader {
+        char magic[4];
+        quint32 version;
+        quint32 recordSize;
+        quint32 flags;
+    };
+    struct IndexHeader {
+        char magic[4];
+        quint32 version;
+        quint64 generation;
+        quint32 records;
+        quint32 live;
+        quint64 strings;
+    };
+
+    QString filePath(const char *suffix) const;
+    bool openFiles(QIODevice::OpenMode mode);
+    bool map();
+    void unmap();
+    void close();
+    // Hängt Datensätze und Zeichenketten an und bildet neu ab
+    bool append(const QByteArray &records, const QByteArray &strings);
+    // Zeichenkette in den Puffer; der Offset gilt für .str, an die der Puffer angehängt wird
+    void addString(const QString &text, QByteArray *strings, quint32 *offset, quint16 *length);
+    QString string(quint32 offset, quint16 length) const;
+    void insertSorted(QVector<quint32> *index, const QVector<quint32> &added, bool byDate) const;
+    bool lessByDate(quint32 a, quint32 b) const;
+
+    QString m_directory;
+    int m_mailboxId;
+    const StoreCipher *m_cipher;
+    uchar m_noncePrefix[8];
+    quint32 m_nonceCounter; // läuft über: neuer Präfix
+    bool m_open;
+    bool m_dirty;
+    quint64 m_generation;
+
+    QFile m_recordFile;
+    QFile m_stringFile;
+    uchar *m_recordMap;
+    uchar *m_stringMap;
+    Record *m_records;
+    const char *m_strings;
+    quint32 m_recordCount;
+    quint64 m_stringSize;
+
+    QVector<quint32> m_byUid;
+    QVector<quint32> m_byDate;
+};
+
+#endif // HEADERSNAPSHOT_H
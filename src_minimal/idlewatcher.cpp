@@ -0,0 +1,351 @@
+/*
+ * mailadler - Push Notifications (IDLE / NOTIFY)
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "idlewatcher.h"
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include <QDebug>
+
+#include <algorithm>
+
+IdleWatcher::IdleWatcher(MessageStore *store, QObject *parent)
+    : QObject(parent)
+    , m_pool(new ImapConnectionPool(this))
+    , m_store(store)
+    , m_notify(false)
+{
+    connect(m_pool, &ImapConnectionPool::sessionReady, this, &IdleWatcher::onSessionReady);
+    connect(m_pool, &ImapConnectionPool::sessionLost, this, &IdleWatcher::onSessionLost);
+}
+
+void IdleWatcher::watch(const QStringList &folders)
+{
+    stop();
+    m_folders = folders;
+    for (const QString &folder : folders) {
+        Watch w;
+        w.folder = folder;
+        w.mailboxId = m_store->mailboxId(m_account, folder);
+        w.renew = new QTimer(this);
+        w.renew->setSingleShot(true);
+        w.renew->setInterval(RenewInterval);
+        connect(w.renew, &QTimer::timeout, this, [this, folder]() {
+            auto it = m_watches.find(folder);
+            if (it != m_watches.end()) {
+                renew(*it);
+            }
+        });
+        m_watches.insert(folder, w);
+    }
+
+    // Erst eine Sitzung: mit NOTIFY reicht sie für alle Ordner
+    m_pool->setMaxConnections(int(folders.size()));
+    m_pool->open(1);
+}
+
+void IdleWatcher::stop()
+{
+    for (const Watch &w : std::as_const(m_watches)) {
+        delete w.renew;
+    }
+    m_watches.clear();
+    m_folders.clear();
+    m_notify = false;
+    m_pool->close();
+}
+
+void IdleWatcher::onSessionReady(ImapConnection *session)
+{
+    Q_UNUSED(session)
+    for (const QString &folder : std::as_const(m_folders)) {
+        Watch &w = m_watches[folder];
+        if (w.session) {
+            continue;
+        }
+        ImapConnection *s = m_pool->acquire();
+        if (!s) {
+            return;
+        }
+        if (m_pool->sessionCount() == 1) {
+            m_notify = s->hasCapability("NOTIFY");
+            if (!m_notify) {
+                m_pool->open(int(m_folders.size()));
+            }
+        }
+        attach(s, w);
+        if (m_notify) {
+            // Alle übrigen Ordner laufen über dieselbe Sitzung
+            for (auto it = m_watches.begin(); it != m_watches.end(); ++it) {
+                if (!it->session) {
+                    it->session = s;
+                    it->step = Remote;
+                }
+            }
+        }
+        return;
+    }
+}
+
+void IdleWatcher::onSessionLost(ImapConnection *session)
+{
+    bool lost = false;
+    for (auto it = m_watches.begin(); it != m_watches.end(); ++it) {
+        if (it->session == session) {
+            it->session = nullptr;
+            it->step = Waiting;
+            it->uids.clear();
+            it->renew->stop();
+            lost = true;
+        }
+    }
+    if (!lost) {
+        return;
+    }
+    qWarning() << "IdleWatcher: Sitzung verloren, neuer Versuch in 30 s";
+    QTimer::singleShot(30000, this, [this]() {
+        if (!m_watches.isEmpty()) {
+            m_pool->open(m_notify ? 1 : int(m_folders.size()));
+        }
+    });
+}
+
+void IdleWatcher::attach(ImapConnection *session, Watch &watch)
+{
+    const QString folder = watch.folder;
+    watch.session = session;
+    watch.uids.clear();
+    watch.verified = false;
+
+    // Die Lambdas suchen den Eintrag jedes Mal neu, Referenzen in den
+    // QHash werden beim Einfügen ungültig
+    auto withWatch = [this, folder](auto &&fn) {
+        auto it = m_watches.find(folder);
+        if (it != m_watches.end()) {
+            fn(*it);
+        }
+    };
+
+    connect(session, &ImapConnection::commandFinished, this, [=](const QString &command, bool ok) {
+        withWatch([&](Watch &w) { onCommandFinished(w, command, ok); });
+    });
+    connect(session, &ImapConnection::headersReceived, this, [=](const QList<EmailHeader> &headers) {
+        withWatch([&](Watch &w) { onHeaders(w, headers); });
+    });
+    connect(session, &ImapConnection::flagsReceived, this, [=](const QVector<ImapFlagUpdate> &updates) {
+        withWatch([&](Watch &w) {
+            m_store->updateFlags(w.mailboxId, updates);
+            emit flagsChanged(w.mailboxId, updates);
+        });
+    });
+    connect(session, &ImapConnection::vanished, this, [=](const QVector<UidRange> &ranges) {
+        withWatch([&](Watch &w) { removeUids(w, ranges); });
+    });
+    connect(session, &ImapConnection::uidsReceived, this, [=](const QVector<UidRange> &ranges) {
+        withWatch([&](Watch &w) { w.serverUids = ranges; });
+    });
+    connect(session, &ImapConnection::existsReceived, this, [=](quint32 count) {
+        withWatch([&](Watch &w) {
+            // Mit NOTIFY kommen neue Nachrichten gleich als FETCH mit ENVELOPE
+            if (w.step == Idle && !m_notify && count > quint32(w.uids.size())) {
+                fetchNew(w);
+            }
+        });
+    });
+    connect(session, &ImapConnection::expungeReceived, this, [=](quint32 seq) {
+        withWatch([&](Watch &w) {
+            if (seq < 1 || seq > quint32(w.uids.size())) {
+                return;
+            }
+            const quint32 uid = w.uids.takeAt(int(seq) - 1);
+            const QVector<UidRange> removed{{uid, uid}};
+            m_store->removeUids(w.mailboxId, removed);
+            emit messagesRemoved(w.mailboxId, removed);
+        });
+    });
+    connect(session, &ImapConnection::sequenceFlagsReceived, this, [=](quint32 seq, quint32 flags) {
+        withWatch([&](Watch &w) {
+            if (seq < 1 || seq > quint32(w.uids.size())) {
+                return;
+            }
+            const QVector<ImapFlagUpdate> updates{{w.uids.at(int(seq) - 1), flags, 0}};
+            m_store->updateFlags(w.mailboxId, updates);
+            emit flagsChanged(w.mailboxId, updates);
+        });
+    });
+    connect(session, &ImapConnection::statusReceived, this, [=](const QString &changed, const ImapFolderState &) {
+        if (changed != folder && m_watches.contains(changed)) {
+            emit folderChanged(changed);
+        }
+    });
+
+    watch.step = Select;
+    session->selectFolder(folder);
+}
+
+void IdleWatcher::enterIdle(Watch &watch)
+{
+    if (m_notify) {
+        watch.step = Notify;
+        watch.session->notify(notifyEvents());
+        return;
+    }
+    watch.step = Idle;
+    watch.session->idle();
+    watch.renew->start();
+}
+
+void IdleWatcher::fetchNew(Watch &watch)
+{
+    watch.step = FetchNew;
+    watch.session->fetchNewHeaders(watch.uids.isEmpty() ? 1 : watch.uids.last() + 1);
+}
+
+void IdleWatcher::renew(Watch &watch)
+{
+    if (watch.step != Idle) {
+        return;
+    }
+    if (m_notify) {
+        // Kein IDLE nötig, nur die Verbindung am Leben halten
+        watch.session->noop();
+        watch.renew->start();
+    } else {
+        // Abschluss des IDLE startet es in onCommandFinished() neu
+        watch.session->stopIdle();
+    }
+}
+
+void IdleWatcher::onCommandFinished(Watch &watch, const QString &command, bool ok)
+{
+    switch (watch.step) {
+    case Select:
+        if (command != QLatin1String("SELECT")) {
+            break;
+        }
+        if (!ok) {
+            qWarning() << "IdleWatcher: Ordner" << watch.folder << "kann nicht ausgewählt werden";
+            watch.step = Waiting;
+            break;
+        }
+        watch.step = Search;
+        watch.serverUids.clear();
+        watch.session->searchAllUids();
+        break;
+    case Search: {
+        if (command != QLatin1String("SEARCH")) {
+            break;
+        }
+        // Sequenznummer n gehört zur n-kleinsten UID
+        watch.uids.clear();
+        for (const UidRange &r : std::as_const(watch.serverUids)) {
+            for (quint64 uid = r.first; uid <= r.last; ++uid) {
+                watch.uids.append(quint32(uid));
+            }
+        }
+        watch.verified = true;
+
+        const QVector<UidRange> removed = m_store->removeUidsNotIn(watch.mailboxId, watch.serverUids);
+        if (!removed.isEmpty()) {
+            emit messagesRemoved(watch.mailboxId, removed);
+        }
+        const QVector<quint32> stored = m_store->uids(watch.mailboxId);
+        const quint32 maxStored = stored.isEmpty() ? 0 : stored.last();
+        if (!watch.uids.isEmpty() && watch.uids.last() > maxStored) {
+            watch.step = FetchNew;
+            watch.session->fetchNewHeaders(maxStored + 1);
+        } else {
+            enterIdle(watch);
+        }
+        break;
+    }
+    case FetchNew:
+        if (command != QLatin1String("FETCH")) {
+            break;
+        }
+        if (!watch.verified && watch.session->folderState().exists != quint32(watch.uids.size())) {
+            // Zuordnung passt nicht mehr (z.B. EXPUNGE verpasst): neu aufbauen
+            qDebug() << "IdleWatcher: Sequenznummern von" << watch.folder << "neu bestimmen";
+            watch.step = Search;
+            watch.serverUids.clear();
+            watch.session->searchAllUids();
+            break;
+        }
+        watch.verified = false;
+        enterIdle(watch);
+        break;
+    case Notify:
+        if (command != QLatin1String("NOTIFY")) {
+            break;
+        }
+        if (ok) {
+            watch.step = Idle;
+            watch.renew->start();
+            break;
+        }
+        // NOTIFY abgelehnt: je Ordner eine Sitzung mit IDLE
+        qWarning() << "IdleWatcher: NOTIFY abgelehnt, verwende IDLE";
+        m_notify = false;
+        for (auto it = m_watches.begin(); it != m_watches.end(); ++it) {
+            if (it->step == Remote) {
+                it->session = nullptr;
+                it->step = Waiting;
+            }
+        }
+        m_pool->open(int(m_folders.size()));
+        enterIdle(watch);
+        break;
+    case Idle:
+        // IDLE beendet (Erneuerung oder ein dazwischen gesendeter Befehl)
+        if (command == QLatin1String("IDLE") && !m_notify) {
+            if (ok) {
+                enterIdle(watch);
+            } else {
+                watch.step = Waiting;
+            }
+        }
+        break;
+    case Waiting:
+    case Remote:
+        break;
+    }
+}
+
+void IdleWatcher::onHeaders(Watch &watch, const QList<EmailHeader> &headers)
+{
+    m_store->storeHeaders(watch.mailboxId, headers);
+    for (const EmailHeader &h : headers) {
+        auto it = std::lower_bound(watch.uids.begin(), watch.uids.end(), h.uid);
+        if (it == watch.uids.end() || *it != h.uid) {
+            watch.uids.insert(it, h.uid);
+        }
+    }
+    emit messagesAdded(watch.mailboxId, headers);
+}
+
+void IdleWatcher::removeUids(Watch &watch, const QVector<UidRange> &ranges)
+{
+    for (const UidRange &r : ranges) {
+        auto begin = std::lower_bound(watch.uids.begin(), watch.uids.end(), r.first);
+        auto end = std::upper_bound(begin, watch.uids.end(), r.last);
+        watch.uids.erase(begin, end);
+    }
+    m_store->removeUids(watch.mailboxId, ranges);
+    emit messagesRemoved(watch.mailboxId, ranges);
+}
+
+QByteArray IdleWatcher::notifyEvents() const
+{
+    // RFC 5465: für den ausgewählten Ordner neue Nachrichten gleich mit Kopfdaten
+    QByteArray events = "(selected (MessageNew (UID FLAGS ENVELOPE RFC822.SIZE) MessageExpunge FlagChange))";
+    QByteArray others;
+    for (int i = 1; i < m_folders.size(); ++i) {
+        others += (others.isEmpty() ? "" : " ") + ImapConnection::quoted(m_folders.at(i));
+    }
+    if (!others.isEmpty()) {
+        events += " (mailboxes (" + others + ") (MessageNew MessageExpunge FlagChange))";
+    }
+    return events;
+}
@@ -0,0 +1,94 @@
+/*
+ * mailadler - Push Notifications (IDLE / NOTIFY)
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IDLEWATCHER_H
+#define IDLEWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include "imapconnection.h"
+
+class ImapConnectionPool;
+class MessageStore;
+
+// Hält für beobachtete Ordner eigene Sitzungen offen und übernimmt
+// Server-Änderungen ohne Abfrage.
+//
+// Bietet der Server NOTIFY (RFC 5465), genügt eine Sitzung: der erste Ordner
+// wird ausgewählt, für die übrigen kommen STATUS-Meldungen. Sonst wartet je
+// Ordner eine Sitzung im IDLE (RFC 2177), das vor Ablauf der 29 Minuten
+// erneuert wird. EXISTS, EXPUNGE und FETCH werden einzeln in den
+// MessageStore übernommen; dafür wird die Zuordnung Sequenznummer -> UID
+// mitgeführt.
+class IdleWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    IdleWatcher(MessageStore *store, QObject *parent = nullptr);
+
+    // Eigene Sitzungen, Server und Zugangsdaten hier setzen
+    ImapConnectionPool *pool() const { return m_pool; }
+    void setAccount(const QString &account) { m_account = account; }
+
+    void watch(const QStringList &folders);
+    void stop();
+    bool isWatching(const QString &folder) const { return m_watches.contains(folder); }
+
+signals:
+    void messagesAdded(int mailboxId, const QList<EmailHeader> &headers);
+    void flagsChanged(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void messagesRemoved(int mailboxId, const QVector<UidRange> &ranges);
+    // Nicht ausgewählter Ordner hat sich geändert (nur mit NOTIFY)
+    void folderChanged(const QString &folder);
+
+private slots:
+    void onSessionReady(ImapConnection *session);
+    void onSessionLost(ImapConnection *session);
+
+private:
+    // Remote: Ordner wird per NOTIFY über die Sitzung eines anderen beobachtet
+    enum Step { Waiting, Select, Search, FetchNew, Notify, Idle, Remote };
+
+    struct Watch {
+        QString folder;
+        int mailboxId = -1;
+        ImapConnection *session = nullptr;
+        Step step = Waiting;
+        // Index = Sequenznummer - 1
+        QVector<quint32> uids;
+        QVector<UidRange> serverUids;
+        // Neue Nachrichten nach UID SEARCH: Zuordnung ist bereits exakt
+        bool verified = false;
+        QTimer *renew = nullptr;
+    };
+
+    void attach(ImapConnection *session, Watch &watch);
+    void enterIdle(Watch &watch);
+    void fetchNew(Watch &watch);
+    void renew(Watch &watch);
+    void onCommandFinished(Watch &watch, const QString &command, bool ok);
+    void onHeaders(Watch &watch, const QList<EmailHeader> &headers);
+    void removeUids(Watch &watch, const QVector<UidRange> &ranges);
+    QByteArray notifyEvents() const;
+
+    // RFC 2177: Server dürfen nach 30 Minuten Inaktivität trennen
+    static const int RenewInterval = 25 * 60 * 1000;
+
+    ImapConnectionPool *m_pool;
+    MessageStore *m_store;
+    QString m_account;
+    QStringList m_folders;
+    QHash<QString, Watch> m_watches;
+    // NOTIFY: eine Sitzung für alle Ordner
+    bool m_notify;
+};
+
+#endif // IDLEWATCHER_H
@@ -0,0 +1,88 @@
+/*
+ * mailadler - IMAP COMPRESS=DEFLATE
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapcompression.h"
+#include "imapparser.h"
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+
+// Entpackt wird in Schritten dieser Größe in den Parser-Puffer
+const qsizetype InflateChunk = 64 * 1024;
+
+} // namespace
+
+ImapCompression::ImapCompression()
+    : m_valid(false)
+{
+    std::memset(&m_inflate, 0, sizeof(m_inflate));
+    std::memset(&m_deflate, 0, sizeof(m_deflate));
+
+    // Negative windowBits: rohes Deflate, wie RFC 4978 verlangt
+    const bool inflateOk = inflateInit2(&m_inflate, -15) == Z_OK;
+    const bool deflateOk = deflateInit2(&m_deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                                        Z_DEFAULT_STRATEGY) == Z_OK;
+    m_valid = inflateOk && deflateOk;
+    if (!m_valid) {
+        qWarning() << "IMAP: zlib konnte nicht initialisiert werden";
+    }
+}
+
+ImapCompression::~ImapCompression()
+{
+    inflateEnd(&m_inflate);
+    deflateEnd(&m_deflate);
+}
+
+bool ImapCompression::inflate(const char *data, qsizetype size, ImapParser *parser)
+{
+    m_inflate.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_inflate.avail_in = uInt(size);
+
+    // Weiter, solange Eingabe übrig ist oder der Ausgabepuffer voll wurde
+    do {
+        char *out = parser->reserve(InflateChunk);
+        m_inflate.next_out = reinterpret_cast<Bytef *>(out);
+        m_inflate.avail_out = uInt(InflateChunk);
+
+        const int result = ::inflate(&m_inflate, Z_SYNC_FLUSH);
+        parser->commit(InflateChunk - qsizetype(m_inflate.avail_out));
+        if (result == Z_BUF_ERROR) {
+            // Kein Fortschritt möglich, d.h. alles verarbeitet
+            break;
+        }
+        if (result != Z_OK && result != Z_STREAM_END) {
+            qWarning() << "IMAP: Deflate-Strom beschädigt:" << (m_inflate.msg ? m_inflate.msg : "");
+            return false;
+        }
+    } while (m_inflate.avail_in > 0 || m_inflate.avail_out == 0);
+
+    return true;
+}
+
+QByteArray ImapCompression::deflate(const QByteArray &data)
+{
+    QByteArray out;
+    out.resize(qsizetype(deflateBound(&m_deflate, uLong(data.size()))) + 16);
+    m_deflate.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    m_deflate.avail_in = uInt(data.size());
+
+    qsizetype written = 0;
+    do {
+        if (written == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        m_deflate.next_out = reinterpret_cast<Bytef *>(out.data() + written);
+        m_deflate.avail_out = uInt(out.size() - written);
+        ::deflate(&m_deflate, Z_SYNC_FLUSH);
+        written = out.size() - qsizetype(m_deflate.avail_out);
+    } while (m_deflate.avail_out == 0);
+
+    out.truncate(written);
+    return out;
+}
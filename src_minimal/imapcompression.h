@@ -0,0 +1,40 @@
+/*
+ * mailadler - IMAP COMPRESS=DEFLATE
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPCOMPRESSION_H
+#define IMAPCOMPRESSION_H
+
+#include <QByteArray>
+
+#include <zlib.h>
+
+class ImapParser;
+
+// Deflate-Strom nach RFC 4978 (rohes Deflate ohne zlib-Kopf) für beide
+// Richtungen einer Verbindung. Eingehende Daten werden direkt in den
+// Puffer des Parsers entpackt.
+class ImapCompression
+{
+public:
+    ImapCompression();
+    ~ImapCompression();
+
+    bool isValid() const { return m_valid; }
+
+    // Liefert false bei beschädigtem Datenstrom
+    bool inflate(const char *data, qsizetype size, ImapParser *parser);
+    // Jeder Aufruf endet mit Z_SYNC_FLUSH, damit der Server den Befehl sofort sieht
+    QByteArray deflate(const QByteArray &data);
+
+private:
+    Q_DISABLE_COPY(ImapCompression)
+
+    z_stream m_inflate;
+    z_stream m_deflate;
+    bool m_valid;
+};
+
+#endif // IMAPCOMPRESSION_H
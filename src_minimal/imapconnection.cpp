@@ -5,19 +5,181 @@
  */
 
 #include "imapconnection.h"
+#include "imapcompression.h"
+#include "mimedecoder.h"
+#include <QDateTime>
 #include <QDebug>
-#include <QRegularExpression>
+
+#include <memory>
+#include <utility>
+
+namespace {
+
+// Nur den Anfang loggen, Literale können Megabytes groß sein
+QByteArray logExcerpt(QByteArrayView raw)
+{
+    return QByteArray(raw.data(), qMin(raw.size(), qsizetype(100))).trimmed();
+}
+
+quint64 parseNumber(QByteArrayView v)
+{
+    quint64 value = 0;
+    for (char c : v) {
+        if (c < '0' || c > '9') {
+            break;
+        }
+        value = value * 10 + quint64(c - '0');
+    }
+    return value;
+}
+
+quint32 flagBit(const ImapResponse &response, int i)
+{
+    if (response.is(i, "\\Seen")) {
+        return FlagSeen;
+    } else if (response.is(i, "\\Answered")) {
+        return FlagAnswered;
+    } else if (response.is(i, "\\Flagged")) {
+        return FlagFlagged;
+    } else if (response.is(i, "\\Deleted")) {
+        return FlagDeleted;
+    } else if (response.is(i, "\\Draft")) {
+        return FlagDraft;
+    } else if (response.is(i, "$Forwarded")) {
+        return FlagForwarded;
+    } else if (response.is(i, "$Junk")) {
+        return FlagJunk;
+    }
+    return 0;
+}
+
+// RFC 2822 Datum aus dem ENVELOPE, z.B. "Mon, 3 Feb 2026 10:15:00 +0100 (CET)"
+qint64 parseEnvelopeDate(const QByteArray &date)
+{
+    QByteArray value = date.trimmed();
+    const int comment = value.indexOf(" (");
+    if (comment > 0) {
+        value.truncate(comment);
+    }
+    const QDateTime dt = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+    return dt.isValid() ? dt.toSecsSinceEpoch() : 0;
+}
+
+// Alle "<...>" aus einer Kopfzeile, mit einem Leerzeichen getrennt
+QByteArray messageIdList(QByteArrayView value)
+{
+    QByteArray ids;
+    qsizetype pos = 0;
+    while ((pos = value.indexOf('<', pos)) >= 0) {
+        const qsizetype close = value.indexOf('>', pos);
+        if (close < 0) {
+            break;
+        }
+        if (!ids.isEmpty()) {
+            ids += ' ';
+        }
+        ids += value.sliced(pos, close + 1 - pos);
+        pos = close + 1;
+    }
+    return ids;
+}
+
+// "(3 6 (4 23)(44 7 96))": aufeinanderfolgende UIDs sind Eltern und Kind,
+// eine Unterliste beginnt einen Zweig unter der zuletzt genannten UID
+void parseThread(const ImapResponse &response, int list, quint32 parent, quint32 thread, QVector<ImapThreadLink> *links)
+{
+    const int end = response.next(list);
+    for (int i = list + 1; i < end; i = response.next(i)) {
+        if (response.type(i) == ImapToken::List) {
+            parseThread(response, i, parent, thread, links);
+            continue;
+        }
+        const quint32 uid = quint32(response.number(i));
+        links->append({uid, parent, thread});
+        parent = uid;
+    }
+}
+
+// RFC 5530: NO mit diesen Codes bleibt beim Wiederholen ein NO
+bool isTransientFailure(const ImapResponse &response)
+{
+    if (!response.isStatus("NO")) {
+        return false;
+    }
+    const QByteArrayView code = response.code();
+    qsizetype space = code.indexOf(' ');
+    if (space < 0) {
+        space = code.size();
+    }
+    const QByteArray name = code.first(space).toByteArray().toUpper();
+    static const char *const permanent[] = {"AUTHENTICATIONFAILED", "AUTHORIZATIONFAILED", "EXPIRED",
+                                            "PRIVACYREQUIRED", "CONTACTADMIN", "NOPERM", "CANNOT",
+                                            "CLIENTBUG", "NONEXISTENT", "TRYCREATE", "ALREADYEXISTS",
+                                            "BADCHARSET"};
+    for (const char *p : permanent) {
+        if (name == p) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "* STATUS "INBOX" (MESSAGES 231 UIDNEXT 44292 UNSEEN 3)"
+void parseStatusItems(const ImapResponse &response, ImapFolderState *state)
+{
+    const int list = response.next(1);
+    if (list >= response.size() || response.type(list) != ImapToken::List) {
+        return;
+    }
+    for (int key = list + 1; key < response.next(list); key = response.next(response.next(key))) {
+        const quint64 value = response.number(response.next(key));
+        if (response.is(key, "MESSAGES")) {
+            state->exists = quint32(value);
+        } else if (response.is(key, "UIDNEXT")) {
+            state->uidNext = quint32(value);
+        } else if (response.is(key, "UIDVALIDITY")) {
+            state->uidValidity = quint32(value);
+        } else if (response.is(key, "UNSEEN")) {
+            state->unseen = quint32(value);
+        } else if (response.is(key, "HIGHESTMODSEQ")) {
+            state->highestModSeq = value;
+        }
+    }
+}
+
+// Ab dieser Menge werden Ergebnisse schon vor dem Befehlsende weitergereicht
+const int FetchBatchSize = 1000;
+
+} // namespace
 
 ImapConnection::ImapConnection(QObject *parent)
     : QObject(parent)
     , m_socket(new QSslSocket(this))
+    , m_compressionAllowed(true)
+    , m_trafficLogged(0)
     , m_commandTag(0)
+    , m_encrypted(true)
     , m_connected(false)
     , m_authenticated(false)
-    , m_messageCount(0)
+    , m_greeted(false)
+    , m_idleState(NotIdle)
+    , m_lastFailureTransient(false)
+    , m_maxInFlight(64)
+    , m_exclusiveInFlight(false)
+    , m_lane(InteractiveLane)
+    , m_heldUsecs(0)
+    , m_backgroundWindow(2)
+    , m_queuedCount{0, 0}
+    , m_inFlightCount{0, 0}
 {
     connect(m_socket, &QSslSocket::encrypted, this, &ImapConnection::onConnected);
+    connect(m_socket, &QSslSocket::connected, this, [this]() {
+        if (!m_encrypted) {
+            onConnected();
+        }
+    });
     connect(m_socket, &QSslSocket::readyRead, this, &ImapConnection::onReadyRead);
+    connect(m_socket, &QSslSocket::disconnected, this, &ImapConnection::onDisconnected);
     connect(m_socket, &QSslSocket::errorOccurred, this, &ImapConnection::onError);
     connect(m_socket, &QSslSocket::sslErrors, this, &ImapConnection::onSslErrors);
 }
@@ -29,47 +191,773 @@ ImapConnection::~ImapConnection()
     }
 }
 
-void ImapConnection::connectToServer(const QString &host, int port)
+void ImapConnection::connectToServer(const QString &host, int port, bool encrypted)
 {
     emit statusMessage(tr("Verbinde mit %1:%2...").arg(host).arg(port));
-    m_socket->connectToHostEncrypted(host, port);
+    m_encrypted = encrypted;
+    m_greeted = false;
+    m_parser.reset();
+    m_traffic = ImapTrafficStats();
+    m_trafficLogged = 0;
+    if (encrypted) {
+        m_socket->connectToHostEncrypted(host, port);
+    } else {
+        m_socket->connectToHost(host, port);
+    }
 }
 
 void ImapConnection::login(const QString &user, const QString &password)
 {
     m_user = user;
-    m_password = password;
     emit statusMessage(tr("Anmelden als %1...").arg(user));
-    sendCommand(QString("LOGIN \"%1\" \"%2\"").arg(user, password));
-    m_currentCommand = "LOGIN";
+
+    ImapCommand command;
+    command.text = "LOGIN " + quoted(user) + ' ' + quoted(password);
+    command.flags = ImapCommand::Exclusive | ImapCommand::Sensitive;
+    command.done = [this](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK");
+        if (ok) {
+            m_authenticated = true;
+            // Vor allen anderen Befehlen, die nach authenticated() kommen
+            if (m_compressionAllowed && hasCapability("COMPRESS=DEFLATE")) {
+                compress();
+            }
+            emit statusMessage(tr("Anmeldung erfolgreich"));
+            emit authenticated();
+        }
+        emit commandFinished("LOGIN", ok);
+    };
+    execute(std::move(command));
 }
 
-void ImapConnection::selectFolder(const QString &folder)
+void ImapConnection::requestCapabilities(Done done)
+{
+    ImapCommand command;
+    command.text = "CAPABILITY";
+    command.done = [this, done](const ImapResponse &response) {
+        if (response.isStatus("OK")) {
+            emit capabilitiesReceived();
+        }
+        emit commandFinished("CAPABILITY", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::enable(const QByteArray &extension, Done done)
+{
+    ImapCommand command;
+    command.text = "ENABLE " + extension;
+    command.done = [this, done](const ImapResponse &response) {
+        emit commandFinished("ENABLE", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::listFolders()
+{
+    auto folders = std::make_shared<QList<ImapFolderInfo>>();
+
+    ImapCommand command;
+    command.text = "LIST \"\" \"*\"";
+    command.untagged = [folders](const ImapResponse &response) {
+        // "* LIST (\HasNoChildren \Sent) "/" "Gesendet""
+        if (response.size() < 4 || !response.is(0, "LIST") || response.type(1) != ImapToken::List) {
+            return false;
+        }
+        ImapFolderInfo info;
+        for (int i = 2; i < response.next(1); i = response.next(i)) {
+            info.attributes.append(response.view(i).toByteArray());
+        }
+        const QByteArray delimiter = response.string(response.next(1));
+        info.delimiter = delimiter.isEmpty() ? QChar() : QChar::fromLatin1(delimiter.at(0));
+        info.name = QString::fromUtf8(response.string(response.next(response.next(1))));
+        folders->append(info);
+        return true;
+    };
+    command.done = [this, folders](const ImapResponse &response) {
+        if (response.isStatus("OK")) {
+            emit foldersListed(*folders);
+        }
+        emit commandFinished("LIST", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::requestStatus(const QString &folder)
+{
+    auto state = std::make_shared<ImapFolderState>();
+    const QByteArray name = folder.toUtf8();
+
+    ImapCommand command;
+    command.text = "STATUS " + quoted(folder) + " (MESSAGES UIDNEXT UIDVALIDITY UNSEEN";
+    command.text += hasCapability("CONDSTORE") ? " HIGHESTMODSEQ)" : ")";
+    command.untagged = [state, name](const ImapResponse &response) {
+        if (response.size() < 3 || !response.is(0, "STATUS") || response.string(1) != name) {
+            return false;
+        }
+        parseStatusItems(response, state.get());
+        return true;
+    };
+    command.done = [this, state, folder](const ImapResponse &response) {
+        if (response.isStatus("OK")) {
+            emit statusReceived(folder, *state);
+        }
+        emit commandFinished("STATUS", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::selectFolder(const QString &folder, const ImapFolderState &known, Done done)
 {
-    m_currentFolder = folder;
     emit statusMessage(tr("Öffne Ordner %1...").arg(folder));
-    sendCommand(QString("SELECT \"%1\"").arg(folder));
-    m_currentCommand = "SELECT";
+
+    ImapCommand command;
+    command.text = "SELECT " + quoted(folder);
+    // Ungetaggte Antworten des SELECT (EXISTS, UIDVALIDITY, ...) dürfen
+    // nicht mit denen eines anderen Ordners vermischt werden
+    command.flags = ImapCommand::DrainBefore;
+    // Erst beim Senden: bis dahin können noch andere SELECTs laufen, deren
+    // Zustand sonst mit diesem vermischt würde
+    command.sending = [this, known](QByteArray *text) {
+        m_folderState = ImapFolderState();
+        if (isEnabled("QRESYNC") && known.uidValidity && known.highestModSeq) {
+            // RFC 7162: Server schickt nur geänderte Flags und VANISHED (EARLIER)
+            *text += " (QRESYNC (" + QByteArray::number(known.uidValidity) + ' '
+                     + QByteArray::number(known.highestModSeq) + "))";
+        } else if (hasCapability("CONDSTORE")) {
+            *text += " (CONDSTORE)";
+        }
+    };
+    command.done = [this, folder, done](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK");
+        if (ok) {
+            m_currentFolder = folder;
+            emit statusMessage(tr("Ordner %1: %2 Nachrichten").arg(folder).arg(m_folderState.exists));
+            emit folderSelected(folder, int(m_folderState.exists));
+        }
+        emit commandFinished("SELECT", ok);
+        if (done) {
+            done(ok);
+        }
+    };
+    execute(std::move(command));
 }
 
-void ImapConnection::fetchHeaders(int count)
+void ImapConnection::fetchNewHeaders(quint32 fromUid, quint32 toUid, Done done)
 {
-    if (m_messageCount == 0) {
-        emit headersReceived(QList<EmailHeader>());
-        return;
+    emit statusMessage(tr("Lade neue Nachrichten ab UID %1...").arg(fromUid));
+
+    ImapCommand command;
+    command.text = "UID FETCH " + QByteArray::number(qMax<quint32>(fromUid, 1)) + ':'
+                   + (toUid ? QByteArray::number(toUid) : QByteArray("*"))
+                   + " (UID FLAGS ENVELOPE RFC822.SIZE BODYSTRUCTURE BODY.PEEK[HEADER.FIELDS (REFERENCES)]";
+    // MODSEQ nur, wenn der beim Senden ausgewählte Ordner welche führt
+    command.sending = [this](QByteArray *text) { *text += m_folderState.highestModSeq ? " MODSEQ)" : ")"; };
+    command.done = [this, done](const ImapResponse &response) {
+        emit commandFinished("FETCH", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::fetchFlagChanges(quint64 sinceModSeq, Done done)
+{
+    emit statusMessage(tr("Synchronisiere Markierungen..."));
+
+    ImapCommand command;
+    command.text = "UID FETCH 1:* (UID FLAGS)";
+    if (sinceModSeq) {
+        command.text += " (CHANGEDSINCE " + QByteArray::number(sinceModSeq) + ')';
     }
-    
-    int start = qMax(1, m_messageCount - count + 1);
-    emit statusMessage(tr("Lade Nachrichten %1-%2...").arg(start).arg(m_messageCount));
-    sendCommand(QString("FETCH %1:%2 (UID FLAGS ENVELOPE)").arg(start).arg(m_messageCount));
-    m_currentCommand = "FETCH";
-    m_headers.clear();
+    command.done = [this, done](const ImapResponse &response) {
+        emit commandFinished("FLAGS", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::searchAllUids(Done done)
+{
+    auto result = std::make_shared<QVector<UidRange>>();
+
+    ImapCommand command;
+    // ESEARCH liefert kompakte Bereiche statt einer Liste aller UIDs
+    command.text = hasCapability("ESEARCH") ? "UID SEARCH RETURN (ALL) ALL" : "UID SEARCH ALL";
+    command.untagged = [result](const ImapResponse &response) {
+        if (response.is(0, "SEARCH")) {
+            for (int i = 1; i < response.size(); i = response.next(i)) {
+                const quint32 uid = quint32(response.number(i));
+                if (!result->isEmpty() && result->last().last + 1 == uid) {
+                    result->last().last = uid;
+                } else if (uid) {
+                    result->append({uid, uid});
+                }
+            }
+            return true;
+        }
+        if (response.is(0, "ESEARCH")) {
+            // "* ESEARCH (TAG "A0005") UID ALL 1:3,5"
+            for (int i = 0; i < response.size(); i = response.next(i)) {
+                if (response.is(i, "ALL")) {
+                    parseUidSet(response.view(response.next(i)), result.get());
+                }
+            }
+            return true;
+        }
+        return false;
+    };
+    command.done = [this, result, done](const ImapResponse &response) {
+        if (response.isStatus("OK")) {
+            emit uidsReceived(*result);
+        }
+        emit commandFinished("SEARCH", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::fetchThreads()
+{
+    auto result = std::make_shared<QVector<ImapThreadLink>>();
+
+    ImapCommand command;
+    command.text = "UID THREAD REFERENCES UTF-8 ALL";
+    command.untagged = [result](const ImapResponse &response) {
+        if (!response.is(0, "THREAD")) {
+            return false;
+        }
+        for (int list = 1; list < response.size(); list = response.next(list)) {
+            if (response.type(list) != ImapToken::List) {
+                continue;
+            }
+            // Bei fehlender Wurzel "((3)(5))" die erste UID als Kennung
+            int first = list + 1;
+            while (first < response.next(list) && response.type(first) == ImapToken::List) {
+                ++first;
+            }
+            const quint32 thread = first < response.next(list) ? quint32(response.number(first)) : 0;
+            parseThread(response, list, 0, thread, result.get());
+        }
+        return true;
+    };
+    command.done = [this, result](const ImapResponse &response) {
+        if (response.isStatus("OK")) {
+            emit threadsReceived(*result);
+        }
+        emit commandFinished("THREAD", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::fetchBodyStructure(quint32 uid)
+{
+    auto structure = std::make_shared<QByteArray>();
+
+    ImapCommand command;
+    command.text = "UID FETCH " + QByteArray::number(uid) + " (UID BODYSTRUCTURE)";
+    command.untagged = [structure](const ImapResponse &response) {
+        if (!response.is(1, "FETCH") || response.type(2) != ImapToken::List) {
+            return false;
+        }
+        const int end = response.next(2);
+        for (int key = 3; key < end; key = response.next(key)) {
+            const int value = response.next(key);
+            if (value < end && response.is(key, "BODYSTRUCTURE")) {
+                *structure = response.view(value).toByteArray();
+                return true;
+            }
+            key = value;
+        }
+        return false;
+    };
+    command.done = [this, uid, structure](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK") && !structure->isEmpty();
+        if (ok) {
+            emit bodyStructureReceived(uid, *structure);
+        }
+        emit commandFinished("FETCH BODYSTRUCTURE", ok);
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::fetchBodySections(quint32 uid, const QVector<ImapBodySection> &sections)
+{
+    auto result = std::make_shared<QVector<ImapBodySection>>(sections);
+
+    ImapCommand command;
+    command.text = "UID FETCH " + QByteArray::number(uid) + " (UID";
+    for (const ImapBodySection &s : sections) {
+        // PEEK: Lesen setzt nicht \Seen, das entscheidet die Oberfläche
+        command.text += " BODY.PEEK[" + s.section + ']';
+        if (s.offset >= 0) {
+            command.text += '<' + QByteArray::number(s.offset) + '.' + QByteArray::number(s.length) + '>';
+        }
+    }
+    command.text += ')';
+    command.untagged = [uid, result](const ImapResponse &response) {
+        if (!response.is(1, "FETCH") || response.type(2) != ImapToken::List) {
+            return false;
+        }
+        // UID kann vor oder nach den Abschnitten stehen
+        const int end = response.next(2);
+        bool sameUid = false;
+        for (int key = 3; key < end && response.next(key) < end; key = response.next(response.next(key))) {
+            if (response.is(key, "UID")) {
+                sameUid = response.number(response.next(key)) == uid;
+            }
+        }
+        if (!sameUid) {
+            return false;
+        }
+        bool matched = false;
+        for (int key = 3; key < end && response.next(key) < end; key = response.next(response.next(key))) {
+            // "BODY[1.2]<0>" bzw. "BODY[TEXT]"
+            const QByteArrayView name = response.view(key);
+            if (!name.startsWith("BODY[")) {
+                continue;
+            }
+            const qsizetype close = name.indexOf(']');
+            const QByteArrayView section = name.mid(5, close - 5);
+            qint64 offset = -1;
+            if (name.size() > close + 2 && name.at(close + 1) == '<') {
+                offset = name.mid(close + 2, name.size() - close - 3).toLongLong();
+            }
+            for (ImapBodySection &s : *result) {
+                if (section == QByteArrayView(s.section) && s.offset == offset) {
+                    s.data = response.string(response.next(key));
+                    matched = true;
+                }
+            }
+        }
+        return matched;
+    };
+    command.done = [this, uid, result](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK");
+        emit bodySectionsReceived(uid, *result, ok);
+        emit commandFinished("FETCH BODY", ok);
+    };
+    execute(std::move(command));
 }
 
 void ImapConnection::logout()
 {
-    sendCommand("LOGOUT");
-    m_currentCommand = "LOGOUT";
+    ImapCommand command;
+    command.text = "LOGOUT";
+    command.flags = ImapCommand::Exclusive;
+    execute(std::move(command));
+}
+
+void ImapConnection::storeFlags(const QVector<UidRange> &uids, quint32 flags, bool add, Done done)
+{
+    ImapCommand command;
+    // SILENT: keine FETCH-Antwort je Nachricht, der lokale Stand ist schon aktuell
+    command.text = "UID STORE " + uidSet(uids) + (add ? " +FLAGS.SILENT " : " -FLAGS.SILENT ") + flagList(flags);
+    command.done = [this, done](const ImapResponse &response) {
+        emit commandFinished("STORE", response.isStatus("OK"));
+        if (done) {
+            done(response.isStatus("OK"));
+        }
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::moveMessages(const QVector<UidRange> &uids, const QString &target, Done done)
+{
+    const QByteArray set = uidSet(uids);
+    if (hasCapability("MOVE")) {
+        ImapCommand command;
+        command.text = "UID MOVE " + set + ' ' + quoted(target);
+        command.done = [this, done](const ImapResponse &response) {
+            emit commandFinished("MOVE", response.isStatus("OK"));
+            if (done) {
+                done(response.isStatus("OK"));
+            }
+        };
+        execute(std::move(command));
+        return;
+    }
+
+    // RFC 6851, 3.3: erst nach erfolgreichem COPY löschen
+    ImapCommand command;
+    command.text = "UID COPY " + set + ' ' + quoted(target);
+    command.done = [this, uids, done](const ImapResponse &response) {
+        if (!response.isStatus("OK")) {
+            emit commandFinished("MOVE", false);
+            if (done) {
+                done(false);
+            }
+            return;
+        }
+        expunge(uids, ImapCommand::FollowUp, "MOVE", done);
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::expungeMessages(const QVector<UidRange> &uids, Done done)
+{
+    expunge(uids, ImapCommand::NoFlags, "EXPUNGE", done);
+}
+
+void ImapConnection::expunge(const QVector<UidRange> &uids, int flags, const QString &name, const Done &done)
+{
+    const QByteArray set = uidSet(uids);
+
+    ImapCommand store;
+    store.text = "UID STORE " + set + " +FLAGS.SILENT (\\Deleted)";
+    store.flags = flags;
+    store.done = [this, set, name, done](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK");
+        // Ein EXPUNGE ohne UIDPLUS entfernt auch \Deleted-Nachrichten anderer
+        // Programme; dann bleibt es beim Markieren
+        if (!ok || !hasCapability("UIDPLUS")) {
+            emit commandFinished(name, ok);
+            if (done) {
+                done(ok);
+            }
+            return;
+        }
+        ImapCommand command;
+        command.text = "UID EXPUNGE " + set;
+        command.flags = ImapCommand::FollowUp;
+        command.done = [this, name, done](const ImapResponse &response) {
+            emit commandFinished(name, response.isStatus("OK"));
+            if (done) {
+                done(response.isStatus("OK"));
+            }
+        };
+        execute(std::move(command));
+    };
+    execute(std::move(store));
+}
+
+void ImapConnection::idle()
+{
+    if (m_idleState != NotIdle) {
+        return;
+    }
+    m_idleState = IdleRequested;
+
+    ImapCommand command;
+    command.text = "IDLE";
+    command.flags = ImapCommand::Exclusive;
+    command.continuation = [this](const ImapResponse &) {
+        // Inzwischen wartet ein anderer Befehl: gleich wieder beenden
+        if (m_idleState == IdleStopping || !m_queue.isEmpty()) {
+            m_idleState = IdleStopping;
+            qDebug() << "IMAP > DONE";
+            send("DONE\r\n");
+            m_exclusiveInFlight = false;
+            pump();
+            return;
+        }
+        m_idleState = Idling;
+        emit idleStarted();
+    };
+    command.done = [this](const ImapResponse &response) {
+        m_idleState = NotIdle;
+        emit commandFinished("IDLE", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::stopIdle()
+{
+    if (m_idleState == IdleRequested) {
+        // DONE folgt, sobald der Server die Fortsetzung anfordert
+        m_idleState = IdleStopping;
+    } else if (m_idleState == Idling) {
+        m_idleState = IdleStopping;
+        qDebug() << "IMAP > DONE";
+        send("DONE\r\n");
+        // Folgebefehle dürfen direkt hinter DONE, ohne auf dessen Abschluss zu warten
+        m_exclusiveInFlight = false;
+    }
+}
+
+void ImapConnection::notify(const QByteArray &events)
+{
+    ImapCommand command;
+    command.text = "NOTIFY SET " + events;
+    command.done = [this](const ImapResponse &response) {
+        emit commandFinished("NOTIFY", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::noop()
+{
+    ImapCommand command;
+    command.text = "NOOP";
+    command.done = [this](const ImapResponse &response) {
+        emit commandFinished("NOOP", response.isStatus("OK"));
+    };
+    execute(std::move(command));
+}
+
+void ImapConnection::compress()
+{
+    if (m_compression || m_pendingCompression) {
+        return;
+    }
+    // Schon vor dem Befehl: ohne funktionierendes zlib unkomprimiert bleiben
+    m_pendingCompression.reset(new ImapCompression);
+    if (!m_pendingCompression->isValid()) {
+        m_pendingCompression.reset();
+        return;
+    }
+
+    ImapCommand command;
+    command.text = "COMPRESS DEFLATE";
+    // Alles danach läuft bereits durch den Deflate-Strom
+    command.flags = ImapCommand::Exclusive;
+    command.done = [this](const ImapResponse &response) {
+        const bool ok = response.isStatus("OK");
+        std::unique_ptr<ImapCompression> compression = std::move(m_pendingCompression);
+        if (ok && compression) {
+            m_compression = std::move(compression);
+            // Was hinter der OK-Zeile schon gelesen wurde, ist bereits komprimiert
+            const QByteArray rest = m_parser.takeUnread();
+            if (!rest.isEmpty() && !m_compression->inflate(rest.constData(), rest.size(), &m_parser)) {
+                m_socket->abort();
+            }
+            emit statusMessage(tr("Komprimierung aktiv"));
+        }
+        emit commandFinished("COMPRESS", ok);
+    };
+    execute(std::move(command));
+}
+
+QByteArray ImapConnection::execute(ImapCommand command)
+{
+    PendingCommand pending;
+    pending.tag = QByteArray("A") + QByteArray::number(++m_commandTag).rightJustified(4, '0');
+    pending.command = std::move(command);
+    pending.lane = m_lane;
+    pending.queued.start();
+    pending.held = m_heldUsecs;
+    const QByteArray tag = pending.tag;
+    ++m_queuedCount[pending.lane];
+
+    const int barrier = ImapCommand::DrainBefore | ImapCommand::Exclusive;
+    if (pending.command.flags & ImapCommand::FollowUp) {
+        // Ein später abgesetztes SELECT wartet noch in der Schlange
+        m_queue.prepend(std::move(pending));
+    } else if (pending.lane == InteractiveLane && !(pending.command.flags & barrier)) {
+        // Vor die wartenden Hintergrundbefehle, höchstens bis zum letzten
+        // SELECT bzw. exklusiven Befehl
+        qsizetype pos = m_queue.size();
+        while (pos > 0 && m_queue.at(pos - 1).lane == BackgroundLane
+               && !(m_queue.at(pos - 1).command.flags & barrier)) {
+            --pos;
+        }
+        m_queue.insert(pos, std::move(pending));
+    } else {
+        m_queue.enqueue(std::move(pending));
+    }
+    // Jeder neue Befehl beendet ein laufendes IDLE
+    if (m_idleState == Idling) {
+        stopIdle();
+    }
+    pump();
+    return tag;
+}
+
+void ImapConnection::pump()
+{
+    if (!m_connected) {
+        return;
+    }
+
+    // Alle sendbaren Befehle in einem Schreibvorgang, damit sie gemeinsam
+    // auf die Leitung gehen
+    QByteArray out;
+    while (!m_queue.isEmpty() && m_inFlight.size() < m_maxInFlight && !m_exclusiveInFlight) {
+        const int flags = m_queue.head().command.flags;
+        if ((flags & (ImapCommand::DrainBefore | ImapCommand::Exclusive)) && !m_inFlight.isEmpty()) {
+            break;
+        }
+        // Interaktive Befehle stehen schon davor, dahinter kommt nichts vorbei
+        if (m_queue.head().lane == BackgroundLane && m_inFlightCount[BackgroundLane] >= m_backgroundWindow) {
+            break;
+        }
+
+        PendingCommand pending = m_queue.dequeue();
+        --m_queuedCount[pending.lane];
+        ++m_inFlightCount[pending.lane];
+        if (pending.command.sending) {
+            pending.command.sending(&pending.command.text);
+        }
+
+        // Passwort nicht loggen
+        if (pending.command.flags & ImapCommand::Sensitive) {
+            qDebug() << "IMAP >" << pending.tag << pending.command.text.left(pending.command.text.indexOf(' ')) << "***";
+        } else {
+            qDebug() << "IMAP >" << pending.tag << pending.command.text;
+        }
+
+        out += pending.tag + ' ' + pending.command.text + "\r\n";
+        if (pending.command.flags & ImapCommand::Exclusive) {
+            m_exclusiveInFlight = true;
+        }
+        m_inFlightOrder.append(pending.tag);
+        m_inFlight.insert(pending.tag, std::move(pending));
+    }
+
+    if (!out.isEmpty()) {
+        send(out);
+    }
+}
+
+void ImapConnection::send(const QByteArray &data)
+{
+    m_traffic.plainOut += quint64(data.size());
+    if (m_compression) {
+        const QByteArray packed = m_compression->deflate(data);
+        m_traffic.wireOut += quint64(packed.size());
+        m_socket->write(packed);
+    } else {
+        m_traffic.wireOut += quint64(data.size());
+        m_socket->write(data);
+    }
+}
+
+void ImapConnection::logTraffic()
+{
+    // Etwa alle 4 MiB auf der Leitung eine Zeile
+    if (m_traffic.wireIn - m_trafficLogged < 4 * 1024 * 1024) {
+        return;
+    }
+    m_trafficLogged = m_traffic.wireIn;
+    qDebug().nospace() << "IMAP: " << m_traffic.wireIn / 1024 << " KiB empfangen, " << m_traffic.plainIn / 1024
+                       << " KiB entpackt (Faktor "
+                       << (m_traffic.wireIn ? double(m_traffic.plainIn) / double(m_traffic.wireIn) : 1.0) << ")";
+}
+
+void ImapConnection::failPending()
+{
+    // Wartende Befehle mit leerer Antwort abschließen
+    const QList<QByteArray> order = m_inFlightOrder;
+    QHash<QByteArray, PendingCommand> inFlight;
+    inFlight.swap(m_inFlight);
+    QQueue<PendingCommand> queue;
+    queue.swap(m_queue);
+    m_inFlightOrder.clear();
+    m_exclusiveInFlight = false;
+    for (int lane = 0; lane < LaneCount; ++lane) {
+        m_queuedCount[lane] = 0;
+        m_inFlightCount[lane] = 0;
+    }
+
+    const ImapResponse none;
+    for (const QByteArray &tag : order) {
+        const PendingCommand &pending = inFlight[tag];
+        if (pending.command.done) {
+            pending.command.done(none);
+        }
+    }
+    for (const PendingCommand &pending : queue) {
+        if (pending.command.done) {
+            pending.command.done(none);
+        }
+    }
+}
+
+bool ImapConnection::hasCapability(const QByteArray &capability) const
+{
+    for (const QByteArray &c : m_capabilities) {
+        if (c.compare(capability, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ImapConnection::isEnabled(const QByteArray &extension) const
+{
+    for (const QByteArray &e : m_enabled) {
+        if (e.compare(extension, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QByteArray ImapConnection::quoted(const QString &text)
+{
+    QByteArray result = text.toUtf8();
+    result.replace('\\', "\\\\");
+    result.replace('"', "\\\"");
+    return '"' + result + '"';
+}
+
+void ImapConnection::parseUidSet(QByteArrayView set, QVector<UidRange> *ranges)
+{
+    // Format: 1:5,7,9:12 (Bereiche können auch absteigend angegeben sein)
+    qsizetype pos = 0;
+    while (pos < set.size()) {
+        qsizetype comma = set.indexOf(',', pos);
+        if (comma < 0) {
+            comma = set.size();
+        }
+        const QByteArrayView item = set.sliced(pos, comma - pos);
+        const qsizetype colon = item.indexOf(':');
+        quint32 first = quint32(parseNumber(item));
+        quint32 last = colon < 0 ? first : quint32(parseNumber(item.sliced(colon + 1)));
+        if (first > last) {
+            qSwap(first, last);
+        }
+        if (first) {
+            ranges->append({first, last});
+        }
+        pos = comma + 1;
+    }
+}
+
+QByteArray ImapConnection::uidSet(const QVector<UidRange> &ranges)
+{
+    QByteArray set;
+    for (const UidRange &r : ranges) {
+        if (!set.isEmpty()) {
+            set += ',';
+        }
+        set += QByteArray::number(r.first);
+        if (r.last != r.first) {
+            set += ':' + QByteArray::number(r.last);
+        }
+    }
+    return set;
+}
+
+QByteArray ImapConnection::flagList(quint32 flags)
+{
+    static const struct {
+        quint32 bit;
+        const char *name;
+    } names[] = {
+        {FlagSeen, "\\Seen"},       {FlagAnswered, "\\Answered"},   {FlagFlagged, "\\Flagged"},
+        {FlagDeleted, "\\Deleted"}, {FlagDraft, "\\Draft"},         {FlagForwarded, "$Forwarded"},
+        {FlagJunk, "$Junk"},
+    };
+    QByteArray list;
+    for (const auto &n : names) {
+        if (flags & n.bit) {
+            list += list.isEmpty() ? "" : " ";
+            list += n.name;
+        }
+    }
+    return '(' + list + ')';
 }
 
 void ImapConnection::onConnected()
@@ -77,21 +965,65 @@ void ImapConnection::onConnected()
     m_connected = true;
     emit statusMessage(tr("Verbunden - warte auf Server..."));
     emit connected();
+    pump();
 }
 
 void ImapConnection::onReadyRead()
 {
-    m_buffer += QString::fromUtf8(m_socket->readAll());
-    
-    while (m_buffer.contains("\r\n")) {
-        int idx = m_buffer.indexOf("\r\n");
-        QString line = m_buffer.left(idx);
-        m_buffer = m_buffer.mid(idx + 2);
-        
-        processResponse(line);
+    const qint64 available = m_socket->bytesAvailable();
+    if (available > 0 && m_compression) {
+        // Komprimiert: über einen wiederverwendeten Puffer in den Parser entpacken
+        if (m_wireBuffer.size() < available) {
+            m_wireBuffer.resize(available);
+        }
+        const qint64 n = m_socket->read(m_wireBuffer.data(), available);
+        if (n > 0) {
+            m_traffic.wireIn += quint64(n);
+            const qsizetype before = m_parser.buffered();
+            if (!m_compression->inflate(m_wireBuffer.constData(), n, &m_parser)) {
+                emit this->error(tr("Komprimierter Datenstrom ist beschädigt"));
+                m_socket->abort();
+                return;
+            }
+            m_traffic.plainIn += quint64(m_parser.buffered() - before);
+        }
+    } else if (available > 0) {
+        // Direkt in den Parser-Puffer lesen, ohne Zwischenkopie
+        char *dst = m_parser.reserve(available);
+        const qint64 n = m_socket->read(dst, available);
+        if (n > 0) {
+            m_parser.commit(n);
+            m_traffic.wireIn += quint64(n);
+            m_traffic.plainIn += quint64(n);
+        }
+    }
+    logTraffic();
+
+    for (;;) {
+        const ImapParser::Result result = m_parser.next();
+        if (result == ImapParser::NeedMore) {
+            break;
+        }
+        if (result == ImapParser::Malformed) {
+            qWarning() << "IMAP: fehlerhafte Antwort" << logExcerpt(m_parser.response().raw());
+            continue;
+        }
+        processResponse(m_parser.response());
     }
 }
 
+void ImapConnection::onDisconnected()
+{
+    m_connected = false;
+    m_authenticated = false;
+    m_capabilities.clear();
+    m_enabled.clear();
+    m_idleState = NotIdle;
+    m_compression.reset();
+    failPending();
+    emit disconnected();
+}
+
 void ImapConnection::onError(QAbstractSocket::SocketError error)
 {
     Q_UNUSED(error)
@@ -107,112 +1039,271 @@ void ImapConnection::onSslErrors(const QList<QSslError> &errors)
     m_socket->ignoreSslErrors();
 }
 
-void ImapConnection::sendCommand(const QString &command)
+void ImapConnection::processResponse(const ImapResponse &response)
 {
-    m_commandTag++;
-    QString fullCommand = QString("A%1 %2\r\n").arg(m_commandTag, 4, 10, QChar('0')).arg(command);
-    
-    // Passwort nicht loggen
-    if (!command.startsWith("LOGIN")) {
-        qDebug() << "IMAP >" << fullCommand.trimmed();
-    } else {
-        qDebug() << "IMAP > LOGIN ***";
+    qDebug() << "IMAP <" << logExcerpt(response.raw());
+
+    switch (response.kind()) {
+    case ImapResponse::Continuation: {
+        // Kopie außerhalb der Schleife aufrufen: der Handler darf weitere
+        // Befehle senden (IDLE nach DONE) und damit m_inFlight verändern
+        std::function<void(const ImapResponse &)> continuation;
+        for (const QByteArray &tag : std::as_const(m_inFlightOrder)) {
+            const PendingCommand &pending = m_inFlight[tag];
+            if (pending.command.continuation) {
+                continuation = pending.command.continuation;
+                break;
+            }
+        }
+        if (continuation) {
+            continuation(response);
+        }
+        break;
+    }
+    case ImapResponse::Untagged:
+        // Ältester laufender Befehl, der die Antwort beansprucht
+        for (int i = 0; i < m_inFlightOrder.size(); ++i) {
+            const PendingCommand &pending = m_inFlight[m_inFlightOrder.at(i)];
+            if (pending.command.untagged && pending.command.untagged(response)) {
+                return;
+            }
+        }
+        processUntagged(response);
+        break;
+    case ImapResponse::Tagged:
+        processTagged(response);
+        break;
     }
-    
-    m_socket->write(fullCommand.toUtf8());
 }
 
-void ImapConnection::processResponse(const QString &line)
+void ImapConnection::processUntagged(const ImapResponse &response)
 {
-    qDebug() << "IMAP <" << line.left(100);
-    
-    // Server-Greeting
-    if (line.startsWith("* OK")) {
-        emit statusMessage(tr("Server bereit"));
+    if (response.isStatus("OK")) {
+        processResponseCode(response.code());
+        // Server-Greeting
+        if (!m_greeted) {
+            m_greeted = true;
+            emit statusMessage(tr("Server bereit"));
+        }
         return;
     }
-    
-    // EXISTS - Anzahl der Nachrichten
-    static QRegularExpression existsRx(R"(\* (\d+) EXISTS)");
-    auto existsMatch = existsRx.match(line);
-    if (existsMatch.hasMatch()) {
-        m_messageCount = existsMatch.captured(1).toInt();
+    if (response.isStatus("BYE")) {
+        emit statusMessage(tr("Server beendet die Verbindung"));
         return;
     }
-    
-    // FETCH Response - Header parsen
-    if (line.startsWith("* ") && line.contains("FETCH")) {
-        parseHeaders(line);
+    if (response.is(0, "CAPABILITY")) {
+        m_capabilities.clear();
+        for (int i = 1; i < response.size(); i = response.next(i)) {
+            m_capabilities.append(response.view(i).toByteArray());
+        }
         return;
     }
-    
-    // Tagged Response (Abschluss eines Befehls)
-    QString tag = QString("A%1").arg(m_commandTag, 4, 10, QChar('0'));
-    if (line.startsWith(tag)) {
-        if (line.contains("OK")) {
-            if (m_currentCommand == "LOGIN") {
-                m_authenticated = true;
-                emit statusMessage(tr("Anmeldung erfolgreich"));
-                emit authenticated();
-            } else if (m_currentCommand == "SELECT") {
-                emit statusMessage(tr("Ordner %1: %2 Nachrichten").arg(m_currentFolder).arg(m_messageCount));
-                emit folderSelected(m_currentFolder, m_messageCount);
-            } else if (m_currentCommand == "FETCH") {
-                emit statusMessage(tr("%1 Nachrichten geladen").arg(m_headers.size()));
-                emit headersReceived(m_headers);
-            }
-        } else if (line.contains("NO") || line.contains("BAD")) {
-            emit error(tr("Befehl fehlgeschlagen: %1").arg(line));
+    if (response.is(0, "ENABLED")) {
+        for (int i = 1; i < response.size(); i = response.next(i)) {
+            m_enabled.append(response.view(i).toByteArray().toUpper());
+        }
+        return;
+    }
+    if (response.is(0, "STATUS") && response.size() >= 3) {
+        // Unaufgefordert per NOTIFY
+        ImapFolderState state;
+        parseStatusItems(response, &state);
+        emit statusReceived(QString::fromUtf8(response.string(1)), state);
+        return;
+    }
+    if (response.is(0, "VANISHED")) {
+        // "* VANISHED (EARLIER) 1:5,9" bzw. "* VANISHED 7"
+        QVector<UidRange> ranges;
+        parseUidSet(response.view(response.size() - 1), &ranges);
+        if (!ranges.isEmpty()) {
+            emit vanished(ranges);
+        }
+        return;
+    }
+
+    // "* n EXISTS" bzw. "* n FETCH (...)"
+    bool isNumber = false;
+    const quint64 number = response.number(0, &isNumber);
+    if (!isNumber) {
+        return;
+    }
+    if (response.is(1, "EXISTS")) {
+        m_folderState.exists = quint32(number);
+        emit existsReceived(quint32(number));
+    } else if (response.is(1, "EXPUNGE")) {
+        m_folderState.exists = m_folderState.exists ? m_folderState.exists - 1 : 0;
+        emit expungeReceived(quint32(number));
+    } else if (response.is(1, "FETCH") && response.type(2) == ImapToken::List) {
+        parseFetch(response, 2);
+        // Unaufgeforderte Änderungen (IDLE, NOTIFY) sofort weiterreichen
+        if (m_idleState != NotIdle || m_inFlight.isEmpty()) {
+            flushFetchResults();
         }
     }
 }
 
-void ImapConnection::parseHeaders(const QString &response)
+void ImapConnection::processTagged(const ImapResponse &response)
+{
+    const QByteArray tag = response.tag().toByteArray();
+    auto it = m_inFlight.find(tag);
+    if (it == m_inFlight.end()) {
+        qWarning() << "IMAP: Antwort auf unbekannten Tag" << tag;
+        return;
+    }
+    PendingCommand pending = std::move(it.value());
+    m_inFlight.erase(it);
+    m_inFlightOrder.removeOne(tag);
+    --m_inFlightCount[pending.lane];
+    if (pending.command.flags & ImapCommand::Exclusive) {
+        m_exclusiveInFlight = false;
+    }
+
+    if (response.isStatus("OK")) {
+        processResponseCode(response.code());
+    } else {
+        m_lastFailureTransient = isTransientFailure(response);
+        emit error(tr("Befehl fehlgeschlagen: %1").arg(QString::fromUtf8(response.raw()).trimmed()));
+    }
+    flushFetchResults();
+    if (pending.command.done) {
+        pending.command.done(response);
+    }
+    pump();
+    emit commandTimed(pending.lane, pending.held + pending.queued.nsecsElapsed() / 1000);
+}
+
+void ImapConnection::processResponseCode(QByteArrayView code)
+{
+    // z.B. "UIDVALIDITY 3857529045", "HIGHESTMODSEQ 715194045007", "CAPABILITY IMAP4rev1 ..."
+    if (code.isEmpty()) {
+        return;
+    }
+    qsizetype space = code.indexOf(' ');
+    if (space < 0) {
+        space = code.size();
+    }
+    const QByteArray name = code.first(space).toByteArray().toUpper();
+    const QByteArrayView value = space < code.size() ? code.sliced(space + 1) : QByteArrayView();
+
+    if (name == "UIDVALIDITY") {
+        m_folderState.uidValidity = quint32(parseNumber(value));
+    } else if (name == "UIDNEXT") {
+        m_folderState.uidNext = quint32(parseNumber(value));
+    } else if (name == "HIGHESTMODSEQ") {
+        m_folderState.highestModSeq = parseNumber(value);
+    } else if (name == "NOMODSEQ") {
+        m_folderState.highestModSeq = 0;
+    } else if (name == "CAPABILITY") {
+        parseCapabilities(value);
+    }
+}
+
+void ImapConnection::parseCapabilities(QByteArrayView list)
+{
+    m_capabilities.clear();
+    qsizetype pos = 0;
+    while (pos < list.size()) {
+        qsizetype space = list.indexOf(' ', pos);
+        if (space < 0) {
+            space = list.size();
+        }
+        if (space > pos) {
+            m_capabilities.append(list.sliced(pos, space - pos).toByteArray());
+        }
+        pos = space + 1;
+    }
+}
+
+void ImapConnection::parseFetch(const ImapResponse &response, int list)
 {
     EmailHeader header;
-    
-    // UID extrahieren
-    static QRegularExpression uidRx(R"(UID (\d+))");
-    auto uidMatch = uidRx.match(response);
-    if (uidMatch.hasMatch()) {
-        header.uid = uidMatch.captured(1);
-    }
-    
-    // FLAGS prüfen (SEEN)
-    header.seen = response.contains("\\Seen");
-    
-    // ENVELOPE parsen (vereinfacht)
-    // Format: ENVELOPE ("date" "subject" ((from)) ((sender)) ((reply-to)) ((to)) ...)
-    static QRegularExpression envRx(R"(ENVELOPE \(\"([^\"]*)\"\s*\"([^\"]*)\")");
-    auto envMatch = envRx.match(response);
-    if (envMatch.hasMatch()) {
-        header.date = envMatch.captured(1);
-        header.subject = envMatch.captured(2);
-        
-        // Dekodiere MIME-Encoded Subjects
-        if (header.subject.contains("=?")) {
-            // Einfache Dekodierung (vollständige Impl. später)
-            header.subject = header.subject.replace("=?UTF-8?Q?", "").replace("?=", "");
-            header.subject = header.subject.replace("=?utf-8?Q?", "").replace("?=", "");
-            header.subject = header.subject.replace("_", " ");
-        }
-    }
-    
-    // From-Adresse extrahieren (vereinfacht)
-    static QRegularExpression fromRx(R"(\(\(\"([^\"]*)\"\s*NIL\s*\"([^\"]*)\"\s*\"([^\"]*)\"\)\))");
-    auto fromMatch = fromRx.match(response);
-    if (fromMatch.hasMatch()) {
-        QString name = fromMatch.captured(1);
-        QString mailbox = fromMatch.captured(2);
-        QString host = fromMatch.captured(3);
-        if (name.isEmpty()) {
-            header.from = QString("%1@%2").arg(mailbox, host);
-        } else {
-            header.from = QString("%1 <%2@%3>").arg(name, mailbox, host);
+    bool hasEnvelope = false;
+    QByteArray inReplyTo;
+
+    // Schlüssel/Wert-Paare: UID n FLAGS (...) MODSEQ (n) ENVELOPE (...)
+    const int end = response.next(list);
+    for (int key = list + 1; key < end; key = response.next(key)) {
+        const int value = response.next(key);
+        if (value >= end) {
+            break;
         }
+
+        if (response.is(key, "UID")) {
+            header.uid = quint32(response.number(value));
+        } else if (response.is(key, "FLAGS")) {
+            for (int f = value + 1; f < response.next(value); f = response.next(f)) {
+                header.flags |= flagBit(response, f);
+            }
+        } else if (response.is(key, "MODSEQ")) {
+            header.modSeq = response.number(response.child(value, 0));
+        } else if (response.is(key, "RFC822.SIZE")) {
+            header.size = quint32(response.number(value));
+        } else if (response.is(key, "BODYSTRUCTURE")) {
+            // Roh speichern, zerlegt wird erst beim Öffnen der Nachricht
+            header.structure = response.view(value).toByteArray();
+        } else if (response.is(key, "ENVELOPE")) {
+            // Format: ("date" "subject" (from) (sender) (reply-to) (to) ... "message-id")
+            hasEnvelope = true;
+            header.date = parseEnvelopeDate(response.string(response.child(value, 0)));
+            header.subject = MimeDecoder::decodeHeader(response.string(response.child(value, 1)));
+            header.from = addressString(response, response.child(value, 2));
+            header.to = addressString(response, response.child(value, 5));
+            inReplyTo = messageIdList(response.view(response.child(value, 8)));
+            header.messageId = QString::fromLatin1(response.string(response.child(value, 9)));
+        } else if (response.view(key).startsWith("BODY[HEADER.FIELDS")) {
+            // "References: <a@x>\r\n <b@y>\r\n\r\n", ggf. gefaltet
+            header.references = messageIdList(response.view(value));
+        }
+        key = value;
+    }
+
+    if (header.references.isEmpty()) {
+        header.references = inReplyTo;
+    }
+
+    if (!header.uid) {
+        // Ohne CONDSTORE/QRESYNC meldet der Server Flag-Änderungen nur mit Sequenznummer
+        if (!hasEnvelope) {
+            emit sequenceFlagsReceived(quint32(response.number(0)), header.flags);
+        }
+        return;
+    }
+    if (hasEnvelope) {
+        m_headers.append(header);
+    } else {
+        // Nur Flags: Ergebnis von CHANGEDSINCE oder unaufgeforderte Änderung
+        m_flagUpdates.append({header.uid, header.flags, header.modSeq});
+    }
+    if (m_headers.size() >= FetchBatchSize || m_flagUpdates.size() >= FetchBatchSize) {
+        flushFetchResults();
+    }
+}
+
+void ImapConnection::flushFetchResults()
+{
+    if (!m_flagUpdates.isEmpty()) {
+        emit flagsReceived(m_flagUpdates);
+        m_flagUpdates.clear();
+    }
+    if (!m_headers.isEmpty()) {
+        emit statusMessage(tr("%1 Nachrichten geladen").arg(m_headers.size()));
+        emit headersReceived(m_headers);
+        m_headers.clear();
+    }
+}
+
+QString ImapConnection::addressString(const ImapResponse &response, int addressList) const
+{
+    // Erste Adresse der Liste: ("name" adl "mailbox" "host")
+    const int address = response.child(addressList, 0);
+    if (address < 0) {
+        return QString();
     }
-    
-    if (!header.uid.isEmpty()) {
-        m_headers.prepend(header); // Neueste zuerst
+    const QString name = MimeDecoder::decodeHeader(response.string(response.child(address, 0)));
+    const QString mailbox = QString::fromUtf8(response.string(response.child(address, 2)));
+    const QString host = QString::fromUtf8(response.string(response.child(address, 3)));
+    if (name.isEmpty()) {
+        return QString("%1@%2").arg(mailbox, host);
     }
+    return QString("%1 <%2@%3>").arg(name, mailbox, host);
 }
@@ -7,69 +7,364 @@
 #ifndef IMAPCONNECTION_H
 #define IMAPCONNECTION_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QSslSocket>
 #include <QQueue>
 #include <QTimer>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+#include "imapparser.h"
+
+class ImapCompression;
+
+// IMAP-Flags als Bitfeld
+enum MessageFlag : quint32 {
+    FlagSeen = 0x01,
+    FlagAnswered = 0x02,
+    FlagFlagged = 0x04,
+    FlagDeleted = 0x08,
+    FlagDraft = 0x10,
+    FlagForwarded = 0x20, // $Forwarded
+    FlagJunk = 0x40,      // $Junk
+};
 
 struct EmailHeader {
-    QString uid;
+    quint32 uid = 0;
+    quint32 flags = 0;
+    quint64 modSeq = 0;
+    qint64 date = 0; // Sekunden seit Epoch (UTC)
+    quint32 size = 0;
     QString from;
     QString to;
     QString subject;
-    QString date;
-    bool seen;
+    QString messageId;
+    // Message-IDs der Vorgänger, älteste zuerst ("<a@x> <b@y>"); References,
+    // ersatzweise In-Reply-To
+    QByteArray references;
+    QByteArray structure; // BODYSTRUCTURE ohne äußere Klammern, siehe BodyStructure
+
+    bool seen() const { return flags & FlagSeen; }
+};
+
+struct ImapFlagUpdate {
+    quint32 uid;
+    quint32 flags;
+    quint64 modSeq;
+};
+
+// Abschnitt für BODY.PEEK[section]<offset.length>; offset < 0: ganzer Abschnitt
+struct ImapBodySection {
+    QByteArray section;
+    qint64 offset = -1;
+    qint64 length = 0;
+    QByteArray data; // Antwort des Servers
+};
+
+// Ergebnis von UID THREAD; parent = 0 für Wurzeln. thread ist die erste UID
+// der Unterhaltung und hält Geschwister unter einer fehlenden Wurzel zusammen.
+struct ImapThreadLink {
+    quint32 uid;
+    quint32 parent;
+    quint32 thread;
+};
+
+struct UidRange {
+    quint32 first;
+    quint32 last;
+};
+
+// Zustand eines Ordners laut Server bzw. lokalem Speicher
+struct ImapFolderState {
+    quint32 uidValidity = 0;
+    quint32 uidNext = 0;
+    quint64 highestModSeq = 0;
+    quint32 exists = 0;
+    quint32 unseen = 0;
+};
+
+// Übertragene Bytes auf der Leitung bzw. nach dem Entpacken
+struct ImapTrafficStats {
+    quint64 wireIn = 0;
+    quint64 wireOut = 0;
+    quint64 plainIn = 0;
+    quint64 plainOut = 0;
+};
+
+struct ImapFolderInfo {
+    QString name;
+    QChar delimiter;
+    QList<QByteArray> attributes; // z.B. \Sent, \HasChildren
+
+    bool selectable() const
+    {
+        for (const QByteArray &a : attributes) {
+            if (a.compare("\\Noselect", Qt::CaseInsensitive) == 0
+                || a.compare("\\NonExistent", Qt::CaseInsensitive) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
+// Ein Befehl in der Pipeline. Die Handler werden mit Sichten auf den
+// Parser-Puffer aufgerufen und dürfen sie nicht über den Aufruf hinaus halten.
+struct ImapCommand {
+    enum Flag {
+        NoFlags = 0x0,
+        DrainBefore = 0x1, // erst senden, wenn nichts mehr aussteht (z.B. SELECT)
+        Exclusive = 0x2,   // nichts davor und danach, bis er fertig ist (LOGIN, IDLE)
+        Sensitive = 0x4,   // nicht loggen
+        FollowUp = 0x8,    // aus done heraus: vor alle wartenden Befehle, also im selben Ordner
+    };
+
+    QByteArray text;
+    int flags = NoFlags;
+    // Getaggte Abschlussmeldung; bei Verbindungsabbruch mit leerer Antwort
+    std::function<void(const ImapResponse &)> done;
+    // Ungetaggte Antworten, die zu diesem Befehl gehören; true = verbraucht.
+    // Darf selbst keine Befehle absetzen (das geht erst in done).
+    std::function<bool(const ImapResponse &)> untagged;
+    // "+"-Fortsetzungsanforderung des Servers
+    std::function<void(const ImapResponse &)> continuation;
+    // Direkt vor dem Senden; darf text an den dann gültigen Zustand anpassen,
+    // aber keine Befehle absetzen
+    std::function<void(QByteArray *text)> sending;
+};
+
+// IMAP-Sitzung mit Befehls-Pipelining.
+//
+// Unabhängige Befehle werden ohne auf die Antwort zu warten gesendet; jede
+// getaggte Antwort wird über ihren Tag dem wartenden Befehl zugeordnet.
+// Ungetaggte Antworten gehen an den ältesten laufenden Befehl, der sie
+// beansprucht, sonst an die allgemeine Auswertung (EXISTS, FETCH, VANISHED).
+//
+// Jeder Befehl gehört zu einer Spur (lane()). Interaktive Befehle überholen
+// noch nicht gesendete Hintergrundbefehle, aber nie einen wartenden SELECT
+// oder exklusiven Befehl, damit sie im selben Ordner laufen wie ohne
+// Überholen. Von der Hintergrundspur sind höchstens backgroundWindow()
+// Befehle unterwegs, so dass ein interaktiver Befehl nicht hinter einem
+// vollen Fenster großer FETCHes auf die Leitung wartet.
 class ImapConnection : public QObject
 {
     Q_OBJECT
 
 public:
+    enum Lane { InteractiveLane, BackgroundLane, LaneCount };
+    Q_ENUM(Lane)
+
+    // Abschluss eines Befehls, auch bei Verbindungsabbruch (dann ok = false)
+    using Done = std::function<void(bool ok)>;
+
     explicit ImapConnection(QObject *parent = nullptr);
     ~ImapConnection();
 
-    void connectToServer(const QString &host, int port = 993);
+    // encrypted = false nur für lokale Testserver
+    void connectToServer(const QString &host, int port = 993, bool encrypted = true);
     void login(const QString &user, const QString &password);
-    void selectFolder(const QString &folder);
-    void fetchHeaders(int count = 50);
+    void requestCapabilities(Done done = nullptr);
+    void enable(const QByteArray &extension, Done done = nullptr);
+    void listFolders();
+    void requestStatus(const QString &folder);
+    // Mit bekanntem Zustand wird per QRESYNC nur das Delta geliefert
+    void selectFolder(const QString &folder, const ImapFolderState &known = ImapFolderState(),
+                      Done done = nullptr);
+    // toUid = 0: bis zur höchsten UID (*)
+    void fetchNewHeaders(quint32 fromUid, quint32 toUid = 0, Done done = nullptr);
+    void fetchFlagChanges(quint64 sinceModSeq, Done done = nullptr);
+    void searchAllUids(Done done = nullptr);
+    // RFC 5256 THREAD=REFERENCES für den ausgewählten Ordner
+    void fetchThreads();
+    void fetchBodyStructure(quint32 uid);
+    // Alle Abschnitte in einem Befehl; gilt für den ausgewählten Ordner
+    void fetchBodySections(quint32 uid, const QVector<ImapBodySection> &sections);
+    // Änderungen im ausgewählten Ordner; große Mengen als ein Befehl
+    void storeFlags(const QVector<UidRange> &uids, quint32 flags, bool add, Done done = nullptr);
+    // UID MOVE, ohne MOVE-Erweiterung COPY und danach löschen
+    void moveMessages(const QVector<UidRange> &uids, const QString &target, Done done = nullptr);
+    // \Deleted setzen; nur mit UIDPLUS auch entfernen (UID EXPUNGE), ein
+    // einfaches EXPUNGE nähme fremde \Deleted-Nachrichten mit
+    void expungeMessages(const QVector<UidRange> &uids, Done done = nullptr);
+    // RFC 2177; jeder weitere Befehl beendet das IDLE automatisch
+    void idle();
+    void stopIdle();
+    bool isIdling() const { return m_idleState != NotIdle; }
+    // RFC 5465, z.B. "(selected (MessageNew (UID FLAGS) MessageExpunge FlagChange))"
+    void notify(const QByteArray &events);
+    void noop();
+    // RFC 4978; nach der Anmeldung automatisch, wenn erlaubt und angeboten
+    void compress();
+    void setCompressionAllowed(bool allowed) { m_compressionAllowed = allowed; }
+    bool isCompressed() const { return bool(m_compression); }
+    const ImapTrafficStats &trafficStats() const { return m_traffic; }
     void logout();
 
+    QByteArray execute(ImapCommand command);
+    int pendingCommands() const { return m_queue.size() + m_inFlight.size(); }
+    void setMaxInFlight(int count) { m_maxInFlight = qMax(1, count); }
+
+    // Spur für alle folgenden Befehle, siehe ImapLaneScope
+    void setLane(Lane lane) { m_lane = lane; }
+    Lane lane() const { return m_lane; }
+    void setBackgroundWindow(int count) { m_backgroundWindow = qMax(1, count); }
+    int backgroundWindow() const { return m_backgroundWindow; }
+    // Wie lange folgende Befehle schon vor execute() gewartet haben, z.B. beim
+    // ImapScheduler; zählt in commandTimed() mit, siehe ImapLaneScope
+    void setHeldTime(qint64 usecs) { m_heldUsecs = usecs; }
+    qint64 heldTime() const { return m_heldUsecs; }
+    int queuedCommands(Lane lane) const { return m_queuedCount[lane]; }
+    int inFlightCommands(Lane lane) const { return m_inFlightCount[lane]; }
+
     bool isConnected() const { return m_connected; }
     bool isAuthenticated() const { return m_authenticated; }
+    bool hasCapability(const QByteArray &capability) const;
+    bool isEnabled(const QByteArray &extension) const;
+    const ImapFolderState &folderState() const { return m_folderState; }
+    // Ob der zuletzt fehlgeschlagene Befehl beim Wiederholen gelingen kann:
+    // NO ohne oder mit vorübergehendem Code wie [INUSE], nicht aber BAD oder
+    // z.B. [NOPERM], [TRYCREATE] (RFC 5530). Gilt in dessen done.
+    bool lastFailureTransient() const { return m_lastFailureTransient; }
+    QString selectedFolder() const { return m_currentFolder; }
+
+    static void parseUidSet(QByteArrayView set, QVector<UidRange> *ranges);
+    // Gegenstück zu parseUidSet: "1:5,7,9:12"
+    static QByteArray uidSet(const QVector<UidRange> &ranges);
+    // "(\Seen \Flagged)"
+    static QByteArray flagList(quint32 flags);
+    static QByteArray quoted(const QString &text);
 
 signals:
     void connected();
+    void disconnected();
     void authenticated();
+    void capabilitiesReceived();
+    void foldersListed(const QList<ImapFolderInfo> &folders);
+    void statusReceived(const QString &folder, const ImapFolderState &state);
     void folderSelected(const QString &folder, int messageCount);
     void headersReceived(const QList<EmailHeader> &headers);
+    void flagsReceived(const QVector<ImapFlagUpdate> &updates);
+    void vanished(const QVector<UidRange> &ranges);
+    // Unaufgeforderte Antworten im ausgewählten Ordner
+    void existsReceived(quint32 count);
+    void expungeReceived(quint32 seq);
+    void sequenceFlagsReceived(quint32 seq, quint32 flags);
+    void idleStarted();
+    void uidsReceived(const QVector<UidRange> &ranges);
+    void threadsReceived(const QVector<ImapThreadLink> &links);
+    void bodyStructureReceived(quint32 uid, const QByteArray &structure);
+    // Angeforderte Abschnitte mit Daten; ok = false bei NO/BAD oder Abbruch
+    void bodySectionsReceived(quint32 uid, const QVector<ImapBodySection> &sections, bool ok);
+    void commandFinished(const QString &command, bool ok);
+    // Zeit von execute() bis zur getaggten Antwort zuzüglich heldTime()
+    void commandTimed(ImapConnection::Lane lane, qint64 usecs);
     void error(const QString &message);
     void statusMessage(const QString &message);
 
 private slots:
     void onConnected();
     void onReadyRead();
+    void onDisconnected();
     void onError(QAbstractSocket::SocketError error);
     void onSslErrors(const QList<QSslError> &errors);
 
 private:
-    void sendCommand(const QString &command);
-    void processResponse(const QString &line);
-    void parseHeaders(const QString &response);
+    enum IdleState { NotIdle, IdleRequested, Idling, IdleStopping };
+
+    struct PendingCommand {
+        QByteArray tag;
+        ImapCommand command;
+        Lane lane = InteractiveLane;
+        QElapsedTimer queued;
+        qint64 held = 0; // µs vor execute()
+    };
+
+    void pump();
+    void send(const QByteArray &data);
+    void logTraffic();
+    void failPending();
+    void processResponse(const ImapResponse &response);
+    void processUntagged(const ImapResponse &response);
+    void processTagged(const ImapResponse &response);
+    void processResponseCode(QByteArrayView code);
+    void parseCapabilities(QByteArrayView list);
+    void parseFetch(const ImapResponse &response, int list);
+    void flushFetchResults();
+    // Gemeinsamer Teil von moveMessages() ohne MOVE und expungeMessages();
+    // flags für das STORE, FollowUp beim Aufruf aus done
+    void expunge(const QVector<UidRange> &uids, int flags, const QString &name, const Done &done);
+    QString addressString(const ImapResponse &response, int addressList) const;
 
     QSslSocket *m_socket;
-    QString m_buffer;
-    QString m_currentCommand;
+    ImapParser m_parser;
+    std::unique_ptr<ImapCompression> m_compression;
+    // Bis zur Antwort auf COMPRESS
+    std::unique_ptr<ImapCompression> m_pendingCompression;
+    bool m_compressionAllowed;
+    QByteArray m_wireBuffer;
+    ImapTrafficStats m_traffic;
+    quint64 m_trafficLogged;
     int m_commandTag;
+    bool m_encrypted;
     bool m_connected;
     bool m_authenticated;
-    
+    bool m_greeted;
+    IdleState m_idleState;
+    bool m_lastFailureTransient;
+
+    // Noch nicht gesendet bzw. gesendet und ohne Abschluss
+    QQueue<PendingCommand> m_queue;
+    QHash<QByteArray, PendingCommand> m_inFlight;
+    QList<QByteArray> m_inFlightOrder;
+    int m_maxInFlight;
+    bool m_exclusiveInFlight;
+    Lane m_lane;
+    qint64 m_heldUsecs;
+    int m_backgroundWindow;
+    int m_queuedCount[LaneCount];
+    int m_inFlightCount[LaneCount];
+
     QString m_user;
-    QString m_password;
     QString m_currentFolder;
-    int m_messageCount;
-    
+    ImapFolderState m_folderState;
+    QList<QByteArray> m_capabilities;
+    QList<QByteArray> m_enabled;
+
     QList<EmailHeader> m_headers;
+    QVector<ImapFlagUpdate> m_flagUpdates;
+};
+
+// Befehle innerhalb des Blocks laufen in der angegebenen Spur, z.B.
+//   ImapLaneScope lane(imap, ImapConnection::BackgroundLane);
+//   imap->fetchThreads();
+// heldUsecs: so lange hat die Arbeit schon vorher gewartet (setHeldTime())
+class ImapLaneScope
+{
+public:
+    ImapLaneScope(ImapConnection *imap, ImapConnection::Lane lane, qint64 heldUsecs = 0)
+        : m_imap(imap)
+        , m_previous(imap->lane())
+        , m_previousHeld(imap->heldTime())
+    {
+        m_imap->setLane(lane);
+        m_imap->setHeldTime(heldUsecs);
+    }
+    ~ImapLaneScope()
+    {
+        m_imap->setLane(m_previous);
+        m_imap->setHeldTime(m_previousHeld);
+    }
+
+private:
+    Q_DISABLE_COPY(ImapLaneScope)
+
+    ImapConnection *m_imap;
+    ImapConnection::Lane m_previous;
+    qint64 m_previousHeld;
 };
 
 #endif // IMAPCONNECTION_H
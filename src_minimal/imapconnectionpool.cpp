@@ -0,0 +1,129 @@
+/*
+ * mailadler - IMAP Connection Pool
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapconnectionpool.h"
+#include <QDebug>
+
+ImapConnectionPool::ImapConnectionPool(QObject *parent)
+    : QObject(parent)
+    , m_port(993)
+    , m_encrypted(true)
+    , m_maxConnections(2)
+{
+}
+
+ImapConnectionPool::~ImapConnectionPool()
+{
+    close();
+}
+
+void ImapConnectionPool::setServer(const QString &host, int port, bool encrypted)
+{
+    m_host = host;
+    m_port = port;
+    m_encrypted = encrypted;
+}
+
+void ImapConnectionPool::setCredentials(const QString &user, const QString &password)
+{
+    m_user = user;
+    m_password = password;
+}
+
+void ImapConnectionPool::open(int count)
+{
+    count = qMin(count, m_maxConnections);
+    while (m_sessions.size() < count) {
+        addSession();
+    }
+}
+
+void ImapConnectionPool::close()
+{
+    const QList<ImapConnection *> sessions = m_sessions;
+    m_sessions.clear();
+    m_idle.clear();
+    for (ImapConnection *session : sessions) {
+        session->disconnect(this);
+        if (session->isConnected()) {
+            session->logout();
+        }
+        session->deleteLater();
+    }
+}
+
+ImapConnection *ImapConnectionPool::acquire()
+{
+    return m_idle.isEmpty() ? nullptr : m_idle.takeFirst();
+}
+
+void ImapConnectionPool::release(ImapConnection *session)
+{
+    if (!m_sessions.contains(session) || m_idle.contains(session)) {
+        return;
+    }
+    if (!session->isAuthenticated()) {
+        // Wird über authenticated() wieder frei
+        return;
+    }
+    m_idle.append(session);
+    emit sessionReady(session);
+}
+
+ImapTrafficStats ImapConnectionPool::trafficStats() const
+{
+    ImapTrafficStats sum;
+    for (const ImapConnection *session : m_sessions) {
+        const ImapTrafficStats &s = session->trafficStats();
+        sum.wireIn += s.wireIn;
+        sum.wireOut += s.wireOut;
+        sum.plainIn += s.plainIn;
+        sum.plainOut += s.plainOut;
+    }
+    return sum;
+}
+
+void ImapConnectionPool::addSession()
+{
+    ImapConnection *session = new ImapConnection(this);
+    m_sessions.append(session);
+
+    connect(session, &ImapConnection::connected, this, [this, session]() {
+        session->login(m_user, m_password);
+    });
+    connect(session, &ImapConnection::authenticated, this, [this, session]() {
+        m_idle.append(session);
+        emit sessionReady(session);
+    });
+    // Getrennt, nie verbunden oder Anmeldung abgelehnt: aus dem Pool nehmen,
+    // damit open() sie ersetzen kann und Wartende von sessionLost() erfahren
+    auto lost = [this, session](const char *reason) {
+        if (!m_sessions.removeOne(session)) {
+            return;
+        }
+        qDebug().nospace() << "IMAP-Pool: Sitzung " << reason << ", " << m_sessions.size() << " verbleiben";
+        m_idle.removeOne(session);
+        session->disconnect(this);
+        emit sessionLost(session);
+        session->deleteLater();
+    };
+    connect(session, &ImapConnection::disconnected, this, [lost]() { lost("getrennt"); });
+    connect(session, &ImapConnection::commandFinished, this, [lost](const QString &command, bool ok) {
+        if (command == "LOGIN" && !ok) {
+            lost("nicht angemeldet");
+        }
+    });
+    connect(session, &ImapConnection::error, this, [this, session, lost](const QString &message) {
+        emit error(message);
+        // Verbindungsaufbau gescheitert, disconnected() kommt dann nicht.
+        // Verzögert, da der Fehler auch aus connectToServer() in open() kommen kann
+        if (!session->isConnected()) {
+            QMetaObject::invokeMethod(this, [lost]() { lost("nicht verbunden"); }, Qt::QueuedConnection);
+        }
+    });
+
+    session->connectToServer(m_host, m_port, m_encrypted);
+}
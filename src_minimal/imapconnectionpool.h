@@ -0,0 +1,65 @@
+/*
+ * mailadler - IMAP Connection Pool
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPCONNECTIONPOOL_H
+#define IMAPCONNECTIONPOOL_H
+
+#include <QList>
+#include <QObject>
+
+#include "imapconnection.h"
+
+// Mehrere angemeldete Sitzungen zu einem Konto.
+//
+// Es werden nie mehr Verbindungen geöffnet als der Provider erlaubt
+// (MailProvider::maxConnections). Freie Sitzungen werden mit acquire()
+// ausgeliehen und mit release() zurückgegeben.
+class ImapConnectionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImapConnectionPool(QObject *parent = nullptr);
+    ~ImapConnectionPool();
+
+    void setServer(const QString &host, int port = 993, bool encrypted = true);
+    void setCredentials(const QString &user, const QString &password);
+    void setMaxConnections(int count) { m_maxConnections = qMax(1, count); }
+    int maxConnections() const { return m_maxConnections; }
+
+    // Bis zu count Sitzungen öffnen (begrenzt durch maxConnections)
+    void open(int count);
+    void close();
+
+    int sessionCount() const { return int(m_sessions.size()); }
+    int idleCount() const { return int(m_idle.size()); }
+    // Freie, angemeldete Sitzung oder nullptr
+    ImapConnection *acquire();
+    void release(ImapConnection *session);
+    // Summe über alle offenen Sitzungen
+    ImapTrafficStats trafficStats() const;
+
+signals:
+    // Sitzung ist angemeldet bzw. wieder frei
+    void sessionReady(ImapConnection *session);
+    void sessionLost(ImapConnection *session);
+    void error(const QString &message);
+
+private:
+    void addSession();
+
+    QString m_host;
+    int m_port;
+    bool m_encrypted;
+    QString m_user;
+    QString m_password;
+    int m_maxConnections;
+
+    QList<ImapConnection *> m_sessions;
+    QList<ImapConnection *> m_idle;
+};
+
+#endif // IMAPCONNECTIONPOOL_H
@@ -0,0 +1,466 @@
+/*
+ * mailadler - IMAP Response Parser
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapparser.h"
+#include <cstring>
+
+namespace {
+
+const qsizetype InitialBufferSize = 64 * 1024;
+
+inline char toUpper(char c)
+{
+    return (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c;
+}
+
+inline bool isAtomChar(char c)
+{
+    switch (c) {
+    case ' ':
+    case '(':
+    case ')':
+    case '{':
+    case '"':
+    case '\r':
+    case '\n':
+        return false;
+    default:
+        return true;
+    }
+}
+
+bool isStatusWord(const char *p, qsizetype len)
+{
+    static const char *const words[] = {"OK", "NO", "BAD", "BYE", "PREAUTH"};
+    for (const char *w : words) {
+        const qsizetype wl = qsizetype(std::strlen(w));
+        if (wl != len)
+            continue;
+        qsizetype i = 0;
+        while (i < len && toUpper(p[i]) == w[i])
+            ++i;
+        if (i == len)
+            return true;
+    }
+    return false;
+}
+
+// Ende einer eckigen Klammer inklusive Verschachtelung, z.B. BODY[HEADER.FIELDS (FROM)]
+const char *skipBracket(const char *p, const char *end)
+{
+    int depth = 0;
+    for (; p < end; ++p) {
+        if (*p == '[') {
+            ++depth;
+        } else if (*p == ']') {
+            if (--depth == 0)
+                return p + 1;
+        } else if (*p == '\r' || *p == '\n') {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+// Beginnt hier eine Status- oder Fortsetzungsantwort? Deren erste Zeile endet
+// in resp-text, ein {n} am Zeilenende ist dort Freitext und kein Literal.
+bool isTextLine(const char *p, const char *end)
+{
+    if (p < end && *p == '+')
+        return true;
+    // Tag bzw. "*"
+    while (p < end && isAtomChar(*p))
+        ++p;
+    if (p >= end || *p != ' ')
+        return false;
+    const char *word = ++p;
+    while (p < end && isAtomChar(*p))
+        ++p;
+    return isStatusWord(word, p - word);
+}
+
+} // namespace
+
+int ImapResponse::child(int list, int n) const
+{
+    if (list < 0 || list >= m_count || m_tokens[list].type != ImapToken::List)
+        return -1;
+    const int end = m_tokens[list].next;
+    int i = list + 1;
+    while (i < end && n-- > 0)
+        i = m_tokens[i].next;
+    return i < end ? i : -1;
+}
+
+QByteArray ImapResponse::string(int i) const
+{
+    if (i < 0 || i >= m_count || m_tokens[i].type == ImapToken::Nil
+        || m_tokens[i].type == ImapToken::List)
+        return QByteArray();
+    const ImapToken &t = m_tokens[i];
+    const char *p = m_base + t.offset;
+    if (!t.escaped)
+        return QByteArray(p, t.length);
+
+    QByteArray result;
+    result.reserve(t.length);
+    for (quint32 k = 0; k < t.length; ++k) {
+        if (p[k] == '\\' && k + 1 < t.length)
+            ++k;
+        result.append(p[k]);
+    }
+    return result;
+}
+
+quint64 ImapResponse::number(int i, bool *ok) const
+{
+    const QByteArrayView v = view(i);
+    quint64 value = 0;
+    bool valid = !v.isEmpty() && m_tokens[i].type == ImapToken::Atom;
+    for (qsizetype k = 0; valid && k < v.size(); ++k) {
+        const char c = v[k];
+        if (c < '0' || c > '9')
+            valid = false;
+        else
+            value = value * 10 + quint64(c - '0');
+    }
+    if (ok)
+        *ok = valid;
+    return valid ? value : 0;
+}
+
+bool ImapResponse::is(int i, const char *atom) const
+{
+    if (i < 0 || i >= m_count)
+        return false;
+    const ImapToken &t = m_tokens[i];
+    if (t.type != ImapToken::Atom && t.type != ImapToken::Nil)
+        return false;
+    const char *p = m_base + t.offset;
+    quint32 k = 0;
+    for (; k < t.length && atom[k]; ++k) {
+        if (toUpper(p[k]) != toUpper(atom[k]))
+            return false;
+    }
+    return k == t.length && atom[k] == '\0';
+}
+
+QByteArrayView ImapResponse::code() const
+{
+    for (int i = 0; i < m_count; i = m_tokens[i].next) {
+        if (m_tokens[i].type == ImapToken::Code)
+            return view(i);
+    }
+    return QByteArrayView();
+}
+
+QByteArrayView ImapResponse::text() const
+{
+    for (int i = 0; i < m_count; i = m_tokens[i].next) {
+        if (m_tokens[i].type == ImapToken::Text)
+            return view(i);
+    }
+    return QByteArrayView();
+}
+
+ImapParser::ImapParser()
+    : m_end(0)
+    , m_readPos(0)
+    , m_scanPos(0)
+    , m_consumeTo(0)
+{
+    m_buffer.resize(InitialBufferSize);
+    m_tokens.reserve(256);
+    m_stack.reserve(16);
+}
+
+void ImapParser::reset()
+{
+    m_end = m_readPos = m_scanPos = m_consumeTo = 0;
+    m_tokens.clear();
+    m_stack.clear();
+    m_response = ImapResponse();
+}
+
+void ImapParser::compact()
+{
+    // Verbrauchte Antworten verwerfen. Der Puffer bleibt zusammenhängend,
+    // damit Token ohne Kopie auf Literale und Strings zeigen können; das
+    // Verschieben kostet amortisiert O(1) pro Byte.
+    m_readPos = qMax(m_readPos, m_consumeTo);
+    if (m_readPos == 0)
+        return;
+    const qsizetype pending = m_end - m_readPos;
+    if (pending > 0)
+        std::memmove(m_buffer.data(), m_buffer.constData() + m_readPos, size_t(pending));
+    m_scanPos -= m_readPos;
+    m_consumeTo = 0;
+    m_readPos = 0;
+    m_end = pending;
+}
+
+char *ImapParser::reserve(qsizetype n)
+{
+    if (m_end + n > m_buffer.size())
+        compact();
+    if (m_end + n > m_buffer.size())
+        m_buffer.resize(qMax(m_buffer.size() * 2, m_end + n));
+    return m_buffer.data() + m_end;
+}
+
+void ImapParser::commit(qsizetype n)
+{
+    Q_ASSERT(m_end + n <= m_buffer.size());
+    m_end += n;
+}
+
+void ImapParser::append(const char *data, qsizetype size)
+{
+    std::memcpy(reserve(size), data, size_t(size));
+    commit(size);
+}
+
+QByteArray ImapParser::takeUnread()
+{
+    const qsizetype from = qMax(m_consumeTo, m_readPos);
+    QByteArray rest(m_buffer.constData() + from, m_end - from);
+    m_end = from;
+    m_scanPos = qMin(m_scanPos, from);
+    return rest;
+}
+
+bool ImapParser::findResponseEnd(qsizetype *end)
+{
+    const char *buf = m_buffer.constData();
+    // m_scanPos kann hinter m_end liegen, solange ein Literal noch unvollständig ist
+    while (m_scanPos < m_end) {
+        const void *hit = std::memchr(buf + m_scanPos, '\n', size_t(m_end - m_scanPos));
+        if (!hit) {
+            m_scanPos = m_end;
+            return false;
+        }
+        const qsizetype lf = static_cast<const char *>(hit) - buf;
+        qsizetype q = lf;
+        if (q > m_readPos && buf[q - 1] == '\r')
+            --q;
+
+        // Endet die Zeile mit {n} bzw. {n+}, folgen n Bytes Literal. Im
+        // Freitext hinter OK/NO/BAD/BYE/PREAUTH bzw. "+" ist das keins; der
+        // steht nur in der ersten Zeile einer Antwort.
+        bool literal = q > m_readPos && buf[q - 1] == '}';
+        if (literal && !std::memchr(buf + m_readPos, '\n', size_t(lf - m_readPos)))
+            literal = !isTextLine(buf + m_readPos, buf + lf);
+        if (literal) {
+            qsizetype d = q - 1;
+            if (d > m_readPos && buf[d - 1] == '+')
+                --d;
+            qsizetype digitsEnd = d;
+            while (d > m_readPos && buf[d - 1] >= '0' && buf[d - 1] <= '9')
+                --d;
+            if (d < digitsEnd && d > m_readPos && buf[d - 1] == '{') {
+                qsizetype length = 0;
+                for (qsizetype k = d; k < digitsEnd && length <= MaxLiteralSize; ++k)
+                    length = length * 10 + (buf[k] - '0');
+                // Zu große Literale lässt tokenize() als fehlerhaft scheitern
+                if (length <= MaxLiteralSize) {
+                    m_scanPos = lf + 1 + length;
+                    continue;
+                }
+            }
+        }
+
+        *end = lf + 1;
+        return true;
+    }
+    return false;
+}
+
+ImapParser::Result ImapParser::next()
+{
+    if (m_consumeTo > m_readPos)
+        m_readPos = m_consumeTo;
+    if (m_scanPos < m_readPos)
+        m_scanPos = m_readPos;
+
+    qsizetype end = 0;
+    if (!findResponseEnd(&end))
+        return NeedMore;
+
+    const char *begin = m_buffer.constData() + m_readPos;
+    m_consumeTo = end;
+    m_scanPos = end;
+    if (!tokenize(begin, m_buffer.constData() + end))
+        return Malformed;
+    return Ready;
+}
+
+void ImapParser::addToken(ImapToken::Type type, const char *base, const char *p, qsizetype length)
+{
+    ImapToken t;
+    t.type = type;
+    t.escaped = false;
+    t.next = qint32(m_tokens.size()) + 1;
+    t.offset = quint32(p - base);
+    t.length = quint32(length);
+    m_tokens.push_back(t);
+}
+
+bool ImapParser::tokenize(const char *begin, const char *end)
+{
+    m_tokens.clear(); // behält die Kapazität
+    m_stack.clear();
+
+    m_response = ImapResponse();
+    m_response.m_base = begin;
+    m_response.m_size = end - begin;
+
+    // Zeilenende der letzten Zeile abschneiden
+    const char *lineEnd = end;
+    if (lineEnd > begin && lineEnd[-1] == '\n')
+        --lineEnd;
+    if (lineEnd > begin && lineEnd[-1] == '\r')
+        --lineEnd;
+
+    const char *p = begin;
+    bool textMode = false;
+    if (p < lineEnd && *p == '+') {
+        m_response.m_kind = ImapResponse::Continuation;
+        m_response.m_tag = QByteArrayView(p, 1);
+        ++p;
+        textMode = true;
+    } else if (p < lineEnd && *p == '*') {
+        m_response.m_kind = ImapResponse::Untagged;
+        m_response.m_tag = QByteArrayView(p, 1);
+        ++p;
+    } else {
+        const char *t = p;
+        while (p < lineEnd && isAtomChar(*p))
+            ++p;
+        if (p == t)
+            return false;
+        m_response.m_kind = ImapResponse::Tagged;
+        m_response.m_tag = QByteArrayView(t, p - t);
+    }
+
+    while (p < end) {
+        while (p < lineEnd && *p == ' ')
+            ++p;
+        if (p >= lineEnd)
+            break;
+
+        if (textMode) {
+            // resp-text: optionaler [Code], danach Freitext bis Zeilenende
+            if (*p == '[') {
+                const char *close = skipBracket(p, lineEnd);
+                if (!close)
+                    return false;
+                addToken(ImapToken::Code, begin, p + 1, close - p - 2);
+                p = close;
+                while (p < lineEnd && *p == ' ')
+                    ++p;
+            }
+            if (p < lineEnd)
+                addToken(ImapToken::Text, begin, p, lineEnd - p);
+            p = lineEnd;
+            break;
+        }
+
+        const char c = *p;
+        if (c == '(') {
+            m_stack.push_back(int(m_tokens.size()));
+            addToken(ImapToken::List, begin, p + 1, 0);
+            ++p;
+        } else if (c == ')') {
+            if (m_stack.empty())
+                return false;
+            ImapToken &list = m_tokens[size_t(m_stack.back())];
+            m_stack.pop_back();
+            list.next = qint32(m_tokens.size());
+            list.length = quint32(p - (begin + list.offset));
+            ++p;
+        } else if (c == '"') {
+            const char *s = ++p;
+            bool escaped = false;
+            while (p < lineEnd && *p != '"') {
+                if (*p == '\\') {
+                    escaped = true;
+                    ++p;
+                }
+                ++p;
+            }
+            if (p >= lineEnd)
+                return false;
+            addToken(ImapToken::Quoted, begin, s, p - s);
+            m_tokens.back().escaped = escaped;
+            ++p;
+        } else if (c == '{' || (c == '~' && p + 1 < lineEnd && p[1] == '{')) {
+            if (c == '~')
+                ++p;
+            ++p;
+            qsizetype length = 0;
+            const char *digits = p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                length = length * 10 + (*p - '0');
+                ++p;
+            }
+            if (p == digits || length > MaxLiteralSize)
+                return false;
+            if (p < end && *p == '+')
+                ++p;
+            if (p >= end || *p != '}')
+                return false;
+            ++p;
+            if (p < end && *p == '\r')
+                ++p;
+            if (p >= end || *p != '\n')
+                return false;
+            ++p;
+            if (end - p < length)
+                return false;
+            addToken(ImapToken::Literal, begin, p, length);
+            p += length;
+
+            // Nach dem Literal geht es in einer neuen Zeile weiter
+            lineEnd = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+            if (!lineEnd)
+                return false;
+            if (lineEnd > p && lineEnd[-1] == '\r')
+                --lineEnd;
+        } else {
+            const char *s = p;
+            while (p < lineEnd) {
+                if (*p == '[') {
+                    p = skipBracket(p, lineEnd);
+                    if (!p)
+                        return false;
+                    continue;
+                }
+                if (!isAtomChar(*p))
+                    break;
+                ++p;
+            }
+            if (p == s)
+                return false;
+            const qsizetype len = p - s;
+            const bool nil = len == 3 && toUpper(s[0]) == 'N' && toUpper(s[1]) == 'I'
+                             && toUpper(s[2]) == 'L';
+            addToken(nil ? ImapToken::Nil : ImapToken::Atom, begin, s, len);
+
+            // Nach dem Status-Wort folgt Freitext, z.B. "A0001 OK [READ-WRITE] done"
+            // oder "* 3 OK ..." kommt nicht vor, "* OK ..." und "* BYE ..." schon.
+            if (m_stack.empty() && m_tokens.size() == 1 && isStatusWord(s, len))
+                textMode = true;
+        }
+
+    }
+
+    if (!m_stack.empty())
+        return false;
+
+    m_response.m_tokens = m_tokens.data();
+    m_response.m_count = int(m_tokens.size());
+    return true;
+}
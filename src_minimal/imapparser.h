@@ -0,0 +1,133 @@
+/*
+ * mailadler - IMAP Response Parser
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPPARSER_H
+#define IMAPPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <vector>
+
+// Ein Token verweist nur auf Bytes im Empfangspuffer des Parsers (keine Kopie).
+// Listen werden flach gespeichert: die Kinder einer Liste folgen direkt auf sie,
+// "next" zeigt auf das nächste Geschwister-Token.
+struct ImapToken
+{
+    enum Type : quint8 {
+        Atom,    // auch Zahlen, Flags (\Seen) und Sektionen (BODY[1]<0>)
+        Nil,
+        Quoted,  // Inhalt ohne Anführungszeichen, ggf. mit Escapes
+        Literal, // {n}\r\n + n Bytes, auch literal8 (~{n})
+        List,    // ( ... )
+        Code,    // Response-Code [UIDVALIDITY 123] ohne Klammern
+        Text     // Freitext hinter OK/NO/BAD/BYE/PREAUTH bzw. "+"
+    };
+
+    Type type;
+    bool escaped;
+    qint32 next;
+    quint32 offset; // relativ zum Beginn der Antwort
+    quint32 length;
+};
+
+// Sicht auf eine vollständige Server-Antwort. Gültig bis zum nächsten
+// Aufruf von ImapParser::next(), reserve() oder append().
+class ImapResponse
+{
+public:
+    enum Kind { Untagged, Tagged, Continuation };
+
+    Kind kind() const { return m_kind; }
+    QByteArrayView tag() const { return m_tag; }
+    QByteArrayView raw() const { return QByteArrayView(m_base, m_size); }
+
+    int size() const { return m_count; }
+    const ImapToken &at(int i) const { return m_tokens[i]; }
+    int next(int i) const { return m_tokens[i].next; }
+    ImapToken::Type type(int i) const { return m_tokens[i].type; }
+
+    // Index des n-ten Kindes einer Liste oder -1
+    int child(int list, int n) const;
+
+    QByteArrayView view(int i) const
+    {
+        if (i < 0 || i >= m_count)
+            return QByteArrayView();
+        return QByteArrayView(m_base + m_tokens[i].offset, m_tokens[i].length);
+    }
+
+    // Kopie mit aufgelösten Escapes; NIL ergibt ein Null-QByteArray
+    QByteArray string(int i) const;
+    quint64 number(int i, bool *ok = nullptr) const;
+    bool is(int i, const char *atom) const;
+
+    // Status-Antwort (OK/NO/BAD/BYE/PREAUTH) als erstes Token?
+    bool isStatus(const char *status) const { return m_count > 0 && is(0, status); }
+    // Inhalt des Response-Codes bzw. des Freitextes, falls vorhanden
+    QByteArrayView code() const;
+    QByteArrayView text() const;
+
+private:
+    friend class ImapParser;
+
+    Kind m_kind = Untagged;
+    QByteArrayView m_tag;
+    const char *m_base = nullptr;
+    qsizetype m_size = 0;
+    const ImapToken *m_tokens = nullptr;
+    int m_count = 0;
+};
+
+// Inkrementeller Parser für Server-Antworten (RFC 3501 / 9051).
+//
+// Empfangene Bytes werden direkt in den internen Puffer gelesen (reserve/commit),
+// vollständige Antworten inklusive Literalen werden ohne Kopien in einen
+// wiederverwendeten Token-Speicher zerlegt. Im eingeschwungenen Zustand
+// finden keine Heap-Allokationen statt.
+class ImapParser
+{
+public:
+    enum Result { NeedMore, Ready, Malformed };
+
+    ImapParser();
+
+    // Schreibzeiger für bis zu n Bytes; danach commit() mit der gelesenen Menge
+    char *reserve(qsizetype n);
+    void commit(qsizetype n);
+    void append(const char *data, qsizetype size);
+
+    // Nächste vollständige Antwort zerlegen. Bei Ready/Malformed gilt die
+    // Antwort als verbraucht, sobald next() erneut aufgerufen wird.
+    Result next();
+    const ImapResponse &response() const { return m_response; }
+
+    qsizetype buffered() const { return m_end - m_readPos; }
+    // Noch nicht gelieferte Bytes herausnehmen, z.B. weil ab hier ein
+    // komprimierter Datenstrom beginnt (COMPRESS). Die aktuelle Antwort
+    // bleibt gültig.
+    QByteArray takeUnread();
+    void reset();
+
+    static constexpr qsizetype MaxLiteralSize = 1024 * 1024 * 1024;
+
+private:
+    void compact();
+    bool findResponseEnd(qsizetype *end);
+    bool tokenize(const char *begin, const char *end);
+    void addToken(ImapToken::Type type, const char *begin, const char *p, qsizetype length);
+
+    QByteArray m_buffer;
+    qsizetype m_end;       // Ende der gültigen Daten
+    qsizetype m_readPos;   // Beginn der aktuellen Antwort
+    qsizetype m_scanPos;   // bis hier wurde bereits nach Zeilenenden gesucht
+    qsizetype m_consumeTo; // Ende der zuletzt gelieferten Antwort
+
+    std::vector<ImapToken> m_tokens;
+    std::vector<int> m_stack;
+    ImapResponse m_response;
+};
+
+#endif // IMAPPARSER_H
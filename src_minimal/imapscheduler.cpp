@@ -0,0 +1,213 @@
+/*
+ * mailadler - IMAP Scheduler
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "imapscheduler.h"
+
+#include <algorithm>
+
+namespace {
+
+// Hintergrundbefehle über alle Sitzungen; jede Verbindung begrenzt zusätzlich
+// selbst (ImapConnection::backgroundWindow())
+const int DefaultMaxBackground = 8;
+
+} // namespace
+
+ImapScheduler::ImapScheduler(QObject *parent)
+    : QObject(parent)
+    , m_nextAccount(0)
+    , m_maxBackground(DefaultMaxBackground)
+    , m_dispatching(false)
+{
+    for (int lane = 0; lane < ImapConnection::LaneCount; ++lane) {
+        m_samples[lane].reserve(SampleCount);
+        m_nextSample[lane] = 0;
+        m_completed[lane] = 0;
+    }
+}
+
+void ImapScheduler::addConnection(const QString &account, ImapConnection *connection)
+{
+    if (m_accountOf.contains(connection)) {
+        return;
+    }
+    m_accountOf.insert(connection, account);
+    this->account(account)->connections.append(connection);
+
+    connect(connection, &ImapConnection::commandTimed, this, [this](ImapConnection::Lane lane, qint64 usecs) {
+        record(lane, usecs);
+        // Ein freier Platz im Hintergrundfenster
+        dispatch();
+    });
+    connect(connection, &ImapConnection::authenticated, this, &ImapScheduler::dispatch);
+    connect(connection, &QObject::destroyed, this,
+            [this, connection]() { removeConnection(connection); });
+}
+
+void ImapScheduler::removeConnection(ImapConnection *connection)
+{
+    if (!m_accountOf.contains(connection)) {
+        return;
+    }
+    const QString name = m_accountOf.take(connection);
+    connection->disconnect(this);
+    for (int i = 0; i < m_accounts.size(); ++i) {
+        Account &a = m_accounts[i];
+        if (a.name != name) {
+            continue;
+        }
+        a.connections.removeOne(connection);
+        // Die Besitzer erfahren vom Verbindungsende über ihre eigenen Befehle
+        a.jobs.erase(std::remove_if(a.jobs.begin(), a.jobs.end(),
+                                    [connection](const Pending &p) { return p.connection == connection; }),
+                     a.jobs.end());
+        if (a.connections.isEmpty()) {
+            m_accounts.removeAt(i);
+            if (m_nextAccount > i) {
+                --m_nextAccount;
+            }
+        }
+        break;
+    }
+}
+
+void ImapScheduler::submit(ImapConnection *connection, ImapConnection::Lane lane, QObject *owner, Job job)
+{
+    const auto it = m_accountOf.constFind(connection);
+    if (lane == ImapConnection::InteractiveLane || it == m_accountOf.constEnd()) {
+        // Sofort; die Verbindung sortiert nach Spur
+        ImapLaneScope scope(connection, lane);
+        job(connection);
+        return;
+    }
+    Pending pending;
+    pending.connection = connection;
+    pending.owner = owner;
+    pending.job = std::move(job);
+    pending.submitted.start();
+    account(it.value())->jobs.append(std::move(pending));
+    dispatch();
+}
+
+void ImapScheduler::cancel(QObject *owner)
+{
+    for (Account &a : m_accounts) {
+        a.jobs.erase(std::remove_if(a.jobs.begin(), a.jobs.end(),
+                                    [owner](const Pending &p) { return p.owner == owner; }),
+                     a.jobs.end());
+    }
+}
+
+void ImapScheduler::dispatch()
+{
+    // Aufträge dürfen selbst wieder submit() aufrufen
+    if (m_dispatching) {
+        return;
+    }
+    m_dispatching = true;
+
+    // Reihum je Konto ein Auftrag, solange irgendwo Platz ist
+    bool progress = true;
+    while (progress && !m_accounts.isEmpty() && backgroundLoad() < m_maxBackground) {
+        progress = false;
+        const int start = m_nextAccount;
+        const int count = int(m_accounts.size());
+        for (int n = 0; n < count && n < m_accounts.size() && backgroundLoad() < m_maxBackground; ++n) {
+            const int index = (start + n) % int(m_accounts.size());
+            QList<Pending> &jobs = m_accounts[index].jobs;
+            for (int i = 0; i < jobs.size(); ++i) {
+                if (!jobs.at(i).owner) {
+                    jobs.removeAt(i--);
+                    continue;
+                }
+                if (!hasRoom(jobs.at(i).connection)) {
+                    continue;
+                }
+                const Pending pending = jobs.takeAt(i);
+                m_nextAccount = (index + 1) % int(m_accounts.size());
+                // Die Wartezeit hier gehört zur Laufzeit seiner Befehle
+                ImapLaneScope scope(pending.connection, ImapConnection::BackgroundLane,
+                                    pending.submitted.nsecsElapsed() / 1000);
+                pending.job(pending.connection);
+                progress = true;
+                break;
+            }
+        }
+    }
+
+    m_dispatching = false;
+}
+
+bool ImapScheduler::hasRoom(const ImapConnection *connection) const
+{
+    // Erst weitergeben, wenn die Verbindung ihn auch gleich senden würde;
+    // was beim Scheduler wartet, lässt sich noch verwerfen
+    return connection->isAuthenticated()
+           && connection->queuedCommands(ImapConnection::BackgroundLane)
+                      + connection->inFlightCommands(ImapConnection::BackgroundLane)
+                  < connection->backgroundWindow();
+}
+
+int ImapScheduler::backgroundLoad() const
+{
+    int load = 0;
+    for (auto it = m_accountOf.constBegin(); it != m_accountOf.constEnd(); ++it) {
+        load += it.key()->queuedCommands(ImapConnection::BackgroundLane)
+                + it.key()->inFlightCommands(ImapConnection::BackgroundLane);
+    }
+    return load;
+}
+
+ImapScheduler::Account *ImapScheduler::account(const QString &name)
+{
+    for (Account &a : m_accounts) {
+        if (a.name == name) {
+            return &a;
+        }
+    }
+    Account a;
+    a.name = name;
+    m_accounts.append(a);
+    return &m_accounts.last();
+}
+
+void ImapScheduler::record(ImapConnection::Lane lane, qint64 usecs)
+{
+    QVector<qint64> &samples = m_samples[lane];
+    if (samples.size() < SampleCount) {
+        samples.append(usecs);
+    } else {
+        samples[m_nextSample[lane]] = usecs;
+        m_nextSample[lane] = (m_nextSample[lane] + 1) % SampleCount;
+    }
+    ++m_completed[lane];
+}
+
+ImapScheduler::LaneStats ImapScheduler::stats(ImapConnection::Lane lane) const
+{
+    LaneStats s;
+    for (auto it = m_accountOf.constBegin(); it != m_accountOf.constEnd(); ++it) {
+        s.queued += it.key()->queuedCommands(lane);
+        s.inFlight += it.key()->inFlightCommands(lane);
+    }
+    if (lane == ImapConnection::BackgroundLane) {
+        for (const Account &a : m_accounts) {
+            s.waiting += int(a.jobs.size());
+        }
+    }
+    s.completed = m_completed[lane];
+
+    QVector<qint64> samples = m_samples[lane];
+    if (!samples.isEmpty()) {
+        auto p50 = samples.begin() + samples.size() / 2;
+        std::nth_element(samples.begin(), p50, samples.end());
+        s.p50 = double(*p50) / 1000.0;
+        auto p99 = samples.begin() + samples.size() * 99 / 100;
+        std::nth_element(samples.begin(), p99, samples.end());
+        s.p99 = double(*p99) / 1000.0;
+    }
+    return s;
+}
@@ -0,0 +1,99 @@
+/*
+ * mailadler - IMAP Scheduler
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef IMAPSCHEDULER_H
+#define IMAPSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include "imapconnection.h"
+
+// Verteilt Arbeit auf die Sitzungen aller Konten nach Spuren.
+//
+// Interaktive Aufträge (Nachricht öffnen, Ordner öffnen) laufen sofort; die
+// Verbindung stellt ihre Befehle vor noch nicht gesendete Hintergrundbefehle.
+// Hintergrundaufträge (Nachladen älterer Nachrichten, Anhänge, Indexierung)
+// hält der Scheduler zurück und gibt sie erst an eine Verbindung, wenn deren
+// Hintergrundfenster frei ist, reihum ein Auftrag je Konto. Ein großer
+// Erstabgleich in einem Konto hält so die anderen nicht auf, und zwischen
+// zwei Hintergrundbefehlen kommt jeder interaktive Befehl an die Reihe.
+class ImapScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Setzt Befehle auf der übergebenen Verbindung ab
+    using Job = std::function<void(ImapConnection *)>;
+
+    struct LaneStats {
+        int waiting = 0;  // beim Scheduler zurückgehalten
+        int queued = 0;   // in den Warteschlangen der Verbindungen
+        int inFlight = 0; // gesendet, ohne Abschluss
+        quint64 completed = 0;
+        // Zeit von submit() bzw. execute() bis zum Abschluss über die letzten
+        // SampleCount Befehle, im Hintergrund mit der Wartezeit beim Scheduler
+        double p50 = 0; // ms
+        double p99 = 0; // ms
+    };
+
+    static const int SampleCount = 1024;
+
+    explicit ImapScheduler(QObject *parent = nullptr);
+
+    // Mehrfaches Anmelden schadet nicht; gelöschte Verbindungen fallen von selbst heraus
+    void addConnection(const QString &account, ImapConnection *connection);
+    void removeConnection(ImapConnection *connection);
+
+    // Wird owner gelöscht, verfallen seine noch nicht gestarteten Aufträge
+    void submit(ImapConnection *connection, ImapConnection::Lane lane, QObject *owner, Job job);
+    // Noch nicht gestartete Aufträge von owner verwerfen
+    void cancel(QObject *owner);
+    // Hintergrundbefehle über alle Verbindungen
+    void setMaxBackground(int count) { m_maxBackground = qMax(1, count); }
+
+    LaneStats stats(ImapConnection::Lane lane) const;
+
+private:
+    struct Pending {
+        ImapConnection *connection;
+        QPointer<QObject> owner;
+        Job job;
+        QElapsedTimer submitted;
+    };
+
+    struct Account {
+        QString name;
+        QList<ImapConnection *> connections;
+        QList<Pending> jobs;
+    };
+
+    void dispatch();
+    void record(ImapConnection::Lane lane, qint64 usecs);
+    bool hasRoom(const ImapConnection *connection) const;
+    int backgroundLoad() const;
+    Account *account(const QString &name);
+
+    QList<Account> m_accounts;
+    QHash<ImapConnection *, QString> m_accountOf;
+    int m_nextAccount;
+    int m_maxBackground;
+    bool m_dispatching;
+
+    // Laufzeiten in µs, Ringpuffer je Spur
+    QVector<qint64> m_samples[ImapConnection::LaneCount];
+    int m_nextSample[ImapConnection::LaneCount];
+    quint64 m_completed[ImapConnection::LaneCount];
+};
+
+#endif // IMAPSCHEDULER_H
@@ -0,0 +1,1017 @@
+/*
+ * mailadler - Mail Archive Import and Export
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "mailarchive.h"
+#include "messagestore.h"
+#include "mimedecoder.h"
+#include "storecipher.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define MAILADLER_SSE2
+#  include <emmintrin.h>
+#endif
+
+const char *const MailArchive::LocalAccount = "Lokal";
+
+namespace {
+
+// X-Mozilla-Status (Thunderbird)
+enum MozillaStatus : quint32 {
+    MozillaRead = 0x0001,
+    MozillaReplied = 0x0002,
+    MozillaMarked = 0x0004,
+    MozillaExpunged = 0x0008,
+    MozillaForwarded = 0x1000,
+};
+
+// Nächstes "\nFrom " in [p, end); end, wenn keins vollständig darin liegt.
+// Mit SSE2 werden je 16 Stellen auf '\n' gefolgt von 'F' geprüft, nur diese
+// Kandidaten noch einzeln verglichen.
+const char *findFromLine(const char *p, const char *end)
+{
+#ifdef MAILADLER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i f = _mm_set1_epi8('F');
+    while (end - p >= 16 + 5) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, newline), _mm_cmpeq_epi8(b, f)));
+        while (candidates) {
+            int i = 0;
+            while (!(candidates & (1 << i))) {
+                ++i;
+            }
+            if (std::memcmp(p + i + 1, "From ", 5) == 0) {
+                return p + i;
+            }
+            candidates &= candidates - 1;
+        }
+        p += 16;
+    }
+#endif
+    while (end - p >= 6) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p - 5));
+        if (!newline) {
+            break;
+        }
+        if (std::memcmp(newline + 1, "From ", 5) == 0) {
+            return newline;
+        }
+        p = newline + 1;
+    }
+    return end;
+}
+
+// Ende der Kopfzeilen (erste Leerzeile), sonst size
+qsizetype headerLength(QByteArrayView data)
+{
+    qsizetype pos = 0;
+    while ((pos = data.indexOf('\n', pos)) >= 0) {
+        ++pos;
+        if (pos < data.size() && data[pos] == '\n') {
+            return pos + 1;
+        }
+        if (pos + 1 < data.size() && data[pos] == '\r' && data[pos + 1] == '\n') {
+            return pos + 2;
+        }
+    }
+    return data.size();
+}
+
+// Kopfzeilen entfaltet, Namen klein geschrieben
+void forEachHeader(QByteArrayView block, const std::function<void(const QByteArray &, const QByteArray &)> &f)
+{
+    QByteArray name;
+    QByteArray value;
+    qsizetype pos = 0;
+    while (pos < block.size()) {
+        qsizetype eol = block.indexOf('\n', pos);
+        if (eol < 0) {
+            eol = block.size();
+        }
+        QByteArrayView line = block.sliced(pos, eol - pos);
+        pos = eol + 1;
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            break;
+        }
+        if (line[0] == ' ' || line[0] == '\t') {
+            value += line.toByteArray();
+            continue;
+        }
+        if (!name.isEmpty()) {
+            f(name, value.trimmed());
+        }
+        name.clear();
+        const qsizetype colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        name = line.first(colon).toByteArray().trimmed().toLower();
+        value = line.sliced(colon + 1).toByteArray();
+    }
+    if (!name.isEmpty()) {
+        f(name, value.trimmed());
+    }
+}
+
+// Erste Adresse einer Liste wie beim ENVELOPE: "Name <a@b>" bzw. "a@b"
+QString firstAddress(const QByteArray &value)
+{
+    qsizetype end = value.size();
+    bool quoted = false;
+    int angle = 0;
+    for (qsizetype i = 0; i < value.size(); ++i) {
+        const char c = value.at(i);
+        if (c == '"' && (i == 0 || value.at(i - 1) != '\\')) {
+            quoted = !quoted;
+        } else if (!quoted && c == '<') {
+            ++angle;
+        } else if (!quoted && c == '>') {
+            --angle;
+        } else if (!quoted && angle <= 0 && c == ',') {
+            end = i;
+            break;
+        }
+    }
+    const QByteArray address = value.left(end).trimmed();
+    const qsizetype open = address.lastIndexOf('<');
+    if (open < 0) {
+        return QString::fromUtf8(address);
+    }
+    const qsizetype close = address.indexOf('>', open);
+    const QString mailbox = QString::fromUtf8(address.mid(open + 1, close < 0 ? -1 : close - open - 1).trimmed());
+    QString name = MimeDecoder::decodeHeader(address.left(open)).trimmed();
+    if (name.size() >= 2 && name.startsWith('"') && name.endsWith('"')) {
+        name = name.mid(1, name.size() - 2).replace("\\\"", "\"");
+    }
+    return name.isEmpty() ? mailbox : QString("%1 <%2>").arg(name, mailbox);
+}
+
+// Alle "<...>" einer Kopfzeile, mit einem Leerzeichen getrennt
+QByteArray messageIdList(QByteArrayView value)
+{
+    QByteArray ids;
+    qsizetype pos = 0;
+    while ((pos = value.indexOf('<', pos)) >= 0) {
+        const qsizetype close = value.indexOf('>', pos);
+        if (close < 0) {
+            break;
+        }
+        if (!ids.isEmpty()) {
+            ids += ' ';
+        }
+        ids += value.sliced(pos, close + 1 - pos);
+        pos = close + 1;
+    }
+    return ids;
+}
+
+// "Mon, 3 Feb 2026 10:15:00 +0100 (CET)"
+qint64 parseDate(const QByteArray &date)
+{
+    QByteArray value = date;
+    const int comment = value.indexOf(" (");
+    if (comment > 0) {
+        value.truncate(comment);
+    }
+    const QDateTime dt = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+    return dt.isValid() ? dt.toSecsSinceEpoch() : 0;
+}
+
+// Maildir-Info ":2,FRS"; in new/ liegt nur Ungelesenes
+quint32 maildirFlags(const QString &name)
+{
+    const qsizetype info = name.lastIndexOf(QLatin1String(":2,"));
+    if (info < 0) {
+        return 0;
+    }
+    quint32 flags = 0;
+    for (const QChar c : name.mid(info + 3)) {
+        switch (c.unicode()) {
+        case 'S': flags |= FlagSeen; break;
+        case 'R': flags |= FlagAnswered; break;
+        case 'F': flags |= FlagFlagged; break;
+        case 'T': flags |= FlagDeleted; break;
+        case 'D': flags |= FlagDraft; break;
+        case 'P': flags |= FlagForwarded; break;
+        default: break;
+        }
+    }
+    return flags;
+}
+
+// Buchstaben in ASCII-Reihenfolge, wie Maildir es verlangt
+QString maildirInfo(quint32 flags)
+{
+    QString info = QStringLiteral(":2,");
+    if (flags & FlagDraft) info += 'D';
+    if (flags & FlagFlagged) info += 'F';
+    if (flags & FlagForwarded) info += 'P';
+    if (flags & FlagAnswered) info += 'R';
+    if (flags & FlagSeen) info += 'S';
+    if (flags & FlagDeleted) info += 'T';
+    return info;
+}
+
+struct ArchiveItem {
+    QString path;        // Maildir: eigene Datei, Kopfzeilen liest der Arbeiter
+    qint64 offset = 0;   // Beginn der Nachricht (nach der From_-Zeile)
+    qint64 length = 0;
+    quint32 flags = 0;
+    QByteArray headers;
+};
+
+struct ArchiveBatch {
+    QList<ArchiveItem> items;
+    QList<EmailHeader> headers; // je Eintrag, uid 0: nicht übernehmen
+    quint32 firstUid = 0;
+    qint64 progress = 0;
+};
+
+// Auf einem Arbeiter: Kopfzeilen zerlegen
+void parseBatch(ArchiveBatch *batch)
+{
+    batch->headers.reserve(batch->items.size());
+    for (int i = 0; i < batch->items.size(); ++i) {
+        ArchiveItem &item = batch->items[i];
+        EmailHeader header;
+        if (!item.path.isEmpty()) {
+            QFile file(item.path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                batch->headers.append(header);
+                continue;
+            }
+            item.length = file.size();
+            const QByteArray data = file.read(MailArchive::MaxHeaderSize);
+            item.headers = data.left(headerLength(data));
+        }
+
+        QByteArray inReplyTo;
+        quint32 flags = item.flags;
+        bool expunged = false;
+        forEachHeader(item.headers, [&](const QByteArray &name, const QByteArray &value) {
+            if (name == "subject" && header.subject.isEmpty()) {
+                header.subject = MimeDecoder::decodeHeader(value);
+            } else if (name == "from" && header.from.isEmpty()) {
+                header.from = firstAddress(value);
+            } else if (name == "to" && header.to.isEmpty()) {
+                header.to = firstAddress(value);
+            } else if (name == "date" && header.date == 0) {
+                header.date = parseDate(value);
+            } else if (name == "message-id" && header.messageId.isEmpty()) {
+                header.messageId = QString::fromLatin1(value);
+            } else if (name == "references") {
+                header.references = messageIdList(value);
+            } else if (name == "in-reply-to") {
+                inReplyTo = messageIdList(value);
+            } else if (name == "status") {
+                if (value.contains('R')) flags |= FlagSeen;
+            } else if (name == "x-status") {
+                if (value.contains('A')) flags |= FlagAnswered;
+                if (value.contains('F')) flags |= FlagFlagged;
+                if (value.contains('D')) flags |= FlagDeleted;
+                if (value.contains('T')) flags |= FlagDraft;
+            } else if (name == "x-mozilla-status") {
+                const quint32 status = value.toUInt(nullptr, 16);
+                if (status & MozillaRead) flags |= FlagSeen;
+                if (status & MozillaReplied) flags |= FlagAnswered;
+                if (status & MozillaMarked) flags |= FlagFlagged;
+                if (status & MozillaForwarded) flags |= FlagForwarded;
+                expunged = status & MozillaExpunged;
+            }
+        });
+        item.headers.clear();
+        if (expunged) {
+            batch->headers.append(header);
+            continue;
+        }
+        if (header.references.isEmpty()) {
+            header.references = inReplyTo;
+        }
+        header.uid = batch->firstUid + quint32(i);
+        header.flags = flags;
+        header.size = quint32(qMin(item.length, qint64(0xffffffff)));
+        batch->headers.append(header);
+    }
+}
+
+// Zerlegt Stapel parallel und schreibt sie im Import-Thread, in der
+// Reihenfolge ihrer Fertigstellung; die UIDs stehen schon vorher fest.
+class ImportPipeline
+{
+public:
+    ImportPipeline(MailArchive *archive, QSqlDatabase db, int mailboxId, qint64 total)
+        : m_archive(archive)
+        , m_db(db)
+        , m_mailboxId(mailboxId)
+        , m_total(total)
+        , m_inFlight(0)
+        , m_uncommitted(0)
+        , m_count(0)
+        , m_ok(true)
+        , m_message(db)
+        , m_location(db)
+        , m_file(db)
+    {
+        m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+        m_message.prepare("INSERT OR REPLACE INTO messages"
+                          " (mailbox_id, uid, flags, modseq, date, size, sender, recipient, subject, message_id, refs, structure)"
+                          " VALUES (?, ?, ?, 0, ?, ?, ?, ?, ?, ?, ?, NULL)");
+        m_location.prepare("INSERT OR REPLACE INTO archive_messages (mailbox_id, uid, file_id, start, length)"
+                           " VALUES (?, ?, ?, ?, ?)");
+        m_db.transaction();
+    }
+
+    int count() const { return m_count; }
+    bool ok() const { return m_ok; }
+
+    qint64 fileId(const QString &path, MailArchive::Format format)
+    {
+        m_file.prepare("INSERT OR IGNORE INTO archive_files (path, format) VALUES (?, ?)");
+        m_file.addBindValue(path);
+        m_file.addBindValue(int(format));
+        m_file.exec();
+        m_file.prepare("SELECT id FROM archive_files WHERE path = ?");
+        m_file.addBindValue(path);
+        return m_file.exec() && m_file.next() ? m_file.value(0).toLongLong() : -1;
+    }
+
+    void submit(ArchiveBatch *batch, qint64 fileId)
+    {
+        while (m_inFlight >= MailArchive::MaxBatchesInFlight) {
+            drain(true);
+        }
+        ++m_inFlight;
+        m_fileIds.insert(batch, fileId);
+        m_pool.start([this, batch]() {
+            parseBatch(batch);
+            QMutexLocker locker(&m_mutex);
+            m_done.append(batch);
+            m_ready.wakeOne();
+        });
+        drain(false);
+    }
+
+    void finish()
+    {
+        while (m_inFlight > 0) {
+            drain(true);
+        }
+        commit();
+    }
+
+private:
+    void drain(bool wait)
+    {
+        QList<ArchiveBatch *> batches;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (wait && m_done.isEmpty()) {
+                m_ready.wait(&m_mutex);
+            }
+            batches.swap(m_done);
+        }
+        for (ArchiveBatch *batch : std::as_const(batches)) {
+            write(batch, m_fileIds.take(batch));
+            --m_inFlight;
+            delete batch;
+        }
+    }
+
+    void write(ArchiveBatch *batch, qint64 fileId)
+    {
+        QList<EmailHeader> written;
+        written.reserve(batch->headers.size());
+        for (int i = 0; i < batch->headers.size() && m_ok; ++i) {
+            const EmailHeader &h = batch->headers.at(i);
+            const ArchiveItem &item = batch->items.at(i);
+            if (h.uid == 0) {
+                continue;
+            }
+            const qint64 file = item.path.isEmpty() ? fileId : this->fileId(item.path, MailArchive::Maildir);
+            m_message.bindValue(0, m_mailboxId);
+            m_message.bindValue(1, h.uid);
+            m_message.bindValue(2, h.flags);
+            m_message.bindValue(3, h.date);
+            m_message.bindValue(4, h.size);
+            m_message.bindValue(5, h.from);
+            m_message.bindValue(6, h.to);
+            m_message.bindValue(7, h.subject);
+            m_message.bindValue(8, h.messageId);
+            m_message.bindValue(9, QString::fromLatin1(h.references));
+            m_location.bindValue(0, m_mailboxId);
+            m_location.bindValue(1, h.uid);
+            m_location.bindValue(2, file);
+            m_location.bindValue(3, item.offset);
+            m_location.bindValue(4, item.length);
+            if (file < 0 || !m_message.exec() || !m_location.exec()) {
+                qWarning() << "MailArchive: Einfügen fehlgeschlagen:" << m_message.lastError().text()
+                           << m_location.lastError().text();
+                m_ok = false;
+                break;
+            }
+            written.append(h);
+        }
+        m_count += int(written.size());
+        m_uncommitted += int(written.size());
+        if (m_uncommitted >= MailArchive::CommitInterval) {
+            commit();
+            m_db.transaction();
+        }
+        if (!written.isEmpty()) {
+            emit m_archive->messagesImported(m_mailboxId, written);
+        }
+        emit m_archive->progress(batch->progress, m_total);
+    }
+
+    void commit()
+    {
+        // Neuer Stand für MessageStore::snapshot() und die Nachrichtenliste
+        QSqlQuery query(m_db);
+        query.prepare("UPDATE mailboxes SET generation = generation + 1 WHERE id = ?");
+        query.addBindValue(m_mailboxId);
+        query.exec();
+        if (!m_db.commit()) {
+            qWarning() << "MailArchive: Commit fehlgeschlagen:" << m_db.lastError().text();
+            m_ok = false;
+        }
+        m_uncommitted = 0;
+    }
+
+    MailArchive *m_archive;
+    QSqlDatabase m_db;
+    int m_mailboxId;
+    qint64 m_total;
+    int m_inFlight;
+    int m_uncommitted;
+    int m_count;
+    bool m_ok;
+    QSqlQuery m_message;
+    QSqlQuery m_location;
+    QSqlQuery m_file;
+    QHash<ArchiveBatch *, qint64> m_fileIds;
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_ready;
+    QList<ArchiveBatch *> m_done;
+};
+
+// Zeilen, die mit ">*From " beginnen: beim Export ein '>' davor (mboxrd),
+// beim Lesen aus einer mbox eins weg. Nur der Anfang jeder Zeile wird
+// zwischengespeichert, bis das entschieden ist.
+class FromLineFilter
+{
+public:
+    FromLineFilter(bool escape, const std::function<bool(QByteArrayView)> &sink)
+        : m_escape(escape)
+        , m_sink(sink)
+        , m_lineStart(true)
+        , m_last('\n')
+    {
+    }
+
+    bool write(QByteArrayView data)
+    {
+        const char *p = data.data();
+        const char *end = p + data.size();
+        while (p < end) {
+            if (!m_lineStart) {
+                const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+                const char *stop = newline ? newline + 1 : end;
+                if (!put(QByteArrayView(p, stop - p))) {
+                    return false;
+                }
+                m_lineStart = newline != nullptr;
+                p = stop;
+                continue;
+            }
+            m_head += *p++;
+            qsizetype quotes = 0;
+            while (quotes < m_head.size() && m_head.at(quotes) == '>') {
+                ++quotes;
+            }
+            const QByteArrayView rest = QByteArrayView(m_head).sliced(quotes);
+            if (rest.size() < 5 && QByteArrayView("From ").startsWith(rest)) {
+                continue;
+            }
+            if (!flushHead(rest.startsWith("From "))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Rest ausgeben; mit terminate endet die Ausgabe mit einem Zeilenende
+    bool finish(bool terminate)
+    {
+        if (!m_head.isEmpty() && !flushHead(false)) {
+            return false;
+        }
+        return !terminate || m_last == '\n' || put("\n");
+    }
+
+private:
+    bool flushHead(bool fromLine)
+    {
+        QByteArrayView head(m_head);
+        bool ok = true;
+        if (fromLine && m_escape) {
+            ok = put(">");
+        } else if (fromLine && head.startsWith('>')) {
+            head = head.sliced(1);
+        }
+        ok = ok && put(head);
+        m_lineStart = m_head.endsWith('\n');
+        m_head.clear();
+        return ok;
+    }
+
+    bool put(QByteArrayView data)
+    {
+        if (data.isEmpty()) {
+            return true;
+        }
+        m_last = data.back();
+        return m_sink(data);
+    }
+
+    bool m_escape;
+    std::function<bool(QByteArrayView)> m_sink;
+    bool m_lineStart;
+    char m_last;
+    QByteArray m_head;
+};
+
+// Umschlag-Absender für die From_-Zeile
+QByteArray envelopeSender(const QString &from)
+{
+    const qsizetype open = from.lastIndexOf('<');
+    const QString address = open >= 0 ? from.mid(open + 1).chopped(from.endsWith('>') ? 1 : 0) : from;
+    return address.contains('@') && !address.contains(' ') ? address.toUtf8() : QByteArray("MAILER-DAEMON");
+}
+
+// asctime() in UTC: "Mon Feb  3 10:15:00 2026"
+QByteArray fromLineDate(qint64 date)
+{
+    const QDateTime dt = QDateTime::fromSecsSinceEpoch(date, Qt::UTC);
+    const QLocale c = QLocale::c();
+    return QString("%1 %2 %3")
+        .arg(c.toString(dt, "ddd MMM"))
+        .arg(dt.date().day(), 2)
+        .arg(c.toString(dt, "hh:mm:ss yyyy"))
+        .toLatin1();
+}
+
+} // namespace
+
+MailArchive::MailArchive(MessageStore *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_thread(nullptr)
+    , m_cancel(false)
+{
+}
+
+MailArchive::~MailArchive()
+{
+    if (m_thread) {
+        m_cancel = true;
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+bool MailArchive::open()
+{
+    QSqlQuery query(m_store->database());
+    const char *statements[] = {
+        "CREATE TABLE IF NOT EXISTS archive_files ("
+        " id INTEGER PRIMARY KEY,"
+        " path TEXT NOT NULL UNIQUE,"
+        " format INTEGER NOT NULL)",
+        "CREATE TABLE IF NOT EXISTS archive_messages ("
+        " mailbox_id INTEGER NOT NULL,"
+        " uid INTEGER NOT NULL,"
+        " file_id INTEGER NOT NULL REFERENCES archive_files(id),"
+        " start INTEGER NOT NULL,"
+        " length INTEGER NOT NULL,"
+        " PRIMARY KEY (mailbox_id, uid),"
+        " FOREIGN KEY (mailbox_id, uid) REFERENCES messages(mailbox_id, uid) ON DELETE CASCADE)"
+        " WITHOUT ROWID",
+    };
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            qWarning() << "MailArchive: Schema-Fehler:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+QList<QPair<int, QString>> MailArchive::mailboxes() const
+{
+    QList<QPair<int, QString>> result;
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT id, name FROM mailboxes WHERE account = ? ORDER BY name");
+    query.addBindValue(QString::fromLatin1(LocalAccount));
+    query.exec();
+    while (query.next()) {
+        result.append({query.value(0).toInt(), query.value(1).toString()});
+    }
+    return result;
+}
+
+bool MailArchive::isLocal(int mailboxId) const
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT account FROM mailboxes WHERE id = ?");
+    query.addBindValue(mailboxId);
+    return query.exec() && query.next() && query.value(0).toString() == QLatin1String(LocalAccount);
+}
+
+bool MailArchive::contains(int mailboxId, quint32 uid) const
+{
+    return !location(mailboxId, uid).path.isEmpty();
+}
+
+MailArchive::Location MailArchive::location(int mailboxId, quint32 uid) const
+{
+    Location location;
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT f.path, f.format, a.start, a.length FROM archive_messages a"
+                  " JOIN archive_files f ON f.id = a.file_id WHERE a.mailbox_id = ? AND a.uid = ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    if (query.exec() && query.next()) {
+        location.path = query.value(0).toString();
+        location.format = Format(query.value(1).toInt());
+        location.offset = query.value(2).toLongLong();
+        location.length = query.value(3).toLongLong();
+    }
+    return location;
+}
+
+bool MailArchive::read(int mailboxId, quint32 uid, const std::function<bool(QByteArrayView)> &sink) const
+{
+    const Location l = location(mailboxId, uid);
+    return !l.path.isEmpty() && readLocation(l, sink);
+}
+
+bool MailArchive::readLocation(const Location &location, const std::function<bool(QByteArrayView)> &sink)
+{
+    QFile file(location.path);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(location.offset)) {
+        qWarning() << "MailArchive: kann" << location.path << "nicht lesen:" << file.errorString();
+        return false;
+    }
+    FromLineFilter filter(false, sink);
+    QByteArray block(int(qMin(ReadBlockSize, qMax(location.length, qint64(1)))), Qt::Uninitialized);
+    qint64 remaining = location.length;
+    while (remaining > 0) {
+        const qint64 n = file.read(block.data(), qMin(remaining, qint64(block.size())));
+        if (n <= 0) {
+            return false;
+        }
+        remaining -= n;
+        const QByteArrayView data(block.constData(), n);
+        // Nur in einer mbox ist "From " maskiert
+        if (!(location.format == Mbox ? filter.write(data) : sink(data))) {
+            return false;
+        }
+    }
+    return filter.finish(false);
+}
+
+int MailArchive::importMbox(const QString &path, const QString &folder)
+{
+    if (isBusy()) {
+        return -1;
+    }
+    const int mailboxId = m_store->mailboxId(QString::fromLatin1(LocalAccount), folder);
+    start([this, mailboxId, path]() { runImport(mailboxId, path, Mbox); });
+    return mailboxId;
+}
+
+int MailArchive::importMaildir(const QString &path, const QString &folder)
+{
+    if (isBusy()) {
+        return -1;
+    }
+    const int mailboxId = m_store->mailboxId(QString::fromLatin1(LocalAccount), folder);
+    start([this, mailboxId, path]() { runImport(mailboxId, path, Maildir); });
+    return mailboxId;
+}
+
+bool MailArchive::exportFolder(int mailboxId, const QString &path, Format format)
+{
+    if (isBusy() || !isLocal(mailboxId)) {
+        return false;
+    }
+    start([this, mailboxId, path, format]() { runExport(mailboxId, path, format); });
+    return true;
+}
+
+bool MailArchive::isBusy() const
+{
+    return m_thread != nullptr;
+}
+
+void MailArchive::cancel()
+{
+    m_cancel = true;
+}
+
+void MailArchive::start(const std::function<void()> &work)
+{
+    m_cancel = false;
+    m_thread = QThread::create(work);
+    connect(m_thread, &QThread::finished, this, [this]() {
+        m_thread->deleteLater();
+        m_thread = nullptr;
+    });
+    m_thread->start(QThread::LowPriority);
+}
+
+void MailArchive::setFlags(int mailboxId, const QVector<UidRange> &uids, quint32 flag, bool add)
+{
+    QVector<ImapFlagUpdate> updates = m_store->flags(mailboxId, uids);
+    for (ImapFlagUpdate &u : updates) {
+        u.flags = add ? (u.flags | flag) : (u.flags & ~flag);
+    }
+    m_store->updateFlags(mailboxId, updates);
+    emit flagsChanged(mailboxId, updates);
+}
+
+void MailArchive::remove(int mailboxId, const QVector<UidRange> &uids)
+{
+    // archive_messages folgt über ON DELETE CASCADE
+    m_store->removeUids(mailboxId, uids);
+    emit messagesRemoved(mailboxId, uids);
+}
+
+void MailArchive::runImport(int mailboxId, const QString &path, Format format)
+{
+    const QString name = QString("mailarchive-%1").arg(quintptr(this), 0, 16);
+    int count = 0;
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(m_store->path());
+        if (!db.open() || (m_store->cipher() && !m_store->cipher()->keyDatabase(db))) {
+            qWarning() << "MailArchive: kann" << m_store->path() << "nicht öffnen:" << db.lastError().text();
+        } else {
+            QSqlQuery query(db);
+            query.exec("PRAGMA busy_timeout = 5000");
+            query.exec("PRAGMA synchronous = NORMAL");
+            // Neue UIDs hinter den vorhandenen, in der Reihenfolge der Quelle
+            query.prepare("SELECT MAX(uid) FROM messages WHERE mailbox_id = ?");
+            query.addBindValue(mailboxId);
+            quint32 nextUid = query.exec() && query.next() ? query.value(0).toUInt() + 1 : 1;
+
+            if (format == Mbox) {
+                QFile file(path);
+                if (!file.open(QIODevice::ReadOnly) || file.peek(5) != "From ") {
+                    qWarning() << "MailArchive:" << path << "ist keine mbox-Datei";
+                } else {
+                    const qint64 size = file.size();
+                    ImportPipeline pipeline(this, db, mailboxId, size);
+                    const qint64 fileId = pipeline.fileId(QFileInfo(path).absoluteFilePath(), Mbox);
+                    ArchiveBatch *batch = nullptr;
+                    ArchiveItem current;
+                    ok = fileId >= 0;
+
+                    // Kopfzeilen ab fromLine kopieren, aus dem Fenster oder,
+                    // wenn sie darüber hinausreichen, direkt aus der Datei
+                    auto startMessage = [&](qint64 fromLine, const uchar *map, qint64 base, qint64 length) {
+                        const qint64 wanted = qMin(qint64(MaxHeaderSize + 1024), size - fromLine);
+                        QByteArray copy;
+                        QByteArrayView data;
+                        if (fromLine + wanted <= base + length) {
+                            data = QByteArrayView(reinterpret_cast<const char *>(map) + (fromLine - base), wanted);
+                        } else {
+                            file.seek(fromLine);
+                            copy = file.read(wanted);
+                            data = copy;
+                        }
+                        const qsizetype eol = data.indexOf('\n');
+                        const qsizetype body = eol < 0 ? data.size() : eol + 1;
+                        const QByteArrayView headers = data.sliced(body, qMin(data.size() - body, qsizetype(MaxHeaderSize)));
+                        current = ArchiveItem();
+                        current.offset = fromLine + body;
+                        current.headers = headers.first(headerLength(headers)).toByteArray();
+                    };
+                    auto finishMessage = [&](qint64 end) {
+                        current.length = qMax(qint64(0), end - current.offset);
+                        if (!batch) {
+                            batch = new ArchiveBatch;
+                            batch->firstUid = nextUid;
+                            batch->items.reserve(BatchSize);
+                        }
+                        batch->items.append(current);
+                        batch->progress = end;
+                        ++nextUid;
+                        if (batch->items.size() >= BatchSize) {
+                            pipeline.submit(batch, fileId);
+                            batch = nullptr;
+                        }
+                    };
+
+                    qint64 base = 0;
+                    bool first = true;
+                    while (ok && base < size && !m_cancel) {
+                        const qint64 length = qMin(WindowSize, size - base);
+                        uchar *map = file.map(base, length);
+                        if (!map) {
+                            qWarning() << "MailArchive: kann" << path << "nicht abbilden:" << file.errorString();
+                            ok = false;
+                            break;
+                        }
+                        if (first) {
+                            startMessage(0, map, base, length);
+                            first = false;
+                        }
+                        const char *begin = reinterpret_cast<const char *>(map);
+                        const char *end = begin + length;
+                        const char *p = begin;
+                        const char *hit;
+                        while ((hit = findFromLine(p, end)) != end && !m_cancel) {
+                            const qint64 at = base + (hit - begin);
+                            finishMessage(at);
+                            startMessage(at + 1, map, base, length);
+                            p = hit + 1;
+                        }
+                        file.unmap(map);
+                        if (base + length >= size) {
+                            break;
+                        }
+                        // Ein "\nFrom " über die Fenstergrenze findet das nächste Fenster
+                        base = qMax(base + qint64(p - begin), base + length - 5);
+                    }
+                    if (ok && !m_cancel) {
+                        finishMessage(size);
+                    }
+                    if (batch) {
+                        pipeline.submit(batch, fileId);
+                    }
+                    pipeline.finish();
+                    count = pipeline.count();
+                    ok = ok && pipeline.ok();
+                }
+            } else {
+                // Nach Namen sortiert, die beginnen mit der Ankunftszeit
+                QList<QPair<QString, QString>> files; // (Name, Unterordner)
+                const QDir root(path);
+                for (const char *sub : {"cur", "new"}) {
+                    const QDir dir(root.filePath(QLatin1String(sub)));
+                    for (const QString &file : dir.entryList(QDir::Files, QDir::Unsorted)) {
+                        files.append({file, QLatin1String(sub)});
+                    }
+                }
+                std::sort(files.begin(), files.end());
+                if (!root.exists("cur") && !root.exists("new")) {
+                    qWarning() << "MailArchive:" << path << "ist kein Maildir";
+                } else {
+                    ImportPipeline pipeline(this, db, mailboxId, files.size());
+                    ArchiveBatch *batch = nullptr;
+                    for (int i = 0; i < files.size() && !m_cancel; ++i) {
+                        if (!batch) {
+                            batch = new ArchiveBatch;
+                            batch->firstUid = nextUid;
+                            batch->items.reserve(BatchSize);
+                        }
+                        ArchiveItem item;
+                        item.path = root.absoluteFilePath(files.at(i).second + '/' + files.at(i).first);
+                        item.flags = files.at(i).second == QLatin1String("cur") ? maildirFlags(files.at(i).first) : 0;
+                        batch->items.append(item);
+                        batch->progress = i + 1;
+                        ++nextUid;
+                        if (batch->items.size() >= BatchSize) {
+                            pipeline.submit(batch, -1);
+                            batch = nullptr;
+                        }
+                    }
+                    if (batch) {
+                        pipeline.submit(batch, -1);
+                    }
+                    pipeline.finish();
+                    count = pipeline.count();
+                    ok = pipeline.ok();
+                }
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    qDebug() << "MailArchive:" << count << "Nachrichten aus" << path << (m_cancel ? "(abgebrochen)" : "");
+    emit finished(mailboxId, count, ok && !m_cancel);
+}
+
+void MailArchive::runExport(int mailboxId, const QString &path, Format format)
+{
+    const QString name = QString("mailarchive-%1").arg(quintptr(this), 0, 16);
+    int count = 0;
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(m_store->path());
+        if (!db.open() || (m_store->cipher() && !m_store->cipher()->keyDatabase(db))) {
+            qWarning() << "MailArchive: kann" << m_store->path() << "nicht öffnen:" << db.lastError().text();
+        } else {
+            QSqlQuery query(db);
+            query.exec("PRAGMA busy_timeout = 5000");
+            query.prepare("SELECT SUM(length) FROM archive_messages WHERE mailbox_id = ?");
+            query.addBindValue(mailboxId);
+            const qint64 total = query.exec() && query.next() ? query.value(0).toLongLong() : 0;
+
+            // Vorwärts gelesen, es liegt nie mehr als eine Zeile im Speicher
+            query.setForwardOnly(true);
+            query.prepare("SELECT m.uid, m.flags, m.date, m.sender, f.path, f.format, a.start, a.length"
+                          " FROM messages m JOIN archive_messages a ON a.mailbox_id = m.mailbox_id AND a.uid = m.uid"
+                          " JOIN archive_files f ON f.id = a.file_id WHERE m.mailbox_id = ? ORDER BY m.uid");
+            query.addBindValue(mailboxId);
+
+            QFile out(path);
+            const QDir maildir(path);
+            if (format == Mbox) {
+                ok = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            } else {
+                ok = maildir.mkpath("cur") && maildir.mkpath("new") && maildir.mkpath("tmp");
+            }
+            if (!ok) {
+                qWarning() << "MailArchive: kann" << path << "nicht schreiben";
+            }
+            ok = ok && query.exec();
+
+            const QByteArray unique = QByteArray::number(QDateTime::currentSecsSinceEpoch());
+            qint64 done = 0;
+            while (ok && !m_cancel && query.next()) {
+                const quint32 uid = query.value(0).toUInt();
+                const quint32 flags = query.value(1).toUInt();
+                Location location;
+                location.path = query.value(4).toString();
+                location.format = Format(query.value(5).toInt());
+                location.offset = query.value(6).toLongLong();
+                location.length = query.value(7).toLongLong();
+
+                if (format == Mbox) {
+                    const QByteArray from = "From " + envelopeSender(query.value(3).toString()) + ' '
+                                          + fromLineDate(query.value(2).toLongLong()) + '\n';
+                    FromLineFilter filter(true, [&out](QByteArrayView data) {
+                        return out.write(data.data(), data.size()) == data.size();
+                    });
+                    ok = out.write(from) == from.size() && readLocation(location, [&filter](QByteArrayView data) {
+                        return filter.write(data);
+                    }) && filter.finish(true) && out.write("\n", 1) == 1;
+                } else {
+                    // In tmp/ schreiben und erst vollständig nach cur/ umbenennen
+                    const QString file = QString::fromLatin1(unique + '.' + QByteArray::number(uid) + ".mailadler");
+                    QFile message(maildir.filePath("tmp/" + file));
+                    ok = message.open(QIODevice::WriteOnly) && readLocation(location, [&message](QByteArrayView data) {
+                        return message.write(data.data(), data.size()) == data.size();
+                    });
+                    message.close();
+                    ok = ok && QFile::rename(message.fileName(), maildir.filePath("cur/" + file + maildirInfo(flags)));
+                    if (!ok) {
+                        message.remove();
+                    }
+                }
+                if (!ok) {
+                    qWarning() << "MailArchive: Export von UID" << uid << "fehlgeschlagen";
+                    break;
+                }
+                ++count;
+                done += location.length;
+                if (count % BatchSize == 0) {
+                    emit progress(done, total);
+                }
+            }
+            ok = ok && (format != Mbox || out.flush());
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    emit finished(mailboxId, count, ok && !m_cancel);
+}
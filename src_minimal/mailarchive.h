@@ -0,0 +1,113 @@
+/*
+ * mailadler - Mail Archive Import and Export
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MAILARCHIVE_H
+#define MAILARCHIVE_H
+
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+#include "imapconnection.h"
+
+class MessageStore;
+class QThread;
+
+// Lokale Ordner aus mbox-Dateien und Maildir-Verzeichnissen, z.B. beim Umzug
+// von Thunderbird.
+//
+// Importierte Nachrichten bleiben, wo sie sind: archive_messages merkt sich
+// Datei, Offset und Länge, nur die Kopfzeilen kommen in den MessageStore
+// (Konto LocalAccount, Ordnername wie die Datei). Ein Archiv von vielen GB
+// belegt so keinen Platz im BodyCache und verdrängt dort nichts.
+//
+// Der Import läuft in einem eigenen Thread. Die mbox wird in Fenstern von
+// WindowSize abgebildet und per SSE2 nach "\nFrom " durchsucht; von jeder
+// Nachricht werden nur die Kopfzeilen (höchstens MaxHeaderSize) kopiert und
+// in Stapeln von BatchSize auf einem Threadpool zerlegt. Mehr als
+// MaxBatchesInFlight Stapel sind nie unterwegs, der Speicherbedarf hängt also
+// nicht von der Dateigröße ab. Geschrieben wird über eine eigene Verbindung,
+// je CommitInterval Nachrichten eine Transaktion. Von Thunderbird gelöschte,
+// aber noch nicht komprimierte Nachrichten (X-Mozilla-Status) fehlen.
+//
+// Der Export schreibt einen lokalen Ordner stückweise zurück als mbox
+// (mboxrd-Maskierung) oder Maildir (Flags im Dateinamen).
+class MailArchive : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const char *const LocalAccount;
+    static const qint64 WindowSize = 64 * 1024 * 1024;
+    static const int MaxHeaderSize = 64 * 1024;
+    static const int BatchSize = 512;
+    static const int MaxBatchesInFlight = 16;
+    static const int CommitInterval = 20000;
+    static const qint64 ReadBlockSize = 1024 * 1024;
+
+    enum Format { Mbox = 0, Maildir = 1 };
+
+    MailArchive(MessageStore *store, QObject *parent = nullptr);
+    // Bricht einen laufenden Import oder Export ab und wartet darauf
+    ~MailArchive() override;
+
+    bool open();
+
+    // Lokale Ordner (mailboxId, Name)
+    QList<QPair<int, QString>> mailboxes() const;
+    bool isLocal(int mailboxId) const;
+    bool contains(int mailboxId, quint32 uid) const;
+    // Rohe Nachricht in Blöcken an sink (ohne From_-Zeile und Maskierung);
+    // sink liefert false zum Abbrechen
+    bool read(int mailboxId, quint32 uid, const std::function<bool(QByteArrayView)> &sink) const;
+
+    // Im Hintergrund; -1 bzw. false, wenn schon ein Import oder Export läuft.
+    // Der Import liefert sonst die mailboxId des Zielordners
+    int importMbox(const QString &path, const QString &folder);
+    int importMaildir(const QString &path, const QString &folder);
+    bool exportFolder(int mailboxId, const QString &path, Format format);
+    bool isBusy() const;
+    void cancel();
+
+    // Flags und Löschen in lokalen Ordnern, ohne Server. Gelöscht wird nur der
+    // Verweis, die Quelldatei bleibt unverändert
+    void setFlags(int mailboxId, const QVector<UidRange> &uids, quint32 flag, bool add);
+    void remove(int mailboxId, const QVector<UidRange> &uids);
+
+signals:
+    void progress(qint64 done, qint64 total); // Bytes, beim Maildir-Import Dateien
+    void messagesImported(int mailboxId, const QList<EmailHeader> &headers);
+    // count: importierte bzw. exportierte Nachrichten
+    void finished(int mailboxId, int count, bool ok);
+    void flagsChanged(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void messagesRemoved(int mailboxId, const QVector<UidRange> &ranges);
+
+private:
+    struct Location {
+        QString path;
+        qint64 offset = 0;
+        qint64 length = 0;
+        Format format = Mbox;
+    };
+
+    void start(const std::function<void()> &work);
+    Location location(int mailboxId, quint32 uid) const;
+    void runImport(int mailboxId, const QString &path, Format format);
+    void runExport(int mailboxId, const QString &path, Format format);
+
+    static bool readLocation(const Location &location, const std::function<bool(QByteArrayView)> &sink);
+
+    MessageStore *m_store;
+    QThread *m_thread;
+    std::atomic<bool> m_cancel;
+};
+
+#endif // MAILARCHIVE_H
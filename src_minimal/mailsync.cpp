@@ -0,0 +1,400 @@
+/*
+ * mailadler - Folder Synchronization
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "mailsync.h"
+#include "imapscheduler.h"
+#include "messagestore.h"
+#include <QDebug>
+#include <QPointer>
+
+MailSync::MailSync(ImapConnection *imap, MessageStore *store, QObject *parent)
+    : QObject(parent)
+    , m_imap(imap)
+    , m_store(store)
+    , m_scheduler(nullptr)
+    , m_mailboxId(-1)
+    , m_step(Idle)
+    , m_run(0)
+    , m_maxUid(0)
+    , m_rangeFirst(0)
+    , m_rangeLast(0)
+    , m_floor(0)
+    , m_yield(false)
+{
+    connect(m_imap, &ImapConnection::authenticated, this, &MailSync::onAuthenticated);
+    connect(m_imap, &ImapConnection::headersReceived, this, &MailSync::onHeadersReceived);
+    connect(m_imap, &ImapConnection::flagsReceived, this, &MailSync::onFlagsReceived);
+    connect(m_imap, &ImapConnection::vanished, this, &MailSync::onVanished);
+    connect(m_imap, &ImapConnection::uidsReceived, this, &MailSync::onUidsReceived);
+}
+
+void MailSync::syncFolder(const QString &folder)
+{
+    if (m_step != Idle) {
+        qWarning() << "MailSync: Abgleich läuft bereits für" << m_folder;
+        return;
+    }
+    m_folder = folder;
+    m_mailboxId = m_store->mailboxId(m_account, folder);
+    m_known = m_store->folderState(m_mailboxId);
+    m_server = ImapFolderState();
+    m_maxUid = 0;
+    m_rangeFirst = 0;
+    m_rangeLast = 0;
+    m_floor = m_known.uidNext ? m_store->backfillFloor(m_mailboxId) : 0;
+    m_yield = false;
+    emit folderLoaded(folder, m_mailboxId);
+
+    // Ohne Anmeldung geht es in onAuthenticated() weiter
+    if (m_imap->isAuthenticated()) {
+        start();
+    }
+}
+
+void MailSync::syncRange(const QString &folder, quint32 uidValidity, quint32 first, quint32 last)
+{
+    if (m_step != Idle) {
+        qWarning() << "MailSync: Abgleich läuft bereits für" << m_folder;
+        return;
+    }
+    m_folder = folder;
+    m_mailboxId = m_store->mailboxId(m_account, folder);
+    m_known = ImapFolderState();
+    m_known.uidValidity = uidValidity;
+    m_server = ImapFolderState();
+    m_maxUid = 0;
+    m_rangeFirst = qMax<quint32>(first, 1);
+    m_rangeLast = last;
+    m_floor = 0;
+    m_yield = false;
+
+    if (m_imap->isAuthenticated()) {
+        start();
+    }
+}
+
+void MailSync::yieldBackfill()
+{
+    if (m_step != Idle) {
+        m_yield = true;
+    }
+}
+
+void MailSync::onAuthenticated()
+{
+    if (m_step == Idle && m_mailboxId >= 0) {
+        start();
+    }
+}
+
+void MailSync::start()
+{
+    ++m_run;
+    if (!m_imap->hasCapability("IMAP4rev1") && !m_imap->hasCapability("IMAP4rev2")) {
+        m_step = Capabilities;
+        m_imap->requestCapabilities(whenDone(&MailSync::onCapabilities));
+    } else if (m_imap->hasCapability("QRESYNC") && !m_imap->isEnabled("QRESYNC")) {
+        m_step = Enable;
+        m_imap->enable("QRESYNC", whenDone(&MailSync::onEnabled));
+    } else {
+        select();
+    }
+}
+
+ImapConnection::Done MailSync::whenDone(void (MailSync::*handler)(bool ok))
+{
+    QPointer<MailSync> self(this);
+    const quint64 run = m_run;
+    return [self, run, handler](bool ok) {
+        if (self && self->m_run == run && self->m_step != Idle) {
+            (self.data()->*handler)(ok);
+        }
+    };
+}
+
+void MailSync::onCapabilities(bool ok)
+{
+    if (!ok) {
+        fail();
+    } else if (m_imap->hasCapability("QRESYNC")) {
+        m_step = Enable;
+        m_imap->enable("QRESYNC", whenDone(&MailSync::onEnabled));
+    } else {
+        select();
+    }
+}
+
+void MailSync::onEnabled(bool)
+{
+    // Ohne QRESYNC geht es mit CONDSTORE bzw. vollem Abgleich weiter
+    select();
+}
+
+void MailSync::select()
+{
+    m_step = Select;
+    m_imap->selectFolder(m_folder, m_known, whenDone(&MailSync::onSelected));
+}
+
+void MailSync::onSelected(bool ok)
+{
+    if (ok) {
+        afterSelect();
+    } else {
+        fail();
+    }
+}
+
+void MailSync::onFlagChanges(bool ok)
+{
+    if (ok) {
+        afterFlagChanges();
+    } else {
+        fail();
+    }
+}
+
+void MailSync::onUidsSearched(bool ok)
+{
+    if (ok) {
+        fetchNew();
+    } else {
+        fail();
+    }
+}
+
+void MailSync::onChunkFetched(bool ok)
+{
+    if (ok) {
+        chunkFinished();
+    } else {
+        fail();
+    }
+}
+
+void MailSync::afterSelect()
+{
+    m_server = m_imap->folderState();
+
+    if (m_rangeLast) {
+        // Der Plan beruht auf dieser UIDVALIDITY, sonst passt der Bereich nicht
+        if (m_server.uidValidity != m_known.uidValidity) {
+            qWarning() << "MailSync: UIDVALIDITY von" << m_folder << "während des Abgleichs geändert";
+            fail();
+            return;
+        }
+        m_step = NewMessages;
+        m_chunks.clear();
+        m_requested = {{{m_rangeFirst, m_rangeLast}, false}};
+        m_imap->fetchNewHeaders(m_rangeFirst, m_rangeLast, whenDone(&MailSync::onChunkFetched));
+        return;
+    }
+
+    if (m_known.uidValidity != m_server.uidValidity) {
+        if (m_known.uidValidity) {
+            qDebug() << "MailSync: UIDVALIDITY von" << m_folder << "geändert, lade neu";
+        }
+        m_store->resetMailbox(m_mailboxId, m_server.uidValidity);
+        m_known = ImapFolderState();
+        m_known.uidValidity = m_server.uidValidity;
+        m_floor = 0;
+        emit mailboxReset(m_mailboxId);
+    }
+
+    if (!m_known.uidNext) {
+        // Erster Abgleich: alles holen
+        fetchNew();
+    } else if (m_imap->isEnabled("QRESYNC") && m_known.highestModSeq) {
+        // Flags und VANISHED kamen bereits mit dem SELECT
+        fetchNew();
+    } else if (m_server.highestModSeq && m_known.highestModSeq) {
+        if (m_server.highestModSeq == m_known.highestModSeq) {
+            afterFlagChanges();
+        } else {
+            m_step = FlagChanges;
+            m_imap->fetchFlagChanges(m_known.highestModSeq, whenDone(&MailSync::onFlagChanges));
+        }
+    } else {
+        m_step = FlagChanges;
+        m_imap->fetchFlagChanges(0, whenDone(&MailSync::onFlagChanges));
+    }
+}
+
+void MailSync::afterFlagChanges()
+{
+    // Unveränderte Anzahl und kein neuer UIDNEXT: nichts gelöscht
+    const quint32 stored = quint32(m_store->messageCount(m_mailboxId));
+    if (m_server.exists == stored && m_server.uidNext == m_known.uidNext && !m_floor) {
+        finish();
+        return;
+    }
+    m_step = Expunged;
+    m_imap->searchAllUids(whenDone(&MailSync::onUidsSearched));
+}
+
+void MailSync::fetchNew()
+{
+    const quint32 from = m_known.uidNext ? m_known.uidNext : 1;
+    m_chunks.clear();
+    m_requested.clear();
+    if (!m_server.uidNext) {
+        // Obergrenze unbekannt: ein Befehl bis *
+        m_chunks.append({{from, 0}, false});
+    } else if (from < m_server.uidNext) {
+        // Beim Erstabgleich ist alles Nachladen, auch das erste Stück
+        planChunks(from, m_server.uidNext - 1, !m_known.uidNext);
+    }
+    if (m_floor > 1) {
+        planChunks(1, m_floor - 1, true);
+    }
+    if (m_chunks.isEmpty()) {
+        finish();
+        return;
+    }
+
+    // Das neueste Stück sofort, damit die Liste oben stimmt
+    m_step = NewMessages;
+    const Chunk first = m_chunks.takeFirst();
+    m_requested.append(first);
+    m_imap->fetchNewHeaders(first.range.first, first.range.last, whenDone(&MailSync::onChunkFetched));
+    requestChunks();
+}
+
+void MailSync::planChunks(quint32 first, quint32 last, bool backfill)
+{
+    // Etwa ChunkSize Nachrichten je Stück, auch bei lückenhaften UIDs
+    quint64 span = ChunkSize;
+    if (m_server.exists && m_server.uidNext > 1) {
+        span = qMax<quint64>(span, quint64(ChunkSize) * (m_server.uidNext - 1) / m_server.exists);
+    }
+    quint64 high = last;
+    while (true) {
+        const quint64 low = high - first + 1 > span ? high - span + 1 : first;
+        m_chunks.append({{quint32(low), quint32(high)}, backfill});
+        if (low == first) {
+            break;
+        }
+        high = low - 1;
+    }
+}
+
+void MailSync::requestChunks()
+{
+    while (!m_chunks.isEmpty() && m_requested.size() < ChunksAhead) {
+        // Nachladen steht immer hinten, ab hier entfällt alles
+        if (m_yield && m_chunks.first().backfill) {
+            m_chunks.clear();
+            break;
+        }
+        const Chunk chunk = m_chunks.takeFirst();
+        m_requested.append(chunk);
+        const UidRange range = chunk.range;
+        const ImapConnection::Done done = whenDone(&MailSync::onChunkFetched);
+        if (m_scheduler) {
+            m_scheduler->submit(m_imap, ImapConnection::BackgroundLane, this, [range, done](ImapConnection *imap) {
+                imap->fetchNewHeaders(range.first, range.last, done);
+            });
+        } else {
+            ImapLaneScope lane(m_imap, ImapConnection::BackgroundLane);
+            m_imap->fetchNewHeaders(range.first, range.last, done);
+        }
+    }
+}
+
+void MailSync::chunkFinished()
+{
+    // Die Verbindung schließt die Stücke in der angeforderten Reihenfolge ab
+    if (!m_requested.isEmpty()) {
+        const Chunk done = m_requested.takeFirst();
+        if (done.backfill) {
+            m_floor = done.range.first;
+        }
+    }
+    requestChunks();
+    if (m_requested.isEmpty()) {
+        finish();
+    }
+}
+
+void MailSync::finish()
+{
+    m_chunks.clear();
+    m_requested.clear();
+    m_yield = false;
+    if (m_rangeLast) {
+        m_step = Idle;
+        m_rangeLast = 0;
+        emit finished(m_folder, true);
+        return;
+    }
+
+    ImapFolderState state = m_server;
+    if (!state.uidNext) {
+        state.uidNext = qMax(m_known.uidNext, m_maxUid + 1);
+    }
+    // Erst die Lücke, dann UIDNEXT: bricht das Programm dazwischen ab, beginnt
+    // der nächste Abgleich höchstens von vorn
+    m_store->setBackfillFloor(m_mailboxId, m_floor > 1 ? m_floor : 0);
+    m_store->setFolderState(m_mailboxId, state);
+    m_step = Idle;
+    emit folderSynced(m_folder, m_mailboxId);
+    emit finished(m_folder, true);
+}
+
+void MailSync::fail()
+{
+    if (m_scheduler) {
+        m_scheduler->cancel(this);
+    }
+    m_chunks.clear();
+    m_requested.clear();
+    m_yield = false;
+    m_step = Idle;
+    m_rangeLast = 0;
+    emit finished(m_folder, false);
+}
+
+void MailSync::onHeadersReceived(const QList<EmailHeader> &headers)
+{
+    if (!ownsSession()) {
+        return;
+    }
+    for (const EmailHeader &h : headers) {
+        m_maxUid = qMax(m_maxUid, h.uid);
+    }
+    m_store->storeHeaders(m_mailboxId, headers);
+    emit messagesAdded(m_mailboxId, headers);
+}
+
+bool MailSync::ownsSession() const
+{
+    // Eine freie Pool-Sitzung kann inzwischen für anderes (z.B. das
+    // OperationJournal) einen anderen Ordner ausgewählt haben
+    return m_mailboxId >= 0 && (m_step != Idle || m_imap->selectedFolder() == m_folder);
+}
+
+void MailSync::onFlagsReceived(const QVector<ImapFlagUpdate> &updates)
+{
+    if (ownsSession()) {
+        m_store->updateFlags(m_mailboxId, updates);
+        emit flagsChanged(m_mailboxId, updates);
+    }
+}
+
+void MailSync::onVanished(const QVector<UidRange> &ranges)
+{
+    if (ownsSession()) {
+        m_store->removeUids(m_mailboxId, ranges);
+        emit messagesRemoved(m_mailboxId, ranges);
+    }
+}
+
+void MailSync::onUidsReceived(const QVector<UidRange> &ranges)
+{
+    if (m_step == Expunged) {
+        emit messagesRemoved(m_mailboxId, m_store->removeUidsNotIn(m_mailboxId, ranges));
+    }
+}
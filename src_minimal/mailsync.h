@@ -0,0 +1,130 @@
+/*
+ * mailadler - Folder Synchronization
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MAILSYNC_H
+#define MAILSYNC_H
+
+#include <QObject>
+
+#include "imapconnection.h"
+
+class ImapScheduler;
+class MessageStore;
+
+// Gleicht einen Ordner inkrementell mit dem lokalen Speicher ab.
+//
+// Mit QRESYNC liefert schon das SELECT alle Flag-Änderungen und gelöschten
+// UIDs; danach werden nur UIDs ab dem gespeicherten UIDNEXT geholt. Ohne
+// QRESYNC wird per CONDSTORE (CHANGEDSINCE) bzw. vollständigem Flag-Abgleich
+// und UID SEARCH nachgezogen.
+//
+// Neue Nachrichten kommen in Stücken, die neuesten zuerst: das erste Stück
+// in der Spur der Verbindung, alle weiteren als Hintergrundaufträge. Ein
+// Erstabgleich lässt sich mit yieldBackfill() nach dem ersten Stück beenden;
+// was darunter fehlt, merkt sich MessageStore::backfillFloor() und der
+// nächste Abgleich lädt es nach.
+class MailSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    MailSync(ImapConnection *imap, MessageStore *store, QObject *parent = nullptr);
+
+    void setAccount(const QString &account) { m_account = account; }
+    // Ohne Scheduler gehen spätere Stücke direkt in die Hintergrundspur
+    void setScheduler(ImapScheduler *scheduler) { m_scheduler = scheduler; }
+    void syncFolder(const QString &folder);
+    // Nur die Kopfzeilen [first, last] holen, ohne den Ordnerzustand zu
+    // speichern; für die Aufteilung eines Erstabgleichs auf mehrere Sitzungen
+    void syncRange(const QString &folder, quint32 uidValidity, quint32 first, quint32 last);
+    bool isBusy() const { return m_step != Idle; }
+    // Keine älteren Nachrichten mehr anfordern; der Abgleich endet nach den
+    // schon angeforderten Stücken, z.B. weil ein anderer Ordner geöffnet wird
+    void yieldBackfill();
+    ImapConnection *connection() const { return m_imap; }
+
+signals:
+    // Lokaler Stand ist sofort verfügbar, noch bevor der Server antwortet
+    void folderLoaded(const QString &folder, int mailboxId);
+    void folderSynced(const QString &folder, int mailboxId);
+    // Ende jedes Abgleichs, auch bei Fehlern und für syncRange()
+    void finished(const QString &folder, bool ok);
+    // UIDVALIDITY geändert, lokaler Inhalt wurde verworfen
+    void mailboxReset(int mailboxId);
+    // Bereits gespeicherte Änderungen, z.B. für MessageListModel
+    void messagesAdded(int mailboxId, const QList<EmailHeader> &headers);
+    void flagsChanged(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void messagesRemoved(int mailboxId, const QVector<UidRange> &ranges);
+
+private slots:
+    void onAuthenticated();
+    void onHeadersReceived(const QList<EmailHeader> &headers);
+    void onFlagsReceived(const QVector<ImapFlagUpdate> &updates);
+    void onVanished(const QVector<UidRange> &ranges);
+    void onUidsReceived(const QVector<UidRange> &ranges);
+
+private:
+    enum Step { Idle, Capabilities, Enable, Select, FlagChanges, Expunged, NewMessages };
+
+    // UIDs je Stück bei gleichmäßig verteilten UIDs
+    static const quint32 ChunkSize = 1000;
+    // Gleichzeitig angeforderte Stücke
+    static const int ChunksAhead = 2;
+
+    struct Chunk {
+        UidRange range; // last = 0: bis *
+        // Unterhalb des lückenlosen Bereichs, entfällt bei yieldBackfill()
+        bool backfill;
+    };
+
+    void start();
+    // Abschluss eines Befehls dieses Abgleichs; nach dessen Ende oder einem
+    // neuen Abgleich wird er ignoriert
+    ImapConnection::Done whenDone(void (MailSync::*handler)(bool ok));
+    void onCapabilities(bool ok);
+    void onEnabled(bool ok);
+    void onSelected(bool ok);
+    void onFlagChanges(bool ok);
+    void onUidsSearched(bool ok);
+    void onChunkFetched(bool ok);
+    void select();
+    void afterSelect();
+    void afterFlagChanges();
+    void fetchNew();
+    // [first, last] absteigend in Stücke teilen
+    void planChunks(quint32 first, quint32 last, bool backfill);
+    void requestChunks();
+    void chunkFinished();
+    void finish();
+    void fail();
+    // Antworten gehören zum Abgleich bzw. zum zuletzt abgeglichenen Ordner
+    bool ownsSession() const;
+
+    ImapConnection *m_imap;
+    MessageStore *m_store;
+    ImapScheduler *m_scheduler;
+    QString m_account;
+    QString m_folder;
+    int m_mailboxId;
+    Step m_step;
+    // Zählt die Abgleiche, siehe whenDone()
+    quint64 m_run;
+    ImapFolderState m_known;
+    ImapFolderState m_server;
+    quint32 m_maxUid;
+    // Nur bei syncRange()
+    quint32 m_rangeFirst;
+    quint32 m_rangeLast;
+
+    // Noch nicht angefordert bzw. angefordert, in der Reihenfolge der Abschlüsse
+    QList<Chunk> m_chunks;
+    QList<Chunk> m_requested;
+    // Älteste UID, ab der alles geladen ist; 0 = keine Lücke
+    quint32 m_floor;
+    bool m_yield;
+};
+
+#endif // MAILSYNC_H
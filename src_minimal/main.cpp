@@ -10,32 +10,102 @@
 #include <QToolBar>
 #include <QDockWidget>
 #include <QTreeWidget>
-#include <QTableWidget>
-#include <QTextEdit>
+#include <QTableView>
+#include <QTextBrowser>
+#include <QTextDocumentFragment>
+#include <QFileDialog>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QHeaderView>
+#include <QScrollBar>
 #include <QMessageBox>
 #include <QSettings>
+#include <QLocale>
+#include <QTimer>
+#include <QDebug>
+#include <QElapsedTimer>
 
 #include <QInputDialog>
+#include <QLineEdit>
 
 #include "imapconnection.h"
 #include "accountsettings.h"
+#include "messagestore.h"
+#include "mailsync.h"
+#include "imapconnectionpool.h"
+#include "imapscheduler.h"
+#include "parallelsync.h"
+#include "idlewatcher.h"
+#include "messagelistmodel.h"
+#include "searchindex.h"
+#include "attachmentindexer.h"
+#include "bodycache.h"
+#include "messageloader.h"
+#include "bodyprefetcher.h"
+#include "threadbuilder.h"
+#include "outbox.h"
+#include "operationjournal.h"
+#include "mailarchive.h"
+#include "storecipher.h"
+
+#include <memory>
 
 class MailAdlerWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    MailAdlerWindow(QWidget *parent = nullptr) : QMainWindow(parent)
+    // cipher: entsperrt oder nullptr für einen unverschlüsselten Speicher,
+    // muss das Fenster überleben
+    MailAdlerWindow(const StoreCipher *cipher = nullptr, QWidget *parent = nullptr)
+        : QMainWindow(parent)
+        , m_cipher(cipher)
     {
         setWindowTitle(tr("mailadler - E-Mail Client"));
         resize(1200, 800);
 
         m_imap = new ImapConnection(this);
+        m_store = new MessageStore();
+        m_store->setCipher(m_cipher);
+        if (!m_store->open()) {
+            QMessageBox::warning(this, tr("Speicherfehler"),
+                tr("Der lokale Nachrichtenspeicher konnte nicht geöffnet werden."));
+        }
+        m_scheduler = new ImapScheduler(this);
+        m_sync = new MailSync(m_imap, m_store, this);
+        m_sync->setScheduler(m_scheduler);
+        m_pool = new ImapConnectionPool(this);
+        m_parallelSync = new ParallelSync(m_pool, m_store, this);
+        m_parallelSync->setScheduler(m_scheduler);
+        m_journal = new OperationJournal(m_pool, m_store, this);
+        m_journal->open();
+        m_watcher = new IdleWatcher(m_store, this);
+        m_messageModel = new MessageListModel(m_store, this);
+        m_messageModel->setThreads(&m_threads);
+        m_bodyCache = new BodyCache(m_store, QString(), m_cipher);
+        m_bodyCache->open();
+        m_loader = new MessageLoader(m_imap, m_store, m_bodyCache, this);
+        m_archive = new MailArchive(m_store, this);
+        m_archive->open();
+        m_loader->setArchive(m_archive);
+        m_prefetcher = new BodyPrefetcher(m_loader, m_messageModel, this);
+        m_outbox = new Outbox(m_store, QString(), this);
+        m_outbox->open();
+        m_searchIndex = new SearchIndex(m_store->path(), this);
+        m_searchIndex->setCipher(m_cipher);
+        if (!m_searchIndex->open()) {
+            statusBar()->showMessage(tr("Volltextsuche nicht verfügbar"));
+        }
+        m_attachmentIndexer = new AttachmentIndexer(m_store, m_bodyCache, m_searchIndex, this);
+        m_attachmentIndexer->setPool(m_pool);
+        m_attachmentIndexer->open();
+        // Jede Eingabe bremst die Anhangindexierung
+        qApp->installEventFilter(this);
         connectImapSignals();
 
         setupMenus();
@@ -51,6 +121,18 @@ public:
         }
     }
 
+    ~MailAdlerWindow()
+    {
+        qApp->removeEventFilter(this);
+        // Vor dem MessageStore, ein laufender Import endet hier
+        delete m_archive;
+        // Vor Pool und BodyCache, laufende Extraktionen enden hier
+        delete m_attachmentIndexer;
+        delete m_outbox;
+        delete m_bodyCache;
+        delete m_store;
+    }
+
 private slots:
     void onNewMail()
     {
@@ -74,8 +156,40 @@ private slots:
             return;
         }
 
+        if (m_sync->isBusy()) {
+            return;
+        }
+        m_scheduler->addConnection(email, m_imap);
+        // Lokalen Stand sofort zeigen, der Abgleich folgt ggf. nach der Anmeldung
+        m_sync->setAccount(email);
+        m_sync->syncFolder(m_currentFolder);
+        if (m_imap->isAuthenticated()) {
+            return;
+        }
         m_imap->connectToServer(server, port);
         m_pendingPassword = password;
+
+        // Weitere Sitzungen: eine für Push (IDLE/NOTIFY), der Rest für den
+        // Abgleich der übrigen Ordner; die Hauptverbindung zählt mit
+        const int limit = providerForServer(server).maxConnections;
+        m_watchSessions = limit > 2 ? 1 : 0;
+        m_pool->setServer(server, port);
+        m_pool->setCredentials(email, password);
+        m_pool->setMaxConnections(limit - 1 - m_watchSessions);
+        m_watcher->pool()->setServer(server, port);
+        m_watcher->pool()->setCredentials(email, password);
+        m_watcher->setAccount(email);
+        m_journal->setAccount(email);
+        m_journal->start();
+
+        // Ausgang: Einlieferung per STARTTLS, Port 465 mit implizitem TLS
+        const MailProvider provider = providerForServer(server);
+        if (!provider.smtpServer.isEmpty()) {
+            m_outbox->client()->setServer(provider.smtpServer, provider.smtpPort,
+                                          provider.smtpPort == 465 ? SmtpClient::Tls : SmtpClient::StartTls);
+            m_outbox->client()->setCredentials(email, password);
+            m_outbox->start();
+        }
     }
 
     void onAccountSettings()
@@ -94,54 +208,309 @@ private slots:
         m_pendingPassword.clear();
     }
 
-    void onImapAuthenticated()
+    void onAuthenticated()
     {
-        QString folder = m_pendingFolder.isEmpty() ? "INBOX" : m_pendingFolder;
-        m_pendingFolder.clear();
-        m_imap->selectFolder(folder);
+        m_imap->listFolders();
+        // Neue Nachrichten im Posteingang ohne Abruf
+        if (m_watchSessions > 0) {
+            m_watcher->watch(QStringList() << "INBOX");
+        }
     }
 
-    void onFolderSelected(const QString &folder, int count)
+    void onWatchedFolderChanged(const QString &folder)
     {
-        Q_UNUSED(folder)
-        Q_UNUSED(count)
-        m_imap->fetchHeaders(50);
+        if (!m_parallelSync->isBusy()) {
+            m_parallelSync->syncFolders(QStringList() << folder);
+        }
     }
 
-    void onHeadersReceived(const QList<EmailHeader> &headers)
+    void onFoldersListed(const QList<ImapFolderInfo> &folders)
     {
-        m_mailTable->setRowCount(0);
-        
-        for (const auto &h : headers) {
-            int row = m_mailTable->rowCount();
-            m_mailTable->insertRow(row);
-            
-            // Ungelesen-Markierung
-            QString prefix = h.seen ? "" : "📧 ";
-            
-            auto *fromItem = new QTableWidgetItem(prefix + h.from);
-            if (!h.seen) {
-                QFont font = fromItem->font();
-                font.setBold(true);
-                fromItem->setFont(font);
+        // STATUS für alle Ordner auf einmal, die Antworten kommen gebündelt
+        QStringList others;
+        for (const ImapFolderInfo &info : folders) {
+            if (!info.selectable()) {
+                continue;
             }
-            m_mailTable->setItem(row, 0, fromItem);
-            
-            auto *subjectItem = new QTableWidgetItem(h.subject);
-            if (!h.seen) {
-                QFont font = subjectItem->font();
-                font.setBold(true);
-                subjectItem->setFont(font);
+            if (info.name != m_currentFolder) {
+                others.append(info.name);
             }
-            m_mailTable->setItem(row, 1, subjectItem);
-            
-            m_mailTable->setItem(row, 2, new QTableWidgetItem(h.date));
-            
-            // UID speichern
-            m_mailTable->item(row, 0)->setData(Qt::UserRole, h.uid);
+            if (!folderItem(info.name)) {
+                QTreeWidgetItem *item = new QTreeWidgetItem(m_folderTree, QStringList() << info.name);
+                item->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
+                item->setData(0, Qt::UserRole, info.name);
+                item->setData(0, FolderLabelRole, info.name);
+            }
+            m_imap->requestStatus(info.name);
         }
-        
-        statusBar()->showMessage(tr("%1 Nachrichten").arg(headers.size()));
+
+        // Der aktuelle Ordner läuft über die Hauptverbindung
+        if (!m_parallelSync->isBusy()) {
+            QSettings settings;
+            m_parallelSync->setAccount(settings.value("Account/email").toString());
+            m_parallelSync->syncFolders(others);
+        }
+    }
+
+    void onSyncProgress(int done, int total)
+    {
+        statusBar()->showMessage(tr("Ordnerabgleich: %1 von %2").arg(done).arg(total));
+    }
+
+    void onStatusReceived(const QString &folder, const ImapFolderState &state)
+    {
+        QTreeWidgetItem *item = folderItem(folder);
+        if (!item) return;
+        const QString label = item->data(0, FolderLabelRole).toString();
+        item->setText(0, state.unseen ? QString("%1 (%2)").arg(label).arg(state.unseen) : label);
+    }
+
+    void onFolderLoaded(const QString &folder, int mailboxId)
+    {
+        Q_UNUSED(folder)
+        const QSignalBlocker blocker(m_searchEdit);
+        m_searchEdit->clear();
+        QElapsedTimer timer;
+        timer.start();
+        m_threads.load(m_store, mailboxId);
+        m_threadMailbox = mailboxId;
+        qDebug() << "Unterhaltungen:" << m_threads.messageCount() << "Nachrichten in" << timer.elapsed() << "ms";
+        m_messageModel->setMailbox(mailboxId);
+    }
+
+    void onFolderSynced(const QString &folder, int mailboxId)
+    {
+        Q_UNUSED(folder)
+        statusBar()->showMessage(tr("%1 Nachrichten").arg(m_store->messageCount(mailboxId)));
+        // Der Server kennt auch Nachrichten, deren References lokal fehlen
+        if (mailboxId == m_threadMailbox && m_imap->hasCapability("THREAD=REFERENCES")) {
+            ImapLaneScope lane(m_imap, ImapConnection::BackgroundLane);
+            m_imap->fetchThreads();
+        }
+    }
+
+    void onThreadsReceived(const QVector<ImapThreadLink> &links)
+    {
+        if (m_imap->selectedFolder() != m_currentFolder || m_threadMailbox != m_messageModel->mailboxId()) return;
+        m_threads.applyServerThreads(links);
+        m_messageModel->threadsChanged();
+    }
+
+    void onShowThread()
+    {
+        const QModelIndex current = m_mailTable->currentIndex();
+        if (!current.isValid() || m_threadMailbox != m_messageModel->mailboxId()) return;
+        const QVector<quint32> uids = m_threads.threadUids(m_messageModel->uid(current.row()));
+        m_messageModel->showSearchResults(m_threadMailbox, uids);
+        statusBar()->showMessage(tr("Unterhaltung mit %1 Nachrichten").arg(uids.size()));
+    }
+
+    // Markieren, Verschieben und Löschen wirken sofort lokal, der Server
+    // folgt über das Journal
+    QVector<UidRange> selectedUids() const
+    {
+        QVector<UidRange> ranges;
+        if (m_messageModel->mailboxId() < 0) return ranges;
+        for (const QModelIndex &index : m_mailTable->selectionModel()->selectedRows()) {
+            const quint32 uid = m_messageModel->uid(index.row());
+            ranges.append({uid, uid});
+        }
+        OperationJournal::normalize(&ranges);
+        return ranges;
+    }
+
+    void onMarkSeen(bool seen)
+    {
+        if (localFolderShown()) {
+            m_archive->setFlags(m_messageModel->mailboxId(), selectedUids(), FlagSeen, seen);
+            return;
+        }
+        m_journal->setFlags(m_currentFolder, selectedUids(), FlagSeen, seen);
+    }
+
+    void onToggleFlagged()
+    {
+        const QVector<UidRange> uids = selectedUids();
+        if (uids.isEmpty()) return;
+        // Wie andere Programme: sind schon alle gekennzeichnet, entfernen
+        bool allFlagged = true;
+        for (const ImapFlagUpdate &u : m_store->flags(m_messageModel->mailboxId(), uids)) {
+            allFlagged = allFlagged && (u.flags & FlagFlagged);
+        }
+        if (localFolderShown()) {
+            m_archive->setFlags(m_messageModel->mailboxId(), uids, FlagFlagged, !allFlagged);
+            return;
+        }
+        m_journal->setFlags(m_currentFolder, uids, FlagFlagged, !allFlagged);
+    }
+
+    void onMoveMessages()
+    {
+        const QVector<UidRange> uids = selectedUids();
+        if (uids.isEmpty()) return;
+        if (localFolderShown()) {
+            statusBar()->showMessage(tr("Nachrichten lokaler Ordner lassen sich nicht verschieben"));
+            return;
+        }
+        QStringList folders;
+        for (int i = 0; i < m_folderTree->topLevelItemCount(); ++i) {
+            const QString folder = m_folderTree->topLevelItem(i)->data(0, Qt::UserRole).toString();
+            if (!folder.isEmpty() && folder != m_currentFolder) folders << folder;
+        }
+        bool ok = false;
+        const QString target = QInputDialog::getItem(this, tr("Verschieben"), tr("Zielordner:"), folders, 0, false, &ok);
+        if (ok && !target.isEmpty()) {
+            m_journal->move(m_currentFolder, uids, target);
+        }
+    }
+
+    void onDeleteMessages()
+    {
+        const QVector<UidRange> uids = selectedUids();
+        if (uids.isEmpty()) return;
+        // Lokal nur der Verweis, die mbox bzw. das Maildir bleibt
+        if (localFolderShown()) {
+            m_archive->remove(m_messageModel->mailboxId(), uids);
+            return;
+        }
+        // Erst in den Papierkorb, dort endgültig
+        if (m_currentFolder == QLatin1String("Trash")) {
+            m_journal->expunge(m_currentFolder, uids);
+        } else {
+            m_journal->move(m_currentFolder, uids, "Trash");
+        }
+    }
+
+    void onSearch()
+    {
+        const int mailboxId = m_messageModel->mailboxId();
+        const QString text = m_searchEdit->text().trimmed();
+        if (mailboxId < 0) return;
+        if (text.isEmpty()) {
+            m_messageModel->setMailbox(mailboxId);
+            return;
+        }
+        const QVector<SearchHit> hits = m_searchIndex->search(text, 500, mailboxId);
+        QVector<quint32> uids;
+        uids.reserve(hits.size());
+        for (const SearchHit &hit : hits) {
+            uids.append(hit.uid);
+        }
+        m_messageModel->showSearchResults(mailboxId, uids);
+        statusBar()->showMessage(tr("%1 Treffer").arg(uids.size()));
+    }
+
+    void onImportMbox()
+    {
+        const QString path = QFileDialog::getOpenFileName(this, tr("mbox importieren"));
+        if (path.isEmpty()) return;
+        // Thunderbird: Dateien ohne Endung, "Inbox", "Sent" usw.
+        const QString folder = QFileInfo(path).fileName();
+        const int mailboxId = m_archive->importMbox(path, folder);
+        if (mailboxId < 0) {
+            statusBar()->showMessage(tr("Es läuft bereits ein Import oder Export"));
+            return;
+        }
+        addLocalFolder(mailboxId, folder);
+    }
+
+    void onImportMaildir()
+    {
+        const QString path = QFileDialog::getExistingDirectory(this, tr("Maildir importieren"));
+        if (path.isEmpty()) return;
+        const QString folder = QDir(path).dirName();
+        const int mailboxId = m_archive->importMaildir(path, folder);
+        if (mailboxId < 0) {
+            statusBar()->showMessage(tr("Es läuft bereits ein Import oder Export"));
+            return;
+        }
+        addLocalFolder(mailboxId, folder);
+    }
+
+    void onExportFolder()
+    {
+        if (!localFolderShown()) {
+            QMessageBox::information(this, tr("Ordner exportieren"),
+                tr("Exportieren lassen sich lokale Ordner. Bitte zuerst einen auswählen."));
+            return;
+        }
+        bool ok = false;
+        const QStringList formats{tr("mbox-Datei"), tr("Maildir-Verzeichnis")};
+        const QString format = QInputDialog::getItem(this, tr("Ordner exportieren"), tr("Format:"), formats, 0, false, &ok);
+        if (!ok) return;
+        const QString path = QFileDialog::getSaveFileName(this, tr("Ordner exportieren"));
+        if (path.isEmpty()) return;
+        if (!m_archive->exportFolder(m_messageModel->mailboxId(), path,
+                                     format == formats.first() ? MailArchive::Mbox : MailArchive::Maildir)) {
+            statusBar()->showMessage(tr("Es läuft bereits ein Import oder Export"));
+        }
+    }
+
+    void onEncryptStore()
+    {
+        if (m_cipher) {
+            QMessageBox::information(this, tr("Speicher verschlüsseln"),
+                tr("Der lokale Speicher ist bereits verschlüsselt."));
+            return;
+        }
+        if (!StoreCipher::hasSqlCipher(m_store->database())) {
+            QMessageBox::warning(this, tr("Speicher verschlüsseln"),
+                tr("Der lokale Speicher kann nicht verschlüsselt werden: "
+                   "der SQLite-Treiber wurde ohne SQLCipher gebaut."));
+            return;
+        }
+        bool ok = false;
+        const QString passphrase = QInputDialog::getText(this, tr("Speicher verschlüsseln"),
+            tr("Passwort für den lokalen Speicher:"), QLineEdit::Password, QString(), &ok);
+        if (!ok || passphrase.isEmpty()) return;
+        const QString repeated = QInputDialog::getText(this, tr("Speicher verschlüsseln"),
+            tr("Passwort wiederholen:"), QLineEdit::Password, QString(), &ok);
+        if (!ok) return;
+        if (repeated != passphrase) {
+            QMessageBox::warning(this, tr("Speicher verschlüsseln"), tr("Die Passwörter stimmen nicht überein."));
+            return;
+        }
+        // Nur Salz und Prüfwert; verschlüsselt wird beim nächsten Start
+        const QString keyFile = MessageStore::defaultPath() + ".key";
+        StoreCipher cipher;
+        if (!cipher.create(keyFile, passphrase)) {
+            QMessageBox::warning(this, tr("Speicher verschlüsseln"),
+                tr("Die Schlüsseldatei konnte nicht angelegt werden."));
+            return;
+        }
+        QSettings().setValue("Storage/encrypt", true);
+        QMessageBox::information(this, tr("Speicher verschlüsseln"),
+            tr("Der lokale Speicher wird beim nächsten Start verschlüsselt. "
+               "Ohne das Passwort sind die gespeicherten Nachrichten nicht mehr lesbar."));
+    }
+
+    void onArchiveProgress(qint64 done, qint64 total)
+    {
+        statusBar()->showMessage(tr("Import/Export: %1 %").arg(total ? done * 100 / total : 0));
+    }
+
+    void onArchiveFinished(int mailboxId, int count, bool ok)
+    {
+        statusBar()->showMessage(ok ? tr("%1 Nachrichten übertragen").arg(count)
+                                    : tr("Import/Export nach %1 Nachrichten abgebrochen").arg(count));
+        // Geschrieben über eine eigene Verbindung: Liste und Unterhaltungen neu laden
+        if (mailboxId == m_messageModel->mailboxId()) {
+            onFolderLoaded(QString(), mailboxId);
+        }
+    }
+
+    void onOutboxSent(qint64 id)
+    {
+        Q_UNUSED(id)
+        const int pending = m_outbox->pendingCount();
+        statusBar()->showMessage(pending ? tr("Nachricht gesendet, %1 im Ausgang").arg(pending)
+                                         : tr("Nachricht gesendet"));
+    }
+
+    void onOutboxFailed(qint64 id, const QString &message)
+    {
+        Q_UNUSED(id)
+        statusBar()->showMessage(tr("Senden fehlgeschlagen: %1").arg(message));
     }
 
     void onImapError(const QString &msg)
@@ -154,35 +523,298 @@ private slots:
         statusBar()->showMessage(msg);
     }
 
-    void onMailSelected(int row, int column)
+    void onMailSelected(const QModelIndex &index)
     {
-        Q_UNUSED(column)
-        if (row < 0) return;
+        if (!index.isValid()) return;
+        const int row = index.row();
         
-        QString from = m_mailTable->item(row, 0)->text();
-        QString subject = m_mailTable->item(row, 1)->text();
-        QString date = m_mailTable->item(row, 2)->text();
+        QString from = m_messageModel->index(row, MessageListModel::FromColumn).data().toString();
+        QString subject = m_messageModel->index(row, MessageListModel::SubjectColumn).data().toString();
+        QString date = m_messageModel->index(row, MessageListModel::DateColumn).data().toString();
         
-        m_preview->setHtml(QString(
+        m_previewHeader = QString(
             "<h2>%1</h2>"
             "<p><b>Von:</b> %2<br>"
             "<b>Datum:</b> %3</p>"
             "<hr>"
-            "<p><i>Nachrichteninhalt wird in Phase C geladen...</i></p>"
-        ).arg(subject.toHtmlEscaped(), from.toHtmlEscaped(), date.toHtmlEscaped()));
+        ).arg(subject.toHtmlEscaped(), from.toHtmlEscaped(), date.toHtmlEscaped());
+        m_preview->setHtml(m_previewHeader + tr("<p><i>Wird geladen...</i></p>"));
+
+        m_previewMailbox = m_messageModel->mailboxId();
+        m_previewUid = m_messageModel->uid(row);
+        m_attachments.clear();
+        m_prefetcher->selected(row);
+        m_loader->load(m_previewMailbox, m_previewUid);
+    }
+
+    void updateViewport()
+    {
+        const int first = qMax(0, m_mailTable->rowAt(0));
+        const int last = m_mailTable->rowAt(m_mailTable->viewport()->height() - 1);
+        m_prefetcher->viewportChanged(first, last < 0 ? m_messageModel->rowCount() - 1 : last);
+    }
+
+    void onMessageLoaded(int mailboxId, quint32 uid, const QString &text, bool html,
+                         const QVector<MimePart> &attachments)
+    {
+        const QString plain = html ? QTextDocumentFragment::fromHtml(text).toPlainText() : text;
+        m_searchIndex->addBody(mailboxId, uid, plain);
+        if (mailboxId != m_previewMailbox || uid != m_previewUid) return;
+
+        m_attachments = attachments;
+        QString body = html ? text : "<pre style=\"white-space: pre-wrap\">" + text.toHtmlEscaped() + "</pre>";
+        if (!attachments.isEmpty()) {
+            const QLocale locale;
+            body += "<hr><p><b>" + tr("Anhänge:") + "</b><br>";
+            for (int i = 0; i < attachments.size(); ++i) {
+                const MimePart &part = attachments.at(i);
+                const QString name = part.filename.isEmpty()
+                    ? QString::fromLatin1(part.type + '/' + part.subtype) : part.filename;
+                body += QString("<a href=\"anhang:%1\">%2</a> (%3)<br>")
+                    .arg(i).arg(name.toHtmlEscaped(), locale.formattedDataSize(part.size));
+            }
+            body += "</p>";
+        }
+        m_preview->setHtml(m_previewHeader + body);
+        m_prefetcher->rendered(mailboxId, uid);
+    }
+
+    void onPreviewLinkClicked(const QUrl &url)
+    {
+        if (url.scheme() != "anhang") return;
+        const int i = url.path().toInt();
+        if (i < 0 || i >= m_attachments.size()) return;
+        m_loader->fetchAttachment(m_previewMailbox, m_previewUid, m_attachments.at(i));
+    }
+
+    void onAttachmentProgress(int mailboxId, quint32 uid, const QByteArray &section, qint64 received, qint64 total)
+    {
+        Q_UNUSED(mailboxId)
+        Q_UNUSED(uid)
+        Q_UNUSED(section)
+        const QLocale locale;
+        statusBar()->showMessage(tr("Anhang: %1 von %2")
+            .arg(locale.formattedDataSize(received), locale.formattedDataSize(total)));
+    }
+
+    void onAttachmentReady(int mailboxId, quint32 uid, const QByteArray &section)
+    {
+        if (mailboxId != m_previewMailbox || uid != m_previewUid) return;
+        for (const MimePart &part : std::as_const(m_attachments)) {
+            if (part.section != section) continue;
+            const QString path = QFileDialog::getSaveFileName(this, tr("Anhang speichern"), part.filename);
+            if (path.isEmpty()) return;
+            QFile file(path);
+            if (!file.open(QIODevice::WriteOnly) || !m_loader->saveAttachment(mailboxId, uid, part, &file)) {
+                QMessageBox::warning(this, tr("Anhang"), tr("Der Anhang konnte nicht gespeichert werden."));
+            }
+            return;
+        }
+    }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        switch (event->type()) {
+        case QEvent::KeyPress:
+        case QEvent::MouseButtonPress:
+        case QEvent::Wheel:
+            m_attachmentIndexer->userActive();
+            break;
+        default:
+            break;
+        }
+        return QMainWindow::eventFilter(watched, event);
     }
 
 private:
+    // Anzeigename ohne Ungelesen-Zähler
+    static const int FolderLabelRole = Qt::UserRole + 1;
+    // mailboxId eines lokalen Ordners (MailArchive)
+    static const int LocalMailboxRole = Qt::UserRole + 2;
+
+    bool localFolderShown() const
+    {
+        return m_archive->isLocal(m_messageModel->mailboxId());
+    }
+
+    void addLocalFolder(int mailboxId, const QString &name)
+    {
+        for (int i = 0; i < m_localFolders->childCount(); ++i) {
+            if (m_localFolders->child(i)->data(0, LocalMailboxRole).toInt() == mailboxId) return;
+        }
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_localFolders, QStringList() << name);
+        item->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
+        item->setData(0, LocalMailboxRole, mailboxId);
+        m_localFolders->setHidden(false);
+        m_localFolders->setExpanded(true);
+    }
+
+    QTreeWidgetItem *folderItem(const QString &folder) const
+    {
+        for (int i = 0; i < m_folderTree->topLevelItemCount(); ++i) {
+            QTreeWidgetItem *item = m_folderTree->topLevelItem(i);
+            if (item->data(0, Qt::UserRole).toString() == folder) {
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
     void connectImapSignals()
     {
         connect(m_imap, &ImapConnection::connected, 
                 this, &MailAdlerWindow::onImapConnected);
         connect(m_imap, &ImapConnection::authenticated, 
-                this, &MailAdlerWindow::onImapAuthenticated);
-        connect(m_imap, &ImapConnection::folderSelected, 
-                this, &MailAdlerWindow::onFolderSelected);
-        connect(m_imap, &ImapConnection::headersReceived, 
-                this, &MailAdlerWindow::onHeadersReceived);
+                this, &MailAdlerWindow::onAuthenticated);
+        connect(m_imap, &ImapConnection::foldersListed, 
+                this, &MailAdlerWindow::onFoldersListed);
+        connect(m_imap, &ImapConnection::statusReceived, 
+                this, &MailAdlerWindow::onStatusReceived);
+        connect(m_sync, &MailSync::folderLoaded, 
+                this, &MailAdlerWindow::onFolderLoaded);
+        connect(m_sync, &MailSync::folderSynced, 
+                this, &MailAdlerWindow::onFolderSynced);
+        connect(m_sync, &MailSync::finished, 
+                this, &MailAdlerWindow::onSyncFinished);
+        // Sitzungen des Pools teilen sich das Hintergrundfenster mit der Hauptverbindung
+        connect(m_pool, &ImapConnectionPool::sessionReady, this, [this](ImapConnection *session) {
+            m_scheduler->addConnection(QSettings().value("Account/email").toString(), session);
+        });
+        connect(m_pool, &ImapConnectionPool::sessionLost, 
+                m_scheduler, &ImapScheduler::removeConnection);
+        connect(m_sync, &MailSync::mailboxReset, 
+                m_messageModel, &MessageListModel::setMailbox);
+        connect(m_sync, &MailSync::messagesAdded, 
+                m_messageModel, &MessageListModel::addMessages);
+        connect(m_sync, &MailSync::flagsChanged, 
+                m_messageModel, &MessageListModel::updateFlags);
+        connect(m_sync, &MailSync::messagesRemoved, 
+                m_messageModel, &MessageListModel::removeMessages);
+        connect(m_parallelSync, &ParallelSync::mailboxReset, 
+                m_messageModel, &MessageListModel::setMailbox);
+        connect(m_parallelSync, &ParallelSync::messagesAdded, 
+                m_messageModel, &MessageListModel::addMessages);
+        connect(m_parallelSync, &ParallelSync::flagsChanged, 
+                m_messageModel, &MessageListModel::updateFlags);
+        connect(m_parallelSync, &ParallelSync::messagesRemoved, 
+                m_messageModel, &MessageListModel::removeMessages);
+        connect(m_watcher, &IdleWatcher::messagesAdded, 
+                m_messageModel, &MessageListModel::addMessages);
+        connect(m_watcher, &IdleWatcher::flagsChanged, 
+                m_messageModel, &MessageListModel::updateFlags);
+        connect(m_watcher, &IdleWatcher::messagesRemoved, 
+                m_messageModel, &MessageListModel::removeMessages);
+        connect(m_journal, &OperationJournal::flagsChanged, 
+                m_messageModel, &MessageListModel::updateFlags);
+        connect(m_journal, &OperationJournal::messagesRemoved, 
+                m_messageModel, &MessageListModel::removeMessages);
+        connect(m_archive, &MailArchive::flagsChanged, 
+                m_messageModel, &MessageListModel::updateFlags);
+        connect(m_archive, &MailArchive::messagesRemoved, 
+                m_messageModel, &MessageListModel::removeMessages);
+        connect(m_archive, &MailArchive::progress, 
+                this, &MailAdlerWindow::onArchiveProgress);
+        connect(m_archive, &MailArchive::finished, 
+                this, &MailAdlerWindow::onArchiveFinished);
+        connect(m_watcher, &IdleWatcher::folderChanged, 
+                this, &MailAdlerWindow::onWatchedFolderChanged);
+        // Volltextindex folgt dem lokalen Speicher
+        connect(m_sync, &MailSync::messagesAdded, 
+                m_searchIndex, &SearchIndex::addMessages);
+        connect(m_sync, &MailSync::messagesRemoved, 
+                m_searchIndex, &SearchIndex::removeMessages);
+        connect(m_sync, &MailSync::mailboxReset, 
+                m_searchIndex, &SearchIndex::removeMailbox);
+        connect(m_parallelSync, &ParallelSync::messagesAdded, 
+                m_searchIndex, &SearchIndex::addMessages);
+        connect(m_parallelSync, &ParallelSync::messagesRemoved, 
+                m_searchIndex, &SearchIndex::removeMessages);
+        connect(m_parallelSync, &ParallelSync::mailboxReset, 
+                m_searchIndex, &SearchIndex::removeMailbox);
+        connect(m_watcher, &IdleWatcher::messagesAdded, 
+                m_searchIndex, &SearchIndex::addMessages);
+        connect(m_watcher, &IdleWatcher::messagesRemoved, 
+                m_searchIndex, &SearchIndex::removeMessages);
+        connect(m_journal, &OperationJournal::messagesRemoved, 
+                m_searchIndex, &SearchIndex::removeMessages);
+        connect(m_archive, &MailArchive::messagesImported, 
+                m_searchIndex, &SearchIndex::addMessages);
+        connect(m_archive, &MailArchive::messagesRemoved, 
+                m_searchIndex, &SearchIndex::removeMessages);
+        connect(m_sync, &MailSync::messagesAdded, 
+                m_attachmentIndexer, &AttachmentIndexer::addMessages);
+        connect(m_sync, &MailSync::messagesRemoved, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMessages);
+        connect(m_sync, &MailSync::mailboxReset, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMailbox);
+        connect(m_parallelSync, &ParallelSync::messagesAdded, 
+                m_attachmentIndexer, &AttachmentIndexer::addMessages);
+        connect(m_parallelSync, &ParallelSync::messagesRemoved, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMessages);
+        connect(m_parallelSync, &ParallelSync::mailboxReset, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMailbox);
+        connect(m_watcher, &IdleWatcher::messagesAdded, 
+                m_attachmentIndexer, &AttachmentIndexer::addMessages);
+        connect(m_watcher, &IdleWatcher::messagesRemoved, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMessages);
+        connect(m_journal, &OperationJournal::messagesRemoved, 
+                m_attachmentIndexer, &AttachmentIndexer::removeMessages);
+        connect(m_loader, &MessageLoader::attachmentReady, 
+                m_attachmentIndexer, &AttachmentIndexer::attachmentReady);
+        // Zwischengespeicherte Inhalte gelöschter Nachrichten freigeben
+        auto dropBodies = [this](int mailboxId, const QVector<UidRange> &ranges) {
+            m_bodyCache->removeMessages(mailboxId, ranges);
+        };
+        auto dropMailbox = [this](int mailboxId) {
+            m_bodyCache->removeMailbox(mailboxId);
+        };
+        connect(m_sync, &MailSync::messagesRemoved, this, dropBodies);
+        connect(m_sync, &MailSync::mailboxReset, this, dropMailbox);
+        connect(m_parallelSync, &ParallelSync::messagesRemoved, this, dropBodies);
+        connect(m_parallelSync, &ParallelSync::mailboxReset, this, dropMailbox);
+        connect(m_journal, &OperationJournal::messagesRemoved, this, dropBodies);
+        connect(m_watcher, &IdleWatcher::messagesRemoved, this, dropBodies);
+        connect(m_loader, &MessageLoader::messageLoaded, 
+                this, &MailAdlerWindow::onMessageLoaded);
+        connect(m_loader, &MessageLoader::attachmentProgress, 
+                this, &MailAdlerWindow::onAttachmentProgress);
+        connect(m_loader, &MessageLoader::attachmentReady, 
+                this, &MailAdlerWindow::onAttachmentReady);
+        connect(m_loader, &MessageLoader::error, 
+                this, &MailAdlerWindow::onImapStatus);
+        // Unterhaltungen des angezeigten Ordners nachführen
+        auto threadAdd = [this](int mailboxId, const QList<EmailHeader> &headers) {
+            if (mailboxId != m_threadMailbox) return;
+            m_threads.add(headers);
+            m_messageModel->threadsChanged();
+        };
+        auto threadRemove = [this](int mailboxId, const QVector<UidRange> &ranges) {
+            if (mailboxId != m_threadMailbox) return;
+            m_threads.remove(ranges);
+            m_messageModel->threadsChanged();
+        };
+        auto threadReset = [this](int mailboxId) {
+            if (mailboxId == m_threadMailbox) m_threads.clear();
+        };
+        connect(m_sync, &MailSync::messagesAdded, this, threadAdd);
+        connect(m_sync, &MailSync::messagesRemoved, this, threadRemove);
+        connect(m_sync, &MailSync::mailboxReset, this, threadReset);
+        connect(m_parallelSync, &ParallelSync::messagesAdded, this, threadAdd);
+        connect(m_parallelSync, &ParallelSync::messagesRemoved, this, threadRemove);
+        connect(m_parallelSync, &ParallelSync::mailboxReset, this, threadReset);
+        connect(m_watcher, &IdleWatcher::messagesAdded, this, threadAdd);
+        connect(m_watcher, &IdleWatcher::messagesRemoved, this, threadRemove);
+        connect(m_journal, &OperationJournal::messagesRemoved, this, threadRemove);
+        connect(m_archive, &MailArchive::messagesRemoved, this, threadRemove);
+        connect(m_imap, &ImapConnection::threadsReceived, 
+                this, &MailAdlerWindow::onThreadsReceived);
+        connect(m_parallelSync, &ParallelSync::progress, 
+                this, &MailAdlerWindow::onSyncProgress);
+        connect(m_outbox, &Outbox::sent, 
+                this, &MailAdlerWindow::onOutboxSent);
+        connect(m_outbox, &Outbox::failed, 
+                this, &MailAdlerWindow::onOutboxFailed);
         connect(m_imap, &ImapConnection::error, 
                 this, &MailAdlerWindow::onImapError);
         connect(m_imap, &ImapConnection::statusMessage, 
@@ -198,6 +830,12 @@ private:
         fileMenu->addSeparator();
         fileMenu->addAction(tr("Konto einrichten..."), this, &MailAdlerWindow::onAccountSettings);
         fileMenu->addSeparator();
+        fileMenu->addAction(tr("mbox importieren..."), this, &MailAdlerWindow::onImportMbox);
+        fileMenu->addAction(tr("Maildir importieren..."), this, &MailAdlerWindow::onImportMaildir);
+        fileMenu->addAction(tr("Ordner exportieren..."), this, &MailAdlerWindow::onExportFolder);
+        fileMenu->addSeparator();
+        fileMenu->addAction(tr("Speicher verschlüsseln..."), this, &MailAdlerWindow::onEncryptStore);
+        fileMenu->addSeparator();
         fileMenu->addAction(tr("Beenden"), QKeySequence::Quit, this, &QMainWindow::close);
 
         // Bearbeiten-Menü
@@ -213,8 +851,14 @@ private:
         QMenu *msgMenu = menuBar()->addMenu(tr("&Nachricht"));
         msgMenu->addAction(tr("Antworten"), QKeySequence(Qt::CTRL | Qt::Key_R), this, []() {});
         msgMenu->addAction(tr("Weiterleiten"), QKeySequence(Qt::CTRL | Qt::Key_F), this, []() {});
+        msgMenu->addAction(tr("Unterhaltung anzeigen"), QKeySequence(Qt::CTRL | Qt::Key_T), this, &MailAdlerWindow::onShowThread);
+        msgMenu->addSeparator();
+        msgMenu->addAction(tr("Als gelesen markieren"), QKeySequence(Qt::CTRL | Qt::Key_M), this, [this]() { onMarkSeen(true); });
+        msgMenu->addAction(tr("Als ungelesen markieren"), QKeySequence(Qt::CTRL | Qt::Key_U), this, [this]() { onMarkSeen(false); });
+        msgMenu->addAction(tr("Kennzeichnen"), QKeySequence(Qt::CTRL | Qt::Key_G), this, &MailAdlerWindow::onToggleFlagged);
+        msgMenu->addAction(tr("Verschieben..."), QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_V), this, &MailAdlerWindow::onMoveMessages);
         msgMenu->addSeparator();
-        msgMenu->addAction(tr("Löschen"), QKeySequence::Delete, this, []() {});
+        msgMenu->addAction(tr("Löschen"), QKeySequence::Delete, this, &MailAdlerWindow::onDeleteMessages);
 
         // Hilfe-Menü
         QMenu *helpMenu = menuBar()->addMenu(tr("&Hilfe"));
@@ -242,7 +886,21 @@ private:
         toolbar->addAction(tr("Antworten"));
         toolbar->addAction(tr("Weiterleiten"));
         toolbar->addSeparator();
-        toolbar->addAction(tr("Löschen"));
+        auto *deleteAction = toolbar->addAction(tr("Löschen"));
+        connect(deleteAction, &QAction::triggered, this, &MailAdlerWindow::onDeleteMessages);
+        toolbar->addSeparator();
+
+        // Suche im aktuellen Ordner, schon während des Tippens
+        m_searchEdit = new QLineEdit();
+        m_searchEdit->setPlaceholderText(tr("Suchen (von:, betreff:)"));
+        m_searchEdit->setClearButtonEnabled(true);
+        m_searchEdit->setMaximumWidth(300);
+        toolbar->addWidget(m_searchEdit);
+        m_searchTimer = new QTimer(this);
+        m_searchTimer->setSingleShot(true);
+        m_searchTimer->setInterval(150);
+        connect(m_searchEdit, &QLineEdit::textChanged, m_searchTimer, qOverload<>(&QTimer::start));
+        connect(m_searchTimer, &QTimer::timeout, this, &MailAdlerWindow::onSearch);
     }
 
     void setupDocks()
@@ -256,22 +914,35 @@ private:
         QTreeWidgetItem *inbox = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Posteingang"));
         inbox->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
         inbox->setData(0, Qt::UserRole, "INBOX");
+        inbox->setData(0, FolderLabelRole, inbox->text(0));
         
         QTreeWidgetItem *sent = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Gesendet"));
         sent->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
         sent->setData(0, Qt::UserRole, "Sent");  // GMX: "Gesendet" oder "Sent"
+        sent->setData(0, FolderLabelRole, sent->text(0));
         
         QTreeWidgetItem *drafts = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Entwürfe"));
         drafts->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
         drafts->setData(0, Qt::UserRole, "Drafts");
+        drafts->setData(0, FolderLabelRole, drafts->text(0));
         
         QTreeWidgetItem *spam = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Spam"));
         spam->setIcon(0, style()->standardIcon(QStyle::SP_DialogNoButton));
         spam->setData(0, Qt::UserRole, "Spam");
+        spam->setData(0, FolderLabelRole, spam->text(0));
         
         QTreeWidgetItem *trash = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Papierkorb"));
         trash->setIcon(0, style()->standardIcon(QStyle::SP_TrashIcon));
         trash->setData(0, Qt::UserRole, "Trash");
+        trash->setData(0, FolderLabelRole, trash->text(0));
+
+        // Importierte mbox- und Maildir-Ordner, ohne Server
+        m_localFolders = new QTreeWidgetItem(m_folderTree, QStringList() << tr("Lokale Ordner"));
+        m_localFolders->setIcon(0, style()->standardIcon(QStyle::SP_DriveHDIcon));
+        m_localFolders->setHidden(true);
+        for (const auto &local : m_archive->mailboxes()) {
+            addLocalFolder(local.first, local.second);
+        }
         
         connect(m_folderTree, &QTreeWidget::itemClicked, this, &MailAdlerWindow::onFolderClicked);
         
@@ -282,15 +953,30 @@ private:
     void onFolderClicked(QTreeWidgetItem *item, int column)
     {
         Q_UNUSED(column)
+        const QVariant local = item->data(0, LocalMailboxRole);
+        if (local.isValid()) {
+            onFolderLoaded(QString(), local.toInt());
+            return;
+        }
         QString folder = item->data(0, Qt::UserRole).toString();
         if (folder.isEmpty()) return;
-        
-        if (!m_imap->isAuthenticated()) {
-            onFetchMails();  // Erst verbinden
-            m_pendingFolder = folder;
-        } else {
-            m_imap->selectFolder(folder);
+        if (m_sync->isBusy()) {
+            // Nach den laufenden Befehlen wechseln, älteres lädt der nächste Abgleich
+            m_pendingFolder = folder != m_currentFolder ? folder : QString();
+            m_sync->yieldBackfill();
+            return;
         }
+        
+        m_currentFolder = folder;
+        onFetchMails();
+    }
+
+    void onSyncFinished()
+    {
+        if (m_pendingFolder.isEmpty()) return;
+        m_currentFolder = m_pendingFolder;
+        m_pendingFolder.clear();
+        onFetchMails();
     }
 
     void setupCentralWidget()
@@ -298,25 +984,38 @@ private:
         QSplitter *splitter = new QSplitter(Qt::Vertical, this);
 
         // Mail-Tabelle (oben)
-        m_mailTable = new QTableWidget();
-        m_mailTable->setColumnCount(3);
-        m_mailTable->setHorizontalHeaderLabels({tr("Von"), tr("Betreff"), tr("Datum")});
-        m_mailTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-        m_mailTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
-        m_mailTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+        m_mailTable = new QTableView();
+        m_mailTable->setModel(m_messageModel);
+        // Feste Zeilenhöhen und Spaltenbreiten: ResizeToContents würde bei
+        // großen Ordnern jede Zeile vermessen
+        m_mailTable->horizontalHeader()->setSectionResizeMode(MessageListModel::FromColumn, QHeaderView::Interactive);
+        m_mailTable->horizontalHeader()->setSectionResizeMode(MessageListModel::SubjectColumn, QHeaderView::Stretch);
+        m_mailTable->horizontalHeader()->setSectionResizeMode(MessageListModel::DateColumn, QHeaderView::Interactive);
+        m_mailTable->setColumnWidth(MessageListModel::FromColumn, 250);
+        m_mailTable->setColumnWidth(MessageListModel::DateColumn, 130);
+        m_mailTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        m_mailTable->verticalHeader()->setDefaultSectionSize(m_mailTable->fontMetrics().height() + 6);
         m_mailTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-        m_mailTable->setSelectionMode(QAbstractItemView::SingleSelection);
+        m_mailTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
         m_mailTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        m_mailTable->setWordWrap(false);
         m_mailTable->verticalHeader()->hide();
         
-        connect(m_mailTable, &QTableWidget::cellClicked, 
+        // Auch mit den Pfeiltasten, wer von oben nach unten liest
+        connect(m_mailTable->selectionModel(), &QItemSelectionModel::currentRowChanged,
                 this, &MailAdlerWindow::onMailSelected);
+        // Sichtbarer Bereich für den Vorabruf
+        connect(m_mailTable->verticalScrollBar(), &QScrollBar::valueChanged, this, &MailAdlerWindow::updateViewport);
+        connect(m_messageModel, &QAbstractItemModel::modelReset, this, &MailAdlerWindow::updateViewport);
+        connect(m_messageModel, &QAbstractItemModel::rowsInserted, this, &MailAdlerWindow::updateViewport);
         
         splitter->addWidget(m_mailTable);
 
         // Mail-Vorschau (unten)
-        m_preview = new QTextEdit();
-        m_preview->setReadOnly(true);
+        m_preview = new QTextBrowser();
+        m_preview->setOpenLinks(false);
+        connect(m_preview, &QTextBrowser::anchorClicked, 
+                this, &MailAdlerWindow::onPreviewLinkClicked);
         m_preview->setHtml(
             "<h2>Willkommen bei mailadler</h2>"
             "<p>Drücke <b>F5</b> oder klicke <b>Abrufen</b> um E-Mails zu laden.</p>"
@@ -331,13 +1030,85 @@ private:
     void setupStatusBar()
     {
         statusBar()->showMessage(tr("Bereit"));
+
+        // Datenmenge auf der Leitung und nach dem Entpacken (COMPRESS)
+        m_trafficLabel = new QLabel();
+        statusBar()->addPermanentWidget(m_trafficLabel);
+        QTimer *trafficTimer = new QTimer(this);
+        connect(trafficTimer, &QTimer::timeout, this, &MailAdlerWindow::updateTrafficLabel);
+        trafficTimer->start(2000);
+    }
+
+    void updateTrafficLabel()
+    {
+        ImapTrafficStats total = m_pool->trafficStats();
+        for (const ImapTrafficStats &s : {m_imap->trafficStats(), m_watcher->pool()->trafficStats()}) {
+            total.wireIn += s.wireIn;
+            total.plainIn += s.plainIn;
+        }
+        // Wartende Befehle und Laufzeiten je Spur
+        const ImapScheduler::LaneStats interactive = m_scheduler->stats(ImapConnection::InteractiveLane);
+        const ImapScheduler::LaneStats background = m_scheduler->stats(ImapConnection::BackgroundLane);
+        const BodyPrefetcher::Stats prefetch = m_prefetcher->stats();
+        const QLocale locale;
+        m_trafficLabel->setToolTip(
+            tr("Interaktiv: %1 wartend, %2 unterwegs, p50 %3 ms, p99 %4 ms\n"
+               "Hintergrund: %5 wartend, %6 unterwegs, p50 %7 ms, p99 %8 ms")
+                .arg(interactive.queued).arg(interactive.inFlight)
+                .arg(interactive.p50, 0, 'f', 0).arg(interactive.p99, 0, 'f', 0)
+                .arg(background.waiting + background.queued).arg(background.inFlight)
+                .arg(background.p50, 0, 'f', 0).arg(background.p99, 0, 'f', 0)
+            + QLatin1Char('\n') +
+            tr("Vorabruf: %1 % Treffer, %2 noch unterwegs, %3 geladen (%4)\n"
+               "Anzeige p50/p90: Treffer %5/%6 ms, ohne Treffer %7/%8 ms")
+                .arg(prefetch.hitRate() * 100.0, 0, 'f', 0)
+                .arg(prefetch.outcomes[BodyPrefetcher::Late]).arg(prefetch.prefetched)
+                .arg(locale.formattedDataSize(prefetch.bytes))
+                .arg(prefetch.renderP50[BodyPrefetcher::Hit], 0, 'f', 0)
+                .arg(prefetch.renderP90[BodyPrefetcher::Hit], 0, 'f', 0)
+                .arg(prefetch.renderP50[BodyPrefetcher::Miss], 0, 'f', 0)
+                .arg(prefetch.renderP90[BodyPrefetcher::Miss], 0, 'f', 0));
+        if (!total.wireIn) {
+            return;
+        }
+        m_trafficLabel->setText(tr("↓ %1 (entpackt %2)")
+            .arg(locale.formattedDataSize(qint64(total.wireIn)), locale.formattedDataSize(qint64(total.plainIn))));
     }
 
     ImapConnection *m_imap;
-    QTableWidget *m_mailTable;
-    QTextEdit *m_preview;
+    const StoreCipher *m_cipher;
+    MessageStore *m_store;
+    MailSync *m_sync;
+    ImapScheduler *m_scheduler;
+    ImapConnectionPool *m_pool;
+    ParallelSync *m_parallelSync;
+    OperationJournal *m_journal;
+    IdleWatcher *m_watcher;
+    int m_watchSessions = 0;
+    MessageListModel *m_messageModel;
+    SearchIndex *m_searchIndex;
+    AttachmentIndexer *m_attachmentIndexer;
+    QLineEdit *m_searchEdit;
+    QTimer *m_searchTimer;
+    QTableView *m_mailTable;
+    QTextBrowser *m_preview;
+    BodyCache *m_bodyCache;
+    MessageLoader *m_loader;
+    BodyPrefetcher *m_prefetcher;
+    Outbox *m_outbox;
+    ThreadBuilder m_threads;
+    int m_threadMailbox = -1;
+    QString m_previewHeader;
+    int m_previewMailbox = -1;
+    quint32 m_previewUid = 0;
+    QVector<MimePart> m_attachments;
     QTreeWidget *m_folderTree;
+    QTreeWidgetItem *m_localFolders;
+    MailArchive *m_archive;
+    QLabel *m_trafficLabel;
     QString m_pendingPassword;
+    QString m_currentFolder = "INBOX";
+    // Angeklickt, während der Abgleich noch lief
     QString m_pendingFolder;
 };
 
@@ -349,7 +1120,50 @@ int main(int argc, char *argv[])
     app.setOrganizationDomain("mailadler.de");
     app.setApplicationVersion("0.1.0");
 
-    MailAdlerWindow window;
+    // Einmal je Sitzung, vor dem ersten Zugriff auf den Speicher
+    std::unique_ptr<StoreCipher> cipher;
+    if (QSettings().value("Storage/encrypt", false).toBool()) {
+        cipher.reset(new StoreCipher);
+        const QString keyFile = MessageStore::defaultPath() + ".key";
+        // Eine neue Schlüsseldatei entsteht nur in onEncryptStore(); hier
+        // machte sie den vorhandenen Speicher unlesbar
+        if (!QFile::exists(keyFile)) {
+            QMessageBox::critical(nullptr, QObject::tr("mailadler"),
+                QObject::tr("Die Schlüsseldatei %1 fehlt. Ohne sie kann der verschlüsselte "
+                            "Speicher nicht geöffnet werden.").arg(keyFile));
+            return 1;
+        }
+        for (int attempt = 0; !cipher->isUnlocked(); ++attempt) {
+            bool ok = false;
+            const QString passphrase = QInputDialog::getText(nullptr, QObject::tr("mailadler"),
+                attempt ? QObject::tr("Falsches Passwort. Passwort für den lokalen Speicher:")
+                        : QObject::tr("Passwort für den lokalen Speicher:"),
+                QLineEdit::Password, QString(), &ok);
+            if (!ok) {
+                return 0;
+            }
+            switch (cipher->unlock(keyFile, passphrase)) {
+            case StoreCipher::Unlocked:
+            case StoreCipher::WrongPassphrase:
+                break;
+            case StoreCipher::KeyFileMissing:
+                QMessageBox::critical(nullptr, QObject::tr("mailadler"),
+                    QObject::tr("Die Schlüsseldatei %1 fehlt.").arg(keyFile));
+                return 1;
+            case StoreCipher::KeyFileUnreadable:
+                QMessageBox::critical(nullptr, QObject::tr("mailadler"),
+                    QObject::tr("Die Schlüsseldatei %1 ist beschädigt oder hat ein unbekanntes Format.")
+                        .arg(keyFile));
+                return 1;
+            case StoreCipher::UnlockFailed:
+                QMessageBox::critical(nullptr, QObject::tr("mailadler"),
+                    QObject::tr("Der Schlüssel für den lokalen Speicher konnte nicht abgeleitet werden."));
+                return 1;
+            }
+        }
+    }
+
+    MailAdlerWindow window(cipher.get());
     window.show();
 
     return app.exec();
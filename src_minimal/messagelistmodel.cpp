@@ -0,0 +1,255 @@
+/*
+ * mailadler - Message List Model
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "messagelistmodel.h"
+#include "headersnapshot.h"
+#include "messagestore.h"
+#include "threadbuilder.h"
+#include <QDateTime>
+
+#include <algorithm>
+
+MessageListModel::MessageListModel(MessageStore *store, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_store(store)
+    , m_threads(nullptr)
+    , m_mailboxId(-1)
+    , m_snapshot(nullptr)
+{
+    m_boldFont.setBold(true);
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushDelay);
+    connect(&m_flushTimer, &QTimer::timeout, this, [this]() { m_store->flushSnapshots(); });
+}
+
+void MessageListModel::setMailbox(int mailboxId)
+{
+    beginResetModel();
+    m_mailboxId = mailboxId;
+    m_rows.clear();
+    m_snapshot = mailboxId >= 0 ? m_store->snapshot(mailboxId) : nullptr;
+    if (m_snapshot) {
+        // Aufsteigend im Abbild, hier neueste zuerst
+        const QVector<quint32> &byUid = m_snapshot->byUid();
+        m_rows.resize(byUid.size());
+        std::reverse_copy(byUid.cbegin(), byUid.cend(), m_rows.begin());
+    }
+    endResetModel();
+}
+
+void MessageListModel::showSearchResults(int mailboxId, const QVector<quint32> &uids)
+{
+    beginResetModel();
+    m_mailboxId = mailboxId;
+    m_rows.clear();
+    m_snapshot = mailboxId >= 0 ? m_store->snapshot(mailboxId) : nullptr;
+    if (m_snapshot) {
+        m_rows.reserve(uids.size());
+        for (quint32 uid : uids) {
+            const qint64 record = m_snapshot->find(uid);
+            if (record >= 0) {
+                m_rows.append(quint32(record));
+            }
+        }
+        std::sort(m_rows.begin(), m_rows.end(), [this](quint32 a, quint32 b) {
+            return m_snapshot->record(a).uid > m_snapshot->record(b).uid;
+        });
+        m_rows.erase(std::unique(m_rows.begin(), m_rows.end()), m_rows.end());
+    }
+    endResetModel();
+}
+
+quint32 MessageListModel::uid(int row) const
+{
+    return m_snapshot->record(m_rows.at(row)).uid;
+}
+
+int MessageListModel::rowForUid(quint32 uid) const
+{
+    // Absteigend sortiert
+    auto it = std::lower_bound(m_rows.cbegin(), m_rows.cend(), uid, [this](quint32 record, quint32 value) {
+        return m_snapshot->record(record).uid > value;
+    });
+    if (it != m_rows.cend() && m_snapshot->record(*it).uid == uid) {
+        return int(it - m_rows.cbegin());
+    }
+    return -1;
+}
+
+int MessageListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_rows.size());
+}
+
+int MessageListModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MessageListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+    const quint32 record = m_rows.at(index.row());
+    const HeaderSnapshot::Record &r = m_snapshot->record(record);
+    const bool seen = r.flags & FlagSeen;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case FromColumn:
+            // Ungelesen-Markierung
+            return seen ? m_snapshot->sender(record) : QStringLiteral("📧 ") + m_snapshot->sender(record);
+        case SubjectColumn: {
+            const int size = m_threads ? m_threads->threadSize(r.uid) : 0;
+            return size > 1 ? m_snapshot->subject(record) + QStringLiteral(" (%1)").arg(size)
+                            : m_snapshot->subject(record);
+        }
+        case DateColumn:
+            return QDateTime::fromSecsSinceEpoch(r.date).toString("dd.MM.yyyy hh:mm");
+        }
+        break;
+    case Qt::FontRole:
+        if (!seen) {
+            return m_boldFont;
+        }
+        break;
+    case UidRole:
+        return r.uid;
+    case FlagsRole:
+        return r.flags & ~HeaderSnapshot::Removed;
+    }
+    return QVariant();
+}
+
+void MessageListModel::threadsChanged()
+{
+    if (!m_rows.isEmpty()) {
+        emit dataChanged(index(0, SubjectColumn), index(int(m_rows.size()) - 1, SubjectColumn), {Qt::DisplayRole});
+    }
+}
+
+QVariant MessageListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case FromColumn:
+        return tr("Von");
+    case SubjectColumn:
+        return tr("Betreff");
+    case DateColumn:
+        return tr("Datum");
+    }
+    return QVariant();
+}
+
+void MessageListModel::addMessages(int mailboxId, const QList<EmailHeader> &headers)
+{
+    scheduleFlush();
+    if (mailboxId != m_mailboxId || !m_snapshot || headers.isEmpty()) {
+        return;
+    }
+
+    QVector<quint32> added;
+    added.reserve(headers.size());
+    for (const EmailHeader &h : headers) {
+        const qint64 record = m_snapshot->find(h.uid);
+        if (record < 0) {
+            continue;
+        }
+        const int row = rowForUid(h.uid);
+        if (row >= 0) {
+            // Flags stehen schon im Abbild
+            emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+            continue;
+        }
+        added.append(quint32(record));
+    }
+    std::sort(added.begin(), added.end(), [this](quint32 a, quint32 b) {
+        return m_snapshot->record(a).uid > m_snapshot->record(b).uid;
+    });
+    added.erase(std::unique(added.begin(), added.end()), added.end());
+
+    // Was zwischen dieselben zwei Zeilen fällt, als ein Block: neue Nachrichten
+    // oben, beim Nachladen ein Stück älterer unten
+    int row = 0;
+    for (int i = 0; i < added.size();) {
+        const quint32 first = m_snapshot->record(added.at(i)).uid;
+        auto it = std::lower_bound(m_rows.cbegin() + row, m_rows.cend(), first, [this](quint32 r, quint32 value) {
+            return m_snapshot->record(r).uid > value;
+        });
+        row = int(it - m_rows.cbegin());
+        const quint32 below = it != m_rows.cend() ? m_snapshot->record(*it).uid : 0;
+        int end = i + 1;
+        while (end < added.size() && m_snapshot->record(added.at(end)).uid > below) {
+            ++end;
+        }
+        beginInsertRows(QModelIndex(), row, row + end - i - 1);
+        m_rows.insert(row, end - i, 0);
+        std::copy(added.cbegin() + i, added.cbegin() + end, m_rows.begin() + row);
+        endInsertRows();
+        row += end - i;
+        i = end;
+    }
+}
+
+void MessageListModel::updateFlags(int mailboxId, const QVector<ImapFlagUpdate> &updates)
+{
+    scheduleFlush();
+    if (mailboxId != m_mailboxId || !m_snapshot) {
+        return;
+    }
+    int top = -1;
+    int bottom = -1;
+    for (const ImapFlagUpdate &u : updates) {
+        const int row = rowForUid(u.uid);
+        if (row < 0) {
+            continue;
+        }
+        top = top < 0 ? row : qMin(top, row);
+        bottom = qMax(bottom, row);
+    }
+    if (top >= 0) {
+        emit dataChanged(index(top, 0), index(bottom, ColumnCount - 1), {Qt::DisplayRole, Qt::FontRole, FlagsRole});
+    }
+}
+
+void MessageListModel::removeMessages(int mailboxId, const QVector<UidRange> &ranges)
+{
+    scheduleFlush();
+    if (mailboxId != m_mailboxId || !m_snapshot) {
+        return;
+    }
+    // Die Datensätze sind nur markiert, ihre UIDs lassen sich noch lesen
+    const auto above = [this](quint32 record, quint32 value) { return m_snapshot->record(record).uid > value; };
+    const auto below = [this](quint32 value, quint32 record) { return value > m_snapshot->record(record).uid; };
+    for (const UidRange &r : ranges) {
+        // Absteigend sortiert: [last .. first] bilden einen zusammenhängenden Block
+        auto begin = std::lower_bound(m_rows.cbegin(), m_rows.cend(), r.last, above);
+        auto end = std::upper_bound(begin, m_rows.cend(), r.first, below);
+        if (begin != end) {
+            removeRowRange(int(begin - m_rows.cbegin()), int(end - m_rows.cbegin()) - 1);
+        }
+    }
+}
+
+void MessageListModel::removeRowRange(int first, int last)
+{
+    beginRemoveRows(QModelIndex(), first, last);
+    m_rows.remove(first, last - first + 1);
+    endRemoveRows();
+}
+
+void MessageListModel::scheduleFlush()
+{
+    // Auch für andere Ordner: ihre Abbilder hat der MessageStore ebenfalls geändert
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
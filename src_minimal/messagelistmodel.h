@@ -0,0 +1,78 @@
+/*
+ * mailadler - Message List Model
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MESSAGELISTMODEL_H
+#define MESSAGELISTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QFont>
+#include <QTimer>
+#include <QVector>
+
+#include "imapconnection.h"
+
+class HeaderSnapshot;
+class MessageStore;
+class ThreadBuilder;
+
+// Nachrichtenliste eines Ordners, neueste UID zuerst.
+//
+// Die Zeilen kommen direkt aus dem HeaderSnapshot des Ordners: das Modell
+// hält nur die Datensatznummern, QStrings entstehen erst in data() für
+// sichtbare Zellen. Auch sehr große Ordner stehen damit ohne SQL-Abfrage
+// vollständig bereit. Der MessageStore hat Änderungen schon ins Abbild
+// übernommen, wenn die Slots aufgerufen werden.
+class MessageListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { FromColumn, SubjectColumn, DateColumn, ColumnCount };
+    enum Role { UidRole = Qt::UserRole, FlagsRole };
+
+    explicit MessageListModel(MessageStore *store, QObject *parent = nullptr);
+
+    void setMailbox(int mailboxId);
+    // Nur diese UIDs zeigen (absteigend), bis zum nächsten setMailbox()
+    void showSearchResults(int mailboxId, const QVector<quint32> &uids);
+    // Betreff mit Anzahl der Nachrichten in der Unterhaltung
+    void setThreads(const ThreadBuilder *threads) { m_threads = threads; }
+    void threadsChanged();
+    int mailboxId() const { return m_mailboxId; }
+    quint32 uid(int row) const;
+    int rowForUid(quint32 uid) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+public slots:
+    void addMessages(int mailboxId, const QList<EmailHeader> &headers);
+    void updateFlags(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void removeMessages(int mailboxId, const QVector<UidRange> &ranges);
+
+private:
+    void removeRowRange(int first, int last);
+    // Änderungen an den Abbildern sammeln, Indexdateien gemeinsam schreiben
+    void scheduleFlush();
+
+    // Indexdateien höchstens alle 5 s schreiben
+    static const int FlushDelay = 5000;
+
+    MessageStore *m_store;
+    const ThreadBuilder *m_threads;
+    int m_mailboxId;
+    // Gehört dem MessageStore
+    HeaderSnapshot *m_snapshot;
+    // Datensatznummern im Abbild, Index = Zeile
+    QVector<quint32> m_rows;
+    QTimer m_flushTimer;
+
+    QFont m_boldFont;
+};
+
+#endif // MESSAGELISTMODEL_H
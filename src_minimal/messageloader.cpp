@@ -0,0 +1,377 @@
+/*
+ * mailadler - Message Body Loader
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "messageloader.h"
+#include "bodycache.h"
+#include "mailarchive.h"
+#include "messagestore.h"
+#include "mimedecoder.h"
+#include <QDebug>
+#include <QHash>
+
+#include <algorithm>
+
+MessageLoader::MessageLoader(ImapConnection *imap, MessageStore *store, BodyCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_imap(imap)
+    , m_store(store)
+    , m_cache(cache)
+    , m_archive(nullptr)
+    , m_mailboxId(-1)
+    , m_uid(0)
+    , m_textPart(-1)
+{
+    connect(m_imap, &ImapConnection::bodyStructureReceived, this, &MessageLoader::onBodyStructureReceived);
+    connect(m_imap, &ImapConnection::bodySectionsReceived, this, &MessageLoader::onBodySectionsReceived);
+}
+
+void MessageLoader::load(int mailboxId, quint32 uid)
+{
+    m_mailboxId = mailboxId;
+    m_uid = uid;
+    m_parts.clear();
+    m_textPart = -1;
+
+    if (m_archive && m_archive->contains(mailboxId, uid)) {
+        loadLocal();
+        return;
+    }
+    const QByteArray structure = m_store->bodyStructure(mailboxId, uid);
+    if (structure.isEmpty()) {
+        // Vor dieser Version gespeichert: ein zusätzlicher Roundtrip
+        m_imap->fetchBodyStructure(uid);
+        return;
+    }
+    showStructure(structure);
+}
+
+int MessageLoader::textPartOf(int mailboxId, quint32 uid, MimePart *text) const
+{
+    const QByteArray structure = m_store->bodyStructure(mailboxId, uid);
+    if (structure.isEmpty()) {
+        return -1;
+    }
+    const QVector<MimePart> parts = BodyStructure::parse(structure);
+    const int index = BodyStructure::textPart(parts);
+    if (index < 0) {
+        return 0;
+    }
+    *text = parts.at(index);
+    return 1;
+}
+
+bool MessageLoader::isCached(int mailboxId, quint32 uid) const
+{
+    if (m_archive && m_archive->contains(mailboxId, uid)) {
+        return true;
+    }
+    MimePart text;
+    const int found = textPartOf(mailboxId, uid, &text);
+    if (found <= 0) {
+        return found == 0;
+    }
+    return m_cache->contains(mailboxId, uid, text.section) || m_cache->contains(mailboxId, uid, text.section, 0);
+}
+
+bool MessageLoader::prefetch(int mailboxId, quint32 uid, qint64 *bytes)
+{
+    if (m_prefetches.contains(uid) || (mailboxId == m_mailboxId && uid == m_uid)
+        || (m_archive && m_archive->contains(mailboxId, uid))) {
+        return false;
+    }
+    MimePart text;
+    if (textPartOf(mailboxId, uid, &text) <= 0 || m_cache->contains(mailboxId, uid, text.section)
+        || m_cache->contains(mailboxId, uid, text.section, 0)) {
+        return false;
+    }
+    // Vorabrufe verdrängen nichts, sie füllen nur freien Platz bis zur Räumgrenze
+    const qint64 size = qMin<qint64>(text.size, TextLimit);
+    if (m_cache->size() + size > m_cache->budget() - m_cache->budget() / 10
+        || m_imap->selectedFolder() != m_store->mailboxName(mailboxId)) {
+        return false;
+    }
+
+    ImapBodySection section;
+    section.section = text.section;
+    if (text.size > TextLimit) {
+        section.offset = 0;
+        section.length = TextLimit;
+    }
+    ImapLaneScope lane(m_imap, ImapConnection::BackgroundLane);
+    m_imap->fetchBodySections(uid, {section});
+    m_prefetches.insert(uid, mailboxId);
+    if (bytes) {
+        *bytes = size;
+    }
+    return true;
+}
+
+void MessageLoader::showStructure(const QByteArray &structure)
+{
+    m_parts = BodyStructure::parse(structure);
+    m_textPart = BodyStructure::textPart(m_parts);
+    if (m_textPart < 0) {
+        finishText(QByteArray());
+        return;
+    }
+
+    const MimePart &text = m_parts.at(m_textPart);
+    QByteArray cached = m_cache->part(m_mailboxId, m_uid, text.section);
+    if (cached.isNull()) {
+        cached = m_cache->part(m_mailboxId, m_uid, text.section, 0);
+    }
+    if (!cached.isNull()) {
+        finishText(cached);
+        return;
+    }
+    if (isPrefetching(m_mailboxId, m_uid)) {
+        // Gleicher Abschnitt, die Antwort des Vorabrufs zeigt ihn an
+        return;
+    }
+    fetchText();
+}
+
+void MessageLoader::fetchText()
+{
+    const MimePart &text = m_parts.at(m_textPart);
+    // Sehr lange Texte nur anlesen
+    ImapBodySection section;
+    section.section = text.section;
+    if (text.size > TextLimit) {
+        section.offset = 0;
+        section.length = TextLimit;
+    }
+    m_imap->fetchBodySections(m_uid, {section});
+}
+
+void MessageLoader::loadLocal()
+{
+    // Ein Durchgang: Teile sammeln, vom ersten Text- und HTML-Teil höchstens
+    // TextLimit behalten; Anhänge laufen nur durch
+    MimeStreamParser parser;
+    QVector<MimePart> parts;
+    QHash<int, QByteArray> texts;
+    int current = -1;
+    parser.partStarted = [&](const MimePart &part) {
+        parts.append(part);
+        current = int(parts.size()) - 1;
+        const bool first = std::none_of(parts.cbegin(), parts.cend() - 1, [&part](const MimePart &p) {
+            return !p.isAttachment() && p.subtype == part.subtype;
+        });
+        if (!part.isAttachment() && (part.subtype == "plain" || part.subtype == "html") && first) {
+            texts.insert(current, QByteArray());
+        }
+    };
+    parser.partData = [&](QByteArrayView data) {
+        parts[current].size += quint32(data.size());
+        const auto text = texts.find(current);
+        if (text != texts.end() && text->size() < TextLimit) {
+            text->append(data.first(qMin(data.size(), qsizetype(TextLimit - text->size()))));
+        }
+    };
+    const bool ok = m_archive->read(m_mailboxId, m_uid, [&parser](QByteArrayView block) {
+        parser.feed(block);
+        return true;
+    });
+    parser.finish();
+    if (!ok) {
+        emit error(tr("Nachricht konnte nicht gelesen werden"));
+        return;
+    }
+
+    m_parts = parts;
+    m_textPart = BodyStructure::textPart(m_parts);
+    if (m_textPart < 0) {
+        showText(QString());
+        return;
+    }
+    // Schon dekodiert, nur noch der Zeichensatz
+    showText(MimeDecoder::decodeText(texts.value(m_textPart), m_parts.at(m_textPart).charset));
+}
+
+void MessageLoader::finishText(const QByteArray &data)
+{
+    showText(m_textPart < 0 ? QString() : decodeText(data, m_parts.at(m_textPart)));
+}
+
+void MessageLoader::showText(const QString &text)
+{
+    QVector<MimePart> attachments;
+    for (int i = 0; i < m_parts.size(); ++i) {
+        if (i != m_textPart && m_parts.at(i).isAttachment()) {
+            attachments.append(m_parts.at(i));
+        }
+    }
+    const bool html = m_textPart >= 0 && m_parts.at(m_textPart).subtype == "html";
+    emit messageLoaded(m_mailboxId, m_uid, text, html, attachments);
+}
+
+void MessageLoader::fetchAttachment(int mailboxId, quint32 uid, const MimePart &part)
+{
+    if (findDownload(uid, part.section) >= 0) {
+        return;
+    }
+    if (m_archive && m_archive->contains(mailboxId, uid)) {
+        // Liegt schon vollständig auf der Platte
+        emit attachmentProgress(mailboxId, uid, part.section, part.size, part.size);
+        emit attachmentReady(mailboxId, uid, part.section);
+        return;
+    }
+    Download download{mailboxId, uid, part.section, qint64(part.size), 0, 0, 0};
+    m_downloads.append(download);
+    pump(m_downloads.last());
+}
+
+void MessageLoader::pump(Download &download)
+{
+    while (download.inFlight < MaxChunksInFlight && download.nextOffset < download.total) {
+        const qint64 offset = download.nextOffset;
+        download.nextOffset += ChunkSize;
+        // Von einem früheren, abgebrochenen Download vorhanden
+        if (m_cache->contains(download.mailboxId, download.uid, download.section, offset)) {
+            download.received += qMin(ChunkSize, download.total - offset);
+            continue;
+        }
+        ImapBodySection section;
+        section.section = download.section;
+        section.offset = offset;
+        section.length = ChunkSize;
+        // Große Stücke im Hintergrund, damit das Öffnen einer Nachricht vorgeht
+        ImapLaneScope lane(m_imap, ImapConnection::BackgroundLane);
+        m_imap->fetchBodySections(download.uid, {section});
+        ++download.inFlight;
+    }
+
+    // Kopie, die Slots dürfen weitere Downloads starten
+    const Download state = download;
+    const bool finished = state.inFlight == 0 && state.nextOffset >= state.total;
+    if (finished) {
+        m_downloads.removeAt(findDownload(state.uid, state.section));
+    }
+    emit attachmentProgress(state.mailboxId, state.uid, state.section, state.received, state.total);
+    if (finished) {
+        emit attachmentReady(state.mailboxId, state.uid, state.section);
+    }
+}
+
+int MessageLoader::findDownload(quint32 uid, const QByteArray &section) const
+{
+    for (int i = 0; i < m_downloads.size(); ++i) {
+        if (m_downloads.at(i).uid == uid && m_downloads.at(i).section == section) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MessageLoader::onBodyStructureReceived(quint32 uid, const QByteArray &structure)
+{
+    if (uid != m_uid || !m_parts.isEmpty()) {
+        return;
+    }
+    m_store->setBodyStructure(m_mailboxId, uid, structure);
+    showStructure(structure);
+}
+
+void MessageLoader::onBodySectionsReceived(quint32 uid, const QVector<ImapBodySection> &sections, bool ok)
+{
+    for (const ImapBodySection &s : sections) {
+        const int index = s.offset >= 0 ? findDownload(uid, s.section) : -1;
+        if (index >= 0) {
+            Download &download = m_downloads[index];
+            --download.inFlight;
+            if (!ok) {
+                m_downloads.removeAt(index);
+                emit error(tr("Anhang konnte nicht geladen werden"));
+                continue;
+            }
+            m_cache->insert(download.mailboxId, uid, s.section, s.offset, s.data);
+            download.received += s.data.size();
+            pump(download);
+            continue;
+        }
+
+        const auto pending = m_prefetches.constFind(uid);
+        const bool fromPrefetch = pending != m_prefetches.cend();
+        if (fromPrefetch) {
+            const int mailboxId = *pending;
+            m_prefetches.erase(pending);
+            if (ok) {
+                m_cache->insert(mailboxId, uid, s.section, s.offset, s.data);
+            }
+            emit prefetched(mailboxId, uid, ok);
+            if (mailboxId != m_mailboxId) {
+                continue;
+            }
+        }
+
+        if (uid != m_uid || m_textPart < 0 || s.section != m_parts.at(m_textPart).section) {
+            continue;
+        }
+        if (!ok && fromPrefetch) {
+            // Der Vorabruf lief im Hintergrund, selbst noch einmal versuchen
+            fetchText();
+            continue;
+        }
+        if (!ok) {
+            emit error(tr("Nachricht konnte nicht geladen werden"));
+            continue;
+        }
+        if (!fromPrefetch) {
+            m_cache->insert(m_mailboxId, uid, s.section, s.offset, s.data);
+        }
+        finishText(s.data);
+    }
+}
+
+bool MessageLoader::saveAttachment(int mailboxId, quint32 uid, const MimePart &part, QIODevice *device)
+{
+    if (m_archive && m_archive->contains(mailboxId, uid)) {
+        return saveLocalAttachment(mailboxId, uid, part, device);
+    }
+    // Stückweise dekodieren, der Anhang liegt nie ganz im Speicher
+    TransferDecoder decoder(TransferDecoder::encodingFor(part.encoding));
+    QByteArray out;
+    const bool ok = m_cache->read(mailboxId, uid, part.section, [&](QByteArrayView block) {
+        out.resize(TransferDecoder::maxDecodedSize(block.size()));
+        const qsizetype n = decoder.decode(block, out.data());
+        return device->write(out.constData(), n) == n;
+    });
+    if (!ok) {
+        return false;
+    }
+    out.resize(TransferDecoder::maxDecodedSize(0));
+    const qsizetype n = decoder.finish(out.data());
+    return device->write(out.constData(), n) == n;
+}
+
+bool MessageLoader::saveLocalAttachment(int mailboxId, quint32 uid, const MimePart &part, QIODevice *device)
+{
+    // Die ganze Nachricht durch den Parser, nur der gesuchte Teil wird geschrieben
+    MimeStreamParser parser;
+    bool selected = false;
+    bool written = true;
+    parser.partStarted = [&](const MimePart &p) { selected = p.section == part.section; };
+    parser.partData = [&](QByteArrayView data) {
+        if (selected) {
+            written = written && device->write(data.data(), data.size()) == data.size();
+        }
+    };
+    const bool ok = m_archive->read(mailboxId, uid, [&](QByteArrayView block) {
+        parser.feed(block);
+        return written;
+    });
+    parser.finish();
+    return ok && written;
+}
+
+QString MessageLoader::decodeText(const QByteArray &data, const MimePart &part)
+{
+    // Bei angelesenen Texten endet data mitten in der Kodierung; der
+    // Decoder gibt dann nur die vollständigen Zeichen aus
+    TransferDecoder decoder(TransferDecoder::encodingFor(part.encoding));
+    return MimeDecoder::decodeText(decoder.decode(data), part.charset);
+}
@@ -0,0 +1,116 @@
+/*
+ * mailadler - Message Body Loader
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MESSAGELOADER_H
+#define MESSAGELOADER_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+#include "bodystructure.h"
+#include "imapconnection.h"
+
+class BodyCache;
+class MailArchive;
+class MessageStore;
+class QIODevice;
+
+// Lädt Nachrichteninhalte abschnittsweise.
+//
+// Die BODYSTRUCTURE kommt schon mit den Kopfzeilen in den MessageStore, so
+// dass beim Öffnen nur der Textteil angefordert wird: ein Roundtrip, egal wie
+// groß die Anhänge sind (bei einem Cache-Treffer gar keiner). Anhänge werden
+// erst auf Anforderung in Stücken per BODY.PEEK[n]<offset.size> geholt;
+// bereits vorhandene Stücke werden übersprungen, ein Abbruch lässt sich
+// also fortsetzen. Die Stücke laufen in der Hintergrundspur der Verbindung.
+// Gilt für den auf der Verbindung ausgewählten Ordner.
+//
+// Nachrichten aus lokalen Ordnern (MailArchive) werden ohne Server in einem
+// Durchgang durch den MimeStreamParser gelesen.
+//
+// prefetch() holt den Textteil wie load(), aber in der Hintergrundspur und
+// nur in den BodyCache (siehe BodyPrefetcher). Wird die Nachricht gewählt,
+// während der Vorabruf unterwegs ist, zeigt dessen Antwort sie an.
+class MessageLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const qint64 TextLimit = 256 * 1024;
+    static const qint64 ChunkSize = 1024 * 1024;
+    static const int MaxChunksInFlight = 4;
+
+    MessageLoader(ImapConnection *imap, MessageStore *store, BodyCache *cache, QObject *parent = nullptr);
+    void setArchive(MailArchive *archive) { m_archive = archive; }
+
+    void load(int mailboxId, quint32 uid);
+    // Textteil im Cache bzw. nichts zu laden; ohne Server
+    bool isCached(int mailboxId, quint32 uid) const;
+    bool isPrefetching(int mailboxId, quint32 uid) const { return m_prefetches.value(uid, -1) == mailboxId; }
+    // false, wenn nichts zu tun ist (im Cache, lokal, ohne BODYSTRUCTURE, nicht
+    // der ausgewählte Ordner) oder der Cache dafür räumen müsste. bytes:
+    // angeforderte Größe
+    bool prefetch(int mailboxId, quint32 uid, qint64 *bytes = nullptr);
+    void fetchAttachment(int mailboxId, quint32 uid, const MimePart &part);
+
+    // Vollständig geladenen Anhang dekodiert schreiben
+    bool saveAttachment(int mailboxId, quint32 uid, const MimePart &part, QIODevice *device);
+
+    // Transfer-Encoding und Zeichensatz eines Textteils auflösen
+    static QString decodeText(const QByteArray &data, const MimePart &part);
+
+signals:
+    // text leer, wenn die Nachricht keinen Textteil hat
+    void messageLoaded(int mailboxId, quint32 uid, const QString &text, bool html,
+                       const QVector<MimePart> &attachments);
+    void attachmentProgress(int mailboxId, quint32 uid, const QByteArray &section, qint64 received, qint64 total);
+    // Vollständig im BodyCache, siehe BodyCache::write()
+    void attachmentReady(int mailboxId, quint32 uid, const QByteArray &section);
+    void prefetched(int mailboxId, quint32 uid, bool ok);
+    void error(const QString &message);
+
+private slots:
+    void onBodyStructureReceived(quint32 uid, const QByteArray &structure);
+    void onBodySectionsReceived(quint32 uid, const QVector<ImapBodySection> &sections, bool ok);
+
+private:
+    struct Download {
+        int mailboxId;
+        quint32 uid;
+        QByteArray section;
+        qint64 total;
+        qint64 nextOffset;
+        qint64 received;
+        int inFlight;
+    };
+
+    // 1 mit Textteil, 0 ohne, -1 ohne gespeicherte BODYSTRUCTURE
+    int textPartOf(int mailboxId, quint32 uid, MimePart *text) const;
+    void showStructure(const QByteArray &structure);
+    void fetchText();
+    void finishText(const QByteArray &data);
+    void showText(const QString &text);
+    void loadLocal();
+    bool saveLocalAttachment(int mailboxId, quint32 uid, const MimePart &part, QIODevice *device);
+    void pump(Download &download);
+    int findDownload(quint32 uid, const QByteArray &section) const;
+
+    ImapConnection *m_imap;
+    MessageStore *m_store;
+    BodyCache *m_cache;
+    MailArchive *m_archive;
+
+    // Aktuell angezeigte Nachricht
+    int m_mailboxId;
+    quint32 m_uid;
+    QVector<MimePart> m_parts;
+    int m_textPart;
+    QList<Download> m_downloads;
+    QHash<quint32, int> m_prefetches; // UID -> mailboxId
+};
+
+#endif // MESSAGELOADER_H
@@ -0,0 +1,553 @@
+/*
+ * mailadler - Local Message Store
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "messagestore.h"
+#include "headersnapshot.h"
+#include "storecipher.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+MessageStore::MessageStore(const QString &path)
+    : m_path(path.isEmpty() ? defaultPath() : path)
+    , m_connectionName(QString("messagestore-%1").arg(quintptr(this), 0, 16))
+    , m_cipher(nullptr)
+{
+}
+
+QString MessageStore::defaultPath()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    return dir + "/mailadler.db";
+}
+
+MessageStore::~MessageStore()
+{
+    // Schreibt die Indexdateien
+    qDeleteAll(m_snapshots);
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        if (db.isOpen()) {
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool MessageStore::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_path);
+    if (!db.open()) {
+        qWarning() << "MessageStore: kann" << m_path << "nicht öffnen:" << db.lastError().text();
+        return false;
+    }
+    if (m_cipher && !StoreCipher::hasSqlCipher(db)) {
+        // Nicht unverschlüsselt weiterarbeiten, wenn Verschlüsselung verlangt ist
+        qWarning() << "MessageStore: SQLite ohne SQLCipher, kann" << m_path << "nicht verschlüsseln";
+        db.close();
+        return false;
+    }
+    if (m_cipher && !m_cipher->keyDatabase(db) && !encryptDatabase()) {
+        db.close();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode = WAL");
+    query.exec("PRAGMA synchronous = NORMAL");
+    query.exec("PRAGMA foreign_keys = ON");
+    return createSchema();
+}
+
+bool MessageStore::encryptDatabase()
+{
+    // Noch unverschlüsselt: einmal mit sqlcipher_export() umschreiben
+    QSqlDatabase db = database();
+    db.close();
+    if (!db.open()) {
+        return false;
+    }
+    const QString sealed = m_path + ".sealed";
+    QFile::remove(sealed);
+    bool ok;
+    {
+        QSqlQuery query(db);
+        ok = query.exec("SELECT count(*) FROM sqlite_master") && query.next();
+        if (!ok) {
+            qWarning() << "MessageStore:" << m_path << "passt nicht zum Schlüssel";
+        } else {
+            qDebug() << "MessageStore: verschlüssele" << m_path;
+            query.finish();
+            query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+            ok = query.exec(QString("ATTACH DATABASE '%1' AS sealed KEY %2")
+                                .arg(QString(sealed).replace('\'', "''"), m_cipher->databaseKeyLiteral()))
+                 && query.exec("SELECT sqlcipher_export('sealed')") && query.exec("DETACH DATABASE sealed");
+            if (!ok) {
+                qWarning() << "MessageStore: Verschlüsseln fehlgeschlagen:" << query.lastError().text();
+            }
+        }
+    }
+    db.close();
+    if (!ok) {
+        QFile::remove(sealed);
+        return false;
+    }
+    QFile::remove(m_path + "-wal");
+    QFile::remove(m_path + "-shm");
+    if (!QFile::remove(m_path) || !QFile::rename(sealed, m_path)) {
+        qWarning() << "MessageStore: kann" << sealed << "nicht umbenennen";
+        return false;
+    }
+    return db.open() && m_cipher->keyDatabase(db);
+}
+
+QSqlDatabase MessageStore::database() const
+{
+    return QSqlDatabase::database(m_connectionName, false);
+}
+
+bool MessageStore::createSchema()
+{
+    QSqlQuery query(database());
+    const char *statements[] = {
+        "CREATE TABLE IF NOT EXISTS mailboxes ("
+        " id INTEGER PRIMARY KEY,"
+        " account TEXT NOT NULL,"
+        " name TEXT NOT NULL,"
+        " uidvalidity INTEGER NOT NULL DEFAULT 0,"
+        " uidnext INTEGER NOT NULL DEFAULT 0,"
+        " highestmodseq INTEGER NOT NULL DEFAULT 0,"
+        " generation INTEGER NOT NULL DEFAULT 0,"
+        " backfill INTEGER NOT NULL DEFAULT 0,"
+        " UNIQUE (account, name))",
+        "CREATE TABLE IF NOT EXISTS messages ("
+        " mailbox_id INTEGER NOT NULL REFERENCES mailboxes(id) ON DELETE CASCADE,"
+        " uid INTEGER NOT NULL,"
+        " flags INTEGER NOT NULL DEFAULT 0,"
+        " modseq INTEGER NOT NULL DEFAULT 0,"
+        " date INTEGER NOT NULL DEFAULT 0,"
+        " size INTEGER NOT NULL DEFAULT 0,"
+        " sender TEXT,"
+        " recipient TEXT,"
+        " subject TEXT,"
+        " message_id TEXT,"
+        " refs TEXT,"
+        " structure BLOB,"
+        " PRIMARY KEY (mailbox_id, uid)) WITHOUT ROWID",
+    };
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            qWarning() << "MessageStore: Schema-Fehler:" << query.lastError().text();
+            return false;
+        }
+    }
+    // Ältere Datenbanken ohne BODYSTRUCTURE bzw. References; schlägt fehl,
+    // wenn die Spalte existiert
+    query.exec("ALTER TABLE messages ADD COLUMN structure BLOB");
+    query.exec("ALTER TABLE messages ADD COLUMN refs TEXT");
+    query.exec("ALTER TABLE mailboxes ADD COLUMN generation INTEGER NOT NULL DEFAULT 0");
+    query.exec("ALTER TABLE mailboxes ADD COLUMN backfill INTEGER NOT NULL DEFAULT 0");
+    return true;
+}
+
+int MessageStore::mailboxId(const QString &account, const QString &mailbox)
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT id FROM mailboxes WHERE account = ? AND name = ?");
+    query.addBindValue(account);
+    query.addBindValue(mailbox);
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+
+    query.prepare("INSERT INTO mailboxes (account, name) VALUES (?, ?)");
+    query.addBindValue(account);
+    query.addBindValue(mailbox);
+    if (!query.exec()) {
+        qWarning() << "MessageStore: Ordner anlegen fehlgeschlagen:" << query.lastError().text();
+        return -1;
+    }
+    return query.lastInsertId().toInt();
+}
+
+QString MessageStore::mailboxName(int mailboxId) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT name FROM mailboxes WHERE id = ?");
+    query.addBindValue(mailboxId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toString();
+    }
+    return QString();
+}
+
+ImapFolderState MessageStore::folderState(int mailboxId) const
+{
+    ImapFolderState state;
+    QSqlQuery query(database());
+    query.prepare("SELECT uidvalidity, uidnext, highestmodseq FROM mailboxes WHERE id = ?");
+    query.addBindValue(mailboxId);
+    if (query.exec() && query.next()) {
+        state.uidValidity = query.value(0).toUInt();
+        state.uidNext = query.value(1).toUInt();
+        state.highestModSeq = query.value(2).toULongLong();
+        state.exists = quint32(messageCount(mailboxId));
+    }
+    return state;
+}
+
+void MessageStore::setFolderState(int mailboxId, const ImapFolderState &state)
+{
+    QSqlQuery query(database());
+    query.prepare("UPDATE mailboxes SET uidvalidity = ?, uidnext = ?, highestmodseq = ? WHERE id = ?");
+    query.addBindValue(state.uidValidity);
+    query.addBindValue(state.uidNext);
+    query.addBindValue(qint64(state.highestModSeq));
+    query.addBindValue(mailboxId);
+    if (!query.exec()) {
+        qWarning() << "MessageStore: Ordnerstatus nicht gespeichert:" << query.lastError().text();
+    }
+}
+
+void MessageStore::resetMailbox(int mailboxId, quint32 uidValidity)
+{
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM messages WHERE mailbox_id = ?");
+    query.addBindValue(mailboxId);
+    query.exec();
+    query.prepare("UPDATE mailboxes SET uidvalidity = ?, uidnext = 0, highestmodseq = 0, backfill = 0 WHERE id = ?");
+    query.addBindValue(uidValidity);
+    query.addBindValue(mailboxId);
+    query.exec();
+    bumpGeneration(mailboxId);
+    db.commit();
+
+    // Das Objekt bleibt für MessageListModel bestehen, snapshot() baut es neu auf
+    if (HeaderSnapshot *snapshot = m_snapshots.value(mailboxId)) {
+        snapshot->discard();
+    } else {
+        HeaderSnapshot(m_path + "-snapshots", mailboxId, m_cipher).discard();
+    }
+}
+
+quint32 MessageStore::backfillFloor(int mailboxId) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT backfill FROM mailboxes WHERE id = ?");
+    query.addBindValue(mailboxId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toUInt();
+    }
+    return 0;
+}
+
+void MessageStore::setBackfillFloor(int mailboxId, quint32 uid)
+{
+    QSqlQuery query(database());
+    query.prepare("UPDATE mailboxes SET backfill = ? WHERE id = ?");
+    query.addBindValue(uid);
+    query.addBindValue(mailboxId);
+    if (!query.exec()) {
+        qWarning() << "MessageStore: Nachladestand nicht gespeichert:" << query.lastError().text();
+    }
+}
+
+quint64 MessageStore::generation(int mailboxId) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT generation FROM mailboxes WHERE id = ?");
+    query.addBindValue(mailboxId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toULongLong();
+    }
+    return 0;
+}
+
+quint64 MessageStore::bumpGeneration(int mailboxId)
+{
+    QSqlQuery query(database());
+    query.prepare("UPDATE mailboxes SET generation = generation + 1 WHERE id = ?");
+    query.addBindValue(mailboxId);
+    query.exec();
+    return generation(mailboxId);
+}
+
+void MessageStore::storeHeaders(int mailboxId, const QList<EmailHeader> &headers)
+{
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO messages"
+                  " (mailbox_id, uid, flags, modseq, date, size, sender, recipient, subject, message_id, refs, structure)"
+                  " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    for (const EmailHeader &h : headers) {
+        query.bindValue(0, mailboxId);
+        query.bindValue(1, h.uid);
+        query.bindValue(2, h.flags);
+        query.bindValue(3, qint64(h.modSeq));
+        query.bindValue(4, h.date);
+        query.bindValue(5, h.size);
+        query.bindValue(6, h.from);
+        query.bindValue(7, h.to);
+        query.bindValue(8, h.subject);
+        query.bindValue(9, h.messageId);
+        query.bindValue(10, QString::fromLatin1(h.references));
+        query.bindValue(11, h.structure);
+        if (!query.exec()) {
+            qWarning() << "MessageStore: Einfügen fehlgeschlagen:" << query.lastError().text();
+            break;
+        }
+    }
+    const quint64 generation = bumpGeneration(mailboxId);
+    db.commit();
+    if (HeaderSnapshot *snapshot = currentSnapshot(mailboxId, generation - 1)) {
+        snapshot->store(headers, generation);
+    }
+}
+
+void MessageStore::updateFlags(int mailboxId, const QVector<ImapFlagUpdate> &updates)
+{
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("UPDATE messages SET flags = ?, modseq = ? WHERE mailbox_id = ? AND uid = ?");
+    for (const ImapFlagUpdate &u : updates) {
+        query.bindValue(0, u.flags);
+        query.bindValue(1, qint64(u.modSeq));
+        query.bindValue(2, mailboxId);
+        query.bindValue(3, u.uid);
+        query.exec();
+    }
+    const quint64 generation = bumpGeneration(mailboxId);
+    db.commit();
+    if (HeaderSnapshot *snapshot = currentSnapshot(mailboxId, generation - 1)) {
+        snapshot->setFlags(updates, generation);
+    }
+}
+
+void MessageStore::removeUids(int mailboxId, const QVector<UidRange> &ranges)
+{
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM messages WHERE mailbox_id = ? AND uid BETWEEN ? AND ?");
+    for (const UidRange &r : ranges) {
+        query.bindValue(0, mailboxId);
+        query.bindValue(1, r.first);
+        query.bindValue(2, r.last);
+        query.exec();
+    }
+    const quint64 generation = bumpGeneration(mailboxId);
+    db.commit();
+    if (HeaderSnapshot *snapshot = currentSnapshot(mailboxId, generation - 1)) {
+        snapshot->remove(ranges, generation);
+    }
+}
+
+QVector<UidRange> MessageStore::removeUidsNotIn(int mailboxId, const QVector<UidRange> &existing)
+{
+    // Lücken zwischen den sortierten Bereichen sind die gelöschten UIDs
+    QVector<UidRange> sorted = existing;
+    std::sort(sorted.begin(), sorted.end(), [](const UidRange &a, const UidRange &b) {
+        return a.first < b.first;
+    });
+
+    // 64 Bit, damit r.last + 1 hinter UID 0xffffffff nicht auf 0 springt
+    QVector<UidRange> gone;
+    quint64 next = 1;
+    for (const UidRange &r : sorted) {
+        if (r.first > next) {
+            gone.append({quint32(next), r.first - 1});
+        }
+        next = qMax(next, quint64(r.last) + 1);
+    }
+    if (next <= 0xffffffffu) {
+        gone.append({quint32(next), 0xffffffffu});
+    }
+    removeUids(mailboxId, gone);
+    return gone;
+}
+
+QList<EmailHeader> MessageStore::headers(int mailboxId, int limit, qint64 beforeUid) const
+{
+    QList<EmailHeader> result;
+    result.reserve(limit);
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid, flags, modseq, date, size, sender, recipient, subject, message_id"
+                  " FROM messages WHERE mailbox_id = ? AND uid < ? ORDER BY uid DESC LIMIT ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(beforeUid);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        return result;
+    }
+    while (query.next()) {
+        EmailHeader h;
+        h.uid = query.value(0).toUInt();
+        h.flags = query.value(1).toUInt();
+        h.modSeq = query.value(2).toULongLong();
+        h.date = query.value(3).toLongLong();
+        h.size = query.value(4).toUInt();
+        h.from = query.value(5).toString();
+        h.to = query.value(6).toString();
+        h.subject = query.value(7).toString();
+        h.messageId = query.value(8).toString();
+        result.append(h);
+    }
+    return result;
+}
+
+QList<EmailHeader> MessageStore::headers(int mailboxId, const QVector<quint32> &uids) const
+{
+    QList<EmailHeader> result;
+    result.reserve(uids.size());
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid, flags, modseq, date, size, sender, recipient, subject, message_id"
+                  " FROM messages WHERE mailbox_id = ? AND uid = ?");
+    for (quint32 uid : uids) {
+        query.bindValue(0, mailboxId);
+        query.bindValue(1, uid);
+        if (!query.exec() || !query.next()) {
+            continue;
+        }
+        EmailHeader h;
+        h.uid = query.value(0).toUInt();
+        h.flags = query.value(1).toUInt();
+        h.modSeq = query.value(2).toULongLong();
+        h.date = query.value(3).toLongLong();
+        h.size = query.value(4).toUInt();
+        h.from = query.value(5).toString();
+        h.to = query.value(6).toString();
+        h.subject = query.value(7).toString();
+        h.messageId = query.value(8).toString();
+        result.append(h);
+    }
+    return result;
+}
+
+QVector<ImapFlagUpdate> MessageStore::flags(int mailboxId, const QVector<UidRange> &ranges) const
+{
+    QVector<ImapFlagUpdate> result;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid, flags, modseq FROM messages WHERE mailbox_id = ? AND uid BETWEEN ? AND ? ORDER BY uid");
+    for (const UidRange &r : ranges) {
+        query.bindValue(0, mailboxId);
+        query.bindValue(1, r.first);
+        query.bindValue(2, r.last);
+        if (!query.exec()) {
+            continue;
+        }
+        while (query.next()) {
+            result.append({query.value(0).toUInt(), query.value(1).toUInt(), query.value(2).toULongLong()});
+        }
+    }
+    return result;
+}
+
+QByteArray MessageStore::bodyStructure(int mailboxId, quint32 uid) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT structure FROM messages WHERE mailbox_id = ? AND uid = ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    if (query.exec() && query.next()) {
+        return query.value(0).toByteArray();
+    }
+    return QByteArray();
+}
+
+void MessageStore::setBodyStructure(int mailboxId, quint32 uid, const QByteArray &structure)
+{
+    QSqlQuery query(database());
+    query.prepare("UPDATE messages SET structure = ? WHERE mailbox_id = ? AND uid = ?");
+    query.addBindValue(structure);
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    query.exec();
+}
+
+int MessageStore::messageCount(int mailboxId) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT COUNT(*) FROM messages WHERE mailbox_id = ?");
+    query.addBindValue(mailboxId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+QVector<quint32> MessageStore::uids(int mailboxId) const
+{
+    QVector<quint32> result;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid FROM messages WHERE mailbox_id = ? ORDER BY uid");
+    query.addBindValue(mailboxId);
+    if (query.exec()) {
+        while (query.next()) {
+            result.append(query.value(0).toUInt());
+        }
+    }
+    return result;
+}
+
+HeaderSnapshot *MessageStore::snapshot(int mailboxId)
+{
+    const quint64 current = generation(mailboxId);
+    HeaderSnapshot *snapshot = currentSnapshot(mailboxId, current);
+    // Mehr gelöschte als vorhandene Datensätze: aufräumen
+    if (snapshot && snapshot->recordCount() - snapshot->liveCount() <= snapshot->liveCount()) {
+        return snapshot;
+    }
+    snapshot = m_snapshots.value(mailboxId);
+    if (!snapshot) {
+        snapshot = new HeaderSnapshot(m_path + "-snapshots", mailboxId, m_cipher);
+        m_snapshots.insert(mailboxId, snapshot);
+    }
+    if (!snapshot->rebuild(database(), current)) {
+        return nullptr;
+    }
+    return snapshot;
+}
+
+HeaderSnapshot *MessageStore::currentSnapshot(int mailboxId, quint64 generation)
+{
+    HeaderSnapshot *snapshot = m_snapshots.value(mailboxId);
+    if (snapshot && snapshot->isOpen()) {
+        return snapshot->generation() == generation ? snapshot : nullptr;
+    }
+    // Nur passende Dateien übernehmen; neu aufgebaut wird erst in snapshot()
+    if (!snapshot) {
+        snapshot = new HeaderSnapshot(m_path + "-snapshots", mailboxId, m_cipher);
+        if (!snapshot->open(generation)) {
+            delete snapshot;
+            return nullptr;
+        }
+        m_snapshots.insert(mailboxId, snapshot);
+        return snapshot;
+    }
+    return snapshot->open(generation) ? snapshot : nullptr;
+}
+
+void MessageStore::flushSnapshots()
+{
+    for (HeaderSnapshot *snapshot : std::as_const(m_snapshots)) {
+        snapshot->flush();
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * mailadler - Local Message Store
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MESSAGESTORE_H
+#define MESSAGESTORE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+
+#include "imapconnection.h"
+
+class HeaderSnapshot;
+class StoreCipher;
+
+// Lokaler Speicher für Kopfzeilen und Flags (SQLite).
+// Schlüssel ist (Konto, Ordner, UIDVALIDITY, UID); ändert sich die
+// UIDVALIDITY eines Ordners, wird sein Inhalt verworfen.
+//
+// Jede Änderung an den Nachrichten eines Ordners zählt dessen generation()
+// hoch und wird in ein schon geöffnetes HeaderSnapshot übernommen.
+//
+// Mit setCipher() wird die Datenbank per SQLCipher seitenweise verschlüsselt
+// (eine noch unverschlüsselte beim ersten open() umgeschrieben) und die
+// Abbilder versiegeln ihre Zeichenketten. Ohne SQLCipher im SQLite-Treiber
+// schlägt open() dann fehl, siehe StoreCipher::keyDatabase().
+class MessageStore
+{
+public:
+    // Obergrenze für headers(), größer als jede UID
+    static constexpr qint64 NoUidLimit = Q_INT64_C(0x100000000);
+
+    explicit MessageStore(const QString &path = QString());
+    ~MessageStore();
+
+    static QString defaultPath();
+
+    // Vor open(); cipher muss entsperrt sein und den MessageStore überleben
+    void setCipher(const StoreCipher *cipher) { m_cipher = cipher; }
+    // Für eigene Verbindungen auf path(), nullptr ohne Verschlüsselung
+    const StoreCipher *cipher() const { return m_cipher; }
+
+    bool open();
+    QSqlDatabase database() const;
+    QString path() const { return m_path; }
+
+    int mailboxId(const QString &account, const QString &mailbox);
+    // Ordnername zu mailboxId, leer wenn unbekannt
+    QString mailboxName(int mailboxId) const;
+    ImapFolderState folderState(int mailboxId) const;
+    void setFolderState(int mailboxId, const ImapFolderState &state);
+    void resetMailbox(int mailboxId, quint32 uidValidity);
+    // Älteste geladene UID eines abgebrochenen Nachladens: UIDs darunter fehlen
+    // noch. 0, wenn alles unter UIDNEXT vorhanden ist
+    quint32 backfillFloor(int mailboxId) const;
+    void setBackfillFloor(int mailboxId, quint32 uid);
+    // Stand der Nachrichten des Ordners, steigt mit jeder Änderung
+    quint64 generation(int mailboxId) const;
+
+    void storeHeaders(int mailboxId, const QList<EmailHeader> &headers);
+    void updateFlags(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void removeUids(int mailboxId, const QVector<UidRange> &ranges);
+    // Alles löschen, was der Server nicht mehr kennt; liefert die gelöschten Bereiche
+    QVector<UidRange> removeUidsNotIn(int mailboxId, const QVector<UidRange> &existing);
+
+    // Bis zu limit Nachrichten mit UID < beforeUid, neueste zuerst
+    QList<EmailHeader> headers(int mailboxId, int limit, qint64 beforeUid = NoUidLimit) const;
+    // Bestimmte UIDs in der übergebenen Reihenfolge, z.B. Suchtreffer
+    QList<EmailHeader> headers(int mailboxId, const QVector<quint32> &uids) const;
+    int messageCount(int mailboxId) const;
+    // Flags und MODSEQ aller gespeicherten Nachrichten in den Bereichen
+    QVector<ImapFlagUpdate> flags(int mailboxId, const QVector<UidRange> &ranges) const;
+    // Roh wie in EmailHeader::structure; leer, wenn (noch) unbekannt
+    QByteArray bodyStructure(int mailboxId, quint32 uid) const;
+    void setBodyStructure(int mailboxId, quint32 uid, const QByteArray &structure);
+    // Alle UIDs aufsteigend, entspricht der Sequenznummer-Reihenfolge
+    QVector<quint32> uids(int mailboxId) const;
+
+    // Speicherabbild der Kopfzeilen, bei Bedarf neu aufgebaut; bleibt bis zum
+    // Ende des MessageStore gültig. nullptr, wenn es nicht geschrieben werden kann
+    HeaderSnapshot *snapshot(int mailboxId);
+    // Indexdateien aller geänderten Abbilder schreiben
+    void flushSnapshots();
+
+private:
+    bool encryptDatabase();
+    bool createSchema();
+    quint64 bumpGeneration(int mailboxId);
+    // Abbild, das genau den Stand generation hat, sonst nullptr
+    HeaderSnapshot *currentSnapshot(int mailboxId, quint64 generation);
+
+    QString m_path;
+    QString m_connectionName;
+    const StoreCipher *m_cipher;
+    QHash<int, HeaderSnapshot *> m_snapshots;
+};
+
+#endif // MESSAGESTORE_H
@@ -0,0 +1,269 @@
+/*
+ * mailadler - Outgoing Message Writer
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "messagewriter.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMimeDatabase>
+#include <QUuid>
+
+#include <algorithm>
+
+namespace {
+
+// 57 Bytes ergeben genau eine Base64-Zeile mit 76 Zeichen
+const qint64 Base64Line = 57;
+const qint64 Base64Block = Base64Line * 1024;
+// RFC 5322: höchstens 998 Zeichen je Zeile
+const qsizetype MaxLineLength = 998;
+// Ein kodiertes Wort darf 75 Zeichen lang sein, davon bleiben 45 Bytes Nutzlast
+const qsizetype EncodedWordBytes = 45;
+
+bool isPlainAscii(const QString &text)
+{
+    for (const QChar c : text) {
+        if (c.unicode() >= 127 || (c.unicode() < 32 && c != QLatin1Char('\t'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "Name <addr>" mit kodiertem bzw. gequotetem Anzeigenamen
+QByteArray encodeAddress(const QString &address)
+{
+    const qsizetype open = address.indexOf(QLatin1Char('<'));
+    if (open < 0) {
+        return address.trimmed().toUtf8();
+    }
+    QString name = address.left(open).trimmed();
+    if (name.size() >= 2 && name.startsWith(QLatin1Char('"')) && name.endsWith(QLatin1Char('"'))) {
+        name = name.mid(1, name.size() - 2);
+    }
+    const QByteArray spec = MessageWriter::addressSpec(address);
+    if (name.isEmpty()) {
+        return '<' + spec + '>';
+    }
+    QByteArray encoded;
+    if (!isPlainAscii(name)) {
+        encoded = MessageWriter::encodeWord(name);
+    } else {
+        // Sonderzeichen wie "," oder "." erfordern Anführungszeichen
+        encoded = name.toUtf8();
+        encoded.replace('\\', "\\\\").replace('"', "\\\"");
+        encoded = '"' + encoded + '"';
+    }
+    return encoded + " <" + spec + '>';
+}
+
+QByteArray addressHeader(const char *name, const QStringList &addresses)
+{
+    QByteArray line = name;
+    line += ": ";
+    for (int i = 0; i < addresses.size(); ++i) {
+        if (i) {
+            line += ",\r\n ";
+        }
+        line += encodeAddress(addresses.at(i));
+    }
+    return line + "\r\n";
+}
+
+// Zeilenenden auf CRLF; liefert false bei überlangen Zeilen
+bool canonicalText(const QString &text, QByteArray *out)
+{
+    const QByteArray utf8 = text.toUtf8();
+    out->clear();
+    out->reserve(utf8.size() + utf8.size() / 40 + 2);
+    bool fits = true;
+    qsizetype lineLength = 0;
+    for (qsizetype i = 0; i < utf8.size(); ++i) {
+        const char c = utf8.at(i);
+        if (c == '\r') {
+            continue;
+        }
+        if (c == '\n') {
+            out->append("\r\n");
+            lineLength = 0;
+            continue;
+        }
+        out->append(c);
+        if (++lineLength > MaxLineLength) {
+            fits = false;
+        }
+    }
+    if (!out->endsWith("\r\n")) {
+        out->append("\r\n");
+    }
+    return fits;
+}
+
+QByteArray wrappedBase64(const QByteArray &data)
+{
+    const QByteArray encoded = data.toBase64();
+    QByteArray out;
+    out.reserve(encoded.size() + encoded.size() / 76 * 2 + 2);
+    for (qsizetype pos = 0; pos < encoded.size(); pos += 76) {
+        out += encoded.mid(pos, 76);
+        out += "\r\n";
+    }
+    return out;
+}
+
+// Dateiname als Parameter: RFC 2231 für Nicht-ASCII, sonst gequotet
+QByteArray fileNameParameter(const char *name, const QString &fileName)
+{
+    if (isPlainAscii(fileName)) {
+        QByteArray quoted = fileName.toUtf8();
+        quoted.replace('\\', "\\\\").replace('"', "\\\"");
+        return QByteArray(name) + "=\"" + quoted + '"';
+    }
+    return QByteArray(name) + "*=utf-8''" + fileName.toUtf8().toPercentEncoding();
+}
+
+bool writeAttachment(const QString &path, const QByteArray &boundary, QIODevice *device)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QString fileName = QFileInfo(path).fileName();
+    const QByteArray type = QMimeDatabase().mimeTypeForFile(path).name().toLatin1();
+    QByteArray head = "--" + boundary + "\r\n";
+    // name= zusätzlich RFC 2047 kodiert, für ältere Programme
+    head += "Content-Type: " + type + "; name=\"" + MessageWriter::encodeWord(fileName) + "\"\r\n";
+    head += "Content-Disposition: attachment; " + fileNameParameter("filename", fileName) + "\r\n";
+    head += "Content-Transfer-Encoding: base64\r\n\r\n";
+    if (device->write(head) != head.size()) {
+        return false;
+    }
+    while (!file.atEnd()) {
+        const QByteArray block = file.read(Base64Block);
+        if (block.isEmpty()) {
+            return false;
+        }
+        const QByteArray lines = wrappedBase64(block);
+        if (device->write(lines) != lines.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool MessageWriter::write(const OutgoingMail &mail, QIODevice *device, bool *eightBit)
+{
+    QByteArray text;
+    const bool fits = canonicalText(mail.text, &text);
+    const bool ascii = std::none_of(text.cbegin(), text.cend(), [](char c) { return uchar(c) >= 128; });
+    QByteArray encoding = "7bit";
+    if (!ascii) {
+        encoding = fits ? "8bit" : "base64";
+    } else if (!fits) {
+        encoding = "base64";
+    }
+    if (encoding == "base64") {
+        text = wrappedBase64(text);
+    }
+    if (eightBit) {
+        *eightBit = encoding == "8bit";
+    }
+
+    const QByteArray spec = addressSpec(mail.from);
+    const QByteArray domain = spec.contains('@') ? spec.mid(spec.lastIndexOf('@') + 1) : QByteArray("localhost");
+    const QByteArray uuid = QUuid::createUuid().toByteArray(QUuid::WithoutBraces);
+
+    QByteArray head;
+    head += addressHeader("From", {mail.from});
+    if (!mail.to.isEmpty()) {
+        head += addressHeader("To", mail.to);
+    }
+    if (!mail.cc.isEmpty()) {
+        head += addressHeader("Cc", mail.cc);
+    }
+    head += "Subject: " + encodeWord(mail.subject) + "\r\n";
+    head += "Date: " + QDateTime::currentDateTime().toString(Qt::RFC2822Date).toLatin1() + "\r\n";
+    head += "Message-ID: <" + uuid + '@' + domain + ">\r\n";
+    head += "MIME-Version: 1.0\r\n";
+
+    const QByteArray textHeaders = "Content-Type: text/plain; charset=utf-8\r\n"
+                                   "Content-Transfer-Encoding: " + encoding + "\r\n";
+    if (mail.attachments.isEmpty()) {
+        head += textHeaders + "\r\n";
+        return device->write(head) == head.size() && device->write(text) == text.size();
+    }
+
+    const QByteArray boundary = "==mailadler_" + uuid;
+    head += "Content-Type: multipart/mixed; boundary=\"" + boundary + "\"\r\n\r\n";
+    head += "--" + boundary + "\r\n" + textHeaders + "\r\n";
+    if (device->write(head) != head.size() || device->write(text) != text.size()) {
+        return false;
+    }
+    for (const QString &path : mail.attachments) {
+        if (!writeAttachment(path, boundary, device)) {
+            return false;
+        }
+    }
+    const QByteArray end = "--" + boundary + "--\r\n";
+    return device->write(end) == end.size();
+}
+
+QByteArray MessageWriter::addressSpec(const QString &address)
+{
+    const qsizetype open = address.indexOf(QLatin1Char('<'));
+    const qsizetype close = address.indexOf(QLatin1Char('>'), open + 1);
+    if (open >= 0 && close > open) {
+        return address.mid(open + 1, close - open - 1).trimmed().toUtf8();
+    }
+    return address.trimmed().toUtf8();
+}
+
+QList<QByteArray> MessageWriter::recipients(const OutgoingMail &mail)
+{
+    QList<QByteArray> result;
+    for (const QStringList *list : {&mail.to, &mail.cc, &mail.bcc}) {
+        for (const QString &address : *list) {
+            const QByteArray spec = addressSpec(address);
+            if (!spec.isEmpty() && !result.contains(spec)) {
+                result.append(spec);
+            }
+        }
+    }
+    return result;
+}
+
+QByteArray MessageWriter::encodeWord(const QString &text)
+{
+    if (isPlainAscii(text)) {
+        return text.toUtf8();
+    }
+    // Höchstens EncodedWordBytes je Wort, ohne ein Zeichen zu teilen
+    QByteArray result;
+    QByteArray chunk;
+    auto flush = [&]() {
+        if (!result.isEmpty()) {
+            result += "\r\n ";
+        }
+        result += "=?utf-8?B?" + chunk.toBase64() + "?=";
+        chunk.clear();
+    };
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const qsizetype length = text.at(i).isHighSurrogate() && i + 1 < text.size() ? 2 : 1;
+        const QByteArray bytes = text.mid(i, length).toUtf8();
+        i += length - 1;
+        if (chunk.size() + bytes.size() > EncodedWordBytes) {
+            flush();
+        }
+        chunk += bytes;
+    }
+    if (!chunk.isEmpty()) {
+        flush();
+    }
+    return result;
+}
@@ -0,0 +1,43 @@
+/*
+ * mailadler - Outgoing Message Writer
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MESSAGEWRITER_H
+#define MESSAGEWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+class QIODevice;
+
+struct OutgoingMail {
+    QString from;        // "Anna Müller <anna@example.de>"
+    QStringList to;
+    QStringList cc;
+    QStringList bcc;     // nur im Umschlag, nicht in den Kopfzeilen
+    QString subject;
+    QString text;
+    QStringList attachments; // Dateipfade
+};
+
+// Schreibt eine Nachricht als MIME (RFC 5322/2045) mit CRLF-Zeilenenden.
+// Anhänge werden blockweise gelesen und Base64-kodiert geschrieben, ihre
+// Größe bestimmt also nicht den Speicherbedarf.
+class MessageWriter
+{
+public:
+    // eightBit: Text enthält 8-Bit-Zeichen (Content-Transfer-Encoding: 8bit)
+    static bool write(const OutgoingMail &mail, QIODevice *device, bool *eightBit = nullptr);
+
+    // "Anna Müller <anna@example.de>" -> "anna@example.de"
+    static QByteArray addressSpec(const QString &address);
+    // Alle Umschlag-Empfänger aus To, Cc und Bcc
+    static QList<QByteArray> recipients(const OutgoingMail &mail);
+    // RFC 2047 für Nicht-ASCII, sonst unverändert
+    static QByteArray encodeWord(const QString &text);
+};
+
+#endif // MESSAGEWRITER_H
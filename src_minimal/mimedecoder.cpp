@@ -0,0 +1,931 @@
+/*
+ * mailadler - MIME Decoder
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "mimedecoder.h"
+#include <QStringDecoder>
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define MAILADLER_SSSE3 __attribute__((target("ssse3")))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define MAILADLER_SSSE3
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+// Base64-Werte; -1 für alles andere (Zeilenenden, Leerzeichen, '=')
+struct Base64Table {
+    qint8 values[256];
+
+    constexpr Base64Table()
+        : values()
+    {
+        for (int i = 0; i < 256; ++i) {
+            values[i] = -1;
+        }
+        const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i) {
+            values[static_cast<unsigned char>(alphabet[i])] = qint8(i);
+        }
+    }
+};
+
+constexpr Base64Table base64Table;
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+QByteArrayView trimmed(QByteArrayView v)
+{
+    qsizetype b = 0;
+    qsizetype e = v.size();
+    while (b < e && isSpace(v[b])) {
+        ++b;
+    }
+    while (e > b && isSpace(v[e - 1])) {
+        --e;
+    }
+    return v.sliced(b, e - b);
+}
+
+bool equalsIgnoreCase(QByteArrayView a, const char *b)
+{
+    const qsizetype n = qsizetype(std::strlen(b));
+    if (a.size() != n) {
+        return false;
+    }
+    for (qsizetype i = 0; i < n; ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c + 32);
+        }
+        if (c != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef MAILADLER_SSSE3
+
+bool cpuHasSsse3()
+{
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("ssse3");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return info[2] & (1 << 9);
+#endif
+}
+
+// Nach W. Muła/D. Lemire: Gültigkeit über zwei Nibble-Tabellen, Werte über
+// eine Verschiebung je oberem Nibble, dann 16 Sextette zu 12 Bytes packen.
+// Bricht am ersten Block mit Nicht-Alphabet-Zeichen ab (Zeilenende, '=');
+// *stop zeigt auf das erste solche Zeichen.
+MAILADLER_SSSE3
+const char *decodeBase64Ssse3(const char *p, const char *end, char **out, const char **stop)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2f = _mm_set1_epi8(0x2f);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    char *o = *out;
+
+    while (end - p >= 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2f);
+        const __m128i loNibbles = _mm_and_si128(in, mask2f);
+        const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        const int invalid = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()));
+        if (invalid) {
+            int first = 0;
+            while (!(invalid & (1 << first))) {
+                ++first;
+            }
+            *stop = p + first;
+            break;
+        }
+
+        const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask2f), hiNibbles));
+        const __m128i values = _mm_add_epi8(in, roll);
+        const __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i packed = _mm_shuffle_epi8(_mm_madd_epi16(merged, _mm_set1_epi32(0x00011000)), pack);
+        // maxDecodedSize() lässt Platz für die 4 Füllbytes
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(o), packed);
+        o += 12;
+        p += 16;
+    }
+    *out = o;
+    return p;
+}
+
+#endif
+
+const bool simdAvailable =
+#ifdef MAILADLER_SSSE3
+    cpuHasSsse3();
+#else
+    false;
+#endif
+
+// 0x80..0x9f in windows-1252; 0 = wie Latin-1
+const char16_t cp1252High[32] = {
+    0x20ac, 0, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017d, 0,
+    0, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0, 0x017e, 0x0178,
+};
+
+QString fromCp1252(QByteArrayView data, bool latin9)
+{
+    QString out(data.size(), Qt::Uninitialized);
+    char16_t *o = reinterpret_cast<char16_t *>(out.data());
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        const uchar c = uchar(data[i]);
+        char16_t u = c;
+        if (latin9) {
+            // ISO-8859-15 weicht nur an acht Stellen von Latin-1 ab
+            switch (c) {
+            case 0xa4: u = 0x20ac; break;
+            case 0xa6: u = 0x0160; break;
+            case 0xa8: u = 0x0161; break;
+            case 0xb4: u = 0x017d; break;
+            case 0xb8: u = 0x017e; break;
+            case 0xbc: u = 0x0152; break;
+            case 0xbd: u = 0x0153; break;
+            case 0xbe: u = 0x0178; break;
+            }
+        } else if (c >= 0x80 && c < 0xa0 && cp1252High[c - 0x80]) {
+            u = cp1252High[c - 0x80];
+        }
+        o[i] = u;
+    }
+    return out;
+}
+
+QByteArray decodeQ(QByteArrayView text)
+{
+    // RFC 2047 "Q": wie quoted-printable, '_' steht für ein Leerzeichen
+    QByteArray out;
+    out.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '_') {
+            out.append(' ');
+        } else if (c == '=' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            out.append(char(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+            i += 2;
+        } else {
+            out.append(c);
+        }
+    }
+    return out;
+}
+
+// Nächster Parameter ab pos in "type/subtype; a=1; b=\"x;y\"": Name und
+// Rohwert (ohne Anführungszeichen, Escapes aufgelöst)
+bool nextParameter(QByteArrayView value, qsizetype *pos, QByteArrayView *name, QByteArray *raw)
+{
+    qsizetype p = *pos;
+    // Zum nächsten ';' außerhalb von Anführungszeichen
+    bool quoted = false;
+    while (p < value.size() && (quoted || value[p] != ';')) {
+        if (value[p] == '"') {
+            quoted = !quoted;
+        } else if (quoted && value[p] == '\\') {
+            ++p;
+        }
+        ++p;
+    }
+    if (p >= value.size()) {
+        return false;
+    }
+    ++p;
+    const qsizetype nameStart = p;
+    while (p < value.size() && value[p] != '=' && value[p] != ';') {
+        ++p;
+    }
+    *name = trimmed(value.sliced(nameStart, p - nameStart));
+    raw->clear();
+    if (p < value.size() && value[p] == '=') {
+        ++p;
+        while (p < value.size() && isSpace(value[p])) {
+            ++p;
+        }
+        if (p < value.size() && value[p] == '"') {
+            ++p;
+            while (p < value.size() && value[p] != '"') {
+                if (value[p] == '\\' && p + 1 < value.size()) {
+                    ++p;
+                }
+                raw->append(value[p]);
+                ++p;
+            }
+            if (p < value.size()) {
+                ++p;
+            }
+        } else {
+            const qsizetype start = p;
+            while (p < value.size() && value[p] != ';') {
+                ++p;
+            }
+            *raw = trimmed(value.sliced(start, p - start)).toByteArray();
+        }
+    }
+    *pos = p;
+    return true;
+}
+
+QByteArray percentDecode(QByteArrayView text)
+{
+    QByteArray out;
+    out.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            out.append(char(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+            i += 2;
+        } else {
+            out.append(text[i]);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+TransferDecoder::TransferDecoder(Encoding encoding)
+    : m_encoding(encoding)
+    , m_bits(0)
+    , m_sextets(0)
+    , m_qpState(QpText)
+    , m_qpHigh(0)
+{
+}
+
+TransferDecoder::Encoding TransferDecoder::encodingFor(QByteArrayView name)
+{
+    const QByteArrayView n = trimmed(name);
+    if (equalsIgnoreCase(n, "base64")) {
+        return Base64;
+    }
+    if (equalsIgnoreCase(n, "quoted-printable")) {
+        return QuotedPrintable;
+    }
+    return Identity;
+}
+
+bool TransferDecoder::hasSimd()
+{
+    return simdAvailable;
+}
+
+void TransferDecoder::reset()
+{
+    m_bits = 0;
+    m_sextets = 0;
+    m_qpState = QpText;
+}
+
+qsizetype TransferDecoder::decode(QByteArrayView in, char *out)
+{
+    const char *p = in.data();
+    const char *end = p + in.size();
+    switch (m_encoding) {
+    case Base64:
+        return decodeBase64(p, end, out);
+    case QuotedPrintable:
+        return decodeQuotedPrintable(p, end, out);
+    case Identity:
+        break;
+    }
+    if (!in.isEmpty()) {
+        std::memcpy(out, p, size_t(in.size()));
+    }
+    return in.size();
+}
+
+QByteArray TransferDecoder::decode(QByteArrayView in)
+{
+    QByteArray out(maxDecodedSize(in.size()), Qt::Uninitialized);
+    out.truncate(decode(in, out.data()));
+    return out;
+}
+
+qsizetype TransferDecoder::finish(char *out)
+{
+    qsizetype n = 0;
+    if (m_encoding == Base64) {
+        if (m_sextets == 2) {
+            out[n++] = char(m_bits >> 4);
+        } else if (m_sextets == 3) {
+            out[n++] = char(m_bits >> 10);
+            out[n++] = char(m_bits >> 2);
+        }
+    } else if (m_encoding == QuotedPrintable) {
+        // Abgeschnittene Escape-Folge wörtlich ausgeben
+        if (m_qpState == QpEqual || m_qpState == QpHex) {
+            out[n++] = '=';
+        }
+        if (m_qpState == QpHex) {
+            out[n++] = m_qpHigh;
+        }
+    }
+    reset();
+    return n;
+}
+
+qsizetype TransferDecoder::decodeBase64(const char *p, const char *end, char *out)
+{
+    char *o = out;
+    const char *scalarUntil = p;
+
+    while (p < end) {
+#ifdef MAILADLER_SSSE3
+        // Nur an Quartettgrenzen und hinter dem letzten Nicht-Alphabet-Zeichen
+        if (simdAvailable && m_sextets == 0 && p >= scalarUntil && end - p >= 16) {
+            const char *stop = nullptr;
+            p = decodeBase64Ssse3(p, end, &o, &stop);
+            if (!stop) {
+                // Weniger als 16 Zeichen übrig
+                scalarUntil = end;
+            } else {
+                scalarUntil = stop + 1;
+            }
+            if (p >= end) {
+                break;
+            }
+        }
+#endif
+        const qint8 v = base64Table.values[uchar(*p)];
+        if (v >= 0) {
+            m_bits = (m_bits << 6) | quint32(v);
+            if (++m_sextets == 4) {
+                o[0] = char(m_bits >> 16);
+                o[1] = char(m_bits >> 8);
+                o[2] = char(m_bits);
+                o += 3;
+                m_bits = 0;
+                m_sextets = 0;
+            }
+        } else if (*p == '=') {
+            // Auffüllung schließt das Quartett ab
+            o += finish(o);
+        }
+        ++p;
+    }
+    Q_UNUSED(scalarUntil)
+    return o - out;
+}
+
+qsizetype TransferDecoder::decodeQuotedPrintable(const char *p, const char *end, char *out)
+{
+    char *o = out;
+    while (p < end) {
+        switch (m_qpState) {
+        case QpText: {
+            // Klartext in einem Stück kopieren
+            const char *eq = static_cast<const char *>(std::memchr(p, '=', size_t(end - p)));
+            const char *stop = eq ? eq : end;
+            std::memcpy(o, p, size_t(stop - p));
+            o += stop - p;
+            p = stop;
+            if (eq) {
+                m_qpState = QpEqual;
+                ++p;
+            }
+            break;
+        }
+        case QpEqual:
+            if (*p == '\r') {
+                m_qpState = QpSoftBreak;
+                ++p;
+            } else if (*p == '\n') {
+                m_qpState = QpText;
+                ++p;
+            } else if (*p == ' ' || *p == '\t') {
+                // Leerraum zwischen "=" und Zeilenende
+                ++p;
+            } else if (hexValue(*p) >= 0) {
+                m_qpHigh = *p;
+                m_qpState = QpHex;
+                ++p;
+            } else {
+                *o++ = '=';
+                m_qpState = QpText;
+            }
+            break;
+        case QpHex:
+            if (hexValue(*p) >= 0) {
+                *o++ = char(hexValue(m_qpHigh) * 16 + hexValue(*p));
+                ++p;
+            } else {
+                *o++ = '=';
+                *o++ = m_qpHigh;
+            }
+            m_qpState = QpText;
+            break;
+        case QpSoftBreak:
+            if (*p == '\n') {
+                ++p;
+            }
+            m_qpState = QpText;
+            break;
+        }
+    }
+    return o - out;
+}
+
+QString MimeDecoder::decodeHeader(QByteArrayView value)
+{
+    QString result;
+    // Benachbarte Wörter im selben Zeichensatz erst als Bytes sammeln:
+    // Mehrbyte-Zeichen werden oft über zwei Wörter verteilt
+    QByteArray pending;
+    QByteArray pendingCharset;
+    auto flush = [&]() {
+        if (!pending.isEmpty()) {
+            result += decodeText(pending, pendingCharset);
+            pending.clear();
+        }
+    };
+
+    qsizetype pos = 0;
+    bool afterWord = false;
+    while (pos < value.size()) {
+        qsizetype start = value.indexOf("=?", pos);
+        qsizetype charsetEnd = -1;
+        qsizetype textStart = -1;
+        qsizetype wordEnd = -1;
+        while (start >= 0) {
+            // =?charset?X?text?=
+            charsetEnd = value.indexOf('?', start + 2);
+            if (charsetEnd > start + 2 && charsetEnd + 2 < value.size() && value[charsetEnd + 2] == '?') {
+                textStart = charsetEnd + 3;
+                wordEnd = value.indexOf("?=", textStart);
+                if (wordEnd >= 0) {
+                    break;
+                }
+            }
+            start = value.indexOf("=?", start + 2);
+        }
+
+        const qsizetype textEnd = start >= 0 ? start : value.size();
+        const QByteArrayView between = value.sliced(pos, textEnd - pos);
+        // Leerraum zwischen zwei kodierten Wörtern entfällt (RFC 2047, 6.2)
+        if (!(afterWord && start >= 0 && trimmed(between).isEmpty())) {
+            flush();
+            result += decodeText(between, QByteArrayView());
+        }
+        if (start < 0) {
+            break;
+        }
+
+        QByteArrayView charset = value.sliced(start + 2, charsetEnd - start - 2);
+        const qsizetype language = charset.indexOf('*');
+        if (language >= 0) {
+            charset = charset.first(language);
+        }
+        const char kind = value[charsetEnd + 1];
+        const QByteArrayView text = value.sliced(textStart, wordEnd - textStart);
+        QByteArray bytes;
+        if (kind == 'B' || kind == 'b') {
+            // Manche Programme lassen die Auffüllung weg
+            TransferDecoder decoder(TransferDecoder::Base64);
+            bytes.resize(TransferDecoder::maxDecodedSize(text.size()));
+            qsizetype n = decoder.decode(text, bytes.data());
+            n += decoder.finish(bytes.data() + n);
+            bytes.truncate(n);
+        } else if (kind == 'Q' || kind == 'q') {
+            bytes = decodeQ(text);
+        } else {
+            bytes = value.sliced(start, wordEnd + 2 - start).toByteArray();
+        }
+        if (!equalsIgnoreCase(charset, pendingCharset.constData())) {
+            flush();
+            pendingCharset = charset.toByteArray().toLower();
+        }
+        pending += bytes;
+        afterWord = true;
+        pos = wordEnd + 2;
+    }
+    flush();
+    return result;
+}
+
+QString MimeDecoder::decodeText(QByteArrayView data, QByteArrayView charset)
+{
+    const QByteArrayView name = trimmed(charset);
+    if (name.isEmpty() || equalsIgnoreCase(name, "utf-8") || equalsIgnoreCase(name, "utf8")
+        || equalsIgnoreCase(name, "us-ascii")) {
+        // Ohne bzw. mit US-ASCII deklariert kommt in der Praxis oft UTF-8 oder Latin-1
+        QStringDecoder utf8(QStringDecoder::Utf8);
+        const QString text = utf8.decode(data);
+        if (!utf8.hasError() || equalsIgnoreCase(name, "utf-8") || equalsIgnoreCase(name, "utf8")) {
+            return text;
+        }
+        return QString::fromLatin1(data);
+    }
+    if (equalsIgnoreCase(name, "iso-8859-1") || equalsIgnoreCase(name, "latin1")) {
+        return QString::fromLatin1(data);
+    }
+    if (equalsIgnoreCase(name, "windows-1252") || equalsIgnoreCase(name, "cp1252")) {
+        return fromCp1252(data, false);
+    }
+    if (equalsIgnoreCase(name, "iso-8859-15") || equalsIgnoreCase(name, "latin9")) {
+        return fromCp1252(data, true);
+    }
+
+    // Weitere Zeichensätze nur, wenn Qt sie kennt (mit ICU)
+    QStringDecoder decoder(name.toByteArray().constData());
+    if (decoder.isValid()) {
+        return decoder.decode(data);
+    }
+    return QString::fromLatin1(data);
+}
+
+QByteArray MimeDecoder::mainValue(QByteArrayView value)
+{
+    qsizetype end = value.indexOf(';');
+    if (end < 0) {
+        end = value.size();
+    }
+    return trimmed(value.first(end)).toByteArray().toLower();
+}
+
+QString MimeDecoder::parameter(QByteArrayView value, QByteArrayView name)
+{
+    QByteArray plain;
+    bool hasPlain = false;
+    QByteArray extended; // name*=
+    // Fortsetzungen name*0, name*1* ...; Index -> (Rohwert, kodiert?)
+    std::vector<std::pair<QByteArray, bool>> sections;
+
+    qsizetype pos = 0;
+    QByteArrayView key;
+    QByteArray raw;
+    while (nextParameter(value, &pos, &key, &raw)) {
+        if (key.size() < name.size() || !equalsIgnoreCase(key.first(name.size()), name.toByteArray().toLower().constData())) {
+            continue;
+        }
+        const QByteArrayView rest = key.sliced(name.size());
+        if (rest.isEmpty()) {
+            plain = raw;
+            hasPlain = true;
+        } else if (rest == "*") {
+            extended = raw;
+        } else if (rest.startsWith('*')) {
+            const bool encoded = rest.endsWith('*') && rest.size() > 2;
+            const QByteArrayView digits = rest.sliced(1, rest.size() - (encoded ? 2 : 1));
+            bool ok = false;
+            const int index = digits.toInt(&ok);
+            if (ok && index >= 0 && index < 100) {
+                if (sections.size() <= size_t(index)) {
+                    sections.resize(size_t(index) + 1);
+                }
+                sections[size_t(index)] = {raw, encoded};
+            }
+        }
+    }
+
+    if (!extended.isEmpty()) {
+        return decodeExtendedValue(extended);
+    }
+    if (!sections.empty()) {
+        // Nur der erste Abschnitt trägt charset'lang'
+        QByteArray charset;
+        QByteArray bytes;
+        for (size_t i = 0; i < sections.size(); ++i) {
+            QByteArrayView part = sections[i].first;
+            if (!sections[i].second) {
+                bytes += part;
+                continue;
+            }
+            if (i == 0) {
+                const qsizetype first = part.indexOf('\'');
+                const qsizetype second = first >= 0 ? part.indexOf('\'', first + 1) : -1;
+                if (second >= 0) {
+                    charset = part.first(first).toByteArray();
+                    part = part.sliced(second + 1);
+                }
+            }
+            bytes += percentDecode(part);
+        }
+        return decodeText(bytes, charset);
+    }
+    // Viele Programme kodieren Dateinamen nach RFC 2047 statt 2231
+    return hasPlain ? decodeHeader(plain) : QString();
+}
+
+QString MimeDecoder::decodeExtendedValue(QByteArrayView value)
+{
+    const qsizetype first = value.indexOf('\'');
+    const qsizetype second = first >= 0 ? value.indexOf('\'', first + 1) : -1;
+    if (second < 0) {
+        return decodeText(percentDecode(value), "utf-8");
+    }
+    return decodeText(percentDecode(value.sliced(second + 1)), value.first(first));
+}
+
+MimeStreamParser::MimeStreamParser()
+    : m_state(Headers)
+    , m_first(true)
+{
+}
+
+void MimeStreamParser::reset()
+{
+    m_state = Headers;
+    m_first = true;
+    m_levels.clear();
+    m_part = MimePart();
+    m_decoder.reset();
+    m_buffer.clear();
+}
+
+void MimeStreamParser::feed(QByteArrayView data)
+{
+    if (m_buffer.isEmpty()) {
+        // Direkt auf den Eingabedaten arbeiten, nur den Rest aufheben
+        const qsizetype consumed = process(data, false);
+        m_buffer = data.sliced(consumed).toByteArray();
+        return;
+    }
+    m_buffer.append(data);
+    const qsizetype consumed = process(m_buffer, false);
+    m_buffer.remove(0, consumed);
+}
+
+void MimeStreamParser::finish()
+{
+    process(m_buffer, true);
+    if (m_state == Body) {
+        endPart();
+    }
+    reset();
+}
+
+qsizetype MimeStreamParser::process(QByteArrayView data, bool final)
+{
+    qsizetype pos = 0;
+    while (pos < data.size()) {
+        const QByteArrayView rest = data.sliced(pos);
+        qsizetype n = 0;
+        if (m_state == Headers) {
+            n = processHeaders(rest);
+            if (!n && final) {
+                // Nachricht endet in den Kopfzeilen
+                startPart(rest);
+                n = rest.size();
+            }
+        } else {
+            n = processBody(rest, final);
+        }
+        if (!n) {
+            break;
+        }
+        pos += n;
+    }
+    return pos;
+}
+
+qsizetype MimeStreamParser::processHeaders(QByteArrayView data)
+{
+    // Ende der Kopfzeilen: Leerzeile; Teile ohne Kopfzeilen beginnen direkt damit
+    qsizetype end = -1;
+    qsizetype headerEnd = 0;
+    if (data.startsWith("\n")) {
+        end = 1;
+    } else if (data.startsWith("\r\n")) {
+        end = 2;
+    } else {
+        qsizetype i = data.indexOf('\n');
+        while (i >= 0 && i + 1 < data.size()) {
+            if (data[i + 1] == '\n') {
+                headerEnd = i + 1;
+                end = i + 2;
+                break;
+            }
+            if (data[i + 1] == '\r' && i + 2 < data.size() && data[i + 2] == '\n') {
+                headerEnd = i + 1;
+                end = i + 3;
+                break;
+            }
+            i = data.indexOf('\n', i + 1);
+        }
+    }
+    if (end < 0) {
+        return 0;
+    }
+    startPart(data.first(headerEnd));
+    // Vor der Präambel das letzte '\n' stehen lassen, es gehört zum ersten Trenner
+    return m_state == Preamble ? end - 1 : end;
+}
+
+qsizetype MimeStreamParser::processBody(QByteArrayView data, bool final)
+{
+    if (m_levels.empty()) {
+        // Einteilige Nachricht bzw. Epilog: alles bis zum Ende
+        if (m_state == Body) {
+            emitData(data);
+        }
+        return data.size();
+    }
+
+    Level &level = m_levels.back();
+    qsizetype from = 0;
+    while (true) {
+        const qsizetype found = level.delimiter.indexIn(data, from);
+        if (found < 0) {
+            // Angefangenen Trenner (samt '\r' davor) für das nächste Stück aufheben
+            const qsizetype safe = final ? data.size() : qMax<qsizetype>(0, data.size() - level.delimiterSize - 1);
+            if (m_state == Body && safe > 0) {
+                emitData(data.first(safe));
+            }
+            return safe;
+        }
+
+        // Hinter dem Trenner: "--" für das Ende, sonst Leerraum bis Zeilenende
+        const qsizetype after = found + level.delimiterSize;
+        const qsizetype lineEnd = data.indexOf('\n', after);
+        if (lineEnd < 0 && !final) {
+            const qsizetype content = found > 0 && data[found - 1] == '\r' ? found - 1 : found;
+            if (m_state == Body && content > 0) {
+                emitData(data.first(content));
+            }
+            return found;
+        }
+        const QByteArrayView tail = data.sliced(after, (lineEnd < 0 ? data.size() : lineEnd) - after);
+        const bool close = tail.startsWith("--");
+        if (!close && !trimmed(tail).isEmpty()) {
+            // Nur ein Präfix der Grenze, weitersuchen
+            from = found + 1;
+            continue;
+        }
+
+        const qsizetype content = found > 0 && data[found - 1] == '\r' ? found - 1 : found;
+        if (m_state == Body) {
+            if (content > 0) {
+                emitData(data.first(content));
+            }
+            endPart();
+        }
+        if (close) {
+            // Zeilenende stehen lassen, es kann zum Trenner der Ebene darüber gehören
+            m_levels.pop_back();
+            m_state = m_levels.empty() ? Epilogue : Preamble;
+            return lineEnd < 0 ? data.size() : lineEnd;
+        }
+        m_state = Headers;
+        return lineEnd < 0 ? data.size() : lineEnd + 1;
+    }
+}
+
+void MimeStreamParser::startPart(QByteArrayView headers)
+{
+    if (m_first) {
+        m_first = false;
+        if (messageHeaders) {
+            messageHeaders(headers);
+        }
+    }
+
+    // Kopfzeilen entfalten und die für MIME nötigen auswerten
+    QByteArray contentType;
+    QByteArray encoding;
+    QByteArray disposition;
+    QByteArray contentId;
+    QByteArray *current = nullptr;
+    qsizetype pos = 0;
+    while (pos < headers.size()) {
+        qsizetype eol = headers.indexOf('\n', pos);
+        if (eol < 0) {
+            eol = headers.size();
+        }
+        const QByteArrayView line = headers.sliced(pos, eol - pos);
+        pos = eol + 1;
+        if (!line.isEmpty() && (line[0] == ' ' || line[0] == '\t')) {
+            if (current) {
+                current->append(' ');
+                current->append(trimmed(line));
+            }
+            continue;
+        }
+        current = nullptr;
+        const qsizetype colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        const QByteArrayView name = trimmed(line.first(colon));
+        if (equalsIgnoreCase(name, "content-type")) {
+            current = &contentType;
+        } else if (equalsIgnoreCase(name, "content-transfer-encoding")) {
+            current = &encoding;
+        } else if (equalsIgnoreCase(name, "content-disposition")) {
+            current = &disposition;
+        } else if (equalsIgnoreCase(name, "content-id")) {
+            current = &contentId;
+        }
+        if (current) {
+            *current = trimmed(line.sliced(colon + 1)).toByteArray();
+        }
+    }
+
+    QByteArray section;
+    if (!m_levels.empty()) {
+        section = nextSection();
+    }
+
+    const QByteArray type = contentType.isEmpty() ? QByteArray("text/plain") : MimeDecoder::mainValue(contentType);
+    const qsizetype slash = type.indexOf('/');
+    const QString boundary = MimeDecoder::parameter(contentType, "boundary");
+    if (type.startsWith("multipart/") && !boundary.isEmpty()) {
+        const QByteArray delimiter = "\n--" + boundary.toLatin1();
+        m_levels.push_back({section, QByteArrayMatcher(delimiter), delimiter.size(), 0});
+        m_state = Preamble;
+        return;
+    }
+
+    m_part = MimePart();
+    m_part.section = section.isEmpty() ? QByteArray("1") : section;
+    m_part.type = slash > 0 ? type.first(slash) : type;
+    m_part.subtype = slash > 0 ? type.sliced(slash + 1) : QByteArray();
+    m_part.charset = MimeDecoder::parameter(contentType, "charset").toLatin1().toLower();
+    m_part.encoding = encoding.toLower();
+    m_part.disposition = MimeDecoder::mainValue(disposition);
+    m_part.contentId = contentId;
+    m_part.filename = MimeDecoder::parameter(disposition, "filename");
+    if (m_part.filename.isEmpty()) {
+        m_part.filename = MimeDecoder::parameter(contentType, "name");
+    }
+    m_decoder = TransferDecoder(TransferDecoder::encodingFor(encoding));
+    m_state = Body;
+    if (partStarted) {
+        partStarted(m_part);
+    }
+}
+
+void MimeStreamParser::emitData(QByteArrayView data)
+{
+    m_part.size += quint32(data.size());
+    if (!partData) {
+        return;
+    }
+    if (m_decoder.encoding() == TransferDecoder::Identity) {
+        partData(data);
+        return;
+    }
+    m_decoded.resize(TransferDecoder::maxDecodedSize(data.size()));
+    const qsizetype n = m_decoder.decode(data, m_decoded.data());
+    if (n > 0) {
+        partData(QByteArrayView(m_decoded.constData(), n));
+    }
+}
+
+void MimeStreamParser::endPart()
+{
+    char rest[16];
+    const qsizetype n = m_decoder.finish(rest);
+    if (n > 0 && partData) {
+        partData(QByteArrayView(rest, n));
+    }
+    if (partFinished) {
+        partFinished();
+    }
+    m_state = Preamble;
+}
+
+QByteArray MimeStreamParser::nextSection()
+{
+    Level &level = m_levels.back();
+    ++level.children;
+    const QByteArray n = QByteArray::number(level.children);
+    return level.section.isEmpty() ? n : level.section + '.' + n;
+}
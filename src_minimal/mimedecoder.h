@@ -0,0 +1,125 @@
+/*
+ * mailadler - MIME Decoder
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef MIMEDECODER_H
+#define MIMEDECODER_H
+
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QByteArrayView>
+#include <QString>
+
+#include <functional>
+#include <vector>
+
+#include "bodystructure.h"
+
+// Content-Transfer-Encoding als Datenstrom. Der Zustand (angefangenes
+// Base64-Quartett, "=" am Ende eines quoted-printable-Stücks) bleibt
+// zwischen den Aufrufen erhalten, die Eingabe darf also beliebig zerteilt sein.
+// Base64 nutzt auf x86 mit SSSE3 einen SIMD-Pfad (16 Zeichen je Schritt).
+class TransferDecoder
+{
+public:
+    enum Encoding { Identity, Base64, QuotedPrintable };
+
+    explicit TransferDecoder(Encoding encoding = Identity);
+
+    static Encoding encodingFor(QByteArrayView name);
+    // Obergrenze für die Ausgabe von decode() bei size Eingabebytes
+    static qsizetype maxDecodedSize(qsizetype size) { return size + 16; }
+    static bool hasSimd();
+
+    // Schreibt nach out und liefert die Anzahl der Bytes
+    qsizetype decode(QByteArrayView in, char *out);
+    QByteArray decode(QByteArrayView in);
+    // Rest eines Base64-Quartetts ohne Auffüllung ausgeben
+    qsizetype finish(char *out);
+
+    Encoding encoding() const { return m_encoding; }
+    void reset();
+
+private:
+    enum QpState { QpText, QpEqual, QpHex, QpSoftBreak };
+
+    qsizetype decodeBase64(const char *p, const char *end, char *out);
+    qsizetype decodeQuotedPrintable(const char *p, const char *end, char *out);
+
+    Encoding m_encoding;
+    quint32 m_bits;
+    int m_sextets;
+    QpState m_qpState;
+    char m_qpHigh;
+};
+
+// Kopfzeilen und Zeichensätze
+class MimeDecoder
+{
+public:
+    // RFC 2047: "=?utf-8?B?...?=" und "=?iso-8859-1?Q?...?=" in beliebiger
+    // Mischung mit Klartext; unkodiertes 8-Bit wird als UTF-8 gelesen
+    static QString decodeHeader(QByteArrayView value);
+    static QString decodeText(QByteArrayView data, QByteArrayView charset);
+
+    // "text/plain; charset=utf-8" -> "text/plain" (klein geschrieben)
+    static QByteArray mainValue(QByteArrayView value);
+    // Parameter einer Kopfzeile, auch RFC 2231 (name*=, name*0*=)
+    static QString parameter(QByteArrayView value, QByteArrayView name);
+    // RFC 2231: "utf-8'de'Rechnung%20M%C3%A4rz.pdf"
+    static QString decodeExtendedValue(QByteArrayView value);
+};
+
+// Zerlegt eine Nachricht im Datenstrom in ihre MIME-Teile.
+//
+// Die Eingabe kommt in beliebigen Stücken; Teilgrenzen werden per
+// Boyer-Moore direkt in den übergebenen Daten gesucht, nur ein möglicher
+// angefangener Trenner am Stückende wird zwischengespeichert. Die Inhalte
+// gehen bereits dekodiert an partData, ein Anhang muss also nie vollständig
+// im Speicher liegen. Abschnittsnummern wie bei IMAP ("1", "2.1").
+class MimeStreamParser
+{
+public:
+    MimeStreamParser();
+
+    // Kopfzeilen der Nachricht selbst (vor dem ersten Teil)
+    std::function<void(QByteArrayView headers)> messageHeaders;
+    std::function<void(const MimePart &part)> partStarted;
+    std::function<void(QByteArrayView data)> partData;
+    std::function<void()> partFinished;
+
+    void feed(QByteArrayView data);
+    // Ende der Nachricht, schließt einen offenen Teil
+    void finish();
+    void reset();
+
+private:
+    enum State { Headers, Body, Preamble, Epilogue };
+
+    struct Level {
+        QByteArray section;
+        QByteArrayMatcher delimiter; // "\n--boundary"
+        qsizetype delimiterSize;
+        int children;
+    };
+
+    qsizetype process(QByteArrayView data, bool final);
+    qsizetype processHeaders(QByteArrayView data);
+    qsizetype processBody(QByteArrayView data, bool final);
+    void startPart(QByteArrayView headers);
+    void emitData(QByteArrayView data);
+    void endPart();
+    QByteArray nextSection();
+
+    State m_state;
+    bool m_first;
+    std::vector<Level> m_levels;
+    MimePart m_part;
+    TransferDecoder m_decoder;
+    QByteArray m_buffer;
+    QByteArray m_decoded;
+};
+
+#endif // MIMEDECODER_H
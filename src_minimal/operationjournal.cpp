@@ -0,0 +1,500 @@
+/*
+ * mailadler - Offline Operation Journal
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "operationjournal.h"
+#include "imapconnectionpool.h"
+#include "messagestore.h"
+#include <QDebug>
+#include <QHash>
+#include <QPointer>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <algorithm>
+
+namespace {
+
+// Beide Listen normalisiert
+bool overlaps(const QVector<UidRange> &a, const QVector<UidRange> &b)
+{
+    int i = 0;
+    int j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a.at(i).last < b.at(j).first) {
+            ++i;
+        } else if (b.at(j).last < a.at(i).first) {
+            ++j;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+OperationJournal::OperationJournal(ImapConnectionPool *pool, MessageStore *store, QObject *parent)
+    : QObject(parent)
+    , m_pool(pool)
+    , m_store(store)
+    , m_started(false)
+    , m_session(nullptr)
+    , m_run(0)
+    , m_pending(0)
+    , m_entryCount(0)
+    , m_commandCount(0)
+    , m_again(false)
+    , m_retry(false)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &OperationJournal::replay);
+    connect(m_pool, &ImapConnectionPool::sessionReady, this, &OperationJournal::onSessionReady);
+}
+
+bool OperationJournal::open()
+{
+    QSqlQuery query(m_store->database());
+    if (!query.exec("CREATE TABLE IF NOT EXISTS journal ("
+                    " id INTEGER PRIMARY KEY,"
+                    " mailbox_id INTEGER NOT NULL REFERENCES mailboxes(id) ON DELETE CASCADE,"
+                    " folder TEXT NOT NULL,"
+                    " op INTEGER NOT NULL,"
+                    " flags INTEGER NOT NULL DEFAULT 0,"
+                    " target TEXT,"
+                    " uids TEXT NOT NULL)")) {
+        qWarning() << "OperationJournal: Schema-Fehler:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void OperationJournal::start()
+{
+    m_started = true;
+    replay();
+}
+
+void OperationJournal::setFlags(const QString &folder, const QVector<UidRange> &uids, quint32 flags, bool add)
+{
+    Entry entry;
+    entry.mailboxId = m_store->mailboxId(m_account, folder);
+    entry.folder = folder;
+    entry.op = add ? AddFlags : RemoveFlags;
+    entry.flags = flags;
+    entry.uids = uids;
+    normalize(&entry.uids);
+    if (entry.uids.isEmpty() || !flags) {
+        return;
+    }
+
+    QVector<ImapFlagUpdate> updates;
+    for (ImapFlagUpdate u : m_store->flags(entry.mailboxId, entry.uids)) {
+        const quint32 changed = add ? u.flags | flags : u.flags & ~flags;
+        if (changed != u.flags) {
+            u.flags = changed;
+            updates.append(u);
+        }
+    }
+    if (!updates.isEmpty()) {
+        m_store->updateFlags(entry.mailboxId, updates);
+        emit flagsChanged(entry.mailboxId, updates);
+    }
+    // Auch ohne lokale Änderung: der Server kann einen anderen Stand haben
+    record(entry);
+}
+
+void OperationJournal::move(const QString &folder, const QVector<UidRange> &uids, const QString &target)
+{
+    Entry entry;
+    entry.mailboxId = m_store->mailboxId(m_account, folder);
+    entry.folder = folder;
+    entry.op = Move;
+    entry.target = target;
+    entry.uids = uids;
+    normalize(&entry.uids);
+    if (entry.uids.isEmpty() || folder == target) {
+        return;
+    }
+    // Im Zielordner erscheinen sie mit neuen UIDs beim nächsten Abgleich
+    m_store->removeUids(entry.mailboxId, entry.uids);
+    emit messagesRemoved(entry.mailboxId, entry.uids);
+    record(entry);
+}
+
+void OperationJournal::expunge(const QString &folder, const QVector<UidRange> &uids)
+{
+    Entry entry;
+    entry.mailboxId = m_store->mailboxId(m_account, folder);
+    entry.folder = folder;
+    entry.op = Expunge;
+    entry.uids = uids;
+    normalize(&entry.uids);
+    if (entry.uids.isEmpty()) {
+        return;
+    }
+    m_store->removeUids(entry.mailboxId, entry.uids);
+    emit messagesRemoved(entry.mailboxId, entry.uids);
+    record(entry);
+}
+
+int OperationJournal::pendingCount() const
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT COUNT(*) FROM journal j JOIN mailboxes m ON m.id = j.mailbox_id WHERE m.account = ?");
+    query.addBindValue(m_account);
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+void OperationJournal::normalize(QVector<UidRange> *ranges)
+{
+    std::sort(ranges->begin(), ranges->end(),
+              [](const UidRange &a, const UidRange &b) { return a.first < b.first; });
+    int out = 0;
+    for (int i = 0; i < ranges->size(); ++i) {
+        const UidRange r = ranges->at(i);
+        if (!r.first) {
+            continue;
+        }
+        // 64 Bit, damit last + 1 bei 0xFFFFFFFF nicht überläuft
+        if (out > 0 && quint64(r.first) <= quint64((*ranges)[out - 1].last) + 1) {
+            (*ranges)[out - 1].last = qMax((*ranges)[out - 1].last, r.last);
+        } else {
+            (*ranges)[out++] = r;
+        }
+    }
+    ranges->resize(out);
+}
+
+void OperationJournal::record(const Entry &entry)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("INSERT INTO journal (mailbox_id, folder, op, flags, target, uids) VALUES (?, ?, ?, ?, ?, ?)");
+    query.addBindValue(entry.mailboxId);
+    query.addBindValue(entry.folder);
+    query.addBindValue(int(entry.op));
+    query.addBindValue(entry.flags);
+    query.addBindValue(entry.target);
+    query.addBindValue(QString::fromLatin1(ImapConnection::uidSet(entry.uids)));
+    if (!query.exec()) {
+        qWarning() << "OperationJournal:" << query.lastError().text();
+        return;
+    }
+    if (m_session) {
+        m_again = true;
+    } else {
+        m_timer.start(ReplayDelay);
+    }
+}
+
+QList<OperationJournal::Entry> OperationJournal::load() const
+{
+    QList<Entry> entries;
+    QSqlQuery query(m_store->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT j.id, j.mailbox_id, j.folder, j.op, j.flags, j.target, j.uids"
+                  " FROM journal j JOIN mailboxes m ON m.id = j.mailbox_id WHERE m.account = ? ORDER BY j.id");
+    query.addBindValue(m_account);
+    if (!query.exec()) {
+        return entries;
+    }
+    while (query.next()) {
+        Entry e;
+        e.id = query.value(0).toLongLong();
+        e.mailboxId = query.value(1).toInt();
+        e.folder = query.value(2).toString();
+        e.op = Operation(query.value(3).toInt());
+        e.flags = query.value(4).toUInt();
+        e.target = query.value(5).toString();
+        ImapConnection::parseUidSet(query.value(6).toString().toLatin1(), &e.uids);
+        e.ids = {e.id};
+        entries.append(e);
+    }
+    return entries;
+}
+
+QList<OperationJournal::Entry> OperationJournal::coalesce(const QList<Entry> &entries)
+{
+    // Ein Eintrag rückt zum letzten gleichartigen Stapel seines Ordners vor,
+    // wenn kein Stapel dazwischen dieselben UIDs betrifft; Aktionen auf
+    // verschiedene Nachrichten sind vertauschbar
+    QList<Entry> batches;
+    for (const Entry &e : entries) {
+        if (e.uids.isEmpty()) {
+            continue;
+        }
+        int target = -1;
+        for (int i = int(batches.size()) - 1; i >= 0; --i) {
+            const Entry &b = batches.at(i);
+            if (b.mailboxId != e.mailboxId) {
+                continue;
+            }
+            if (b.op == e.op && b.flags == e.flags && b.target == e.target) {
+                target = i;
+                break;
+            }
+            if (overlaps(b.uids, e.uids)) {
+                break;
+            }
+        }
+        if (target < 0) {
+            batches.append(e);
+            continue;
+        }
+        Entry &b = batches[target];
+        if (e.uids.first().first > b.uids.last().last) {
+            // Häufigster Fall, Auswahl von oben nach unten: nur anhängen
+            for (const UidRange &r : e.uids) {
+                if (quint64(r.first) <= quint64(b.uids.last().last) + 1) {
+                    b.uids.last().last = qMax(b.uids.last().last, r.last);
+                } else {
+                    b.uids.append(r);
+                }
+            }
+        } else {
+            b.uids += e.uids;
+            normalize(&b.uids);
+        }
+        b.id = e.id;
+        b.ids += e.ids;
+    }
+    return batches;
+}
+
+void OperationJournal::replay()
+{
+    m_timer.stop();
+    if (m_session) {
+        m_again = true;
+        return;
+    }
+    if (!m_started) {
+        return;
+    }
+    const QList<Entry> entries = load();
+    if (entries.isEmpty()) {
+        return;
+    }
+    ImapConnection *session = m_pool->acquire();
+    if (!session) {
+        // Weiter über sessionReady()
+        if (m_pool->sessionCount() == 0) {
+            m_pool->open(1);
+        }
+        return;
+    }
+
+    m_session = session;
+    ++m_run;
+    m_pending = 0;
+    m_entryCount = int(entries.size());
+    m_commandCount = 0;
+    m_again = false;
+    m_retry = false;
+
+    // Ordner in der Reihenfolge ihres ersten Eintrags, je Ordner ein SELECT
+    QVector<int> order;
+    QHash<int, qint64> lastIds;
+    QHash<int, QVector<qint64>> ids;
+    for (const Entry &e : entries) {
+        if (!lastIds.contains(e.mailboxId)) {
+            order.append(e.mailboxId);
+        }
+        lastIds.insert(e.mailboxId, e.id);
+        ids[e.mailboxId].append(e.id);
+    }
+    const QList<Entry> batches = coalesce(entries);
+    for (int mailboxId : std::as_const(order)) {
+        auto folder = std::make_shared<Folder>(Folder{mailboxId, lastIds.value(mailboxId), 0});
+        bool selected = false;
+        for (const Entry &b : batches) {
+            if (b.mailboxId != mailboxId) {
+                continue;
+            }
+            if (!selected && session->selectedFolder() != b.folder) {
+                session->selectFolder(b.folder, ImapFolderState(),
+                                      whenDone(QStringLiteral("SELECT"), folder, ids.value(mailboxId)));
+            }
+            selected = true;
+            m_commandCount += issue(session, b, folder);
+        }
+        if (!folder->pending) {
+            // Nur leere UID-Mengen, nichts zu senden
+            forget(mailboxId, folder->lastId);
+        }
+    }
+    if (!m_pending) {
+        finishReplay(false);
+        return;
+    }
+    qDebug() << "OperationJournal:" << m_entryCount << "Einträge als" << m_commandCount << "Befehle";
+}
+
+int OperationJournal::issue(ImapConnection *session, const Entry &batch, const std::shared_ptr<Folder> &folder)
+{
+    int count = 0;
+    for (int first = 0; first < batch.uids.size(); first += MaxRangesPerCommand) {
+        const QVector<UidRange> part = batch.uids.mid(first, MaxRangesPerCommand);
+        switch (batch.op) {
+        case AddFlags:
+        case RemoveFlags:
+            session->storeFlags(part, batch.flags, batch.op == AddFlags,
+                                whenDone(QStringLiteral("STORE"), folder, batch.ids));
+            break;
+        case Move:
+            session->moveMessages(part, batch.target, whenDone(QStringLiteral("MOVE"), folder, batch.ids));
+            break;
+        case Expunge:
+            session->expungeMessages(part, whenDone(QStringLiteral("EXPUNGE"), folder, batch.ids));
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+ImapConnection::Done OperationJournal::whenDone(const QString &command, const std::shared_ptr<Folder> &folder,
+                                                const QVector<qint64> &ids)
+{
+    ++folder->pending;
+    ++m_pending;
+    const int index = int(folder->commands.size());
+    folder->commands.append(ids);
+    QPointer<OperationJournal> self(this);
+    const quint64 run = m_run;
+    return [self, run, command, folder, index](bool ok) {
+        if (self && self->m_run == run && self->m_session) {
+            self->commandDone(command, folder.get(), index, ok);
+        }
+    };
+}
+
+void OperationJournal::commandDone(const QString &command, Folder *folder, int index, bool ok)
+{
+    --m_pending;
+    if (!ok) {
+        if (!m_session->isConnected()) {
+            finishReplay(true);
+            return;
+        }
+        if (m_session->lastFailureTransient()) {
+            // z.B. [INUSE] oder [UNAVAILABLE]: die lokale Änderung bleibt
+            qWarning() << "OperationJournal:" << command << "vorübergehend abgelehnt";
+            if (folder->retryFrom < 0 || index < folder->retryFrom) {
+                folder->retryFrom = index;
+            }
+        } else {
+            // Nicht wiederholen: z.B. Zielordner fehlt. Der nächste Abgleich
+            // bringt den lokalen Stand auf den des Servers.
+            qWarning() << "OperationJournal:" << command << "abgelehnt";
+        }
+    }
+    // Erst wenn alle Befehle des Ordners abgeschlossen sind, auch ein
+    // nachgeschobenes UID EXPUNGE
+    if (--folder->pending == 0) {
+        folderDone(*folder);
+    }
+    if (!m_pending) {
+        finishReplay(false);
+    }
+}
+
+void OperationJournal::folderDone(const Folder &folder)
+{
+    // Ab dem ersten vorübergehend abgelehnten Befehl alles behalten, auch
+    // Erfolgreiches: erneut abgespielt ergibt es denselben Stand, nur in der
+    // ursprünglichen Reihenfolge
+    QSet<qint64> retry;
+    if (folder.retryFrom >= 0) {
+        for (int i = folder.retryFrom; i < folder.commands.size(); ++i) {
+            for (qint64 id : folder.commands.at(i)) {
+                retry.insert(id);
+            }
+        }
+    }
+    QSet<qint64> done;
+    for (const QVector<qint64> &command : folder.commands) {
+        for (qint64 id : command) {
+            if (!retry.contains(id)) {
+                done.insert(id);
+            }
+        }
+    }
+    for (auto it = retry.begin(); it != retry.end();) {
+        if (++m_attempts[*it] < MaxAttempts) {
+            ++it;
+            continue;
+        }
+        qWarning() << "OperationJournal: Eintrag" << *it << "nach" << MaxAttempts << "Versuchen verworfen";
+        done.insert(*it);
+        it = retry.erase(it);
+    }
+    for (qint64 id : std::as_const(done)) {
+        m_attempts.remove(id);
+    }
+
+    if (retry.isEmpty()) {
+        forget(folder.mailboxId, folder.lastId);
+    } else {
+        forget(done);
+        m_retry = true;
+    }
+}
+
+void OperationJournal::forget(int mailboxId, qint64 lastId)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("DELETE FROM journal WHERE mailbox_id = ? AND id <= ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(lastId);
+    query.exec();
+}
+
+void OperationJournal::forget(const QSet<qint64> &ids)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("DELETE FROM journal WHERE id = ?");
+    for (qint64 id : ids) {
+        query.addBindValue(id);
+        query.exec();
+    }
+}
+
+void OperationJournal::finishReplay(bool lost)
+{
+    ImapConnection *session = m_session;
+    m_session = nullptr;
+    // Ausstehende Abschlüsse, z.B. nach einem Verbindungsabbruch, verfallen
+    ++m_run;
+    m_pending = 0;
+    if (lost) {
+        // Erledigte Ordner sind schon aus dem Journal, der Rest kommt wieder
+        qWarning() << "OperationJournal: Verbindung verloren, neuer Versuch in 30 s";
+        m_timer.start(RetryDelay);
+        return;
+    }
+    emit replayed(m_entryCount, m_commandCount);
+    const bool again = m_again;
+    m_again = false;
+    m_pool->release(session);
+    if (again && !m_session) {
+        replay();
+    } else if (m_retry && !m_session) {
+        qWarning() << "OperationJournal: abgelehnte Einträge, neuer Versuch in 30 s";
+        m_timer.start(RetryDelay);
+    }
+}
+
+void OperationJournal::onSessionReady(ImapConnection *session)
+{
+    Q_UNUSED(session)
+    // Nicht in eine laufende Verzögerung hinein, die sammelt noch
+    if (!m_session && m_started && !m_timer.isActive()) {
+        replay();
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ * mailadler - Offline Operation Journal
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef OPERATIONJOURNAL_H
+#define OPERATIONJOURNAL_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+#include "imapconnection.h"
+
+class ImapConnectionPool;
+class MessageStore;
+
+// Markieren, Verschieben und Löschen ohne auf den Server zu warten.
+//
+// Jede Aktion wirkt sofort im MessageStore und wird in der Tabelle journal
+// festgehalten, so dass sie auch einen Neustart ohne Verbindung übersteht.
+// Beim Abspielen werden gleichartige Einträge eines Ordners zu einer
+// UID-Menge zusammengefasst, solange keine andere Aktion dazwischen dieselben
+// Nachrichten betrifft: 500 einzeln gelesene Nachrichten werden zu einem
+// "UID STORE 1:500 +FLAGS.SILENT (\Seen)". Alle Befehle eines Ordners gehen
+// hinter dem SELECT gemeinsam auf die Leitung. Lehnt der Server einen Befehl
+// nur vorübergehend ab (z.B. [INUSE]), bleiben seine Einträge für einen
+// späteren Versuch stehen; endgültig abgelehnte werden verworfen.
+class OperationJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation { AddFlags = 1, RemoveFlags = 2, Move = 3, Expunge = 4 };
+
+    // Längere UID-Mengen auf mehrere Befehle verteilen, manche Server
+    // begrenzen die Zeilenlänge auf 8 KiB
+    static constexpr int MaxRangesPerCommand = 500;
+    // Schnell aufeinanderfolgende Aktionen gemeinsam abspielen
+    static constexpr int ReplayDelay = 300; // ms
+    static constexpr int RetryDelay = 30000;
+    // Vorübergehend abgelehnte Einträge so oft erneut versuchen
+    static constexpr int MaxAttempts = 5;
+
+    OperationJournal(ImapConnectionPool *pool, MessageStore *store, QObject *parent = nullptr);
+
+    bool open();
+    void setAccount(const QString &account) { m_account = account; }
+    // Pool ist eingerichtet: ausstehende Einträge abspielen
+    void start();
+
+    void setFlags(const QString &folder, const QVector<UidRange> &uids, quint32 flags, bool add);
+    void move(const QString &folder, const QVector<UidRange> &uids, const QString &target);
+    void expunge(const QString &folder, const QVector<UidRange> &uids);
+
+    int pendingCount() const;
+
+    // Aufsteigend, überlappende und angrenzende Bereiche zusammengefasst
+    static void normalize(QVector<UidRange> *ranges);
+
+signals:
+    // Schon im MessageStore, z.B. für MessageListModel
+    void flagsChanged(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void messagesRemoved(int mailboxId, const QVector<UidRange> &ranges);
+    void replayed(int entries, int commands);
+
+public slots:
+    void replay();
+
+private slots:
+    void onSessionReady(ImapConnection *session);
+
+private:
+    struct Entry {
+        qint64 id = 0;
+        int mailboxId = -1;
+        QString folder;
+        Operation op = AddFlags;
+        quint32 flags = 0;
+        QString target;
+        QVector<UidRange> uids;
+        // Alle im Stapel zusammengefassten Einträge
+        QVector<qint64> ids;
+    };
+
+    // Ein Ordner beim Abspielen; ohne ausstehende Befehle ist er erledigt
+    struct Folder {
+        int mailboxId;
+        qint64 lastId;
+        int pending = 0;
+        // Einträge je Befehl in Sendereihenfolge, beim SELECT alle des Ordners
+        QVector<QVector<qint64>> commands;
+        // Erster vorübergehend abgelehnte Befehl; er und alle danach werden
+        // wiederholt, damit die Reihenfolge erhalten bleibt
+        int retryFrom = -1;
+    };
+
+    void record(const Entry &entry);
+    QList<Entry> load() const;
+    static QList<Entry> coalesce(const QList<Entry> &entries);
+    int issue(ImapConnection *session, const Entry &batch, const std::shared_ptr<Folder> &folder);
+    // Abschluss eines Befehls dieses Abspielens über die Einträge ids, siehe commandDone()
+    ImapConnection::Done whenDone(const QString &command, const std::shared_ptr<Folder> &folder,
+                                  const QVector<qint64> &ids);
+    void commandDone(const QString &command, Folder *folder, int index, bool ok);
+    void folderDone(const Folder &folder);
+    void forget(int mailboxId, qint64 lastId);
+    void forget(const QSet<qint64> &ids);
+    void finishReplay(bool lost);
+
+    ImapConnectionPool *m_pool;
+    MessageStore *m_store;
+    QString m_account;
+    bool m_started;
+    QTimer m_timer;
+
+    // Laufendes Abspielen
+    ImapConnection *m_session;
+    // Zählt die Abspielvorgänge; Abschlüsse früherer werden ignoriert
+    quint64 m_run;
+    int m_pending;
+    int m_entryCount;
+    int m_commandCount;
+    bool m_again;
+    // Einträge dieses Abspielens werden nach RetryDelay wiederholt
+    bool m_retry;
+    // Bisherige vorübergehende Ablehnungen je Eintrag
+    QHash<qint64, int> m_attempts;
+};
+
+#endif // OPERATIONJOURNAL_H
@@ -0,0 +1,275 @@
+/*
+ * mailadler - Persistent Outbox
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "outbox.h"
+#include "messagestore.h"
+#include "messagewriter.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QUuid>
+
+namespace {
+
+qint64 now()
+{
+    return QDateTime::currentSecsSinceEpoch();
+}
+
+OutboxEntry entryFrom(const QSqlQuery &query)
+{
+    OutboxEntry e;
+    e.id = query.value(0).toLongLong();
+    e.sender = query.value(1).toString().toUtf8();
+    e.recipients = query.value(2).toString().toUtf8().split('\n');
+    e.path = query.value(3).toString();
+    e.eightBit = query.value(4).toBool();
+    e.attempts = query.value(5).toInt();
+    e.nextAttempt = query.value(6).toLongLong();
+    e.lastError = query.value(7).toString();
+    e.failed = query.value(8).toBool();
+    return e;
+}
+
+const char *const EntryColumns = "id, sender, recipients, path, eight_bit, attempts, next_attempt, last_error, failed";
+
+} // namespace
+
+Outbox::Outbox(MessageStore *store, const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_directory(directory)
+    , m_client(new SmtpClient(this))
+    , m_sending(0)
+{
+    if (m_directory.isEmpty()) {
+        m_directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/outbox";
+    }
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &Outbox::processNext);
+    connect(m_client, &SmtpClient::sent, this, &Outbox::onSent);
+    connect(m_client, &SmtpClient::failed, this, &Outbox::onFailed);
+}
+
+bool Outbox::open()
+{
+    QDir().mkpath(m_directory);
+    QSqlQuery query(m_store->database());
+    if (!query.exec("CREATE TABLE IF NOT EXISTS outbox ("
+                    " id INTEGER PRIMARY KEY,"
+                    " sender TEXT NOT NULL,"
+                    " recipients TEXT NOT NULL,"
+                    " path TEXT NOT NULL,"
+                    " eight_bit INTEGER NOT NULL DEFAULT 0,"
+                    " attempts INTEGER NOT NULL DEFAULT 0,"
+                    " next_attempt INTEGER NOT NULL DEFAULT 0,"
+                    " last_error TEXT,"
+                    " failed INTEGER NOT NULL DEFAULT 0)")) {
+        qWarning() << "Outbox: Schema-Fehler:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void Outbox::start()
+{
+    processNext();
+}
+
+qint64 Outbox::enqueue(const OutgoingMail &mail)
+{
+    const QString path = m_directory + QLatin1Char('/') + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".eml";
+    QSaveFile file(path);
+    bool eightBit = false;
+    if (!file.open(QIODevice::WriteOnly) || !MessageWriter::write(mail, &file, &eightBit) || !file.commit()) {
+        qWarning() << "Outbox: kann" << path << "nicht schreiben";
+        return 0;
+    }
+    const qint64 id = insert(path, MessageWriter::addressSpec(mail.from), MessageWriter::recipients(mail), eightBit);
+    if (!id) {
+        QFile::remove(path);
+    }
+    return id;
+}
+
+qint64 Outbox::enqueueFile(const QString &path, const QByteArray &sender, const QList<QByteArray> &recipients,
+                           bool eightBit)
+{
+    const QString target = m_directory + QLatin1Char('/') + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".eml";
+    if (!QFile::rename(path, target) && !(QFile::copy(path, target) && QFile::remove(path))) {
+        qWarning() << "Outbox: kann" << path << "nicht übernehmen";
+        return 0;
+    }
+    return insert(target, sender, recipients, eightBit);
+}
+
+qint64 Outbox::insert(const QString &path, const QByteArray &sender, const QList<QByteArray> &recipients,
+                      bool eightBit)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("INSERT INTO outbox (sender, recipients, path, eight_bit) VALUES (?, ?, ?, ?)");
+    query.addBindValue(QString::fromUtf8(sender));
+    query.addBindValue(QString::fromUtf8(recipients.join('\n')));
+    query.addBindValue(path);
+    query.addBindValue(eightBit);
+    if (!query.exec()) {
+        qWarning() << "Outbox:" << query.lastError().text();
+        return 0;
+    }
+    const qint64 id = query.lastInsertId().toLongLong();
+    emit changed();
+    processNext();
+    return id;
+}
+
+QList<OutboxEntry> Outbox::entries() const
+{
+    QList<OutboxEntry> result;
+    QSqlQuery query(m_store->database());
+    if (query.exec(QString("SELECT %1 FROM outbox ORDER BY id").arg(QLatin1String(EntryColumns)))) {
+        while (query.next()) {
+            result.append(entryFrom(query));
+        }
+    }
+    return result;
+}
+
+int Outbox::pendingCount() const
+{
+    QSqlQuery query(m_store->database());
+    if (query.exec("SELECT COUNT(*) FROM outbox WHERE failed = 0") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+void Outbox::retry()
+{
+    QSqlQuery query(m_store->database());
+    query.exec("UPDATE outbox SET failed = 0, attempts = 0, next_attempt = 0");
+    emit changed();
+    processNext();
+}
+
+void Outbox::remove(qint64 id)
+{
+    // Eine laufende Übertragung lässt sich nicht zurückholen
+    if (id == m_sending) {
+        return;
+    }
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT path FROM outbox WHERE id = ?");
+    query.addBindValue(id);
+    if (query.exec() && query.next()) {
+        QFile::remove(query.value(0).toString());
+    }
+    finish(id);
+}
+
+void Outbox::processNext()
+{
+    // Ohne Server bleibt alles liegen, bis start() kommt
+    if (m_sending || !m_client->isConfigured()) {
+        return;
+    }
+    QSqlQuery query(m_store->database());
+    query.prepare(QString("SELECT %1 FROM outbox WHERE failed = 0 AND next_attempt <= ? ORDER BY id LIMIT 1")
+                      .arg(QLatin1String(EntryColumns)));
+    query.addBindValue(now());
+    if (!query.exec() || !query.next()) {
+        m_client->quit();
+        schedule();
+        return;
+    }
+    const OutboxEntry entry = entryFrom(query);
+    m_sending = entry.id;
+    qDebug() << "Outbox: sende" << entry.id << "an" << entry.recipients.size() << "Empfänger";
+
+    SmtpJob job;
+    job.id = entry.id;
+    job.sender = entry.sender;
+    job.recipients = entry.recipients;
+    job.path = entry.path;
+    job.eightBit = entry.eightBit;
+    m_client->send(job);
+}
+
+void Outbox::schedule()
+{
+    if (m_sending) {
+        return;
+    }
+    QSqlQuery query(m_store->database());
+    if (!query.exec("SELECT MIN(next_attempt) FROM outbox WHERE failed = 0") || !query.next()
+        || query.value(0).isNull()) {
+        m_timer.stop();
+        return;
+    }
+    const qint64 wait = qMax<qint64>(0, query.value(0).toLongLong() - now());
+    m_timer.start(int(qMin<qint64>(wait, MaxDelay) * 1000));
+}
+
+void Outbox::finish(qint64 id)
+{
+    QSqlQuery query(m_store->database());
+    query.prepare("DELETE FROM outbox WHERE id = ?");
+    query.addBindValue(id);
+    query.exec();
+    emit changed();
+}
+
+void Outbox::onSent(qint64 id)
+{
+    if (id != m_sending) {
+        return;
+    }
+    m_sending = 0;
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT path FROM outbox WHERE id = ?");
+    query.addBindValue(id);
+    if (query.exec() && query.next()) {
+        QFile::remove(query.value(0).toString());
+    }
+    finish(id);
+    emit sent(id);
+    processNext();
+}
+
+void Outbox::onFailed(qint64 id, const QString &message, bool permanent)
+{
+    if (id != m_sending) {
+        return;
+    }
+    m_sending = 0;
+
+    QSqlQuery query(m_store->database());
+    query.prepare("SELECT attempts FROM outbox WHERE id = ?");
+    query.addBindValue(id);
+    const int attempts = (query.exec() && query.next() ? query.value(0).toInt() : 0) + 1;
+    const bool giveUp = permanent || attempts >= MaxAttempts;
+    // 30 s, 1 min, 2 min ... höchstens eine Stunde
+    const qint64 delay = qMin<qint64>(qint64(FirstDelay) << qMin(attempts - 1, 20), MaxDelay);
+    qWarning() << "Outbox: Versuch" << attempts << "für" << id << "fehlgeschlagen:" << message;
+
+    query.prepare("UPDATE outbox SET attempts = ?, next_attempt = ?, last_error = ?, failed = ? WHERE id = ?");
+    query.addBindValue(attempts);
+    query.addBindValue(now() + delay);
+    query.addBindValue(message);
+    query.addBindValue(giveUp);
+    query.addBindValue(id);
+    query.exec();
+
+    emit changed();
+    if (giveUp) {
+        emit failed(id, message);
+    }
+    processNext();
+}
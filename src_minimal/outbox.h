@@ -0,0 +1,87 @@
+/*
+ * mailadler - Persistent Outbox
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include "smtpclient.h"
+
+class MessageStore;
+struct OutgoingMail;
+
+struct OutboxEntry {
+    qint64 id = 0;
+    QByteArray sender;
+    QList<QByteArray> recipients;
+    QString path;
+    bool eightBit = false;
+    int attempts = 0;
+    qint64 nextAttempt = 0; // Sekunden seit Epoch
+    QString lastError;
+    bool failed = false;    // endgültig, wartet auf den Benutzer
+};
+
+// Warteschlange für ausgehende Nachrichten, übersteht Neustarts.
+//
+// Jede Nachricht liegt fertig kodiert als Datei im Ausgangsordner, der
+// Umschlag und der Zustand der Zustellversuche in der Tabelle outbox der
+// Datenbank des MessageStore. Vorübergehende Fehler (4xx, Verbindung)
+// werden mit wachsendem Abstand wiederholt, dauerhafte (5xx) bleiben als
+// fehlgeschlagen liegen, bis retry() oder remove() sie erledigt.
+class Outbox : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int FirstDelay = 30;       // Sekunden
+    static constexpr int MaxDelay = 60 * 60;
+    static constexpr int MaxAttempts = 12;
+
+    explicit Outbox(MessageStore *store, const QString &directory = QString(), QObject *parent = nullptr);
+
+    bool open();
+    SmtpClient *client() const { return m_client; }
+    // Nach dem Einrichten des Servers: fällige Nachrichten senden
+    void start();
+
+    // Schreibt die Nachricht in den Ausgangsordner; 0 bei Fehler
+    qint64 enqueue(const OutgoingMail &mail);
+    // Fertige Nachricht übernehmen (wird in den Ausgangsordner verschoben)
+    qint64 enqueueFile(const QString &path, const QByteArray &sender, const QList<QByteArray> &recipients,
+                       bool eightBit);
+    QList<OutboxEntry> entries() const;
+    int pendingCount() const;
+    // Fehlgeschlagene und wartende Nachrichten sofort erneut versuchen
+    void retry();
+    void remove(qint64 id);
+
+signals:
+    void sent(qint64 id);
+    void failed(qint64 id, const QString &message);
+    void changed();
+
+private slots:
+    void processNext();
+    void onSent(qint64 id);
+    void onFailed(qint64 id, const QString &message, bool permanent);
+
+private:
+    qint64 insert(const QString &path, const QByteArray &sender, const QList<QByteArray> &recipients, bool eightBit);
+    void schedule();
+    void finish(qint64 id);
+
+    MessageStore *m_store;
+    QString m_directory;
+    SmtpClient *m_client;
+    QTimer m_timer;
+    qint64 m_sending; // id der laufenden Nachricht
+};
+
+#endif // OUTBOX_H
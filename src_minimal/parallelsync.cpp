@@ -0,0 +1,244 @@
+/*
+ * mailadler - Parallel Folder Synchronization
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "parallelsync.h"
+#include "imapconnectionpool.h"
+#include "mailsync.h"
+#include "messagestore.h"
+#include <QDebug>
+
+#include <algorithm>
+
+ParallelSync::ParallelSync(ImapConnectionPool *pool, MessageStore *store, QObject *parent)
+    : QObject(parent)
+    , m_pool(pool)
+    , m_store(store)
+    , m_scheduler(nullptr)
+    , m_phase(Idle)
+    , m_statusSession(nullptr)
+    , m_statusPending(0)
+    , m_running(0)
+    , m_done(0)
+    , m_total(0)
+{
+    connect(m_pool, &ImapConnectionPool::sessionReady, this, &ParallelSync::onSessionReady);
+    connect(m_pool, &ImapConnectionPool::sessionLost, this, &ParallelSync::onSessionLost);
+}
+
+void ParallelSync::syncFolders(const QStringList &folders)
+{
+    if (m_phase != Idle) {
+        qWarning() << "ParallelSync: Abgleich läuft bereits";
+        return;
+    }
+    if (folders.isEmpty()) {
+        emit finished();
+        return;
+    }
+    m_folders = folders;
+    m_status.clear();
+    m_phase = Status;
+
+    // Für STATUS reicht eine Sitzung, die übrigen öffnet plan()
+    m_pool->open(1);
+    if (ImapConnection *session = m_pool->acquire()) {
+        requestStatus(session);
+    }
+}
+
+void ParallelSync::onSessionReady(ImapConnection *session)
+{
+    Q_UNUSED(session)
+    if (m_phase == Status && !m_statusSession) {
+        if (ImapConnection *s = m_pool->acquire()) {
+            requestStatus(s);
+        }
+    } else if (m_phase == Running) {
+        dispatch();
+    }
+}
+
+void ParallelSync::onSessionLost(ImapConnection *session)
+{
+    // Laufende Aufträge wurden bereits mit Fehler beendet
+    if (MailSync *w = m_workers.take(session)) {
+        w->deleteLater();
+    }
+    if (m_pool->sessionCount() > 0) {
+        return;
+    }
+    if (m_phase == Status && !m_statusSession) {
+        m_phase = Idle;
+        emit finished();
+    } else if (m_phase == Running) {
+        dispatch();
+    }
+}
+
+void ParallelSync::requestStatus(ImapConnection *session)
+{
+    m_statusSession = session;
+    m_statusPending = int(m_folders.size());
+
+    connect(session, &ImapConnection::statusReceived, this,
+            [this](const QString &folder, const ImapFolderState &state) { m_status.insert(folder, state); });
+    connect(session, &ImapConnection::commandFinished, this, [this, session](const QString &command, bool ok) {
+        Q_UNUSED(ok)
+        if (command != QLatin1String("STATUS") || --m_statusPending > 0) {
+            return;
+        }
+        disconnect(session, &ImapConnection::statusReceived, this, nullptr);
+        disconnect(session, &ImapConnection::commandFinished, this, nullptr);
+        m_statusSession = nullptr;
+        plan();
+        m_pool->release(session);
+        dispatch();
+    });
+
+    // Alle STATUS-Befehle gehen gemeinsam auf die Leitung
+    for (const QString &folder : std::as_const(m_folders)) {
+        session->requestStatus(folder);
+    }
+}
+
+void ParallelSync::plan()
+{
+    m_phase = Running;
+    m_jobs.clear();
+    m_splits.clear();
+
+    const int sessions = m_pool->maxConnections();
+    for (const QString &folder : std::as_const(m_folders)) {
+        auto it = m_status.constFind(folder);
+        if (it == m_status.constEnd()) {
+            qWarning() << "ParallelSync: kein STATUS für" << folder;
+            continue;
+        }
+        const ImapFolderState &server = it.value();
+        const int mailboxId = m_store->mailboxId(m_account, folder);
+        const ImapFolderState known = m_store->folderState(mailboxId);
+        const bool incremental = known.uidNext && known.uidValidity == server.uidValidity;
+
+        if (!incremental && sessions > 1 && server.exists >= SplitThreshold && server.uidNext > 1) {
+            if (known.uidValidity && known.uidValidity != server.uidValidity) {
+                m_store->resetMailbox(mailboxId, server.uidValidity);
+                emit mailboxReset(mailboxId);
+            }
+            // UIDs sind lückenhaft verteilt, gleich große UID-Spannen sind
+            // trotzdem eine brauchbare Näherung für gleich viel Arbeit
+            const quint32 parts = qMin<quint32>(quint32(sessions), (server.exists + SplitThreshold - 1) / SplitThreshold);
+            // 64 Bit, sonst läuft first + step bei UIDNEXT nahe 2^32 über
+            const quint64 span = server.uidNext - 1;
+            const quint64 step = (span + parts - 1) / parts;
+            Split split;
+            split.mailboxId = mailboxId;
+            split.state = server;
+            for (quint64 first = 1; first <= span; first += step) {
+                Job job;
+                job.folder = folder;
+                job.first = quint32(first);
+                job.last = quint32(qMin(span, first + step - 1));
+                job.weight = server.exists / parts;
+                m_jobs.append(job);
+                ++split.remaining;
+            }
+            m_splits.insert(folder, split);
+            continue;
+        }
+
+        Job job;
+        job.folder = folder;
+        // Fester Anteil für SELECT und Flag-Abgleich
+        job.weight = 100 + (incremental ? qMax<qint64>(0, qint64(server.uidNext) - known.uidNext) : server.exists);
+        m_jobs.append(job);
+    }
+
+    // Größte zuerst, damit am Ende keine Sitzung allein an einem Riesen hängt
+    std::stable_sort(m_jobs.begin(), m_jobs.end(), [](const Job &a, const Job &b) { return a.weight > b.weight; });
+    m_total = int(m_jobs.size());
+    m_done = 0;
+    m_running = 0;
+    m_pool->open(m_total);
+}
+
+void ParallelSync::dispatch()
+{
+    while (!m_jobs.isEmpty()) {
+        ImapConnection *session = m_pool->acquire();
+        if (!session) {
+            break;
+        }
+        const Job job = m_jobs.takeFirst();
+        // Die übrigen Ordner sind Hintergrundarbeit, bis die Sitzung zurückgeht
+        session->setLane(ImapConnection::BackgroundLane);
+        MailSync *w = worker(session);
+        w->setAccount(m_account);
+        ++m_running;
+        if (job.last) {
+            w->syncRange(job.folder, m_splits.value(job.folder).state.uidValidity, job.first, job.last);
+        } else {
+            w->syncFolder(job.folder);
+        }
+    }
+
+    if (m_phase == Running && m_running == 0 && (m_jobs.isEmpty() || m_pool->sessionCount() == 0)) {
+        if (!m_jobs.isEmpty()) {
+            qWarning() << "ParallelSync: keine Sitzung mehr," << m_jobs.size() << "Aufträge verworfen";
+            m_jobs.clear();
+        }
+        m_splits.clear();
+        m_phase = Idle;
+        emit finished();
+    }
+}
+
+void ParallelSync::onWorkerFinished(MailSync *worker, const QString &folder, bool ok)
+{
+    --m_running;
+    ++m_done;
+    emit progress(m_done, m_total);
+    if (!ok) {
+        qWarning() << "ParallelSync: Abgleich von" << folder << "fehlgeschlagen";
+    }
+
+    auto it = m_splits.find(folder);
+    if (it != m_splits.end()) {
+        it->ok = it->ok && ok;
+        if (--it->remaining == 0) {
+            // Zustand vom STATUS vor dem Laden: spätere Änderungen holt der
+            // nächste inkrementelle Abgleich
+            const Split split = *it;
+            m_splits.erase(it);
+            if (split.ok) {
+                m_store->setFolderState(split.mailboxId, split.state);
+                emit folderSynced(folder, split.mailboxId);
+            }
+        }
+    }
+
+    worker->connection()->setLane(ImapConnection::InteractiveLane);
+    m_pool->release(worker->connection());
+    dispatch();
+}
+
+MailSync *ParallelSync::worker(ImapConnection *session)
+{
+    MailSync *w = m_workers.value(session);
+    if (w) {
+        return w;
+    }
+    w = new MailSync(session, m_store, this);
+    w->setScheduler(m_scheduler);
+    connect(w, &MailSync::folderSynced, this, &ParallelSync::folderSynced);
+    connect(w, &MailSync::mailboxReset, this, &ParallelSync::mailboxReset);
+    connect(w, &MailSync::messagesAdded, this, &ParallelSync::messagesAdded);
+    connect(w, &MailSync::flagsChanged, this, &ParallelSync::flagsChanged);
+    connect(w, &MailSync::messagesRemoved, this, &ParallelSync::messagesRemoved);
+    connect(w, &MailSync::finished, this,
+            [this, w](const QString &folder, bool ok) { onWorkerFinished(w, folder, ok); });
+    m_workers.insert(session, w);
+    return w;
+}
@@ -0,0 +1,102 @@
+/*
+ * mailadler - Parallel Folder Synchronization
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef PARALLELSYNC_H
+#define PARALLELSYNC_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+#include "imapconnection.h"
+
+class ImapConnectionPool;
+class ImapScheduler;
+class MailSync;
+class MessageStore;
+
+// Verteilt den Abgleich mehrerer Ordner auf die Sitzungen eines
+// ImapConnectionPool.
+//
+// Zuerst wird per STATUS (gebündelt auf einer Sitzung) die Größe aller Ordner
+// ermittelt. Große Ordner ohne lokalen Stand werden in UID-Bereiche zerlegt,
+// die parallel geladen werden; alle anderen werden als Ganzes von MailSync
+// abgeglichen. Die größten Aufträge werden zuerst vergeben. Ausgeliehene
+// Sitzungen arbeiten in der Hintergrundspur.
+class ParallelSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    ParallelSync(ImapConnectionPool *pool, MessageStore *store, QObject *parent = nullptr);
+
+    void setAccount(const QString &account) { m_account = account; }
+    void setScheduler(ImapScheduler *scheduler) { m_scheduler = scheduler; }
+    void syncFolders(const QStringList &folders);
+    bool isBusy() const { return m_phase != Idle; }
+
+signals:
+    void folderSynced(const QString &folder, int mailboxId);
+    void mailboxReset(int mailboxId);
+    void messagesAdded(int mailboxId, const QList<EmailHeader> &headers);
+    void flagsChanged(int mailboxId, const QVector<ImapFlagUpdate> &updates);
+    void messagesRemoved(int mailboxId, const QVector<UidRange> &ranges);
+    void progress(int done, int total);
+    void finished();
+
+private slots:
+    void onSessionReady(ImapConnection *session);
+    void onSessionLost(ImapConnection *session);
+
+private:
+    enum Phase { Idle, Status, Running };
+
+    // last == 0: ganzer Ordner über MailSync::syncFolder()
+    struct Job {
+        QString folder;
+        quint32 first = 0;
+        quint32 last = 0;
+        quint64 weight = 0;
+    };
+
+    // Ein in Bereiche zerlegter Ordner
+    struct Split {
+        int mailboxId = -1;
+        ImapFolderState state;
+        int remaining = 0;
+        bool ok = true;
+    };
+
+    void requestStatus(ImapConnection *session);
+    void plan();
+    void dispatch();
+    void onWorkerFinished(MailSync *worker, const QString &folder, bool ok);
+    MailSync *worker(ImapConnection *session);
+
+    // Ab dieser Größe lohnt sich die Aufteilung eines Erstabgleichs
+    static const quint32 SplitThreshold = 20000;
+
+    ImapConnectionPool *m_pool;
+    MessageStore *m_store;
+    ImapScheduler *m_scheduler;
+    QString m_account;
+    Phase m_phase;
+
+    QStringList m_folders;
+    QHash<QString, ImapFolderState> m_status;
+    ImapConnection *m_statusSession;
+    int m_statusPending;
+
+    QList<Job> m_jobs;
+    QHash<QString, Split> m_splits;
+    QHash<ImapConnection *, MailSync *> m_workers;
+    int m_running;
+    int m_done;
+    int m_total;
+};
+
+#endif // PARALLELSYNC_H
@@ -0,0 +1,398 @@
+/*
+ * mailadler - Full-Text Search Index
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "searchindex.h"
+#include "storecipher.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QRunnable>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+// Ein Stapel Dokumente bzw. Löschungen. Normalisiert wird parallel, geschrieben
+// in der Reihenfolge der Aufträge, damit ein Löschen nicht von einem älteren
+// Einfügen überholt wird.
+class SearchIndexTask : public QRunnable
+{
+public:
+    SearchIndexTask(SearchIndex *index, quint64 ticket)
+        : m_index(index)
+        , m_ticket(ticket)
+        , m_removalMailbox(-1)
+    {
+    }
+
+    void run() override;
+
+    QVector<SearchDocument> documents;
+    QVector<SearchDocument> attachments;
+    QVector<UidRange> removals;
+    int removalMailbox() const { return m_removalMailbox; }
+    void setRemovalMailbox(int mailboxId) { m_removalMailbox = mailboxId; }
+
+private:
+    void write(QSqlDatabase db);
+
+    SearchIndex *m_index;
+    quint64 m_ticket;
+    int m_removalMailbox;
+};
+
+void SearchIndexTask::run()
+{
+    // Teurer Teil ohne Sperre: Zerlegen, Falten, Stemmen
+    for (SearchDocument &d : documents) {
+        d.subject = TextNormalizer::normalize(d.subject);
+        d.addresses = TextNormalizer::normalize(d.addresses);
+        d.body = TextNormalizer::normalize(d.body);
+    }
+    for (SearchDocument &d : attachments) {
+        d.body = TextNormalizer::normalize(d.body);
+    }
+
+    SearchIndex::WriteOrder &order = m_index->m_order;
+    QMutexLocker locker(&order.mutex);
+    while (order.next != m_ticket) {
+        order.turn.wait(&order.mutex);
+    }
+
+    // Eigene Verbindung je Auftrag, QSqlDatabase ist an den Thread gebunden
+    const QString name = QString("searchindex-%1-%2").arg(quintptr(m_index), 0, 16).arg(m_ticket);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(m_index->m_path);
+        if (db.open() && (!m_index->m_cipher || m_index->m_cipher->keyDatabase(db))) {
+            write(db);
+            db.close();
+        } else {
+            qWarning() << "SearchIndex: kann" << m_index->m_path << "nicht öffnen:" << db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+
+    ++order.next;
+    order.turn.wakeAll();
+}
+
+void SearchIndexTask::write(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.exec("PRAGMA busy_timeout = 5000");
+    db.transaction();
+
+    if (m_removalMailbox >= 0) {
+        for (const char *sql : {"DELETE FROM message_index WHERE rowid BETWEEN ? AND ?",
+                                "DELETE FROM attachment_index WHERE rowid BETWEEN ? AND ?"}) {
+            query.prepare(sql);
+            if (removals.isEmpty()) {
+                query.addBindValue(SearchIndex::rowId(m_removalMailbox, 0));
+                query.addBindValue(SearchIndex::rowId(m_removalMailbox, 0xffffffffu));
+                query.exec();
+            }
+            for (const UidRange &r : std::as_const(removals)) {
+                query.bindValue(0, SearchIndex::rowId(m_removalMailbox, r.first));
+                query.bindValue(1, SearchIndex::rowId(m_removalMailbox, r.last));
+                query.exec();
+            }
+        }
+    }
+
+    if (!documents.isEmpty()) {
+        query.prepare("INSERT OR REPLACE INTO message_index (rowid, subject, addresses, body) VALUES (?, ?, ?, ?)");
+        for (const SearchDocument &d : std::as_const(documents)) {
+            query.bindValue(0, SearchIndex::rowId(d.mailboxId, d.uid));
+            query.bindValue(1, d.subject);
+            query.bindValue(2, d.addresses);
+            query.bindValue(3, d.body);
+            if (!query.exec()) {
+                qWarning() << "SearchIndex:" << query.lastError().text();
+                break;
+            }
+        }
+    }
+
+    if (!attachments.isEmpty()) {
+        query.prepare("INSERT OR REPLACE INTO attachment_index (rowid, subject, addresses, body) VALUES (?, '', '', ?)");
+        for (const SearchDocument &d : std::as_const(attachments)) {
+            query.bindValue(0, SearchIndex::rowId(d.mailboxId, d.uid));
+            query.bindValue(1, d.body);
+            if (!query.exec()) {
+                qWarning() << "SearchIndex:" << query.lastError().text();
+                break;
+            }
+        }
+    }
+
+    db.commit();
+    if (!documents.isEmpty()) {
+        emit m_index->indexed(int(documents.size()));
+    }
+}
+
+SearchIndex::SearchIndex(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_connectionName(QString("searchindex-%1").arg(quintptr(this), 0, 16))
+    , m_cipher(nullptr)
+    , m_valid(false)
+    , m_contentless(false)
+{
+    // Ein Kern bleibt für die Oberfläche frei
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(500);
+    connect(&m_flushTimer, &QTimer::timeout, this, &SearchIndex::flush);
+}
+
+SearchIndex::~SearchIndex()
+{
+    flush();
+    m_pool.waitForDone();
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        if (db.isOpen()) {
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool SearchIndex::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_path);
+    if (!db.open()) {
+        qWarning() << "SearchIndex: kann" << m_path << "nicht öffnen:" << db.lastError().text();
+        return false;
+    }
+    if (m_cipher && !m_cipher->keyDatabase(db)) {
+        qWarning() << "SearchIndex:" << m_path << "passt nicht zum Schlüssel";
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode = WAL");
+    query.exec("PRAGMA busy_timeout = 5000");
+
+    if (!createTable(query, "message_index") || !createTable(query, "attachment_index")) {
+        return false;
+    }
+    m_valid = true;
+    return true;
+}
+
+bool SearchIndex::createTable(QSqlQuery &query, const char *name)
+{
+    // Texte sind schon normalisiert, der Tokenizer trennt nur noch an Leerzeichen.
+    // Ohne gespeicherten Inhalt (SQLite >= 3.43) bleibt der Index klein.
+    m_contentless = query.exec(QString("CREATE VIRTUAL TABLE IF NOT EXISTS %1 USING fts5("
+                                       "subject, addresses, body, content='', contentless_delete=1,"
+                                       " tokenize='ascii', prefix='2 3')").arg(QLatin1String(name)));
+    if (!m_contentless) {
+        qDebug() << "SearchIndex: contentless_delete nicht unterstützt," << name << "speichert den Text mit";
+        if (!query.exec(QString("CREATE VIRTUAL TABLE IF NOT EXISTS %1 USING fts5("
+                                "subject, addresses, body, tokenize='ascii', prefix='2 3')").arg(QLatin1String(name)))) {
+            qWarning() << "SearchIndex: FTS5 nicht verfügbar:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchIndex::addDocuments(const QVector<SearchDocument> &documents)
+{
+    if (!m_valid) {
+        return;
+    }
+    m_pending += documents;
+    if (m_pending.size() >= BatchSize) {
+        flush();
+    } else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void SearchIndex::addMessages(int mailboxId, const QList<EmailHeader> &headers)
+{
+    QVector<SearchDocument> documents;
+    documents.reserve(headers.size());
+    for (const EmailHeader &h : headers) {
+        SearchDocument d;
+        d.mailboxId = mailboxId;
+        d.uid = h.uid;
+        d.subject = h.subject;
+        d.addresses = h.from + QLatin1Char(' ') + h.to;
+        documents.append(d);
+    }
+    addDocuments(documents);
+}
+
+void SearchIndex::addBody(int mailboxId, quint32 uid, const QString &text)
+{
+    if (!m_valid) {
+        return;
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare("SELECT subject, sender, recipient FROM messages WHERE mailbox_id = ? AND uid = ?");
+    query.addBindValue(mailboxId);
+    query.addBindValue(uid);
+    if (!query.exec() || !query.next()) {
+        return;
+    }
+    SearchDocument d;
+    d.mailboxId = mailboxId;
+    d.uid = uid;
+    d.subject = query.value(0).toString();
+    d.addresses = query.value(1).toString() + QLatin1Char(' ') + query.value(2).toString();
+    d.body = text;
+    addDocuments({d});
+}
+
+void SearchIndex::addAttachments(int mailboxId, quint32 uid, const QString &text)
+{
+    if (!m_valid) {
+        return;
+    }
+    SearchDocument d;
+    d.mailboxId = mailboxId;
+    d.uid = uid;
+    d.body = text;
+    m_pendingAttachments.append(d);
+    if (m_pendingAttachments.size() >= BatchSize) {
+        flush();
+    } else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void SearchIndex::removeMessages(int mailboxId, const QVector<UidRange> &ranges)
+{
+    if (m_valid && !ranges.isEmpty()) {
+        submit(QVector<SearchDocument>(), QVector<SearchDocument>(), ranges, mailboxId);
+    }
+}
+
+void SearchIndex::removeMailbox(int mailboxId)
+{
+    if (m_valid) {
+        submit(QVector<SearchDocument>(), QVector<SearchDocument>(), QVector<UidRange>(), mailboxId);
+    }
+}
+
+void SearchIndex::flush()
+{
+    m_flushTimer.stop();
+    while (!m_pending.isEmpty()) {
+        const qsizetype count = qMin<qsizetype>(m_pending.size(), BatchSize);
+        submit(m_pending.mid(0, count), QVector<SearchDocument>(), QVector<UidRange>(), -1);
+        m_pending.remove(0, count);
+    }
+    // Anhangtexte sind groß, kleinere Stapel
+    while (!m_pendingAttachments.isEmpty()) {
+        const qsizetype count = qMin<qsizetype>(m_pendingAttachments.size(), BatchSize / 10);
+        submit(QVector<SearchDocument>(), m_pendingAttachments.mid(0, count), QVector<UidRange>(), -1);
+        m_pendingAttachments.remove(0, count);
+    }
+}
+
+void SearchIndex::submit(QVector<SearchDocument> documents, QVector<SearchDocument> attachments,
+                         QVector<UidRange> removals, int removalMailbox)
+{
+    // Ausstehende Dokumente vor einer Löschung einreihen
+    if (removalMailbox >= 0 && (!m_pending.isEmpty() || !m_pendingAttachments.isEmpty())) {
+        flush();
+    }
+    QMutexLocker locker(&m_order.mutex);
+    SearchIndexTask *task = new SearchIndexTask(this, m_order.issued++);
+    locker.unlock();
+    task->documents = std::move(documents);
+    task->attachments = std::move(attachments);
+    task->removals = std::move(removals);
+    task->setRemovalMailbox(removalMailbox);
+    m_pool.start(task);
+}
+
+void SearchIndex::waitForDone()
+{
+    flush();
+    m_pool.waitForDone();
+}
+
+QVector<SearchHit> SearchIndex::search(const QString &query, int limit, int mailboxId) const
+{
+    QVector<SearchHit> hits;
+    const QString match = toMatchExpression(query);
+    if (!m_valid || match.isEmpty()) {
+        return hits;
+    }
+
+    QSqlQuery q(QSqlDatabase::database(m_connectionName, false));
+    q.setForwardOnly(true);
+    // Absteigende rowid liest die Trefferlisten rückwärts und bricht beim Limit ab;
+    // UNION entfernt Nachrichten, die in Text und Anhang treffen
+    if (mailboxId >= 0) {
+        q.prepare("SELECT rowid FROM message_index WHERE message_index MATCH ? AND rowid BETWEEN ? AND ?"
+                  " UNION SELECT rowid FROM attachment_index WHERE attachment_index MATCH ? AND rowid BETWEEN ? AND ?"
+                  " ORDER BY rowid DESC LIMIT ?");
+        for (int i = 0; i < 2; ++i) {
+            q.addBindValue(match);
+            q.addBindValue(rowId(mailboxId, 0));
+            q.addBindValue(rowId(mailboxId, 0xffffffffu));
+        }
+    } else {
+        q.prepare("SELECT rowid FROM message_index WHERE message_index MATCH ?"
+                  " UNION SELECT rowid FROM attachment_index WHERE attachment_index MATCH ?"
+                  " ORDER BY rowid DESC LIMIT ?");
+        q.addBindValue(match);
+        q.addBindValue(match);
+    }
+    q.addBindValue(limit);
+    if (!q.exec()) {
+        qWarning() << "SearchIndex:" << q.lastError().text();
+        return hits;
+    }
+    while (q.next()) {
+        const qint64 rowid = q.value(0).toLongLong();
+        hits.append({int(rowid >> 32), quint32(rowid & 0xffffffff)});
+    }
+    return hits;
+}
+
+QString SearchIndex::toMatchExpression(const QString &query)
+{
+    // "von:max rechnung betreff:mär" -> addresses : "max" AND "rechnung" AND subject : "mar"*
+    QStringList parts;
+    const QStringList words = query.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    for (const QString &word : words) {
+        QString column;
+        QString text = word;
+        const int colon = word.indexOf(QLatin1Char(':'));
+        if (colon > 0) {
+            const QString prefix = word.left(colon).toLower();
+            if (prefix == "von" || prefix == "from" || prefix == "an" || prefix == "to") {
+                column = "addresses";
+            } else if (prefix == "betreff" || prefix == "subject") {
+                column = "subject";
+            }
+            if (!column.isEmpty()) {
+                text = word.mid(colon + 1);
+            }
+        }
+        for (const QString &term : TextNormalizer::terms(text)) {
+            const QString phrase = QLatin1Char('"') + term + QLatin1Char('"');
+            parts.append(column.isEmpty() ? phrase : column + " : " + phrase);
+        }
+    }
+    if (parts.isEmpty()) {
+        return QString();
+    }
+    // Letzter Begriff als Präfix, damit schon während des Tippens Treffer kommen
+    parts.last() += QLatin1Char('*');
+    return parts.join(" AND ");
+}
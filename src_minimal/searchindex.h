@@ -0,0 +1,113 @@
+/*
+ * mailadler - Full-Text Search Index
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "imapconnection.h"
+
+class QSqlQuery;
+class StoreCipher;
+
+struct SearchDocument {
+    int mailboxId = -1;
+    quint32 uid = 0;
+    QString subject;
+    QString addresses;
+    QString body; // dekodierter Text, falls bereits geladen
+};
+
+struct SearchHit {
+    int mailboxId;
+    quint32 uid;
+};
+
+// Volltextindex (SQLite FTS5) über Betreff, Adressen und Text.
+//
+// Dokumente werden gesammelt und in Stapeln im Hintergrund-Threadpool
+// normalisiert (TextNormalizer); geschrieben wird in Auftragsreihenfolge,
+// jeweils ein Stapel pro Transaktion. Die rowid setzt sich aus Postfach und
+// UID zusammen, so dass eine Suche pro Ordner ein rowid-Bereich ist und die
+// neuesten Treffer ohne Sortierung aller Treffer zuerst kommen.
+//
+// Text aus Anhängen (AttachmentIndexer) steht in einer zweiten Tabelle mit
+// gleichem Aufbau und gleicher rowid, so dass er den Nachrichtentext nicht
+// überschreibt; die Suche vereinigt beide.
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Gleiche Datei wie der MessageStore (WAL erlaubt paralleles Lesen)
+    explicit SearchIndex(const QString &path, QObject *parent = nullptr);
+    ~SearchIndex() override;
+
+    // Vor open(), wie MessageStore::setCipher(); gilt auch für die Pool-Threads
+    void setCipher(const StoreCipher *cipher) { m_cipher = cipher; }
+    bool open();
+    bool isValid() const { return m_valid; }
+
+    void addDocuments(const QVector<SearchDocument> &documents);
+    // mailboxId < 0: alle Ordner; neueste UID zuerst
+    QVector<SearchHit> search(const QString &query, int limit = 200, int mailboxId = -1) const;
+
+    // Wartet, bis alle übergebenen Dokumente geschrieben sind
+    void waitForDone();
+
+    static qint64 rowId(int mailboxId, quint32 uid) { return (qint64(mailboxId) << 32) | uid; }
+    static QString toMatchExpression(const QString &query);
+
+public slots:
+    void addMessages(int mailboxId, const QList<EmailHeader> &headers);
+    // Text nachträglich ergänzen; Betreff und Adressen kommen aus dem MessageStore
+    void addBody(int mailboxId, quint32 uid, const QString &text);
+    // Dateinamen und Text aller Anhänge einer Nachricht, ersetzt den bisherigen
+    void addAttachments(int mailboxId, quint32 uid, const QString &text);
+    void removeMessages(int mailboxId, const QVector<UidRange> &ranges);
+    void removeMailbox(int mailboxId);
+
+signals:
+    void indexed(int count);
+
+private:
+    friend class SearchIndexTask;
+
+    // Schreibreihenfolge zwischen den Pool-Threads
+    struct WriteOrder {
+        QMutex mutex;
+        QWaitCondition turn;
+        quint64 issued = 0;
+        quint64 next = 0;
+    };
+
+    void flush();
+    void submit(QVector<SearchDocument> documents, QVector<SearchDocument> attachments,
+                QVector<UidRange> removals, int removalMailbox);
+    bool createTable(QSqlQuery &query, const char *name);
+
+    static const int BatchSize = 2000;
+
+    QString m_path;
+    QString m_connectionName;
+    const StoreCipher *m_cipher;
+    bool m_valid;
+    bool m_contentless;
+
+    QVector<SearchDocument> m_pending;
+    QVector<SearchDocument> m_pendingAttachments;
+    QTimer m_flushTimer;
+    QThreadPool m_pool;
+    WriteOrder m_order;
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,558 @@
+/*
+ * mailadler - SMTP Submission Client
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "smtpclient.h"
+#include <QDebug>
+#include <QHostAddress>
+
+#include <cstring>
+
+namespace {
+
+// RFC 5321 empfiehlt bis zu 10 Minuten für das Ende von DATA
+const int ReplyTimeout = 5 * 60 * 1000;
+
+} // namespace
+
+SmtpClient::SmtpClient(QObject *parent)
+    : QObject(parent)
+    , m_socket(new QSslSocket(this))
+    , m_port(587)
+    , m_security(StartTls)
+    , m_chunkingAllowed(true)
+    , m_state(Disconnected)
+    , m_bodySent(0)
+    , m_accepted(0)
+    , m_rejectedTemporary(false)
+    , m_jobFailed(false)
+    , m_failPermanent(false)
+    , m_chunking(false)
+    , m_bodyActive(false)
+    , m_lastChunk(false)
+    , m_chunkLeft(0)
+    , m_atLineStart(true)
+{
+    m_timeout.setSingleShot(true);
+    m_timeout.setInterval(ReplyTimeout);
+    connect(&m_timeout, &QTimer::timeout, this, [this]() {
+        qWarning() << "SMTP: Zeitüberschreitung";
+        dropConnection(tr("Der SMTP-Server antwortet nicht"));
+    });
+
+    connect(m_socket, &QSslSocket::connected, this, &SmtpClient::onConnected);
+    connect(m_socket, &QSslSocket::encrypted, this, &SmtpClient::onEncrypted);
+    connect(m_socket, &QSslSocket::readyRead, this, &SmtpClient::onReadyRead);
+    connect(m_socket, &QSslSocket::bytesWritten, this, &SmtpClient::onBytesWritten);
+    connect(m_socket, &QSslSocket::disconnected, this, &SmtpClient::onDisconnected);
+    connect(m_socket, &QSslSocket::errorOccurred, this, &SmtpClient::onError);
+    connect(m_socket, &QSslSocket::sslErrors, this, &SmtpClient::onSslErrors);
+}
+
+void SmtpClient::setServer(const QString &host, int port, Security security)
+{
+    m_host = host;
+    m_port = port;
+    m_security = security;
+}
+
+void SmtpClient::setCredentials(const QString &user, const QString &password)
+{
+    m_user = user;
+    m_password = password;
+}
+
+void SmtpClient::send(const SmtpJob &job)
+{
+    m_jobs.enqueue(job);
+    if (m_state == Disconnected) {
+        connectToServer();
+    } else if (m_state == Ready) {
+        startJob();
+    }
+}
+
+bool SmtpClient::hasExtension(const QByteArray &name) const
+{
+    // "SIZE 35882577", "AUTH PLAIN LOGIN"
+    for (const QByteArray &e : m_extensions) {
+        if (e.size() >= name.size() && qstrnicmp(e.constData(), name.constData(), name.size()) == 0
+            && (e.size() == name.size() || e.at(name.size()) == ' ')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SmtpClient::quit()
+{
+    if (m_state != Ready || isBusy()) {
+        return;
+    }
+    m_state = Quitting;
+    command("QUIT", [this](const Reply &) {
+        m_socket->disconnectFromHost();
+    });
+}
+
+void SmtpClient::connectToServer()
+{
+    qDebug() << "SMTP: Verbinde mit" << m_host << m_port;
+    m_state = Connecting;
+    m_extensions.clear();
+    m_reply = Reply();
+    if (m_security == Tls) {
+        m_socket->connectToHostEncrypted(m_host, quint16(m_port));
+    } else {
+        m_socket->connectToHost(m_host, quint16(m_port));
+    }
+    m_timeout.start();
+}
+
+void SmtpClient::command(const QByteArray &line, Handler handler, bool sensitive)
+{
+    m_unsent.enqueue({line, std::move(handler), sensitive});
+    flushCommands();
+}
+
+void SmtpClient::flushCommands()
+{
+    // Ohne PIPELINING (und vor dem EHLO) strikt abwechselnd
+    const bool pipelining = hasExtension("PIPELINING");
+    while (!m_unsent.isEmpty() && (pipelining || m_pending.isEmpty())) {
+        Command c = m_unsent.dequeue();
+        qDebug() << "SMTP >" << (c.sensitive ? QByteArray("<Zugangsdaten>") : c.line);
+        m_pending.enqueue(std::move(c.handler));
+        m_socket->write(c.line + "\r\n");
+        m_timeout.start();
+    }
+}
+
+void SmtpClient::ehlo()
+{
+    QHostAddress local = m_socket->localAddress();
+    const QByteArray name = local.protocol() == QAbstractSocket::IPv6Protocol
+        ? "[IPv6:" + local.toString().toLatin1() + ']'
+        : '[' + local.toString().toLatin1() + ']';
+    command("EHLO " + name, [this](const Reply &r) {
+        if (r.code != 250) {
+            closeWith(tr("EHLO abgelehnt: %1").arg(QString::fromUtf8(r.text())));
+            return;
+        }
+        // Erste Zeile ist die Begrüßung, dann je eine Erweiterung
+        m_extensions = r.lines.mid(1);
+        for (QByteArray &e : m_extensions) {
+            e = e.trimmed();
+        }
+        if (m_security == StartTls && !m_socket->isEncrypted()) {
+            if (!hasExtension("STARTTLS")) {
+                closeWith(tr("Der SMTP-Server bietet kein STARTTLS an"), true);
+                return;
+            }
+            command("STARTTLS", [this](const Reply &r) {
+                if (r.code != 220) {
+                    closeWith(tr("STARTTLS fehlgeschlagen: %1").arg(QString::fromUtf8(r.text())));
+                    return;
+                }
+                // Alles vor der Verschlüsselung ist ungültig (RFC 3207)
+                m_extensions.clear();
+                m_socket->startClientEncryption();
+            });
+            return;
+        }
+        authenticate();
+    });
+}
+
+void SmtpClient::authenticate()
+{
+    auto done = [this](const Reply &r) {
+        if (r.code != 235) {
+            closeWith(tr("SMTP-Anmeldung fehlgeschlagen: %1").arg(QString::fromUtf8(r.text())), r.code >= 500);
+            return;
+        }
+        m_state = Ready;
+        startJob();
+    };
+
+    QByteArray mechanisms;
+    for (const QByteArray &e : std::as_const(m_extensions)) {
+        if (e.startsWith("AUTH ") || e.startsWith("auth ")) {
+            mechanisms = ' ' + e.mid(5).toUpper() + ' ';
+        }
+    }
+    if (m_user.isEmpty() || mechanisms.isEmpty()) {
+        m_state = Ready;
+        startJob();
+        return;
+    }
+    if (mechanisms.contains(" PLAIN ")) {
+        const QByteArray token = '\0' + m_user.toUtf8() + '\0' + m_password.toUtf8();
+        command("AUTH PLAIN " + token.toBase64(), done, true);
+        return;
+    }
+    command("AUTH LOGIN", [this, done](const Reply &r) {
+        if (r.code != 334) {
+            done(r);
+            return;
+        }
+        command(m_user.toUtf8().toBase64(), [this, done](const Reply &r) {
+            if (r.code != 334) {
+                done(r);
+                return;
+            }
+            command(m_password.toUtf8().toBase64(), done, true);
+        }, true);
+    });
+}
+
+void SmtpClient::startJob()
+{
+    if (m_state != Ready || m_current.id || m_jobs.isEmpty()) {
+        return;
+    }
+    m_current = m_jobs.dequeue();
+    m_bodySent = 0;
+    m_accepted = 0;
+    m_rejected.clear();
+    m_rejectedTemporary = false;
+    m_jobFailed = false;
+    m_failMessage.clear();
+    m_failPermanent = false;
+    m_bodyActive = false;
+    m_lastChunk = false;
+    m_chunkLeft = 0;
+    m_atLineStart = true;
+    m_chunking = m_chunkingAllowed && hasExtension("CHUNKING");
+
+    m_body.setFileName(m_current.path);
+    if (!m_body.open(QIODevice::ReadOnly)) {
+        fail(tr("Nachricht %1 nicht lesbar").arg(m_current.path), true);
+        finishJob();
+        return;
+    }
+    m_state = Sending;
+    sendEnvelope();
+}
+
+void SmtpClient::sendEnvelope()
+{
+    QByteArray mail = "MAIL FROM:<" + m_current.sender + '>';
+    if (hasExtension("SIZE")) {
+        mail += " SIZE=" + QByteArray::number(m_body.size());
+    }
+    if (m_current.eightBit) {
+        if (hasExtension("8BITMIME")) {
+            mail += " BODY=8BITMIME";
+        } else {
+            qWarning() << "SMTP: Server ohne 8BITMIME, sende 8-Bit-Text trotzdem";
+        }
+    }
+    command(mail, [this](const Reply &r) {
+        if (r.code != 250) {
+            fail(tr("Absender abgelehnt: %1").arg(QString::fromUtf8(r.text())), r.code >= 500);
+        }
+    });
+
+    for (int i = 0; i < m_current.recipients.size(); ++i) {
+        const QByteArray recipient = m_current.recipients.at(i);
+        const bool last = i == m_current.recipients.size() - 1;
+        command("RCPT TO:<" + recipient + '>', [this, recipient, last](const Reply &r) {
+            if (r.code == 250 || r.code == 251) {
+                ++m_accepted;
+            } else {
+                m_rejected += QString::fromUtf8(recipient) + QLatin1String(": ") + QString::fromUtf8(r.text()) + QLatin1Char('\n');
+                m_rejectedTemporary = m_rejectedTemporary || r.code < 500;
+            }
+            if (!last || !m_chunking) {
+                return;
+            }
+            // BDAT erst nach den Antworten auf den Umschlag, bei einer
+            // Ablehnung gingen sonst Megabytes umsonst hinaus
+            if (!m_accepted) {
+                fail(tr("Alle Empfänger abgelehnt:\n%1").arg(m_rejected), !m_rejectedTemporary);
+            }
+            if (m_jobFailed) {
+                maybeConclude();
+                return;
+            }
+            m_bodyActive = true;
+            pumpBody();
+        });
+    }
+
+    if (!m_chunking) {
+        command("DATA", [this](const Reply &r) {
+            if (r.code == 354) {
+                m_bodyActive = true;
+                pumpBody();
+                return;
+            }
+            if (!m_accepted && !m_rejected.isEmpty()) {
+                fail(tr("Alle Empfänger abgelehnt:\n%1").arg(m_rejected), !m_rejectedTemporary);
+            } else {
+                fail(tr("DATA abgelehnt: %1").arg(QString::fromUtf8(r.text())), r.code >= 500);
+            }
+            maybeConclude();
+        });
+    }
+}
+
+void SmtpClient::pumpBody()
+{
+    auto finalReply = [this](const Reply &r) {
+        if (r.code != 250) {
+            fail(tr("Nachricht abgelehnt: %1").arg(QString::fromUtf8(r.text())), r.code >= 500);
+        }
+        if (m_chunking && !hasExtension("PIPELINING")) {
+            pumpBody();
+        }
+        maybeConclude();
+    };
+
+    while (m_bodyActive && m_socket->bytesToWrite() < MaxBuffered) {
+        QByteArray block;
+        if (m_chunking) {
+            if (m_chunkLeft == 0) {
+                if (m_lastChunk || m_jobFailed) {
+                    m_bodyActive = false;
+                    maybeConclude();
+                    return;
+                }
+                // Ohne PIPELINING erst die Antwort auf das vorige Stück
+                if (!hasExtension("PIPELINING") && !m_pending.isEmpty()) {
+                    return;
+                }
+                const qint64 left = m_body.size() - m_body.pos();
+                m_chunkLeft = qMin(ChunkSize, left);
+                m_lastChunk = m_chunkLeft == left;
+                m_pending.enqueue(finalReply);
+                m_socket->write("BDAT " + QByteArray::number(m_chunkLeft) + (m_lastChunk ? " LAST\r\n" : "\r\n"));
+                m_timeout.start();
+                continue;
+            }
+            block = m_body.read(qMin(BlockSize, m_chunkLeft));
+            if (block.isEmpty()) {
+                // Mitten in einem angekündigten Stück: nicht mehr zu retten
+                dropConnection(tr("Nachricht %1 nicht lesbar").arg(m_current.path));
+                return;
+            }
+            m_chunkLeft -= block.size();
+            m_socket->write(block);
+        } else {
+            if (m_body.atEnd()) {
+                m_bodyActive = false;
+                m_pending.enqueue(finalReply);
+                m_socket->write(m_atLineStart ? ".\r\n" : "\r\n.\r\n");
+                m_timeout.start();
+                return;
+            }
+            block = m_body.read(BlockSize);
+            if (block.isEmpty()) {
+                dropConnection(tr("Nachricht %1 nicht lesbar").arg(m_current.path));
+                return;
+            }
+            writeStuffed(block);
+        }
+        m_bodySent += block.size();
+        emit progress(m_current.id, m_bodySent, m_body.size());
+    }
+}
+
+void SmtpClient::writeStuffed(const QByteArray &block)
+{
+    // Punkt am Zeilenanfang verdoppeln (RFC 5321, 4.5.2)
+    QByteArray out;
+    out.reserve(block.size() + 64);
+    const char *p = block.constData();
+    const char *end = p + block.size();
+    while (p < end) {
+        if (m_atLineStart && *p == '.') {
+            out += '.';
+        }
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        const char *stop = newline ? newline + 1 : end;
+        out.append(p, stop - p);
+        m_atLineStart = newline != nullptr;
+        p = stop;
+    }
+    m_socket->write(out);
+}
+
+void SmtpClient::fail(const QString &message, bool permanent)
+{
+    if (m_jobFailed) {
+        return;
+    }
+    m_jobFailed = true;
+    m_failMessage = message;
+    m_failPermanent = permanent;
+}
+
+void SmtpClient::maybeConclude()
+{
+    if (m_current.id && !m_bodyActive && m_pending.isEmpty()) {
+        finishJob();
+    }
+}
+
+void SmtpClient::finishJob()
+{
+    const SmtpJob job = m_current;
+    m_current = SmtpJob();
+    m_body.close();
+    m_state = Ready;
+    if (m_jobFailed) {
+        command("RSET", nullptr);
+        emit failed(job.id, m_failMessage, m_failPermanent);
+    } else {
+        if (!m_rejected.isEmpty()) {
+            qWarning() << "SMTP: Empfänger abgelehnt:" << m_rejected;
+        }
+        emit sent(job.id);
+    }
+    startJob();
+}
+
+void SmtpClient::abortJobs(const QString &message, bool permanent)
+{
+    qWarning() << "SMTP:" << message;
+    QQueue<SmtpJob> jobs;
+    jobs.swap(m_jobs);
+    if (m_current.id) {
+        jobs.prepend(m_current);
+        m_current = SmtpJob();
+        m_body.close();
+    }
+    m_bodyActive = false;
+    for (const SmtpJob &job : std::as_const(jobs)) {
+        emit failed(job.id, message, permanent);
+    }
+}
+
+void SmtpClient::closeWith(const QString &message, bool permanent)
+{
+    // Quitting vor dem Melden: neue Aufträge aus failed() warten auf die
+    // nächste Sitzung statt in die alte zu laufen
+    m_state = Quitting;
+    abortJobs(message, permanent);
+    m_socket->disconnectFromHost();
+}
+
+void SmtpClient::dropConnection(const QString &message)
+{
+    m_state = Quitting;
+    abortJobs(message);
+    m_socket->abort();
+    // Ohne bestehende Verbindung kommt kein disconnected()
+    if (m_state == Quitting) {
+        onDisconnected();
+    }
+}
+
+void SmtpClient::onConnected()
+{
+    qDebug() << "SMTP: Verbunden";
+    m_state = Greeting;
+    // Die Begrüßung "220" beantwortet keinen Befehl
+    m_pending.enqueue([this](const Reply &r) {
+        if (r.code != 220) {
+            closeWith(tr("SMTP-Server lehnt ab: %1").arg(QString::fromUtf8(r.text())));
+            return;
+        }
+        ehlo();
+    });
+}
+
+void SmtpClient::onEncrypted()
+{
+    // Nach STARTTLS neu begrüßen; bei Tls kommt erst jetzt die Begrüßung
+    if (m_security == StartTls) {
+        ehlo();
+    }
+}
+
+void SmtpClient::onReadyRead()
+{
+    m_timeout.stop();
+    while (m_socket->canReadLine()) {
+        QByteArray line = m_socket->readLine();
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        qDebug() << "SMTP <" << line.left(100);
+        // "250-PIPELINING" fortgesetzt, "250 OK" letzte Zeile
+        m_reply.code = line.left(3).toInt();
+        m_reply.lines.append(line.mid(4));
+        if (line.size() > 3 && line.at(3) == '-') {
+            continue;
+        }
+        const Reply reply = m_reply;
+        m_reply = Reply();
+        if (m_pending.isEmpty()) {
+            // Unaufgefordert, z.B. "421 Timeout" vor dem Trennen
+            qWarning() << "SMTP: Unerwartete Antwort" << line;
+            continue;
+        }
+        const Handler handler = m_pending.dequeue();
+        if (handler) {
+            handler(reply);
+        }
+        flushCommands();
+    }
+    if (!m_pending.isEmpty()) {
+        m_timeout.start();
+    }
+}
+
+void SmtpClient::onBytesWritten()
+{
+    if (!m_pending.isEmpty()) {
+        m_timeout.start();
+    }
+    if (m_bodyActive) {
+        pumpBody();
+    }
+}
+
+void SmtpClient::onDisconnected()
+{
+    qDebug() << "SMTP: Getrennt";
+    m_timeout.stop();
+    const bool expected = m_state == Quitting;
+    m_state = Disconnected;
+    m_pending.clear();
+    m_unsent.clear();
+    m_extensions.clear();
+    if (!expected) {
+        abortJobs(tr("Verbindung zum SMTP-Server getrennt"));
+    }
+    emit disconnected();
+    // Während des Abmeldens eingetroffene Aufträge
+    if (m_state == Disconnected && !m_jobs.isEmpty()) {
+        connectToServer();
+    }
+}
+
+void SmtpClient::onError(QAbstractSocket::SocketError error)
+{
+    Q_UNUSED(error)
+    qWarning() << "SMTP:" << m_socket->errorString();
+    // Ohne bestehende Verbindung kommt kein disconnected()
+    if (m_socket->state() == QAbstractSocket::UnconnectedState && m_state == Connecting) {
+        m_timeout.stop();
+        m_state = Disconnected;
+        abortJobs(tr("SMTP-Verbindung fehlgeschlagen: %1").arg(m_socket->errorString()));
+        emit disconnected();
+    }
+}
+
+void SmtpClient::onSslErrors(const QList<QSslError> &errors)
+{
+    // Anders als bei IMAP nicht ignorieren: hier gehen Zugangsdaten und Inhalte hinaus
+    for (const QSslError &e : errors) {
+        qWarning() << "SMTP SSL:" << e.errorString();
+    }
+}
@@ -0,0 +1,145 @@
+/*
+ * mailadler - SMTP Submission Client
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef SMTPCLIENT_H
+#define SMTPCLIENT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QSslSocket>
+#include <QTimer>
+
+#include <functional>
+
+// Ein Versandauftrag; die Nachricht liegt fertig kodiert (CRLF) in path
+struct SmtpJob {
+    qint64 id = 0;
+    QByteArray sender;
+    QList<QByteArray> recipients;
+    QString path;
+    bool eightBit = false; // enthält 8-Bit-Text, BODY=8BITMIME
+};
+
+// Einlieferung per SMTP (RFC 6409) mit den Erweiterungen PIPELINING,
+// CHUNKING (BDAT) und 8BITMIME.
+//
+// Der Umschlag (MAIL, alle RCPT, ggf. DATA) geht mit PIPELINING in einem
+// Paket hinaus. Der Inhalt wird blockweise aus der Datei gelesen und erst
+// nachgeschoben, wenn der Socket-Puffer unter MaxBuffered fällt, ein großer
+// Anhang liegt also nie ganz im Speicher. Aufträge laufen nacheinander über
+// dieselbe Sitzung.
+class SmtpClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Security { Plain, StartTls, Tls };
+
+    static constexpr qint64 BlockSize = 64 * 1024;
+    static constexpr qint64 MaxBuffered = 256 * 1024;
+    static constexpr qint64 ChunkSize = 1024 * 1024; // je BDAT
+
+    explicit SmtpClient(QObject *parent = nullptr);
+
+    // Plain nur für lokale Testserver
+    void setServer(const QString &host, int port, Security security);
+    void setCredentials(const QString &user, const QString &password);
+    void setChunkingAllowed(bool allowed) { m_chunkingAllowed = allowed; }
+
+    void send(const SmtpJob &job);
+    bool isBusy() const { return m_current.id || !m_jobs.isEmpty(); }
+    bool isConnected() const { return m_state != Disconnected; }
+    bool isConfigured() const { return !m_host.isEmpty(); }
+    bool hasExtension(const QByteArray &name) const;
+    void quit();
+
+signals:
+    void sent(qint64 id);
+    // permanent: 5xx des Servers, ein neuer Versuch ist zwecklos
+    void failed(qint64 id, const QString &message, bool permanent);
+    void progress(qint64 id, qint64 bytes, qint64 total);
+    void disconnected();
+
+private slots:
+    void onConnected();
+    void onEncrypted();
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError error);
+    void onSslErrors(const QList<QSslError> &errors);
+
+private:
+    enum State { Disconnected, Connecting, Greeting, Ready, Sending, Quitting };
+
+    struct Reply {
+        int code = 0;
+        QList<QByteArray> lines;
+        QByteArray text() const { return lines.join(' '); }
+    };
+
+    using Handler = std::function<void(const Reply &)>;
+
+    struct Command {
+        QByteArray line;
+        Handler handler;
+        bool sensitive = false;
+    };
+
+    void connectToServer();
+    void command(const QByteArray &line, Handler handler, bool sensitive = false);
+    void flushCommands();
+    void ehlo();
+    void authenticate();
+    void startJob();
+    void sendEnvelope();
+    void pumpBody();
+    void writeStuffed(const QByteArray &block);
+    // Fehler merken; gemeldet wird, wenn alle Antworten des Auftrags da sind
+    void fail(const QString &message, bool permanent);
+    void maybeConclude();
+    void finishJob();
+    void abortJobs(const QString &message, bool permanent = false);
+    void closeWith(const QString &message, bool permanent = false);
+    void dropConnection(const QString &message);
+
+    QSslSocket *m_socket;
+    QString m_host;
+    int m_port;
+    Security m_security;
+    QString m_user;
+    QString m_password;
+    bool m_chunkingAllowed;
+    State m_state;
+    QTimer m_timeout;
+    QList<QByteArray> m_extensions;
+    Reply m_reply;
+
+    // Gesendet und noch ohne Antwort bzw. ohne PIPELINING noch zurückgehalten
+    QQueue<Handler> m_pending;
+    QQueue<Command> m_unsent;
+
+    QQueue<SmtpJob> m_jobs;
+    SmtpJob m_current;
+    QFile m_body;
+    qint64 m_bodySent;
+    int m_accepted;
+    QString m_rejected;
+    bool m_rejectedTemporary;
+    bool m_jobFailed;
+    QString m_failMessage;
+    bool m_failPermanent;
+    bool m_chunking;
+    bool m_bodyActive;
+    bool m_lastChunk;
+    qint64 m_chunkLeft; // Rest des laufenden BDAT-Stücks
+    bool m_atLineStart; // für das Punkt-Verdoppeln bei DATA
+};
+
+#endif // SMTPCLIENT_H
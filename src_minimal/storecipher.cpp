@@ -0,0 +1,272 @@
+/*
+ * mailadler - Local Store Encryption
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "storecipher.h"
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QSqlQuery>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const char KeyFileMagic[4] = {'M', 'A', 'K', 'Y'};
+const quint32 KeyFileVersion = 1;
+const char CheckLabel[] = "mailadler-pruefwert";
+
+// Bezeichnungen der Teilschlüssel, Reihenfolge wie StoreCipher::Purpose
+const char *const Labels[StoreCipher::PurposeCount] = {
+    "mailadler-datenbank",
+    "mailadler-inhalte",
+    "mailadler-namen",
+    "mailadler-kopfzeilen",
+};
+
+struct KeyFile {
+    char magic[4];
+    quint32 version;
+    quint32 iterations;
+    uchar salt[StoreCipher::SaltSize];
+    uchar check[32];
+};
+
+std::atomic<quint64> nextSession(1);
+
+// Je Thread, Zweck und Richtung ein Kontext mit fertig eingerichtetem
+// Schlüssel, je Aufruf kommt nur das Nonce dazu. EVP_CIPHER_CTX ist nicht
+// threadsicher, und bei kurzen Zeichenketten kostet das Einrichten mehr als
+// das Verschlüsseln
+struct Contexts {
+    quint64 session = 0;
+    EVP_CIPHER_CTX *ctx[StoreCipher::PurposeCount][2] = {};
+
+    void clear()
+    {
+        for (auto &pair : ctx) {
+            for (EVP_CIPHER_CTX *&c : pair) {
+                EVP_CIPHER_CTX_free(c);
+                c = nullptr;
+            }
+        }
+    }
+    ~Contexts() { clear(); }
+};
+
+EVP_CIPHER_CTX *context(quint64 session, const uchar *key, int purpose, bool encrypt)
+{
+    thread_local Contexts contexts;
+    if (contexts.session != session) {
+        contexts.clear();
+        contexts.session = session;
+    }
+    EVP_CIPHER_CTX *&ctx = contexts.ctx[purpose][encrypt ? 1 : 0];
+    if (!ctx) {
+        ctx = EVP_CIPHER_CTX_new();
+        if (ctx && EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, nullptr, encrypt ? 1 : 0) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            ctx = nullptr;
+        }
+    }
+    return ctx;
+}
+
+bool hmac(const uchar *key, const void *data, size_t size, uchar *out)
+{
+    unsigned int length = 0;
+    return HMAC(EVP_sha256(), key, StoreCipher::KeySize, static_cast<const uchar *>(data), size, out, &length)
+           && length == 32;
+}
+
+// Hauptschlüssel und Prüfwert aus Passwort, Salz und Iterationen
+bool derive(const QString &passphrase, const KeyFile &header, uchar *master, uchar *check)
+{
+    QByteArray password = passphrase.toUtf8();
+    const bool derived = PKCS5_PBKDF2_HMAC(password.constData(), int(password.size()), header.salt,
+                                           StoreCipher::SaltSize, int(header.iterations), EVP_sha256(),
+                                           StoreCipher::KeySize, master) == 1
+                         && hmac(master, CheckLabel, sizeof(CheckLabel) - 1, check);
+    OPENSSL_cleanse(password.data(), size_t(password.size()));
+    if (!derived) {
+        qWarning() << "StoreCipher: Schlüsselableitung fehlgeschlagen";
+        OPENSSL_cleanse(master, StoreCipher::KeySize);
+    }
+    return derived;
+}
+
+} // namespace
+
+StoreCipher::StoreCipher()
+    : m_unlocked(false)
+    , m_session(0)
+{
+    std::memset(m_keys, 0, sizeof(m_keys));
+}
+
+StoreCipher::~StoreCipher()
+{
+    OPENSSL_cleanse(m_keys, sizeof(m_keys));
+}
+
+bool StoreCipher::create(const QString &keyFile, const QString &passphrase, quint32 iterations)
+{
+    KeyFile header;
+    std::memcpy(header.magic, KeyFileMagic, sizeof(KeyFileMagic));
+    header.version = KeyFileVersion;
+    header.iterations = qBound<quint32>(1, iterations, quint32(INT_MAX));
+    uchar master[KeySize];
+    if (!randomBytes(header.salt, SaltSize) || !derive(passphrase, header, master, header.check)) {
+        return false;
+    }
+
+    QSaveFile save(keyFile);
+    if (!save.open(QIODevice::WriteOnly)
+        || save.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || !save.commit()) {
+        qWarning() << "StoreCipher: kann" << keyFile << "nicht schreiben";
+        OPENSSL_cleanse(master, sizeof(master));
+        return false;
+    }
+    return setMaster(master);
+}
+
+StoreCipher::UnlockResult StoreCipher::unlock(const QString &keyFile, const QString &passphrase)
+{
+    QFile file(keyFile);
+    if (!file.exists()) {
+        qWarning() << "StoreCipher: Schlüsseldatei" << keyFile << "fehlt";
+        return KeyFileMissing;
+    }
+    KeyFile header;
+    if (!file.open(QIODevice::ReadOnly)
+        || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || std::memcmp(header.magic, KeyFileMagic, sizeof(KeyFileMagic)) != 0 || header.version != KeyFileVersion
+        || header.iterations == 0 || header.iterations > quint32(INT_MAX)) {
+        qWarning() << "StoreCipher: Schlüsseldatei" << keyFile << "ist unlesbar";
+        return KeyFileUnreadable;
+    }
+
+    uchar master[KeySize];
+    uchar check[32];
+    if (!derive(passphrase, header, master, check)) {
+        return UnlockFailed;
+    }
+    if (CRYPTO_memcmp(check, header.check, sizeof(check)) != 0) {
+        OPENSSL_cleanse(master, sizeof(master));
+        return WrongPassphrase;
+    }
+    return setMaster(master) ? Unlocked : UnlockFailed;
+}
+
+bool StoreCipher::setMaster(uchar *master)
+{
+    bool ok = true;
+    for (int i = 0; i < PurposeCount; ++i) {
+        ok = ok && hmac(master, Labels[i], std::strlen(Labels[i]), m_keys[i]);
+    }
+    OPENSSL_cleanse(master, KeySize);
+    m_session = nextSession++;
+    m_unlocked = ok;
+    return ok;
+}
+
+bool StoreCipher::seal(Purpose purpose, const uchar *nonce, QByteArrayView aad, QByteArrayView plain, char *out) const
+{
+    if (!m_unlocked) {
+        return false;
+    }
+    EVP_CIPHER_CTX *ctx = context(m_session, m_keys[purpose], purpose, true);
+    int length = 0;
+    if (!ctx || plain.size() > INT_MAX - TagSize || aad.size() > INT_MAX
+        || EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) != 1
+        || (!aad.isEmpty()
+            && EVP_EncryptUpdate(ctx, nullptr, &length, reinterpret_cast<const uchar *>(aad.data()), int(aad.size()))
+                   != 1)) {
+        return false;
+    }
+    uchar *cipher = reinterpret_cast<uchar *>(out);
+    int written = 0;
+    if (EVP_EncryptUpdate(ctx, cipher, &written, reinterpret_cast<const uchar *>(plain.data()), int(plain.size())) != 1
+        || EVP_EncryptFinal_ex(ctx, cipher + written, &length) != 1) {
+        return false;
+    }
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TagSize, cipher + plain.size()) == 1;
+}
+
+bool StoreCipher::open(Purpose purpose, const uchar *nonce, QByteArrayView aad, QByteArrayView sealed, char *out) const
+{
+    if (!m_unlocked) {
+        return false;
+    }
+    EVP_CIPHER_CTX *ctx = context(m_session, m_keys[purpose], purpose, false);
+    int length = 0;
+    if (!ctx || sealed.size() < TagSize || sealed.size() > INT_MAX || aad.size() > INT_MAX
+        || EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) != 1
+        || (!aad.isEmpty()
+            && EVP_DecryptUpdate(ctx, nullptr, &length, reinterpret_cast<const uchar *>(aad.data()), int(aad.size()))
+                   != 1)) {
+        return false;
+    }
+    const qsizetype size = sealed.size() - TagSize;
+    const uchar *cipher = reinterpret_cast<const uchar *>(sealed.data());
+    uchar *plain = reinterpret_cast<uchar *>(out);
+    int written = 0;
+    uchar tag[TagSize];
+    std::memcpy(tag, cipher + size, TagSize);
+    return EVP_DecryptUpdate(ctx, plain, &written, cipher, int(size)) == 1
+           && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TagSize, tag) == 1
+           && EVP_DecryptFinal_ex(ctx, plain + written, &length) == 1;
+}
+
+QByteArray StoreCipher::mac(Purpose purpose, QByteArrayView data) const
+{
+    QByteArray out(32, Qt::Uninitialized);
+    if (!m_unlocked || !hmac(m_keys[purpose], data.data(), size_t(data.size()), reinterpret_cast<uchar *>(out.data()))) {
+        return QByteArray();
+    }
+    return out;
+}
+
+bool StoreCipher::keyDatabase(QSqlDatabase db) const
+{
+    if (!hasSqlCipher(db)) {
+        qWarning() << "StoreCipher: SQLite ohne SQLCipher, kann" << db.databaseName() << "nicht verschlüsseln";
+        return false;
+    }
+    QSqlQuery query(db);
+    query.exec(QString("PRAGMA key = %1").arg(databaseKeyLiteral()));
+    // Der Schlüssel wird erst beim ersten Lesen geprüft
+    return query.exec("SELECT count(*) FROM sqlite_master") && query.next();
+}
+
+bool StoreCipher::hasSqlCipher(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    return query.exec("PRAGMA cipher_version") && query.next() && !query.value(0).toString().isEmpty();
+}
+
+QString StoreCipher::databaseKeyLiteral() const
+{
+    // Roher Schlüssel: x'<64 Hexziffern>' überspringt SQLCiphers eigenes PBKDF2
+    const QByteArray key(reinterpret_cast<const char *>(m_keys[Database]), KeySize);
+    return QString("\"x'%1'\"").arg(QString::fromLatin1(key.toHex()));
+}
+
+bool StoreCipher::randomBytes(uchar *data, int size)
+{
+    if (RAND_bytes(data, size) != 1) {
+        qWarning() << "StoreCipher: keine Zufallszahlen";
+        return false;
+    }
+    return true;
+}
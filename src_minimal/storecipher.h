@@ -0,0 +1,91 @@
+/*
+ * mailadler - Local Store Encryption
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef STORECIPHER_H
+#define STORECIPHER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QSqlDatabase>
+#include <QString>
+
+// Schlüssel für den verschlüsselten lokalen Speicher (AES-256-GCM).
+//
+// Der Hauptschlüssel entsteht einmal je Sitzung in unlock() bzw. create() per
+// PBKDF2-SHA256 aus Passwort und dem Salz der Schlüsseldatei; danach gibt es
+// keine Ableitung mehr, auch nicht je Datenbankverbindung. Für jeden Zweck
+// gibt es einen eigenen Teilschlüssel (HMAC-SHA256 über eine Bezeichnung),
+// ein Nonce darf also nur innerhalb eines Zwecks nicht doppelt vorkommen.
+//
+// Die Schlüsseldatei enthält nur Salz, Iterationen und einen Prüfwert, mit
+// dem ein falsches Passwort erkannt wird, bevor etwas entschlüsselt wird.
+class StoreCipher
+{
+public:
+    static const int KeySize = 32;
+    static const int NonceSize = 12;
+    static const int TagSize = 16;
+    static const int SaltSize = 16;
+    static const quint32 DefaultIterations = 600000;
+
+    enum Purpose {
+        Database = 0,  // SQLCipher-Schlüssel
+        Bodies = 1,    // BodyCache-Seiten
+        BodyNames = 2, // Dateinamen im BodyCache statt SHA-256
+        Snapshots = 3, // Zeichenketten der HeaderSnapshots
+        PurposeCount
+    };
+
+    enum UnlockResult {
+        Unlocked,
+        WrongPassphrase,
+        KeyFileMissing,
+        KeyFileUnreadable, // beschädigt oder anderes Format
+        UnlockFailed,      // OpenSSL
+    };
+
+    StoreCipher();
+    ~StoreCipher();
+
+    // Neue Schlüsseldatei mit frischem Salz, eine vorhandene wird ersetzt;
+    // danach entsperrt. Nur für einen noch unverschlüsselten Speicher, sonst
+    // ist dessen Inhalt verloren
+    bool create(const QString &keyFile, const QString &passphrase, quint32 iterations = DefaultIterations);
+    // Mit einer vorhandenen Schlüsseldatei; legt nie eine an
+    UnlockResult unlock(const QString &keyFile, const QString &passphrase);
+    bool isUnlocked() const { return m_unlocked; }
+
+    // out braucht plain.size() + TagSize Bytes, Tag am Ende
+    bool seal(Purpose purpose, const uchar *nonce, QByteArrayView aad, QByteArrayView plain, char *out) const;
+    // out braucht sealed.size() - TagSize Bytes; false, wenn der Tag nicht passt
+    bool open(Purpose purpose, const uchar *nonce, QByteArrayView aad, QByteArrayView sealed, char *out) const;
+    // HMAC-SHA256, 32 Bytes
+    QByteArray mac(Purpose purpose, QByteArrayView data) const;
+
+    // PRAGMA key mit dem fertigen Teilschlüssel, SQLCipher leitet nichts mehr
+    // ab. false, wenn die Datei mit dem Schlüssel nicht lesbar ist oder der
+    // SQLite-Treiber kein SQLCipher hat; die Verbindung ist dann nicht zu
+    // benutzen, sonst landete alles unverschlüsselt auf der Platte
+    bool keyDatabase(QSqlDatabase db) const;
+    // Mit SQLCipher gebaut?
+    static bool hasSqlCipher(QSqlDatabase db);
+    // Für ATTACH ... KEY
+    QString databaseKeyLiteral() const;
+
+    static bool randomBytes(uchar *data, int size);
+
+private:
+    Q_DISABLE_COPY(StoreCipher)
+
+    // Teilschlüssel aus dem Hauptschlüssel, der danach gelöscht wird
+    bool setMaster(uchar *master);
+
+    bool m_unlocked;
+    quint64 m_session; // für die Kontexte je Thread, siehe storecipher.cpp
+    uchar m_keys[PurposeCount][KeySize];
+};
+
+#endif // STORECIPHER_H
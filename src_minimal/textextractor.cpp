@@ -0,0 +1,360 @@
+/*
+ * mailadler - Attachment Text Extraction
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "textextractor.h"
+#include "mimedecoder.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QProcess>
+#include <QVector>
+
+#include <cstring>
+#include <initializer_list>
+#include <zlib.h>
+
+namespace {
+
+quint16 le16(const char *p)
+{
+    return quint16(uchar(p[0]) | uchar(p[1]) << 8);
+}
+
+quint32 le32(const char *p)
+{
+    return quint32(le16(p)) | quint32(le16(p + 2)) << 16;
+}
+
+struct ZipEntry {
+    QByteArray name;
+    quint16 method;
+    quint32 compressedSize;
+    quint32 size;
+    quint32 localOffset;
+};
+
+// Zentralverzeichnis am Ende des Archivs; ZIP64 kommt in Office-Dateien
+// dieser Größe nicht vor
+QVector<ZipEntry> zipDirectory(const QByteArray &zip)
+{
+    const char *data = zip.constData();
+    // End of central directory: 22 Bytes plus höchstens 64 KiB Kommentar
+    const qsizetype lowest = qMax<qsizetype>(0, zip.size() - 22 - 0xffff);
+    for (qsizetype pos = zip.size() - 22; pos >= lowest; --pos) {
+        if (le32(data + pos) != 0x06054b50) {
+            continue;
+        }
+        const quint16 count = le16(data + pos + 10);
+        const quint32 size = le32(data + pos + 12);
+        const quint32 offset = le32(data + pos + 16);
+        if (quint64(offset) + size > quint64(zip.size())) {
+            return {};
+        }
+        QVector<ZipEntry> entries;
+        entries.reserve(count);
+        qsizetype p = offset;
+        for (int i = 0; i < count && p + 46 <= zip.size() && le32(data + p) == 0x02014b50; ++i) {
+            ZipEntry entry;
+            entry.method = le16(data + p + 10);
+            entry.compressedSize = le32(data + p + 20);
+            entry.size = le32(data + p + 24);
+            const quint16 nameLength = le16(data + p + 28);
+            const quint16 extraLength = le16(data + p + 30);
+            const quint16 commentLength = le16(data + p + 32);
+            entry.localOffset = le32(data + p + 42);
+            if (p + 46 + nameLength > zip.size()) {
+                break;
+            }
+            entry.name = QByteArray(data + p + 46, nameLength);
+            entries.append(entry);
+            p += 46 + nameLength + extraLength + commentLength;
+        }
+        return entries;
+    }
+    return {};
+}
+
+// Entpackter Inhalt; leer bei Fehlern und oberhalb von MaxInflatedSize
+QByteArray zipData(const QByteArray &zip, const ZipEntry &entry)
+{
+    const char *data = zip.constData();
+    const qsizetype local = entry.localOffset;
+    if (entry.size == 0 || local + 30 > zip.size() || le32(data + local) != 0x04034b50) {
+        return {};
+    }
+    // Name und Zusatzfeld im lokalen Kopf können vom Verzeichnis abweichen
+    const qsizetype start = local + 30 + le16(data + local + 26) + le16(data + local + 28);
+    if (start + qsizetype(entry.compressedSize) > zip.size()) {
+        return {};
+    }
+    if (entry.method == 0) {
+        return QByteArray(data + start, entry.compressedSize);
+    }
+    if (entry.method != 8 || entry.size > TextExtractor::MaxInflatedSize) {
+        return {};
+    }
+
+    QByteArray out(qsizetype(entry.size), Qt::Uninitialized);
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK) {
+        return {};
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + start));
+    stream.avail_in = uInt(entry.compressedSize);
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = uInt(entry.size);
+    const int result = ::inflate(&stream, Z_FINISH);
+    const qsizetype produced = qsizetype(entry.size) - qsizetype(stream.avail_out);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return {};
+    }
+    out.resize(produced);
+    return out;
+}
+
+bool endsWithAny(const QString &name, std::initializer_list<const char *> suffixes)
+{
+    for (const char *suffix : suffixes) {
+        if (name.endsWith(QLatin1String(suffix))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lokaler Name ohne Namensraum-Präfix, klein geschrieben ("w:p" -> "p")
+QByteArray localName(QByteArrayView tag)
+{
+    qsizetype end = 0;
+    while (end < tag.size() && tag[end] != ' ' && tag[end] != '/' && tag[end] != '>' && tag[end] != '\t'
+           && tag[end] != '\r' && tag[end] != '\n') {
+        ++end;
+    }
+    QByteArrayView name = tag.first(end);
+    const qsizetype colon = name.lastIndexOf(':');
+    if (colon >= 0) {
+        name = name.sliced(colon + 1);
+    }
+    return name.toByteArray().toLower();
+}
+
+void appendEntity(QByteArrayView entity, QByteArray *out)
+{
+    if (entity == "amp") {
+        out->append('&');
+    } else if (entity == "lt") {
+        out->append('<');
+    } else if (entity == "gt") {
+        out->append('>');
+    } else if (entity == "quot") {
+        out->append('"');
+    } else if (entity == "apos") {
+        out->append('\'');
+    } else if (entity == "nbsp") {
+        out->append(' ');
+    } else if (entity.startsWith('#')) {
+        bool ok = false;
+        const uint code = entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X')
+                              ? entity.sliced(2).toByteArray().toUInt(&ok, 16)
+                              : entity.sliced(1).toByteArray().toUInt(&ok, 10);
+        if (ok && code > 0 && code <= 0x10ffff) {
+            const char32_t c = code;
+            out->append(QString::fromUcs4(&c, 1).toUtf8());
+        }
+    } else {
+        out->append(' ');
+    }
+}
+
+} // namespace
+
+TextExtractor::Kind TextExtractor::kindOf(const MimePart &part)
+{
+    const QString name = part.filename.toLower();
+    if (part.type == "text") {
+        return part.subtype == "html" ? Html : PlainText;
+    }
+    if (part.subtype == "pdf" || name.endsWith(QLatin1String(".pdf"))) {
+        return Pdf;
+    }
+    if (part.subtype.startsWith("vnd.openxmlformats-officedocument.") || endsWithAny(name, {".docx", ".xlsx", ".pptx"})) {
+        return OfficeOpenXml;
+    }
+    if (part.subtype.startsWith("vnd.oasis.opendocument.") || endsWithAny(name, {".odt", ".ods", ".odp"})) {
+        return OpenDocument;
+    }
+    // application/octet-stream mit sprechendem Namen
+    if (endsWithAny(name, {".txt", ".csv", ".md", ".log"})) {
+        return PlainText;
+    }
+    if (endsWithAny(name, {".html", ".htm"})) {
+        return Html;
+    }
+    return None;
+}
+
+QString TextExtractor::extract(const QByteArray &data, const MimePart &part, const std::atomic<bool> *cancelled)
+{
+    const Kind kind = kindOf(part);
+    if (kind == None) {
+        return QString();
+    }
+    TransferDecoder decoder(TransferDecoder::encodingFor(part.encoding));
+    QByteArray decoded = decoder.decode(data);
+    char tail[16];
+    decoded.append(tail, decoder.finish(tail));
+    if (cancelled && *cancelled) {
+        return QString();
+    }
+
+    QString text;
+    switch (kind) {
+    case PlainText:
+        text = MimeDecoder::decodeText(decoded, part.charset);
+        break;
+    case Html:
+        text = stripMarkup(MimeDecoder::decodeText(decoded, part.charset).toUtf8());
+        break;
+    case Pdf:
+        text = fromPdf(decoded, cancelled);
+        break;
+    case OfficeOpenXml:
+    case OpenDocument:
+        text = fromZip(decoded, kind, cancelled);
+        break;
+    case None:
+        break;
+    }
+    if (text.size() > MaxLength) {
+        text.truncate(MaxLength);
+    }
+    return text;
+}
+
+QString TextExtractor::stripMarkup(QByteArrayView markup)
+{
+    QByteArray out;
+    out.reserve(markup.size() / 2);
+    qsizetype pos = 0;
+    while (pos < markup.size()) {
+        const char c = markup[pos];
+        if (c == '&') {
+            const qsizetype semicolon = markup.indexOf(';', pos);
+            if (semicolon > pos && semicolon - pos <= 10) {
+                appendEntity(markup.sliced(pos + 1, semicolon - pos - 1), &out);
+                pos = semicolon + 1;
+                continue;
+            }
+            out.append(c);
+            ++pos;
+            continue;
+        }
+        if (c != '<') {
+            out.append(c);
+            ++pos;
+            continue;
+        }
+
+        qsizetype end = markup.indexOf('>', pos);
+        if (end < 0) {
+            break;
+        }
+        const bool closing = pos + 1 < markup.size() && markup[pos + 1] == '/';
+        const QByteArray name = localName(markup.sliced(pos + (closing ? 2 : 1), end - pos - (closing ? 2 : 1)));
+        if (!closing && (name == "script" || name == "style")) {
+            // Inhalt ist kein Text
+            const qsizetype close = markup.indexOf(QByteArray("</" + name), end);
+            end = close < 0 ? markup.size() - 1 : markup.indexOf('>', close);
+            if (end < 0) {
+                break;
+            }
+        } else if (name == "p" || name == "h" || name == "br" || name == "tr" || name == "li" || name == "div"
+                   || name == "si" || (name.size() == 2 && name[0] == 'h' && name[1] >= '1' && name[1] <= '6')) {
+            // Absätze (HTML, WordprocessingML, DrawingML, ODF) und Tabellenzeilen
+            if (closing || name == "br") {
+                out.append('\n');
+            }
+        } else if (name == "tab" || name == "tc" || name == "td" || name == "th" || name == "s"
+                   || name == "table-cell" || name == "c") {
+            out.append(' ');
+        }
+        pos = end + 1;
+    }
+    return QString::fromUtf8(out);
+}
+
+QString TextExtractor::fromPdf(const QByteArray &data, const std::atomic<bool> *cancelled)
+{
+    static std::atomic<bool> missing(false);
+    if (missing) {
+        return QString();
+    }
+
+    QProcess process;
+    process.start("pdftotext", {"-q", "-enc", "UTF-8", "-", "-"});
+    if (!process.waitForStarted(5000)) {
+        if (!missing.exchange(true)) {
+            qWarning() << "TextExtractor: pdftotext nicht verfügbar, PDF-Anhänge bleiben ohne Text";
+        }
+        return QString();
+    }
+    process.write(data);
+    process.closeWriteChannel();
+
+    // Mehr als MaxLength Zeichen werden ohnehin abgeschnitten
+    QByteArray out;
+    QElapsedTimer timer;
+    timer.start();
+    while (!process.waitForFinished(100) && process.state() != QProcess::NotRunning) {
+        out += process.readAllStandardOutput();
+        if ((cancelled && *cancelled) || timer.elapsed() > ProcessTimeout) {
+            process.kill();
+            process.waitForFinished(1000);
+            return QString();
+        }
+        if (out.size() > qsizetype(MaxLength) * 4) {
+            process.kill();
+            process.waitForFinished(1000);
+            return QString::fromUtf8(out);
+        }
+    }
+    out += process.readAllStandardOutput();
+    return QString::fromUtf8(out);
+}
+
+QString TextExtractor::fromZip(const QByteArray &data, Kind kind, const std::atomic<bool> *cancelled)
+{
+    // Folien in ihrer Reihenfolge, nicht in der des Archivs
+    QMap<int, ZipEntry> parts;
+    const QVector<ZipEntry> entries = zipDirectory(data);
+    for (const ZipEntry &entry : entries) {
+        if (kind == OpenDocument) {
+            if (entry.name == "content.xml") {
+                parts.insert(0, entry);
+            }
+        } else if (entry.name == "word/document.xml" || entry.name == "xl/sharedStrings.xml") {
+            parts.insert(0, entry);
+        } else if (entry.name.startsWith("ppt/slides/slide") && entry.name.endsWith(".xml")) {
+            bool ok = false;
+            const int number = entry.name.mid(16, entry.name.size() - 20).toInt(&ok);
+            if (ok) {
+                parts.insert(number, entry);
+            }
+        }
+    }
+
+    QString text;
+    for (const ZipEntry &entry : std::as_const(parts)) {
+        if ((cancelled && *cancelled) || text.size() > MaxLength) {
+            break;
+        }
+        text += stripMarkup(zipData(data, entry));
+        text += QLatin1Char('\n');
+    }
+    return text;
+}
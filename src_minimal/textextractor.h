@@ -0,0 +1,53 @@
+/*
+ * mailadler - Attachment Text Extraction
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef TEXTEXTRACTOR_H
+#define TEXTEXTRACTOR_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+#include <atomic>
+
+#include "bodystructure.h"
+
+// Durchsuchbarer Text aus Anhängen.
+//
+// Textanhänge (auch HTML, CSV) werden über ihren Zeichensatz gelesen,
+// Office-Dokumente (docx, xlsx, pptx, odt, ods, odp) direkt aus dem
+// ZIP-Container entpackt und von ihren XML-Tags befreit. PDF geht an das
+// externe pdftotext (poppler-utils); fehlt es, bleiben PDFs ohne Text.
+// Alle Funktionen sind threadsicher.
+class TextExtractor
+{
+public:
+    enum Kind { None, PlainText, Html, Pdf, OfficeOpenXml, OpenDocument };
+
+    // Höchstens so viele Zeichen je Anhang
+    static const int MaxLength = 1024 * 1024;
+    // Grenze für entpackte XML-Dateien, gegen ZIP-Bomben
+    static const qint64 MaxInflatedSize = 64 * 1024 * 1024;
+    // Laufzeitgrenze für pdftotext
+    static const int ProcessTimeout = 60000; // ms
+
+    static Kind kindOf(const MimePart &part);
+    static bool canExtract(const MimePart &part) { return kindOf(part) != None; }
+
+    // data noch mit Content-Transfer-Encoding wie im BodyCache; leer, wenn
+    // nichts zu finden ist oder cancelled gesetzt wurde
+    static QString extract(const QByteArray &data, const MimePart &part,
+                           const std::atomic<bool> *cancelled = nullptr);
+
+    // Tags entfernen, Entitäten auflösen; Absatzenden werden Zeilenumbrüche
+    static QString stripMarkup(QByteArrayView markup);
+
+private:
+    static QString fromPdf(const QByteArray &data, const std::atomic<bool> *cancelled);
+    static QString fromZip(const QByteArray &data, Kind kind, const std::atomic<bool> *cancelled);
+};
+
+#endif // TEXTEXTRACTOR_H
@@ -0,0 +1,124 @@
+/*
+ * mailadler - Text Normalization for Search
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "textnormalizer.h"
+
+namespace {
+
+// Kürzere Wörter bleiben ungestemmt, Wörter mit Ziffern ebenfalls (Rechnungsnummern)
+const int MinStemLength = 4;
+
+bool endsWith(const QString &w, const char *suffix)
+{
+    return w.endsWith(QLatin1String(suffix));
+}
+
+} // namespace
+
+QString TextNormalizer::normalize(const QString &text)
+{
+    return terms(text).join(QLatin1Char(' '));
+}
+
+QStringList TextNormalizer::terms(const QString &text)
+{
+    QStringList result;
+    QString word;
+    bool hasDigit = false;
+
+    auto finish = [&]() {
+        if (word.isEmpty()) {
+            return;
+        }
+        const QString folded = fold(word);
+        result.append(hasDigit || folded.size() < MinStemLength ? folded : stem(folded));
+        word.clear();
+        hasDigit = false;
+    };
+
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            word.append(c.toLower());
+            hasDigit = hasDigit || c.isDigit();
+        } else if (c.category() != QChar::Mark_NonSpacing) {
+            finish();
+        }
+    }
+    finish();
+    return result;
+}
+
+QString TextNormalizer::fold(const QString &word)
+{
+    QString out;
+    out.reserve(word.size() + 2);
+    for (const QChar c : word) {
+        const ushort u = c.unicode();
+        if (u < 0x80) {
+            out.append(c);
+        } else if (u == 0x00df) { // ß
+            out.append(QLatin1String("ss"));
+        } else if (c.decompositionTag() == QChar::Canonical) {
+            // é -> e + Akzent: nur den Grundbuchstaben behalten
+            out.append(c.decomposition().at(0));
+        } else {
+            out.append(c);
+        }
+    }
+
+    // Umschreibungen ae/oe/ue wie Umlaute behandeln, aber nicht "que"
+    QString result;
+    result.reserve(out.size());
+    for (int i = 0; i < out.size(); ++i) {
+        const QChar c = out.at(i);
+        if (c == QLatin1Char('e') && i > 0) {
+            const QChar prev = out.at(i - 1);
+            if ((prev == QLatin1Char('a') || prev == QLatin1Char('o')
+                 || (prev == QLatin1Char('u') && (i < 2 || out.at(i - 2) != QLatin1Char('q'))))) {
+                continue;
+            }
+        }
+        result.append(c);
+    }
+    return result;
+}
+
+QString TextNormalizer::stem(const QString &word)
+{
+    // CISTEM, Variante ohne Groß-/Kleinschreibung; Umlaute sind schon gefaltet
+    QString w = word;
+    if (w.size() >= 6 && w.startsWith(QLatin1String("ge"))) {
+        w.remove(0, 2);
+    }
+    w.replace(QLatin1String("sch"), QLatin1String("$"));
+    w.replace(QLatin1String("ei"), QLatin1String("%"));
+    w.replace(QLatin1String("ie"), QLatin1String("&"));
+    for (int i = 1; i < w.size(); ++i) {
+        if (w.at(i) == w.at(i - 1)) {
+            w[i] = QLatin1Char('*');
+        }
+    }
+
+    while (w.size() > 3) {
+        if (w.size() > 5 && (endsWith(w, "em") || endsWith(w, "er") || endsWith(w, "nd"))) {
+            w.chop(2);
+        } else if (endsWith(w, "t") || endsWith(w, "e") || endsWith(w, "s") || endsWith(w, "n")) {
+            w.chop(1);
+        } else {
+            break;
+        }
+    }
+
+    for (int i = 1; i < w.size(); ++i) {
+        if (w.at(i) == QLatin1Char('*')) {
+            w[i] = w.at(i - 1);
+        }
+    }
+    w.replace(QLatin1String("%"), QLatin1String("ei"));
+    w.replace(QLatin1String("&"), QLatin1String("ie"));
+    w.replace(QLatin1String("$"), QLatin1String("sch"));
+    return w;
+}
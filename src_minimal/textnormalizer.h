@@ -0,0 +1,29 @@
+/*
+ * mailadler - Text Normalization for Search
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef TEXTNORMALIZER_H
+#define TEXTNORMALIZER_H
+
+#include <QString>
+#include <QStringList>
+
+// Zerlegt Text in Suchbegriffe: Kleinschreibung, Umlaute und andere
+// diakritische Zeichen gefaltet (ä/ae -> a, ß -> ss, é -> e), deutsche
+// Wortformen auf ihren Stamm reduziert (CISTEM, Weissweiler & Fraser 2017).
+// Index und Suchanfrage laufen durch dieselbe Normalisierung, daher finden
+// "Müller", "Mueller" und "Muller" dasselbe, ebenso "Rechnung"/"Rechnungen".
+class TextNormalizer
+{
+public:
+    // Begriffe durch Leerzeichen getrennt, für den Index
+    static QString normalize(const QString &text);
+    static QStringList terms(const QString &text);
+
+    static QString fold(const QString &word);
+    static QString stem(const QString &word);
+};
+
+#endif // TEXTNORMALIZER_H
@@ -0,0 +1,363 @@
+/*
+ * mailadler - Conversation Threading
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#include "threadbuilder.h"
+#include "messagestore.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Antwort- und Weiterleitungspräfixe, auch von deutschen Programmen
+const char *const ReplyPrefixes[] = {"re", "aw", "antw", "fwd", "fw", "wg"};
+
+} // namespace
+
+ThreadBuilder::ThreadBuilder()
+{
+}
+
+void ThreadBuilder::clear()
+{
+    m_nodes.clear();
+    m_byId.clear();
+    m_byUid.clear();
+    m_bySubject.clear();
+    m_serverRoots.clear();
+}
+
+void ThreadBuilder::reserve(int messages)
+{
+    // Dazu kommen Knoten für fehlende Vorgänger
+    m_nodes.reserve(messages + messages / 4);
+    m_byId.reserve(messages);
+    m_byUid.reserve(messages);
+}
+
+bool ThreadBuilder::load(MessageStore *store, int mailboxId)
+{
+    clear();
+    reserve(store->messageCount(mailboxId));
+
+    QSqlQuery query(store->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT uid, message_id, refs, subject FROM messages WHERE mailbox_id = ? ORDER BY uid");
+    query.addBindValue(mailboxId);
+    if (!query.exec()) {
+        qWarning() << "ThreadBuilder:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        add(query.value(0).toUInt(), query.value(1).toString().toLatin1(), query.value(2).toString().toLatin1(),
+            query.value(3).toString());
+    }
+    return true;
+}
+
+void ThreadBuilder::add(const QList<EmailHeader> &headers)
+{
+    for (const EmailHeader &h : headers) {
+        add(h.uid, h.messageId.toLatin1(), h.references, h.subject);
+    }
+}
+
+void ThreadBuilder::add(quint32 uid, QByteArrayView messageId, QByteArrayView references, const QString &subject)
+{
+    if (m_byUid.contains(uid)) {
+        return;
+    }
+    int node = messageId.isEmpty() ? -1 : nodeFor(messageId);
+    if (node < 0 || m_nodes[node].uid) {
+        // Ohne oder mit doppelter Message-ID: eigener Knoten
+        node = newNode();
+    }
+    m_nodes[node].uid = uid;
+    m_byUid.insert(uid, node);
+    addCount(node, 1);
+
+    // Die Verweise untereinander verketten, vorhandene Verknüpfungen bleiben
+    int previous = -1;
+    qsizetype pos = 0;
+    while (pos < references.size()) {
+        qsizetype space = references.indexOf(' ', pos);
+        if (space < 0) {
+            space = references.size();
+        }
+        const QByteArrayView id = references.sliced(pos, space - pos);
+        pos = space + 1;
+        if (id.isEmpty()) {
+            continue;
+        }
+        const int ref = nodeFor(id);
+        if (previous >= 0 && ref != previous && m_nodes[ref].parent < 0 && !isAncestor(ref, previous)) {
+            link(previous, ref);
+        }
+        previous = ref;
+    }
+
+    // Der letzte Verweis ist der Vorgänger dieser Nachricht
+    if (previous >= 0 && previous != node && !isAncestor(node, previous)) {
+        if (m_nodes[node].parent != previous) {
+            unlink(node);
+            link(previous, node);
+        }
+        return;
+    }
+    if (previous >= 0) {
+        return;
+    }
+
+    unlink(node);
+    bool reply = false;
+    const QString base = baseSubject(subject, &reply);
+    if (base.isEmpty()) {
+        return;
+    }
+    if (!reply) {
+        if (!m_bySubject.contains(base)) {
+            m_bySubject.insert(base, node);
+        }
+        return;
+    }
+    const int original = m_bySubject.value(base, -1);
+    if (original >= 0 && original != node && !isAncestor(node, original)) {
+        link(original, node);
+    }
+}
+
+void ThreadBuilder::remove(const QVector<UidRange> &ranges)
+{
+    for (const UidRange &r : ranges) {
+        QVector<quint32> gone;
+        if (quint64(r.last) - r.first < quint64(m_byUid.size())) {
+            for (quint64 uid = r.first; uid <= r.last; ++uid) {
+                if (m_byUid.contains(quint32(uid))) {
+                    gone.append(quint32(uid));
+                }
+            }
+        } else {
+            // Großer Bereich, z.B. der ganze Ordner: über den Bestand laufen
+            for (auto it = m_byUid.cbegin(); it != m_byUid.cend(); ++it) {
+                if (it.key() >= r.first && it.key() <= r.last) {
+                    gone.append(it.key());
+                }
+            }
+        }
+        for (quint32 uid : gone) {
+            // Der Knoten bleibt als Platzhalter, seine Antworten hängen weiter daran
+            const int node = m_byUid.take(uid);
+            m_nodes[node].uid = 0;
+            addCount(node, -1);
+        }
+    }
+}
+
+void ThreadBuilder::applyServerThreads(const QVector<ImapThreadLink> &links)
+{
+    for (const ImapThreadLink &l : links) {
+        const int node = m_byUid.value(l.uid, -1);
+        if (node < 0) {
+            continue;
+        }
+        int target = -1;
+        if (l.parent) {
+            target = m_byUid.value(l.parent, -1);
+        } else if (l.uid != l.thread || m_serverRoots.contains(l.thread)) {
+            // Geschwister unter einer fehlenden Wurzel: Platzhalter dafür,
+            // auch bei einem späteren Abgleich
+            auto it = m_serverRoots.find(l.thread);
+            if (it == m_serverRoots.end()) {
+                const int root = newNode();
+                it = m_serverRoots.insert(l.thread, root);
+                const int first = m_byUid.value(l.thread, -1);
+                if (first >= 0) {
+                    unlink(first);
+                    link(root, first);
+                }
+            }
+            target = it.value();
+        }
+        if (m_nodes[node].parent == target) {
+            continue;
+        }
+        unlink(node);
+        if (target >= 0 && !isAncestor(node, target)) {
+            link(target, node);
+        }
+    }
+}
+
+quint32 ThreadBuilder::parent(quint32 uid) const
+{
+    const int node = m_byUid.value(uid, -1);
+    for (int n = node >= 0 ? m_nodes[node].parent : -1; n >= 0; n = m_nodes[n].parent) {
+        if (m_nodes[n].uid) {
+            return m_nodes[n].uid;
+        }
+    }
+    return 0;
+}
+
+int ThreadBuilder::depth(quint32 uid) const
+{
+    const int node = m_byUid.value(uid, -1);
+    int depth = 0;
+    for (int n = node >= 0 ? m_nodes[node].parent : -1; n >= 0; n = m_nodes[n].parent) {
+        if (m_nodes[n].uid) {
+            ++depth;
+        }
+    }
+    return depth;
+}
+
+int ThreadBuilder::threadSize(quint32 uid) const
+{
+    const int node = m_byUid.value(uid, -1);
+    return node >= 0 ? m_nodes[top(node)].count : 0;
+}
+
+QVector<quint32> ThreadBuilder::threadUids(quint32 uid) const
+{
+    QVector<quint32> uids;
+    const int node = m_byUid.value(uid, -1);
+    if (node < 0) {
+        return uids;
+    }
+    const int root = top(node);
+    uids.reserve(m_nodes[root].count);
+    // Tiefensuche ohne Rekursion über die Geschwisterlisten
+    QVector<int> stack{root};
+    while (!stack.isEmpty()) {
+        const int n = stack.takeLast();
+        if (m_nodes[n].uid) {
+            uids.append(m_nodes[n].uid);
+        }
+        for (int child = m_nodes[n].firstChild; child >= 0; child = m_nodes[child].nextSibling) {
+            stack.append(child);
+        }
+    }
+    std::sort(uids.begin(), uids.end(), std::greater<quint32>());
+    return uids;
+}
+
+QString ThreadBuilder::baseSubject(const QString &subject, bool *reply)
+{
+    QStringView s = QStringView(subject).trimmed();
+    bool isReply = false;
+    bool changed = true;
+    while (changed && !s.isEmpty()) {
+        changed = false;
+        // Listenkennung "[liste]"
+        if (s.startsWith(QLatin1Char('['))) {
+            const qsizetype close = s.indexOf(QLatin1Char(']'));
+            if (close > 0) {
+                s = s.sliced(close + 1).trimmed();
+                changed = true;
+                continue;
+            }
+        }
+        for (const char *prefix : ReplyPrefixes) {
+            const QLatin1String p(prefix);
+            if (!s.startsWith(p, Qt::CaseInsensitive)) {
+                continue;
+            }
+            qsizetype i = p.size();
+            // Zähler wie "Re[2]:" oder "AW(3):"
+            if (i < s.size() && (s[i] == QLatin1Char('[') || s[i] == QLatin1Char('('))) {
+                while (i < s.size() && s[i] != QLatin1Char(']') && s[i] != QLatin1Char(')')) {
+                    ++i;
+                }
+                ++i;
+            }
+            if (i < s.size() && s[i] == QLatin1Char(':')) {
+                s = s.sliced(i + 1).trimmed();
+                isReply = true;
+                changed = true;
+                break;
+            }
+        }
+    }
+    if (s.endsWith(QLatin1String("(fwd)"), Qt::CaseInsensitive)) {
+        s = s.chopped(5).trimmed();
+        isReply = true;
+    }
+    if (reply) {
+        *reply = isReply;
+    }
+    return s.toString().toLower();
+}
+
+int ThreadBuilder::nodeFor(QByteArrayView messageId)
+{
+    const QByteArray key = messageId.toByteArray();
+    auto it = m_byId.constFind(key);
+    if (it != m_byId.constEnd()) {
+        return it.value();
+    }
+    const int node = newNode();
+    m_byId.insert(key, node);
+    return node;
+}
+
+int ThreadBuilder::newNode()
+{
+    m_nodes.append(Node());
+    return int(m_nodes.size() - 1);
+}
+
+int ThreadBuilder::top(int node) const
+{
+    while (m_nodes[node].parent >= 0) {
+        node = m_nodes[node].parent;
+    }
+    return node;
+}
+
+bool ThreadBuilder::isAncestor(int ancestor, int node) const
+{
+    for (int n = node; n >= 0; n = m_nodes[n].parent) {
+        if (n == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadBuilder::link(int parent, int child)
+{
+    Node &c = m_nodes[child];
+    c.parent = parent;
+    c.nextSibling = m_nodes[parent].firstChild;
+    m_nodes[parent].firstChild = child;
+    addCount(parent, c.count);
+}
+
+void ThreadBuilder::unlink(int child)
+{
+    const int parent = m_nodes[child].parent;
+    if (parent < 0) {
+        return;
+    }
+    int *slot = &m_nodes[parent].firstChild;
+    while (*slot != child) {
+        slot = &m_nodes[*slot].nextSibling;
+    }
+    *slot = m_nodes[child].nextSibling;
+    m_nodes[child].parent = -1;
+    m_nodes[child].nextSibling = -1;
+    addCount(parent, -m_nodes[child].count);
+}
+
+void ThreadBuilder::addCount(int node, int delta)
+{
+    for (int n = node; n >= 0; n = m_nodes[n].parent) {
+        m_nodes[n].count += delta;
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * mailadler - Conversation Threading
+ * Copyright (c) 2026 Georg Dahmen
+ * GPLv3 License
+ */
+
+#ifndef THREADBUILDER_H
+#define THREADBUILDER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "imapconnection.h"
+
+class MessageStore;
+
+// Unterhaltungen eines Ordners nach JWZ (wie RFC 5256 REFERENCES).
+//
+// Jede Message-ID bekommt einen Knoten, auch wenn die Nachricht selbst
+// (noch) fehlt; References verketten die Knoten. Eine neue Nachricht wird
+// nur eingehängt, der Wald wird nie neu aufgebaut: Kosten O(Länge der
+// References + Tiefe), die Tiefe für die Schleifenprüfung. Jeder Knoten
+// zählt die Nachrichten in seinem Teilbaum, die Größe einer Unterhaltung
+// steht also an der Wurzel.
+//
+// Bietet der Server THREAD=REFERENCES, überschreibt dessen Ergebnis die
+// lokalen Verknüpfungen (applyServerThreads); danach kommen neue
+// Nachrichten wieder lokal hinzu. Betreff-Gruppierung nur vereinfacht:
+// eine Antwort ohne References hängt unter der ersten Nachricht mit
+// gleichem Grundbetreff.
+class ThreadBuilder
+{
+public:
+    ThreadBuilder();
+
+    void clear();
+    void reserve(int messages);
+    // Alle Nachrichten eines Ordners aus dem MessageStore, aufsteigend nach UID
+    bool load(MessageStore *store, int mailboxId);
+
+    // references: Message-IDs wie in EmailHeader::references
+    void add(quint32 uid, QByteArrayView messageId, QByteArrayView references, const QString &subject);
+    void add(const QList<EmailHeader> &headers);
+    void remove(const QVector<UidRange> &ranges);
+    void applyServerThreads(const QVector<ImapThreadLink> &links);
+
+    bool contains(quint32 uid) const { return m_byUid.contains(uid); }
+    int messageCount() const { return int(m_byUid.size()); }
+    // Direkter Vorgänger mit vorhandener Nachricht, sonst 0
+    quint32 parent(quint32 uid) const;
+    int depth(quint32 uid) const;
+    // Nachrichten in der Unterhaltung von uid (mindestens 1)
+    int threadSize(quint32 uid) const;
+    // Alle UIDs der Unterhaltung, absteigend
+    QVector<quint32> threadUids(quint32 uid) const;
+
+    // "Re: AW: [liste] Betreff" -> "betreff"; reply = Präfix entfernt
+    static QString baseSubject(const QString &subject, bool *reply = nullptr);
+
+private:
+    struct Node {
+        int parent = -1;
+        int firstChild = -1;
+        int nextSibling = -1;
+        int count = 0; // Nachrichten im Teilbaum
+        quint32 uid = 0;
+    };
+
+    int nodeFor(QByteArrayView messageId);
+    int newNode();
+    int top(int node) const;
+    bool isAncestor(int ancestor, int node) const;
+    void link(int parent, int child);
+    void unlink(int child);
+    void addCount(int node, int delta);
+
+    QVector<Node> m_nodes;
+    QHash<QByteArray, int> m_byId;
+    QHash<quint32, int> m_byUid;
+    // Grundbetreff -> erste Nachricht, die keine Antwort ist
+    QHash<QString, int> m_bySubject;
+    // Unterhaltungen mit fehlender Wurzel aus UID THREAD
+    QHash<quint32, int> m_serverRoots;
+};
+
+#endif // THREADBUILDER_H